@@ -39,16 +39,49 @@
  * BSD Licensed as described in the file LICENSE
  */
 #include "dht.h"
+#include "dht_decode.h"
 
 #include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <string.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include "lwip/sys.h"
 
+#if CONFIG_DHT_SIMULATOR
+#include "dht_sim.h"
+#define dht_gpio_set_direction dht_sim_set_direction
+#define dht_gpio_set_level dht_sim_set_level
+#define dht_gpio_get_level dht_sim_get_level
+#define dht_delay_us dht_sim_delay_us
+#else
+#include <freertos/ringbuf.h>
+#define dht_gpio_set_direction gpio_set_direction
+#define dht_gpio_set_level gpio_set_level
+#define dht_gpio_get_level gpio_get_level
+#define dht_delay_us ets_delay_us
+#endif
+
 // DHT timer precision in microseconds
 #define DHT_TIMER_INTERVAL 2
-#define DHT_DATA_BITS 40
-#define DHT_DATA_BYTES (DHT_DATA_BITS / 8)
+
+// Bit timeouts, with headroom for the slow edges of long cables
+#define DHT_BIT_LOW_TIMEOUT_US 85
+#define DHT_BIT_HIGH_TIMEOUT_US 95
+
+// Phase 'A' length, DHT11 needs at least 18 ms
+#define DHT_START_PULSE_MS 20
+#define SI7021_START_PULSE_US 500
+
+#if !CONFIG_DHT_SIMULATOR
+// RMT capture: 1 us ticks, frame ends after 100 us without an edge
+#define DHT_RMT_CLK_DIV 80
+#define DHT_RMT_IDLE_US 100
+#define DHT_RMT_FILTER_TICKS 100
+#define DHT_RMT_RINGBUF_SIZE 512
+#define DHT_RMT_TIMEOUT_MS 20
+#define DHT_RMT_MAX_EDGES 96
+#endif
 
 /*
  *  Note:
@@ -80,20 +113,46 @@
 
 static const char *TAG = "dht";
 
+#if !CONFIG_DHT_SIMULATOR
+typedef struct
+{
+    bool attached;
+    rmt_channel_t channel;
+    RingbufHandle_t rb;
+} dht_rmt_slot_t;
+
+static dht_rmt_slot_t rmt_slots[GPIO_NUM_MAX];
+#endif
+static dht_stats_t stats[GPIO_NUM_MAX];
+
+/*
+ * Faults are only recorded while the line is being read and are logged
+ * and counted after the critical section is left.
+ */
+static const char *fault_msg[] = {
+    [DHT_FAULT_PHASE_B] = "Initialization error, problem in phase 'B'",
+    [DHT_FAULT_PHASE_C] = "Initialization error, problem in phase 'C'",
+    [DHT_FAULT_PHASE_D] = "Initialization error, problem in phase 'D'",
+    [DHT_FAULT_BIT_LOW] = "LOW bit timeout",
+    [DHT_FAULT_BIT_HIGH] = "HIGH bit timeout",
+    [DHT_FAULT_CAPTURE] = "RMT capture error, no response from sensor",
+    [DHT_FAULT_CRC] = "Checksum failed, invalid data received from sensor",
+};
+
 static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
 #define PORT_ENTER_CRITICAL() portENTER_CRITICAL(&mux)
 #define PORT_EXIT_CRITICAL() portEXIT_CRITICAL(&mux)
 
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
-#define CHECK_LOGE(x, msg, ...) do { \
-        esp_err_t __; \
-        if ((__ = x) != ESP_OK) { \
-            PORT_EXIT_CRITICAL(); \
-            ESP_LOGE(TAG, msg, ## __VA_ARGS__); \
-            return __; \
-        } \
-    } while (0)
+#define CHECK_PHASE(x, fault) do { if ((x) != ESP_OK) return fault; } while (0)
+
+// a single supported type turns every branch on the type into a constant
+#ifdef DHT_TYPE_FIXED
+#define DHT_TYPE(type) DHT_TYPE_FIXED
+#else
+#define DHT_TYPE(type) (type)
+#endif
 
 
 /**
@@ -109,12 +168,12 @@ static esp_err_t dht_await_pin_state(gpio_num_t pin, uint32_t timeout,
      * the direction before return. however, the SDK does not provide
      * gpio_get_direction().
      */
-    gpio_set_direction(pin, GPIO_MODE_INPUT);
+    dht_gpio_set_direction(pin, GPIO_MODE_INPUT);
     for (uint32_t i = 0; i < timeout; i += DHT_TIMER_INTERVAL)
     {
         // need to wait at least a single interval to prevent reading a jitter
-        ets_delay_us(DHT_TIMER_INTERVAL);
-        if (gpio_get_level(pin) == expected_pin_state)
+        dht_delay_us(DHT_TIMER_INTERVAL);
+        if (dht_gpio_get_level(pin) == expected_pin_state)
         {
             if (duration)
                 *duration = i;
@@ -126,48 +185,149 @@ static esp_err_t dht_await_pin_state(gpio_num_t pin, uint32_t timeout,
 }
 
 /**
- * Request data from DHT and read raw bit stream.
- * The function call should be protected from task switching.
- * Return false if error occurred.
+ * Phase 'A': pull the line low long enough to wake the sensor up.
+ * Only the short Si7021 pulse is busy-waited, the DHT pulse sleeps
+ * so interrupts and the scheduler keep running.
  */
-static inline esp_err_t dht_fetch_data(dht_sensor_type_t sensor_type, gpio_num_t pin, uint8_t data[DHT_DATA_BYTES])
+static void dht_start_signal(dht_sensor_type_t sensor_type, gpio_num_t pin)
+{
+    dht_gpio_set_level(pin, 0);
+    if (DHT_TYPE(sensor_type) == DHT_TYPE_SI7021)
+        dht_delay_us(SI7021_START_PULSE_US);
+    else
+        // one extra tick, vTaskDelay() may return up to a tick early
+        vTaskDelay(pdMS_TO_TICKS(DHT_START_PULSE_MS) + 1);
+}
+
+/**
+ * Release the line after the start signal and read raw pulse widths.
+ * The function call should be protected from task switching, see
+ * dht_fetch_data_locked(). It must not log.
+ */
+static inline dht_fault_t dht_fetch_data(gpio_num_t pin, dht_pulse_t pulses[DHT_DATA_BITS],
+        uint16_t *preamble_high)
 {
     uint32_t low_duration;
     uint32_t high_duration;
 
-    // Phase 'A' pulling signal low to initiate read sequence
-    gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
-    gpio_set_level(pin, 0);
-    ets_delay_us(sensor_type == DHT_TYPE_SI7021 ? 500 : 20000);
-    gpio_set_level(pin, 1);
+    // End of phase 'A', release the line
+    dht_gpio_set_level(pin, 1);
 
     // Step through Phase 'B', 40us
-    CHECK_LOGE(dht_await_pin_state(pin, 40, 0, NULL),
-            "Initialization error, problem in phase 'B'");
+    CHECK_PHASE(dht_await_pin_state(pin, 40, 0, NULL), DHT_FAULT_PHASE_B);
     // Step through Phase 'C', 88us
-    CHECK_LOGE(dht_await_pin_state(pin, 88, 1, NULL),
-            "Initialization error, problem in phase 'C'");
+    CHECK_PHASE(dht_await_pin_state(pin, 88, 1, NULL), DHT_FAULT_PHASE_C);
     // Step through Phase 'D', 88us
-    CHECK_LOGE(dht_await_pin_state(pin, 88, 0, NULL),
-            "Initialization error, problem in phase 'D'");
+    CHECK_PHASE(dht_await_pin_state(pin, 88, 0, &high_duration), DHT_FAULT_PHASE_D);
+    *preamble_high = high_duration;
 
     // Read in each of the 40 bits of data...
     for (int i = 0; i < DHT_DATA_BITS; i++)
     {
-        CHECK_LOGE(dht_await_pin_state(pin, 65, 1, &low_duration),
-                "LOW bit timeout");
-        CHECK_LOGE(dht_await_pin_state(pin, 75, 0, &high_duration),
-                "HIGH bit timeout");
+        CHECK_PHASE(dht_await_pin_state(pin, DHT_BIT_LOW_TIMEOUT_US, 1, &low_duration), DHT_FAULT_BIT_LOW);
+        CHECK_PHASE(dht_await_pin_state(pin, DHT_BIT_HIGH_TIMEOUT_US, 0, &high_duration), DHT_FAULT_BIT_HIGH);
+
+        pulses[i].low = low_duration;
+        pulses[i].high = high_duration;
+    }
+
+    return DHT_FAULT_NONE;
+}
 
-        uint8_t b = i / 8;
-        uint8_t m = i % 8;
-        if (!m)
-            data[b] = 0;
+/**
+ * Run the bit-banged transfer with task switching and interrupts disabled.
+ * This is the only place the lock is taken, so every path releases it.
+ */
+static dht_fault_t dht_fetch_data_locked(gpio_num_t pin, dht_pulse_t pulses[DHT_DATA_BITS],
+        uint16_t *preamble_high, uint32_t *cs_us)
+{
+    PORT_ENTER_CRITICAL();
+    int64_t start = esp_timer_get_time();
+    dht_fault_t fault = dht_fetch_data(pin, pulses, preamble_high);
+    *cs_us = esp_timer_get_time() - start;
+    PORT_EXIT_CRITICAL();
+
+    return fault;
+}
 
-        data[b] |= (high_duration > low_duration) << (7 - m);
+#if !CONFIG_DHT_SIMULATOR
+/**
+ * Request data from DHT and capture the pulse train with RMT.
+ * Nothing but the start pulse is timed by the CPU, so no critical
+ * section is needed.
+ */
+static dht_fault_t dht_rmt_fetch_data(dht_sensor_type_t sensor_type, gpio_num_t pin,
+        dht_pulse_t pulses[DHT_DATA_BITS], uint16_t *preamble_high)
+{
+    dht_rmt_slot_t *slot = &rmt_slots[pin];
+    rmt_item32_t *items;
+    size_t size = 0;
+
+    // drop anything captured since the last read
+    while ((items = xRingbufferReceive(slot->rb, &size, 0)) != NULL)
+        vRingbufferReturnItem(slot->rb, items);
+
+    dht_start_signal(sensor_type, pin);
+    rmt_rx_start(slot->channel, true);
+    gpio_set_level(pin, 1);
+
+    items = xRingbufferReceive(slot->rb, &size, pdMS_TO_TICKS(DHT_RMT_TIMEOUT_MS));
+    rmt_rx_stop(slot->channel);
+    if (!items)
+        return DHT_FAULT_CAPTURE;
+
+    dht_edge_t edges[DHT_RMT_MAX_EDGES];
+    size_t count = 0;
+    for (size_t i = 0; i < size / sizeof(rmt_item32_t) && count + 2 <= DHT_RMT_MAX_EDGES; i++)
+    {
+        edges[count].duration = items[i].duration0;
+        edges[count++].level = items[i].level0;
+        edges[count].duration = items[i].duration1;
+        edges[count++].level = items[i].level1;
     }
+    vRingbufferReturnItem(slot->rb, items);
 
-    return ESP_OK;
+    switch (dht_decode_edges(edges, count, pulses, preamble_high))
+    {
+    case DHT_DECODE_NO_PREAMBLE:
+        return DHT_FAULT_CAPTURE;
+    case DHT_DECODE_TRUNCATED:
+        return DHT_FAULT_BIT_LOW;
+    default:
+        return DHT_FAULT_NONE;
+    }
+}
+#endif
+
+/**
+ * Count a fault in the per-pin error counters.
+ */
+static void dht_count_fault(dht_error_counters_t *errors, dht_fault_t fault)
+{
+    switch (fault)
+    {
+    case DHT_FAULT_PHASE_B:
+        errors->phase_b_timeouts++;
+        break;
+    case DHT_FAULT_PHASE_C:
+        errors->phase_c_timeouts++;
+        break;
+    case DHT_FAULT_PHASE_D:
+        errors->phase_d_timeouts++;
+        break;
+    case DHT_FAULT_BIT_LOW:
+    case DHT_FAULT_BIT_HIGH:
+        errors->bit_timeouts++;
+        break;
+    case DHT_FAULT_CAPTURE:
+        errors->capture_errors++;
+        break;
+    case DHT_FAULT_CRC:
+        errors->crc_failures++;
+        break;
+    default:
+        break;
+    }
 }
 
 /**
@@ -177,7 +337,7 @@ static inline int16_t dht_convert_data(dht_sensor_type_t sensor_type, uint8_t ms
 {
     int16_t data;
 
-    if (sensor_type == DHT_TYPE_DHT11)
+    if (DHT_TYPE(sensor_type) == DHT_TYPE_DHT11)
     {
         data = msb * 10;
     }
@@ -193,42 +353,86 @@ static inline int16_t dht_convert_data(dht_sensor_type_t sensor_type, uint8_t ms
     return data;
 }
 
-esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin,
-        int16_t *humidity, int16_t *temperature)
+esp_err_t dht_read_raw(dht_sensor_type_t sensor_type, gpio_num_t pin, uint8_t data[DHT_RAW_LEN])
 {
-    CHECK_ARG(humidity || temperature);
+    CHECK_ARG(data);
+    CHECK_ARG(pin >= 0 && pin < GPIO_NUM_MAX);
+#ifdef DHT_TYPE_FIXED
+    if (sensor_type != DHT_TYPE_FIXED)
+        return ESP_ERR_NOT_SUPPORTED;
+#endif
+
+    dht_pulse_t pulses[DHT_DATA_BITS];
+    uint16_t preamble_high = 0;
+    dht_decode_info_t info = { .corrected_bit = -1 };
+    uint32_t cs_us = 0;
+    dht_fault_t fault;
+
+#if !CONFIG_DHT_SIMULATOR
+    if (rmt_slots[pin].attached)
+    {
+        fault = dht_rmt_fetch_data(sensor_type, pin, pulses, &preamble_high);
+    }
+    else
+#endif
+    {
+        dht_gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
+        dht_start_signal(sensor_type, pin);
 
-    uint8_t data[DHT_DATA_BYTES] = { 0 };
+        fault = dht_fetch_data_locked(pin, pulses, &preamble_high, &cs_us);
 
-    gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
-    gpio_set_level(pin, 1);
+        /* restore GPIO direction because, after calling dht_fetch_data(), the
+         * GPIO direction mode changes */
+        dht_gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
+        dht_gpio_set_level(pin, 1);
+    }
 
-    PORT_ENTER_CRITICAL();
-    esp_err_t result = dht_fetch_data(sensor_type, pin, data);
-    if (result == ESP_OK)
-        PORT_EXIT_CRITICAL();
+    if (fault == DHT_FAULT_NONE && !dht_decode_adaptive(pulses, preamble_high, data, &info))
+        fault = DHT_FAULT_CRC;
 
-    /* restore GPIO direction because, after calling dht_fetch_data(), the
-     * GPIO direction mode changes */
-    gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
-    gpio_set_level(pin, 1);
+    stats[pin].reads++;
+    if (info.corrected_bit >= 0)
+        stats[pin].corrected++;
+    stats[pin].cs_last_us = cs_us;
+    stats[pin].last_fault = fault;
+    if (cs_us > stats[pin].cs_max_us)
+        stats[pin].cs_max_us = cs_us;
 
-    if (result != ESP_OK)
-        return result;
-
-    if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF))
+    if (fault != DHT_FAULT_NONE)
     {
-        ESP_LOGE(TAG, "Checksum failed, invalid data received from sensor");
-        return ESP_ERR_INVALID_CRC;
+        dht_count_fault(&stats[pin].errors, fault);
+        ESP_LOGE(TAG, "%s", fault_msg[fault]);
+        return fault == DHT_FAULT_CRC ? ESP_ERR_INVALID_CRC : ESP_ERR_TIMEOUT;
     }
 
+    ESP_LOGD(TAG, "Sensor data: %02x %02x %02x %02x, critical section %u us, threshold %u us, margin %u us",
+            data[0], data[1], data[2], data[3], cs_us, info.threshold, info.margin);
+    if (info.corrected_bit >= 0)
+        ESP_LOGW(TAG, "Bit %d corrected against the checksum", info.corrected_bit);
+
+    return ESP_OK;
+}
+
+void dht_convert(dht_sensor_type_t sensor_type, const uint8_t data[DHT_RAW_LEN],
+        int16_t *humidity, int16_t *temperature)
+{
     if (humidity)
         *humidity = dht_convert_data(sensor_type, data[0], data[1]);
     if (temperature)
         *temperature = dht_convert_data(sensor_type, data[2], data[3]);
+}
+
+esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin,
+        int16_t *humidity, int16_t *temperature)
+{
+    CHECK_ARG(humidity || temperature);
 
-    ESP_LOGD(TAG, "Sensor data: humidity=%d, temp=%d", *humidity, *temperature);
+    uint8_t data[DHT_RAW_LEN] = { 0 };
+    esp_err_t res = dht_read_raw(sensor_type, pin, data);
+    if (res != ESP_OK)
+        return res;
 
+    dht_convert(sensor_type, data, humidity, temperature);
     return ESP_OK;
 }
 
@@ -250,3 +454,71 @@ esp_err_t dht_read_float_data(dht_sensor_type_t sensor_type, gpio_num_t pin,
 
     return ESP_OK;
 }
+
+#if !CONFIG_DHT_SIMULATOR
+esp_err_t dht_rmt_attach(gpio_num_t pin, rmt_channel_t channel)
+{
+    CHECK_ARG(pin >= 0 && pin < GPIO_NUM_MAX && channel < RMT_CHANNEL_MAX);
+    if (rmt_slots[pin].attached)
+        return ESP_ERR_INVALID_STATE;
+
+    rmt_config_t config = RMT_DEFAULT_CONFIG_RX(pin, channel);
+    config.clk_div = DHT_RMT_CLK_DIV;
+    config.rx_config.idle_threshold = DHT_RMT_IDLE_US;
+    config.rx_config.filter_en = true;
+    config.rx_config.filter_ticks_thresh = DHT_RMT_FILTER_TICKS;
+
+    esp_err_t res = rmt_config(&config);
+    if (res != ESP_OK)
+        return res;
+    if ((res = rmt_driver_install(channel, DHT_RMT_RINGBUF_SIZE, 0)) != ESP_OK)
+        return res;
+    if ((res = rmt_get_ringbuf_handle(channel, &rmt_slots[pin].rb)) != ESP_OK)
+    {
+        rmt_driver_uninstall(channel);
+        return res;
+    }
+
+    // keep the input path enabled for RMT while driving the line open drain
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level(pin, 1);
+
+    rmt_slots[pin].channel = channel;
+    rmt_slots[pin].attached = true;
+
+    return ESP_OK;
+}
+
+esp_err_t dht_rmt_detach(gpio_num_t pin)
+{
+    CHECK_ARG(pin >= 0 && pin < GPIO_NUM_MAX);
+    if (!rmt_slots[pin].attached)
+        return ESP_ERR_INVALID_STATE;
+
+    esp_err_t res = rmt_driver_uninstall(rmt_slots[pin].channel);
+    if (res != ESP_OK)
+        return res;
+
+    memset(&rmt_slots[pin], 0, sizeof(rmt_slots[pin]));
+    gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
+    gpio_set_level(pin, 1);
+
+    return ESP_OK;
+}
+#endif
+
+esp_err_t dht_get_stats(gpio_num_t pin, dht_stats_t *out)
+{
+    CHECK_ARG(pin >= 0 && pin < GPIO_NUM_MAX && out);
+
+    *out = stats[pin];
+    return ESP_OK;
+}
+
+esp_err_t dht_reset_stats(gpio_num_t pin)
+{
+    CHECK_ARG(pin >= 0 && pin < GPIO_NUM_MAX);
+
+    memset(&stats[pin], 0, sizeof(stats[pin]));
+    return ESP_OK;
+}
@@ -46,8 +46,12 @@
 #ifndef __DHT_H__
 #define __DHT_H__
 
+#include <sdkconfig.h>
 #include <driver/gpio.h>
 #include <esp_err.h>
+#if !CONFIG_DHT_SIMULATOR
+#include <driver/rmt.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -63,6 +67,64 @@ typedef enum
     DHT_TYPE_SI7021       //!< Itead Si7021
 } dht_sensor_type_t;
 
+/**
+ * The only type supported by this build, undefined with `CONFIG_DHT_ANY_TYPE`
+ */
+#if CONFIG_DHT_ONLY_DHT11
+#define DHT_TYPE_FIXED DHT_TYPE_DHT11
+#elif CONFIG_DHT_ONLY_AM2301
+#define DHT_TYPE_FIXED DHT_TYPE_AM2301
+#elif CONFIG_DHT_ONLY_SI7021
+#define DHT_TYPE_FIXED DHT_TYPE_SI7021
+#endif
+
+/**
+ * Bytes sent by the sensor: humidity and temperature, most significant
+ * byte first, then the checksum
+ */
+#define DHT_RAW_LEN 5
+
+/**
+ * Why a read failed
+ */
+typedef enum
+{
+    DHT_FAULT_NONE = 0,     //!< Read succeeded
+    DHT_FAULT_PHASE_B,      //!< Sensor did not pull the line low after the start signal
+    DHT_FAULT_PHASE_C,      //!< Sensor did not release the line after its response LOW
+    DHT_FAULT_PHASE_D,      //!< Sensor did not start the first bit
+    DHT_FAULT_BIT_LOW,      //!< LOW of a data bit took too long
+    DHT_FAULT_BIT_HIGH,     //!< HIGH of a data bit took too long
+    DHT_FAULT_CAPTURE,      //!< RMT captured no response
+    DHT_FAULT_CRC,          //!< Checksum mismatch
+} dht_fault_t;
+
+/**
+ * Per-pin read error counters
+ */
+typedef struct
+{
+    uint32_t phase_b_timeouts;  //!< Sensor did not pull the line low after the start signal
+    uint32_t phase_c_timeouts;  //!< Sensor did not release the line after its response LOW
+    uint32_t phase_d_timeouts;  //!< Sensor did not start the first bit
+    uint32_t bit_timeouts;      //!< LOW or HIGH of a data bit took too long
+    uint32_t capture_errors;    //!< RMT captured no response
+    uint32_t crc_failures;      //!< Checksum mismatch
+} dht_error_counters_t;
+
+/**
+ * Per-pin read statistics
+ */
+typedef struct
+{
+    uint32_t reads;                 //!< Reads attempted
+    uint32_t cs_last_us;            //!< Critical section held by the last read, microseconds
+    uint32_t cs_max_us;             //!< Longest critical section of any read, microseconds
+    uint32_t corrected;             //!< Reads saved by flipping one ambiguous bit
+    dht_fault_t last_fault;         //!< Cause of the last failure, `DHT_FAULT_NONE` if the last read succeeded
+    dht_error_counters_t errors;    //!< Failed reads by cause
+} dht_stats_t;
+
 /**
  * @brief Read integer data from sensor on specified pin
  *
@@ -78,6 +140,30 @@ typedef enum
 esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin,
         int16_t *humidity, int16_t *temperature);
 
+/**
+ * @brief Read the bytes sent by the sensor on specified pin
+ *
+ * The checksum is verified, dht_convert() turns the data into values.
+ *
+ * @param sensor_type DHT11 or DHT22
+ * @param pin GPIO pin connected to sensor OUT
+ * @param[out] data Raw data
+ * @return `ESP_OK` on success, `ESP_ERR_NOT_SUPPORTED` if this build is
+ *         specialized for another type
+ */
+esp_err_t dht_read_raw(dht_sensor_type_t sensor_type, gpio_num_t pin, uint8_t data[DHT_RAW_LEN]);
+
+/**
+ * @brief Convert raw data to integer values
+ *
+ * @param sensor_type DHT11 or DHT22
+ * @param data Raw data from dht_read_raw()
+ * @param[out] humidity Humidity, percents * 10, nullable
+ * @param[out] temperature Temperature, degrees Celsius * 10, nullable
+ */
+void dht_convert(dht_sensor_type_t sensor_type, const uint8_t data[DHT_RAW_LEN],
+        int16_t *humidity, int16_t *temperature);
+
 /**
  * @brief Read float data from sensor on specified pin
  *
@@ -92,6 +178,53 @@ esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin,
 esp_err_t dht_read_float_data(dht_sensor_type_t sensor_type, gpio_num_t pin,
         float *humidity, float *temperature);
 
+#if !CONFIG_DHT_SIMULATOR
+/**
+ * @brief Capture the sensor on specified pin with the RMT peripheral
+ *
+ * Subsequent reads on this pin record the pulse train with RMT and decode
+ * it afterwards instead of bit-banging it with interrupts disabled.
+ * Reads on other pins are not affected.
+ * Not available with `CONFIG_DHT_SIMULATOR`, which builds without the RMT
+ * driver.
+ *
+ * @param pin GPIO pin connected to sensor OUT
+ * @param channel RMT channel reserved for this pin
+ * @return `ESP_OK` on success
+ */
+esp_err_t dht_rmt_attach(gpio_num_t pin, rmt_channel_t channel);
+
+/**
+ * @brief Release the RMT channel of specified pin
+ *
+ * Subsequent reads on this pin fall back to bit-banging.
+ *
+ * @param pin GPIO pin connected to sensor OUT
+ * @return `ESP_OK` on success
+ */
+esp_err_t dht_rmt_detach(gpio_num_t pin);
+#endif
+
+/**
+ * @brief Get read statistics of specified pin
+ *
+ * The start pulse is slept through, so the critical section covers only
+ * the ~5 ms bit-banged transfer, and nothing at all with RMT capture.
+ *
+ * @param pin GPIO pin connected to sensor OUT
+ * @param[out] stats Statistics
+ * @return `ESP_OK` on success
+ */
+esp_err_t dht_get_stats(gpio_num_t pin, dht_stats_t *stats);
+
+/**
+ * @brief Clear read statistics of specified pin
+ *
+ * @param pin GPIO pin connected to sensor OUT
+ * @return `ESP_OK` on success
+ */
+esp_err_t dht_reset_stats(gpio_num_t pin);
+
 #ifdef __cplusplus
 }
 #endif
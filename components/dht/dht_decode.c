@@ -0,0 +1,196 @@
+/**
+ * @file dht_decode.c
+ *
+ * Pulse-duration decoder for the DHT single-wire protocol
+ *
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "dht_decode.h"
+
+typedef struct
+{
+    dht_pulse_t *pulses;
+    size_t bits;            // bits collected so far
+    bool synced;            // preamble seen
+    uint16_t prev_low;      // last LOW while searching for the preamble
+    uint16_t preamble_high; // phase D HIGH
+} dht_decode_ctx_t;
+
+/**
+ * Feed one merged segment into the decoder state machine.
+ * Returns true once all bits are collected.
+ */
+static bool dht_decode_segment(dht_decode_ctx_t *ctx, uint8_t level, uint16_t duration)
+{
+    if (!ctx->synced)
+    {
+        if (!level)
+            ctx->prev_low = duration;
+        else if (ctx->prev_low >= DHT_PREAMBLE_MIN_US && duration >= DHT_PREAMBLE_MIN_US)
+        {
+            ctx->synced = true;
+            ctx->preamble_high = duration;
+        }
+        else
+            ctx->prev_low = 0;
+        return false;
+    }
+
+    if (!level)
+    {
+        ctx->pulses[ctx->bits].low = duration;
+        return false;
+    }
+
+    ctx->pulses[ctx->bits++].high = duration;
+    return ctx->bits == DHT_DATA_BITS;
+}
+
+void dht_decode_pulses(const dht_pulse_t *pulses, uint8_t data[DHT_DATA_BYTES])
+{
+    for (int i = 0; i < DHT_DATA_BITS; i++)
+    {
+        uint8_t b = i / 8;
+        uint8_t m = i % 8;
+        if (!m)
+            data[b] = 0;
+
+        data[b] |= (pulses[i].high > pulses[i].low) << (7 - m);
+    }
+}
+
+/**
+ * Pick the '0'/'1' threshold on the HIGH widths.
+ */
+static uint16_t dht_decode_threshold(const dht_pulse_t *pulses, uint16_t preamble_high)
+{
+    uint16_t highs[DHT_DATA_BITS];
+    uint32_t low_sum = 0;
+    uint32_t threshold;
+    int split = -1;
+    uint16_t gap = 0;
+
+    // insertion sort, 40 items
+    for (int i = 0; i < DHT_DATA_BITS; i++)
+    {
+        uint16_t h = pulses[i].high;
+        int j = i;
+        for (; j > 0 && highs[j - 1] > h; j--)
+            highs[j] = highs[j - 1];
+        highs[j] = h;
+        low_sum += pulses[i].low;
+    }
+
+    for (int i = 0; i < DHT_DATA_BITS - 1; i++)
+    {
+        if (highs[i + 1] - highs[i] > gap)
+        {
+            gap = highs[i + 1] - highs[i];
+            split = i;
+        }
+    }
+
+    if (gap >= DHT_CLUSTER_GAP_US)
+        threshold = (highs[split] + highs[split + 1]) / 2;
+    else if (preamble_high)
+        // '1' is ~70 us against a ~80 us preamble, '0' ~27 us
+        threshold = preamble_high * 3 / 5;
+    else
+        threshold = low_sum / DHT_DATA_BITS;
+
+    if (threshold < DHT_THRESHOLD_MIN_US)
+        threshold = DHT_THRESHOLD_MIN_US;
+    if (threshold > DHT_THRESHOLD_MAX_US)
+        threshold = DHT_THRESHOLD_MAX_US;
+    return threshold;
+}
+
+bool dht_decode_adaptive(const dht_pulse_t *pulses, uint16_t preamble_high,
+        uint8_t data[DHT_DATA_BYTES], dht_decode_info_t *info)
+{
+    uint16_t threshold = dht_decode_threshold(pulses, preamble_high);
+    uint16_t margins[DHT_DATA_BITS];
+    uint16_t min_margin = UINT16_MAX;
+
+    for (int i = 0; i < DHT_DATA_BITS; i++)
+    {
+        uint8_t b = i / 8;
+        uint8_t m = i % 8;
+        if (!m)
+            data[b] = 0;
+
+        uint16_t high = pulses[i].high;
+        data[b] |= (high > threshold) << (7 - m);
+        margins[i] = high > threshold ? high - threshold : threshold - high;
+        if (margins[i] < min_margin)
+            min_margin = margins[i];
+    }
+
+    if (info)
+    {
+        info->threshold = threshold;
+        info->margin = min_margin;
+        info->corrected_bit = -1;
+    }
+    if (dht_decode_checksum_ok(data))
+        return true;
+
+    // flip ambiguous bits one at a time, give up unless exactly one fixes it
+    int fix = -1;
+    for (int i = 0; i < DHT_DATA_BITS; i++)
+    {
+        if (margins[i] >= DHT_AMBIGUOUS_US)
+            continue;
+
+        data[i / 8] ^= 0x80 >> (i % 8);
+        bool ok = dht_decode_checksum_ok(data);
+        data[i / 8] ^= 0x80 >> (i % 8);
+        if (!ok)
+            continue;
+        if (fix >= 0)
+            return false;
+        fix = i;
+    }
+    if (fix < 0)
+        return false;
+
+    data[fix / 8] ^= 0x80 >> (fix % 8);
+    if (info)
+        info->corrected_bit = fix;
+    return true;
+}
+
+dht_decode_status_t dht_decode_edges(const dht_edge_t *edges, size_t count,
+        dht_pulse_t *pulses, uint16_t *preamble_high)
+{
+    dht_decode_ctx_t ctx = { .pulses = pulses };
+    bool done = false;
+    uint8_t level = 0;
+    uint32_t duration = 0;
+
+    for (size_t i = 0; i < count && !done; i++)
+    {
+        // zero duration marks the end of an RMT capture
+        if (!edges[i].duration)
+            continue;
+
+        if (duration && edges[i].level == level)
+        {
+            duration += edges[i].duration;
+            continue;
+        }
+        if (duration)
+            done = dht_decode_segment(&ctx, level, duration > UINT16_MAX ? UINT16_MAX : duration);
+
+        level = edges[i].level;
+        duration = edges[i].duration;
+    }
+    if (!done && duration)
+        done = dht_decode_segment(&ctx, level, duration > UINT16_MAX ? UINT16_MAX : duration);
+
+    if (preamble_high)
+        *preamble_high = ctx.preamble_high;
+    if (done)
+        return DHT_DECODE_OK;
+    return ctx.synced ? DHT_DECODE_TRUNCATED : DHT_DECODE_NO_PREAMBLE;
+}
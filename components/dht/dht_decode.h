@@ -0,0 +1,151 @@
+/**
+ * @file dht_decode.h
+ * @defgroup dht_decode dht_decode
+ * @{
+ *
+ * Pulse-duration decoder for the DHT single-wire protocol
+ *
+ * Turns captured pulse widths into the 5 data bytes. It does not depend on
+ * ESP-IDF, so it is shared by every capture backend and builds on any host.
+ *
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef __DHT_DECODE_H__
+#define __DHT_DECODE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DHT_DATA_BITS 40
+#define DHT_DATA_BYTES (DHT_DATA_BITS / 8)
+
+/**
+ * Shortest LOW and HIGH of the phase C/D preamble, microseconds
+ */
+#define DHT_PREAMBLE_MIN_US 60
+
+/**
+ * Window of the adaptive '0'/'1' threshold on the HIGH width, microseconds
+ */
+#define DHT_THRESHOLD_MIN_US 35
+#define DHT_THRESHOLD_MAX_US 60
+
+/**
+ * Smallest gap between the '0' and '1' clusters for the data to be treated
+ * as bimodal, microseconds
+ */
+#define DHT_CLUSTER_GAP_US 12
+
+/**
+ * Bits this close to the threshold are tried by the single-bit correction,
+ * microseconds
+ */
+#define DHT_AMBIGUOUS_US 15
+
+/**
+ * Widths of one data bit, microseconds
+ */
+typedef struct
+{
+    uint16_t low;   //!< LOW time before the bit, ~50 us
+    uint16_t high;  //!< HIGH time carrying the bit, ~27 us for '0', ~70 us for '1'
+} dht_pulse_t;
+
+/**
+ * One captured line segment: a level held for some time
+ */
+typedef struct
+{
+    uint16_t duration;  //!< Microseconds
+    uint8_t level;      //!< 0 or 1
+} dht_edge_t;
+
+/**
+ * Decoder status
+ */
+typedef enum
+{
+    DHT_DECODE_OK = 0,          //!< Data decoded
+    DHT_DECODE_NO_PREAMBLE,     //!< Phase C/D preamble not found
+    DHT_DECODE_TRUNCATED,       //!< Fewer than 40 bits after the preamble
+} dht_decode_status_t;
+
+/**
+ * Details of an adaptive decode
+ */
+typedef struct
+{
+    uint16_t threshold;     //!< HIGH widths above it were read as '1', microseconds
+    uint16_t margin;        //!< Distance of the least certain bit from the threshold, microseconds
+    int8_t corrected_bit;   //!< Bit flipped to satisfy the checksum, -1 if none
+} dht_decode_info_t;
+
+/**
+ * @brief Decode 40 bit pulses into data bytes
+ *
+ * @param pulses Array of `DHT_DATA_BITS` pulses
+ * @param[out] data Decoded bytes
+ */
+void dht_decode_pulses(const dht_pulse_t *pulses, uint8_t data[DHT_DATA_BYTES]);
+
+/**
+ * @brief Decode 40 bit pulses with a threshold adapted to the capture
+ *
+ * All HIGH widths are sorted and split at the widest gap when the '0' and
+ * '1' clusters are at least `DHT_CLUSTER_GAP_US` apart. Otherwise all bits
+ * have the same value and the threshold is derived from the preamble HIGH
+ * (~80 us) or, if unknown, from the average bit LOW (~50 us). Either way
+ * it is kept between `DHT_THRESHOLD_MIN_US` and `DHT_THRESHOLD_MAX_US`.
+ *
+ * If the checksum fails, the bits closest to the threshold (within
+ * `DHT_AMBIGUOUS_US`) are flipped one at a time. The read is corrected
+ * only if exactly one of them makes the checksum match.
+ *
+ * @param pulses Array of `DHT_DATA_BITS` pulses
+ * @param preamble_high Phase D HIGH width in microseconds, 0 if unknown
+ * @param[out] data Decoded bytes
+ * @param[out] info Decode details, nullable
+ * @return true if the checksum matches, possibly after a correction
+ */
+bool dht_decode_adaptive(const dht_pulse_t *pulses, uint16_t preamble_high,
+        uint8_t data[DHT_DATA_BYTES], dht_decode_info_t *info);
+
+/**
+ * @brief Extract the bit pulses from a captured segment train
+ *
+ * Looks for the phase C/D preamble (LOW then HIGH, both at least
+ * `DHT_PREAMBLE_MIN_US`) and collects the 40 LOW/HIGH pairs that follow.
+ * Consecutive segments of the same level are merged.
+ *
+ * @param edges Captured segments
+ * @param count Number of segments
+ * @param[out] pulses Array of `DHT_DATA_BITS` pulses
+ * @param[out] preamble_high Phase D HIGH width in microseconds, nullable
+ * @return `DHT_DECODE_OK` on success
+ */
+dht_decode_status_t dht_decode_edges(const dht_edge_t *edges, size_t count,
+        dht_pulse_t *pulses, uint16_t *preamble_high);
+
+/**
+ * @brief Verify the checksum byte
+ *
+ * @param data Decoded bytes
+ * @return true if `data[4]` is the low byte of the sum of `data[0..3]`
+ */
+static inline bool dht_decode_checksum_ok(const uint8_t data[DHT_DATA_BYTES])
+{
+    return data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/**@}*/
+
+#endif  // __DHT_DECODE_H__
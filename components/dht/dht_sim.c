@@ -0,0 +1,247 @@
+/**
+ * @file dht_sim.c
+ *
+ * Simulated DHT sensors
+ *
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "dht_sim.h"
+#include "dht_decode.h"
+
+#include <string.h>
+#include <esp_timer.h>
+
+// shortest start pulse each type answers to
+#define DHT11_WAKE_US       18000
+#define AM2301_WAKE_US      1000
+#define SI7021_WAKE_US      400
+
+// nominal pulse widths of the answer
+#define SIM_RESPONSE_US     30      // phase 'B'
+#define SIM_PREAMBLE_US     80      // phases 'C' and 'D'
+#define SIM_BIT_LOW_US      50
+#define SIM_BIT_ZERO_US     26
+#define SIM_BIT_ONE_US      70
+
+// a level held past every timeout of the driver, an edge that never comes
+#define SIM_STUCK_US        1000
+
+// B, C, D, 40 bits of LOW and HIGH, final LOW
+#define SIM_SEGMENTS        (3 + DHT_DATA_BITS * 2 + 1)
+
+typedef struct
+{
+    bool                attached;
+    dht_sim_config_t    config;
+    uint32_t            rng;
+    bool                driven_low;     // MCU holds the line low
+    int64_t             low_since_us;
+    bool                answering;
+    int64_t             answer_start_us;
+    uint16_t            segments[SIM_SEGMENTS];
+} dht_sim_pin_t;
+
+static dht_sim_pin_t sim_pins[GPIO_NUM_MAX];
+
+// virtual time spent in dht_sim_delay_us()
+static int64_t sim_offset_us;
+
+#define CHECK_PIN(pin) do { if ((pin) < 0 || (pin) >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG; } while (0)
+
+static inline int64_t dht_sim_now(void)
+{
+    return esp_timer_get_time() + sim_offset_us;
+}
+
+static uint16_t dht_sim_jitter(dht_sim_pin_t *p, uint16_t us)
+{
+    uint32_t j = p->config.jitter_us;
+
+    if (!j)
+        return us;
+
+    // xorshift32
+    p->rng ^= p->rng << 13;
+    p->rng ^= p->rng >> 17;
+    p->rng ^= p->rng << 5;
+
+    int v = us + (int)(p->rng % (2 * j + 1)) - (int)j;
+    return v < 1 ? 1 : v;
+}
+
+static void dht_sim_encode(const dht_sim_config_t *config, uint8_t data[DHT_DATA_BYTES])
+{
+    memset(data, 0, DHT_DATA_BYTES);
+    if (config->type == DHT_TYPE_DHT11)
+    {
+        data[0] = config->humidity / 10;
+        data[2] = config->temperature / 10;
+    }
+    else
+    {
+        uint16_t t = config->temperature < 0 ? 0x8000 | -config->temperature : config->temperature;
+        data[0] = config->humidity >> 8;
+        data[1] = config->humidity;
+        data[2] = t >> 8;
+        data[3] = t;
+    }
+    data[4] = data[0] + data[1] + data[2] + data[3];
+}
+
+/**
+ * Lay out the answer of the sensor, starting HIGH right after the release.
+ */
+static void dht_sim_answer(dht_sim_pin_t *p)
+{
+    uint8_t data[DHT_DATA_BYTES];
+    int n = 0;
+
+    dht_sim_encode(&p->config, data);
+    if (p->config.fault == DHT_SIM_FAULT_CHECKSUM)
+        data[4] ^= 0x5A;
+
+    p->segments[n++] = dht_sim_jitter(p, SIM_RESPONSE_US);
+    p->segments[n++] = dht_sim_jitter(p, SIM_PREAMBLE_US);
+    p->segments[n++] = dht_sim_jitter(p, SIM_PREAMBLE_US);
+    for (int i = 0; i < DHT_DATA_BITS; i++)
+    {
+        bool one = data[i / 8] & (0x80 >> (i % 8));
+        p->segments[n++] = dht_sim_jitter(p, SIM_BIT_LOW_US);
+        p->segments[n++] = dht_sim_jitter(p, one ? SIM_BIT_ONE_US : SIM_BIT_ZERO_US);
+    }
+    p->segments[n++] = dht_sim_jitter(p, SIM_BIT_LOW_US);
+
+    int bit = p->config.fault_bit < DHT_DATA_BITS ? p->config.fault_bit : DHT_DATA_BITS - 1;
+    switch (p->config.fault)
+    {
+    case DHT_SIM_FAULT_NO_PHASE_C:
+        p->segments[1] = SIM_STUCK_US;
+        break;
+    case DHT_SIM_FAULT_NO_PHASE_D:
+        p->segments[2] = SIM_STUCK_US;
+        break;
+    case DHT_SIM_FAULT_BIT_LOW:
+        p->segments[3 + bit * 2] = SIM_STUCK_US;
+        break;
+    case DHT_SIM_FAULT_BIT_HIGH:
+        p->segments[4 + bit * 2] = SIM_STUCK_US;
+        break;
+    default:
+        break;
+    }
+
+    p->answering = true;
+    p->answer_start_us = dht_sim_now();
+}
+
+static uint32_t dht_sim_wake_us(dht_sensor_type_t type)
+{
+    switch (type)
+    {
+    case DHT_TYPE_DHT11:
+        return DHT11_WAKE_US;
+    case DHT_TYPE_SI7021:
+        return SI7021_WAKE_US;
+    default:
+        return AM2301_WAKE_US;
+    }
+}
+
+esp_err_t dht_sim_attach(gpio_num_t pin, const dht_sim_config_t *config)
+{
+    CHECK_PIN(pin);
+    if (!config)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(&sim_pins[pin], 0, sizeof(sim_pins[pin]));
+    sim_pins[pin].config = *config;
+    sim_pins[pin].rng = config->seed ? config->seed : 0x2545F491 + (uint32_t)pin;
+    sim_pins[pin].attached = true;
+
+    return ESP_OK;
+}
+
+esp_err_t dht_sim_detach(gpio_num_t pin)
+{
+    CHECK_PIN(pin);
+
+    sim_pins[pin].attached = false;
+    sim_pins[pin].answering = false;
+
+    return ESP_OK;
+}
+
+esp_err_t dht_sim_set_values(gpio_num_t pin, int16_t humidity, int16_t temperature)
+{
+    CHECK_PIN(pin);
+    if (!sim_pins[pin].attached)
+        return ESP_ERR_INVALID_STATE;
+
+    sim_pins[pin].config.humidity = humidity;
+    sim_pins[pin].config.temperature = temperature;
+
+    return ESP_OK;
+}
+
+esp_err_t dht_sim_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+    CHECK_PIN(pin);
+
+    // an input does not drive the line, the pull-up or the sensor does
+    if (mode == GPIO_MODE_INPUT)
+        sim_pins[pin].driven_low = false;
+
+    return ESP_OK;
+}
+
+esp_err_t dht_sim_set_level(gpio_num_t pin, uint32_t level)
+{
+    CHECK_PIN(pin);
+    dht_sim_pin_t *p = &sim_pins[pin];
+
+    if (!level)
+    {
+        if (!p->driven_low)
+            p->low_since_us = dht_sim_now();
+        p->driven_low = true;
+        p->answering = false;
+        return ESP_OK;
+    }
+
+    if (p->driven_low && p->attached
+            && dht_sim_now() - p->low_since_us >= dht_sim_wake_us(p->config.type))
+        dht_sim_answer(p);
+    p->driven_low = false;
+
+    return ESP_OK;
+}
+
+int dht_sim_get_level(gpio_num_t pin)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX)
+        return 0;
+    dht_sim_pin_t *p = &sim_pins[pin];
+
+    if (p->driven_low)
+        return 0;
+    if (!p->answering)
+        return 1;
+
+    // segments alternate HIGH, LOW, ... starting right after the release
+    int64_t t = dht_sim_now() - p->answer_start_us;
+    for (int i = 0; i < SIM_SEGMENTS; i++)
+    {
+        if (t < p->segments[i])
+            return !(i & 1);
+        t -= p->segments[i];
+    }
+
+    // transfer over, the pull-up takes the line
+    p->answering = false;
+    return 1;
+}
+
+void dht_sim_delay_us(uint32_t us)
+{
+    sim_offset_us += us;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file dht_sim.h
+ *
+ * Simulated DHT sensors, enabled with `CONFIG_DHT_SIMULATOR`
+ *
+ * The driver calls the line functions below instead of the GPIO driver.
+ * When the line is released after a long enough start pulse, an attached
+ * sensor answers with the waveform of its type carrying the configured
+ * values. Busy-waits advance a virtual clock instead of spinning, so a read
+ * takes only the start pulse in real time.
+ *
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef __DHT_SIM_H__
+#define __DHT_SIM_H__
+
+#include "dht.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Fault injected into the answer of a simulated sensor
+ */
+typedef enum
+{
+    DHT_SIM_FAULT_NONE = 0,
+    DHT_SIM_FAULT_NO_PHASE_C,   //!< Response LOW never released, no phase 'C' edge
+    DHT_SIM_FAULT_NO_PHASE_D,   //!< Line left high after phase 'C', no phase 'D' edge
+    DHT_SIM_FAULT_BIT_LOW,      //!< LOW of bit `fault_bit` stretched past the driver timeout
+    DHT_SIM_FAULT_BIT_HIGH,     //!< HIGH of bit `fault_bit` stretched past the driver timeout
+    DHT_SIM_FAULT_CHECKSUM,     //!< Checksum byte corrupted
+} dht_sim_fault_t;
+
+/**
+ * Simulated sensor
+ */
+typedef struct
+{
+    dht_sensor_type_t   type;           //!< Waveform and data encoding
+    int16_t             humidity;       //!< Percents * 10
+    int16_t             temperature;    //!< Degrees Celsius * 10
+    uint16_t            jitter_us;      //!< Maximum deviation of every pulse, microseconds
+    uint32_t            seed;           //!< Seed of the jitter generator, 0 for a fixed default
+    dht_sim_fault_t     fault;          //!< Fault of every answer
+    uint8_t             fault_bit;      //!< Data bit of the bit faults, 0 to 39
+} dht_sim_config_t;
+
+/**
+ * @brief Attach a simulated sensor to specified pin
+ *
+ * A pin without a sensor never answers, reads time out in phase 'B'.
+ *
+ * @param pin Simulated GPIO pin
+ * @param config Sensor, copied
+ * @return `ESP_OK` on success
+ */
+esp_err_t dht_sim_attach(gpio_num_t pin, const dht_sim_config_t *config);
+
+/**
+ * @brief Remove the simulated sensor of specified pin
+ *
+ * @param pin Simulated GPIO pin
+ * @return `ESP_OK` on success
+ */
+esp_err_t dht_sim_detach(gpio_num_t pin);
+
+/**
+ * @brief Change the values reported by a simulated sensor
+ *
+ * @param pin Simulated GPIO pin
+ * @param humidity Percents * 10
+ * @param temperature Degrees Celsius * 10
+ * @return `ESP_OK` on success
+ */
+esp_err_t dht_sim_set_values(gpio_num_t pin, int16_t humidity, int16_t temperature);
+
+/**
+ * @brief Line access used by the driver in place of the GPIO driver
+ */
+esp_err_t dht_sim_set_direction(gpio_num_t pin, gpio_mode_t mode);
+esp_err_t dht_sim_set_level(gpio_num_t pin, uint32_t level);
+int dht_sim_get_level(gpio_num_t pin);
+void dht_sim_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __DHT_SIM_H__
@@ -0,0 +1,58 @@
+/**
+ * @file sensor.c
+ *
+ * Humidity and temperature sensors behind a common driver interface
+ */
+#include "sensor.h"
+
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
+
+esp_err_t sensor_init(sensor_t *sensor)
+{
+    CHECK_ARG(sensor && sensor->drv);
+
+    esp_err_t err = sensor->drv->init(sensor);
+    sensor->ready = err == ESP_OK;
+    return err;
+}
+
+esp_err_t sensor_read(sensor_t *sensor, int16_t *humidity, int16_t *temperature)
+{
+    CHECK_ARG(sensor && sensor->drv && (humidity || temperature));
+
+    const sensor_drv_t *drv = sensor->drv;
+    uint8_t raw[SENSOR_RAW_MAX];
+    int16_t h, t;
+    uint32_t wait_ms = 0;
+    esp_err_t err;
+
+    if (!sensor->ready && (err = sensor_init(sensor)) != ESP_OK)
+        return err;
+    if ((err = drv->start(sensor, &wait_ms)) != ESP_OK)
+        return err;
+    // one extra tick, vTaskDelay() may return up to a tick early
+    if (wait_ms)
+        vTaskDelay(pdMS_TO_TICKS(wait_ms) + 1);
+    if ((err = drv->read(sensor, raw)) != ESP_OK)
+        return err;
+    if ((err = drv->convert(sensor, raw, &h, &t)) != ESP_OK)
+        return err;
+
+    if (humidity)
+        *humidity = h;
+    if (temperature)
+        *temperature = t;
+    return ESP_OK;
+}
+
+void sensor_describe(const sensor_t *sensor, char *buf, size_t size)
+{
+    if (sensor->drv == &sensor_dht)
+        snprintf(buf, size, "%s on GPIO %d", sensor->drv->name, sensor->dht.pin);
+    else
+        snprintf(buf, size, "%s on I2C%d 0x%02x", sensor->drv->name, sensor->i2c.port, sensor->i2c.addr);
+}
@@ -0,0 +1,135 @@
+/**
+ * @file sensor.h
+ * @defgroup sensor sensor
+ * @{
+ *
+ * Humidity and temperature sensors behind a common driver interface
+ *
+ * Every read goes through the same steps: start a conversion, wait as long
+ * as the sensor needs, fetch its raw bytes, convert them. The bit-banged DHT
+ * does all of its line work in the fetch and asks for no wait, the I2C
+ * sensors convert on their own after the start command and leave the CPU
+ * free meanwhile. Values are integers, percents and degrees Celsius * 10,
+ * as with the DHT driver.
+ *
+ * Backends:
+ *
+ *     sensor_dht      DHT11, AM2301, single-wire Si7021, see dht.h
+ *     sensor_si7021   Si7021, HTU21D on I2C
+ *     sensor_sht3x    SHT30, SHT31, SHT35 on I2C
+ *     sensor_bme280   BME280 on I2C, pressure is not read
+ */
+#ifndef __SENSOR_H__
+#define __SENSOR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <driver/i2c.h>
+
+#include "dht.h"
+#include "sensor_i2c_decode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Longest raw reading of any backend
+ */
+#define SENSOR_RAW_MAX 8
+
+typedef struct sensor sensor_t;
+
+/**
+ * Backend operations, called in this order for every read
+ */
+typedef struct
+{
+    const char  *name;
+    /** Check the device is there, set `min_interval_ms` */
+    esp_err_t   (*init)(sensor_t *sensor);
+    /** Trigger a conversion, `*wait_ms` until it can be read */
+    esp_err_t   (*start)(sensor_t *sensor, uint32_t *wait_ms);
+    /** Fetch the raw result */
+    esp_err_t   (*read)(sensor_t *sensor, uint8_t raw[SENSOR_RAW_MAX]);
+    /** Verify and convert the raw result, on any task */
+    esp_err_t   (*convert)(const sensor_t *sensor, const uint8_t raw[SENSOR_RAW_MAX],
+                           int16_t *humidity, int16_t *temperature);
+} sensor_drv_t;
+
+/**
+ * Sensor instance, initialized with SENSOR_DHT_DEV() or SENSOR_I2C_DEV()
+ */
+struct sensor
+{
+    const sensor_drv_t  *drv;
+    union
+    {
+        struct
+        {
+            dht_sensor_type_t   type;
+            gpio_num_t          pin;
+        } dht;
+        struct
+        {
+            i2c_port_t          port;
+            uint8_t             addr;
+        } i2c;
+    };
+    uint32_t            min_interval_ms;    //!< Shortest period the sensor supports, set by sensor_init()
+    bool                ready;              //!< sensor_init() succeeded
+    uint32_t            cs_us;              //!< Interrupts masked by the last read, microseconds
+    bme280_calib_t      bme280;             //!< Trimming parameters of a BME280
+};
+
+extern const sensor_drv_t sensor_dht;
+extern const sensor_drv_t sensor_si7021;
+extern const sensor_drv_t sensor_sht3x;
+extern const sensor_drv_t sensor_bme280;
+
+#define SENSOR_DHT_DEV(type_, pin_)         { .drv = &sensor_dht, .dht = { .type = (type_), .pin = (pin_) } }
+#define SENSOR_I2C_DEV(drv_, port_, addr_)  { .drv = &(drv_), .i2c = { .port = (port_), .addr = (addr_) } }
+
+/**
+ * @brief Check the sensor answers and prepare it for reads
+ *
+ * I2C sensors need their bus set up first, see sensor_i2c_bus_init().
+ * `min_interval_ms` is set even on failure.
+ *
+ * @param sensor Sensor
+ * @return `ESP_OK` on success
+ */
+esp_err_t sensor_init(sensor_t *sensor);
+
+/**
+ * @brief Read the sensor, sleeping through the conversion
+ *
+ * A sensor whose sensor_init() failed is set up again first, so one that
+ * was missing at boot starts working once connected.
+ *
+ * @param sensor Sensor
+ * @param[out] humidity Humidity, percents * 10, nullable
+ * @param[out] temperature Temperature, degrees Celsius * 10, nullable
+ * @return `ESP_OK` on success, `ESP_ERR_INVALID_CRC` on corrupted data,
+ *         or the error of the bus
+ */
+esp_err_t sensor_read(sensor_t *sensor, int16_t *humidity, int16_t *temperature);
+
+/**
+ * @brief Name the sensor and where it is connected, for logs
+ *
+ * @param sensor Sensor
+ * @param[out] buf Text such as "dht on GPIO 15" or "sht3x on I2C0 0x44"
+ * @param size Size of `buf`
+ */
+void sensor_describe(const sensor_t *sensor, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**@}*/
+
+#endif  // __SENSOR_H__
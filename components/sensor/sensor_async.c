@@ -0,0 +1,101 @@
+/**
+ * @file sensor_async.c
+ *
+ * Non-blocking sensor reads
+ */
+#include "sensor_async.h"
+
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <esp_timer.h>
+
+typedef struct
+{
+    sensor_t *sensor;
+    sensor_read_cb_t cb;
+    void *ctx;
+    int64_t queued_us;
+} sensor_request_t;
+
+static QueueHandle_t requests;
+
+#define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
+
+static void sensor_async_worker(void *arg)
+{
+    sensor_request_t req;
+    sensor_read_result_t result;
+
+    while (1)
+    {
+        if (xQueueReceive(requests, &req, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        result.sensor = req.sensor;
+        result.humidity = 0;
+        result.temperature = 0;
+        result.queued_us = req.queued_us;
+        req.sensor->cs_us = 0;
+        result.started_us = esp_timer_get_time();
+        result.err = sensor_read(req.sensor, &result.humidity, &result.temperature);
+        result.done_us = esp_timer_get_time();
+        result.cs_us = req.sensor->cs_us;
+
+        req.cb(&result, req.ctx);
+    }
+}
+
+static esp_err_t sensor_async_start(size_t queue_len, uint32_t stack_size, UBaseType_t priority, BaseType_t core_id,
+        StackType_t *stack, StaticTask_t *tcb)
+{
+    TaskHandle_t task = NULL;
+
+    CHECK_ARG(queue_len);
+    if (requests)
+        return ESP_ERR_INVALID_STATE;
+
+    if (!(requests = xQueueCreate(queue_len, sizeof(sensor_request_t))))
+        return ESP_ERR_NO_MEM;
+
+    if (stack)
+        task = xTaskCreateStaticPinnedToCore(sensor_async_worker, SENSOR_ASYNC_TASK, stack_size, NULL, priority,
+                                             stack, tcb, core_id);
+    else
+        xTaskCreatePinnedToCore(sensor_async_worker, SENSOR_ASYNC_TASK, stack_size, NULL, priority, &task, core_id);
+    if (!task)
+    {
+        vQueueDelete(requests);
+        requests = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t sensor_async_init(size_t queue_len, uint32_t stack_size, UBaseType_t priority, BaseType_t core_id)
+{
+    return sensor_async_start(queue_len, stack_size, priority, core_id, NULL, NULL);
+}
+
+esp_err_t sensor_async_init_static(size_t queue_len, uint32_t stack_size, UBaseType_t priority, BaseType_t core_id,
+        StackType_t *stack, StaticTask_t *tcb)
+{
+    CHECK_ARG(stack && tcb);
+    return sensor_async_start(queue_len, stack_size, priority, core_id, stack, tcb);
+}
+
+esp_err_t sensor_read_async(sensor_t *sensor, sensor_read_cb_t cb, void *ctx)
+{
+    CHECK_ARG(sensor && sensor->drv && cb);
+    if (!requests)
+        return ESP_ERR_INVALID_STATE;
+
+    sensor_request_t req = {
+        .sensor = sensor,
+        .cb = cb,
+        .ctx = ctx,
+        .queued_us = esp_timer_get_time(),
+    };
+
+    return xQueueSend(requests, &req, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
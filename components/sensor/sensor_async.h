@@ -0,0 +1,86 @@
+/**
+ * @file sensor_async.h
+ *
+ * Non-blocking sensor reads
+ *
+ * Reads are queued and carried out one by one by a worker task, which goes
+ * through the steps of the backend (see sensor_read()) and sleeps through
+ * the start pulse of a DHT or the conversion of an I2C sensor. The caller
+ * returns right away and the result is delivered to a callback on the
+ * worker, in request order.
+ */
+#ifndef __SENSOR_ASYNC_H__
+#define __SENSOR_ASYNC_H__
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Name of the worker task
+ */
+#define SENSOR_ASYNC_TASK "sensor_async"
+
+/**
+ * Outcome of a queued read
+ */
+typedef struct
+{
+    sensor_t            *sensor;        //!< Sensor of the request
+    esp_err_t           err;            //!< Result of sensor_read()
+    int16_t             humidity;       //!< Percents * 10, valid if `err` is `ESP_OK`
+    int16_t             temperature;    //!< Degrees Celsius * 10, valid if `err` is `ESP_OK`
+    uint32_t            cs_us;          //!< Interrupts masked by the read, microseconds
+    int64_t             queued_us;      //!< esp_timer time of the request
+    int64_t             started_us;     //!< esp_timer time the worker started the read
+    int64_t             done_us;        //!< esp_timer time of the result
+} sensor_read_result_t;
+
+/**
+ * Completion callback, runs on the worker task and must not block for long
+ */
+typedef void (*sensor_read_cb_t)(const sensor_read_result_t *result, void *ctx);
+
+/**
+ * @brief Create the request queue and the worker task
+ *
+ * @param queue_len Requests that can be pending at once
+ * @param stack_size Stack of the worker, bytes, including the callbacks
+ * @param priority Priority of the worker
+ * @param core_id Core the worker is pinned to, `tskNO_AFFINITY` to let it float.
+ *                Keeping it off the Wi-Fi core avoids stretched DHT pulses.
+ * @return `ESP_OK` on success, `ESP_ERR_INVALID_STATE` if already started
+ */
+esp_err_t sensor_async_init(size_t queue_len, uint32_t stack_size, UBaseType_t priority, BaseType_t core_id);
+
+/**
+ * @brief Same as sensor_async_init(), the worker running on a caller-owned stack
+ *
+ * Only the request queue comes from the heap.
+ *
+ * @param stack Stack of `stack_size` bytes, never freed
+ * @param tcb Task control block, never freed
+ */
+esp_err_t sensor_async_init_static(size_t queue_len, uint32_t stack_size, UBaseType_t priority, BaseType_t core_id,
+        StackType_t *stack, StaticTask_t *tcb);
+
+/**
+ * @brief Queue a read and return without waiting for it
+ *
+ * @param sensor Sensor, used by the worker until the callback
+ * @param cb Called with the result, in request order
+ * @param ctx Passed to `cb`
+ * @return `ESP_OK` if queued, `ESP_ERR_NO_MEM` if the queue is full,
+ *         `ESP_ERR_INVALID_STATE` if sensor_async_init() was not called
+ */
+esp_err_t sensor_read_async(sensor_t *sensor, sensor_read_cb_t cb, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __SENSOR_ASYNC_H__
@@ -0,0 +1,84 @@
+/**
+ * @file sensor_bme280.c
+ *
+ * Bosch BME280 on I2C
+ *
+ * Forced mode at x1 oversampling: each read triggers one measurement and
+ * the sensor sleeps in between, as the datasheet recommends for weather
+ * monitoring. The trimming parameters are read once by init. Pressure is
+ * measured, as the mode requires, but not compensated.
+ */
+#include "sensor.h"
+#include "sensor_i2c.h"
+
+#define BME280_REG_CALIB_TP         0x88
+#define BME280_REG_ID               0xD0
+#define BME280_REG_CALIB_H          0xE1
+#define BME280_REG_CTRL_HUM         0xF2
+#define BME280_REG_CTRL_MEAS        0xF4
+#define BME280_REG_DATA             0xF7
+
+#define BME280_CHIP_ID              0x60
+#define BME280_CTRL_HUM_X1          0x01
+// temperature and pressure x1, forced mode
+#define BME280_CTRL_MEAS_FORCED     0x25
+
+// 1.25 + 3 * 2.3 + 2 * 0.575 ms at x1 oversampling
+#define BME280_CONVERSION_MS        10
+#define BME280_MIN_INTERVAL_MS      1000
+
+static esp_err_t sensor_bme280_read_regs(sensor_t *sensor, uint8_t reg, uint8_t *data, size_t len)
+{
+    return sensor_i2c_write_read(sensor->i2c.port, sensor->i2c.addr, &reg, 1, data, len);
+}
+
+static esp_err_t sensor_bme280_init(sensor_t *sensor)
+{
+    uint8_t id;
+    uint8_t tp[BME280_CALIB_TP_LEN];
+    uint8_t h[BME280_CALIB_H_LEN];
+    const uint8_t ctrl_hum[] = { BME280_REG_CTRL_HUM, BME280_CTRL_HUM_X1 };
+    esp_err_t err;
+
+    sensor->min_interval_ms = BME280_MIN_INTERVAL_MS;
+    if ((err = sensor_bme280_read_regs(sensor, BME280_REG_ID, &id, 1)) != ESP_OK)
+        return err;
+    // a BMP280 answers on the same addresses, without humidity
+    if (id != BME280_CHIP_ID)
+        return ESP_ERR_NOT_FOUND;
+    if ((err = sensor_bme280_read_regs(sensor, BME280_REG_CALIB_TP, tp, sizeof(tp))) != ESP_OK ||
+        (err = sensor_bme280_read_regs(sensor, BME280_REG_CALIB_H, h, sizeof(h))) != ESP_OK)
+        return err;
+    bme280_parse_calib(&sensor->bme280, tp, h);
+
+    // applied by the next write of ctrl_meas
+    return sensor_i2c_write(sensor->i2c.port, sensor->i2c.addr, ctrl_hum, sizeof(ctrl_hum));
+}
+
+static esp_err_t sensor_bme280_start(sensor_t *sensor, uint32_t *wait_ms)
+{
+    const uint8_t ctrl_meas[] = { BME280_REG_CTRL_MEAS, BME280_CTRL_MEAS_FORCED };
+
+    *wait_ms = BME280_CONVERSION_MS;
+    return sensor_i2c_write(sensor->i2c.port, sensor->i2c.addr, ctrl_meas, sizeof(ctrl_meas));
+}
+
+static esp_err_t sensor_bme280_read(sensor_t *sensor, uint8_t raw[SENSOR_RAW_MAX])
+{
+    return sensor_bme280_read_regs(sensor, BME280_REG_DATA, raw, BME280_DATA_LEN);
+}
+
+static esp_err_t sensor_bme280_convert(const sensor_t *sensor, const uint8_t raw[SENSOR_RAW_MAX],
+        int16_t *humidity, int16_t *temperature)
+{
+    // no checksum on this bus, a skipped measurement is the only tell
+    return bme280_compensate(&sensor->bme280, raw, humidity, temperature) == 0 ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+const sensor_drv_t sensor_bme280 = {
+    .name = "bme280",
+    .init = sensor_bme280_init,
+    .start = sensor_bme280_start,
+    .read = sensor_bme280_read,
+    .convert = sensor_bme280_convert,
+};
@@ -0,0 +1,53 @@
+/**
+ * @file sensor_dht.c
+ *
+ * Single-wire DHT sensors as a sensor backend
+ *
+ * The start pulse and the answer form a single transfer, so the whole read
+ * happens in the fetch step. dht_read_raw() sleeps through the start pulse
+ * itself. With `CONFIG_DHT_ANY_TYPE` unset the type is checked once here,
+ * and the driver folds its type branches away.
+ */
+#include "sensor.h"
+
+static esp_err_t sensor_dht_init(sensor_t *sensor)
+{
+    sensor->min_interval_ms = sensor->dht.type == DHT_TYPE_AM2301 ? 2000 : 1000;
+#ifdef DHT_TYPE_FIXED
+    if (sensor->dht.type != DHT_TYPE_FIXED)
+        return ESP_ERR_NOT_SUPPORTED;
+#endif
+    return ESP_OK;
+}
+
+static esp_err_t sensor_dht_start(sensor_t *sensor, uint32_t *wait_ms)
+{
+    *wait_ms = 0;
+    return ESP_OK;
+}
+
+static esp_err_t sensor_dht_read(sensor_t *sensor, uint8_t raw[SENSOR_RAW_MAX])
+{
+    dht_stats_t stats;
+    esp_err_t err = dht_read_raw(sensor->dht.type, sensor->dht.pin, raw);
+
+    if (dht_get_stats(sensor->dht.pin, &stats) == ESP_OK)
+        sensor->cs_us = stats.cs_last_us;
+    return err;
+}
+
+static esp_err_t sensor_dht_convert(const sensor_t *sensor, const uint8_t raw[SENSOR_RAW_MAX],
+        int16_t *humidity, int16_t *temperature)
+{
+    // the checksum was verified by the driver
+    dht_convert(sensor->dht.type, raw, humidity, temperature);
+    return ESP_OK;
+}
+
+const sensor_drv_t sensor_dht = {
+    .name = "dht",
+    .init = sensor_dht_init,
+    .start = sensor_dht_start,
+    .read = sensor_dht_read,
+    .convert = sensor_dht_convert,
+};
@@ -0,0 +1,57 @@
+/**
+ * @file sensor_i2c.c
+ *
+ * I2C transfers of the sensor backends
+ */
+#include "sensor_i2c.h"
+
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+
+// a transaction of a few bytes takes well under a millisecond at 100 kHz
+#define SENSOR_I2C_TIMEOUT_MS 20
+
+#define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
+
+static bool installed[I2C_NUM_MAX];
+
+esp_err_t sensor_i2c_bus_init(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t clk_hz)
+{
+    CHECK_ARG(port >= 0 && port < I2C_NUM_MAX);
+    if (installed[port])
+        return ESP_OK;
+
+    i2c_config_t config = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = sda,
+        .scl_io_num = scl,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = clk_hz,
+    };
+    esp_err_t res = i2c_param_config(port, &config);
+    if (res != ESP_OK)
+        return res;
+    if ((res = i2c_driver_install(port, I2C_MODE_MASTER, 0, 0, 0)) != ESP_OK)
+        return res;
+
+    installed[port] = true;
+    return ESP_OK;
+}
+
+esp_err_t sensor_i2c_write(i2c_port_t port, uint8_t addr, const uint8_t *data, size_t len)
+{
+    return i2c_master_write_to_device(port, addr, data, len, pdMS_TO_TICKS(SENSOR_I2C_TIMEOUT_MS));
+}
+
+esp_err_t sensor_i2c_read(i2c_port_t port, uint8_t addr, uint8_t *data, size_t len)
+{
+    return i2c_master_read_from_device(port, addr, data, len, pdMS_TO_TICKS(SENSOR_I2C_TIMEOUT_MS));
+}
+
+esp_err_t sensor_i2c_write_read(i2c_port_t port, uint8_t addr, const uint8_t *out, size_t out_len,
+        uint8_t *in, size_t in_len)
+{
+    return i2c_master_write_read_device(port, addr, out, out_len, in, in_len,
+                                        pdMS_TO_TICKS(SENSOR_I2C_TIMEOUT_MS));
+}
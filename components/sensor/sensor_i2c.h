@@ -0,0 +1,61 @@
+/**
+ * @file sensor_i2c.h
+ *
+ * I2C transfers of the sensor backends
+ *
+ * Every bus access of the I2C backends goes through these functions, one
+ * call per transaction, so they are the only part to replace when the
+ * backends run against recorded transactions instead of a device.
+ */
+#ifndef __SENSOR_I2C_H__
+#define __SENSOR_I2C_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include <driver/i2c.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Install the master driver of a port, once
+ *
+ * Later calls for the same port return `ESP_OK` and keep the first setup.
+ *
+ * @param port I2C port
+ * @param sda SDA pin, with the internal pull-up enabled
+ * @param scl SCL pin, with the internal pull-up enabled
+ * @param clk_hz Bus clock
+ * @return `ESP_OK` on success
+ */
+esp_err_t sensor_i2c_bus_init(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t clk_hz);
+
+/**
+ * @brief Write bytes in one transaction
+ *
+ * @return `ESP_OK` on success, `ESP_FAIL` if the device did not acknowledge
+ */
+esp_err_t sensor_i2c_write(i2c_port_t port, uint8_t addr, const uint8_t *data, size_t len);
+
+/**
+ * @brief Read bytes in one transaction
+ *
+ * @return `ESP_OK` on success, `ESP_FAIL` if the device did not acknowledge
+ */
+esp_err_t sensor_i2c_read(i2c_port_t port, uint8_t addr, uint8_t *data, size_t len);
+
+/**
+ * @brief Write bytes then read with a repeated start, such as a register read
+ *
+ * @return `ESP_OK` on success, `ESP_FAIL` if the device did not acknowledge
+ */
+esp_err_t sensor_i2c_write_read(i2c_port_t port, uint8_t addr, const uint8_t *out, size_t out_len,
+        uint8_t *in, size_t in_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __SENSOR_I2C_H__
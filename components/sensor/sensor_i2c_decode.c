@@ -0,0 +1,92 @@
+/**
+ * @file sensor_i2c_decode.c
+ *
+ * Checksums and conversions of the I2C humidity sensors
+ */
+#include "sensor_i2c_decode.h"
+
+/**
+ * Divide rounding half away from zero, `d` positive.
+ */
+static inline int32_t div_round(int32_t n, int32_t d)
+{
+    return (n >= 0 ? n + d / 2 : n - d / 2) / d;
+}
+
+uint8_t sensor_crc8(const uint8_t *data, size_t len, uint8_t init)
+{
+    uint8_t crc = init;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 0x80 ? (uint8_t)(crc << 1) ^ 0x31 : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+int16_t si7021_humidity(uint16_t code)
+{
+    // RH = 125 * code / 65536 - 6, the sensor overshoots near both ends
+    int32_t rh = (int32_t)((1250u * code + 32768) >> 16) - 60;
+
+    return rh < 0 ? 0 : rh > 1000 ? 1000 : rh;
+}
+
+int16_t si7021_temperature(uint16_t code)
+{
+    // T = 175.72 * code / 65536 - 46.85, rounded once
+    return div_round((int32_t)(17572u * code) - 4685 * 65536, 655360);
+}
+
+int16_t sht3x_humidity(uint16_t raw)
+{
+    return (1000u * raw + 32767) / 65535;
+}
+
+int16_t sht3x_temperature(uint16_t raw)
+{
+    return (int32_t)((1750u * raw + 32767) / 65535) - 450;
+}
+
+void bme280_parse_calib(bme280_calib_t *calib, const uint8_t tp[BME280_CALIB_TP_LEN],
+        const uint8_t h[BME280_CALIB_H_LEN])
+{
+    calib->t1 = tp[0] | tp[1] << 8;
+    calib->t2 = (int16_t)(tp[2] | tp[3] << 8);
+    calib->t3 = (int16_t)(tp[4] | tp[5] << 8);
+    calib->h1 = tp[25];
+    calib->h2 = (int16_t)(h[0] | h[1] << 8);
+    calib->h3 = h[2];
+    // 12-bit signed values sharing the nibbles of 0xE5
+    calib->h4 = (int16_t)((int8_t)h[3] * 16 | (h[4] & 0x0F));
+    calib->h5 = (int16_t)((int8_t)h[5] * 16 | h[4] >> 4);
+    calib->h6 = (int8_t)h[6];
+}
+
+int bme280_compensate(const bme280_calib_t *calib, const uint8_t data[BME280_DATA_LEN],
+        int16_t *humidity, int16_t *temperature)
+{
+    int32_t adc_t = (int32_t)data[3] << 12 | data[4] << 4 | data[5] >> 4;
+    int32_t adc_h = data[6] << 8 | data[7];
+
+    if (adc_t == BME280_ADC_SKIPPED)
+        return -1;
+
+    // datasheet section 4.2.3, temperature in hundredths
+    int32_t var1 = (((adc_t >> 3) - ((int32_t)calib->t1 << 1)) * calib->t2) >> 11;
+    int32_t var2 = (((((adc_t >> 4) - calib->t1) * ((adc_t >> 4) - calib->t1)) >> 12) * calib->t3) >> 14;
+    int32_t t_fine = var1 + var2;
+    *temperature = div_round((t_fine * 5 + 128) >> 8, 10);
+
+    // relative humidity in Q22.10
+    int32_t v = t_fine - 76800;
+    v = ((((adc_h << 14) - ((int32_t)calib->h4 << 20) - (calib->h5 * v)) + 16384) >> 15)
+        * (((((((v * calib->h6) >> 10) * (((v * calib->h3) >> 11) + 32768)) >> 10) + 2097152)
+            * calib->h2 + 8192) >> 14);
+    v -= ((((v >> 15) * (v >> 15)) >> 7) * calib->h1) >> 4;
+    v = v < 0 ? 0 : v > 419430400 ? 419430400 : v;
+    *humidity = ((v >> 12) * 10 + 512) >> 10;
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file sensor_i2c_decode.h
+ *
+ * Checksums and conversions of the I2C humidity sensors
+ *
+ * Pure functions on the bytes read from the bus, no driver calls, so they
+ * can be checked on the host against recorded transactions. Results are
+ * percents and degrees Celsius * 10, rounded to nearest, like the DHT
+ * driver.
+ */
+#ifndef __SENSOR_I2C_DECODE_H__
+#define __SENSOR_I2C_DECODE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * BME280 trimming parameters, registers 0x88..0xA1 and 0xE1..0xE7.
+ * The pressure ones are not kept.
+ */
+typedef struct
+{
+    uint16_t    t1;
+    int16_t     t2;
+    int16_t     t3;
+    uint8_t     h1;
+    int16_t     h2;
+    uint8_t     h3;
+    int16_t     h4;
+    int16_t     h5;
+    int8_t      h6;
+} bme280_calib_t;
+
+#define BME280_CALIB_TP_LEN     26      //!< Registers 0x88..0xA1
+#define BME280_CALIB_H_LEN      7       //!< Registers 0xE1..0xE7
+#define BME280_DATA_LEN         8       //!< Registers 0xF7..0xFE, pressure, temperature, humidity
+#define BME280_ADC_SKIPPED      0x80000 //!< Temperature of a measurement that did not run
+
+/**
+ * @brief CRC-8 of Sensirion and Silicon Labs sensors, polynomial 0x31
+ *
+ * @param init 0xFF for SHT3x, 0x00 for Si7021
+ */
+uint8_t sensor_crc8(const uint8_t *data, size_t len, uint8_t init);
+
+/**
+ * @brief Si7021 relative humidity code to percents * 10, clamped to 0..100 %
+ */
+int16_t si7021_humidity(uint16_t code);
+
+/**
+ * @brief Si7021 temperature code to degrees Celsius * 10
+ */
+int16_t si7021_temperature(uint16_t code);
+
+/**
+ * @brief SHT3x humidity to percents * 10
+ */
+int16_t sht3x_humidity(uint16_t raw);
+
+/**
+ * @brief SHT3x temperature to degrees Celsius * 10
+ */
+int16_t sht3x_temperature(uint16_t raw);
+
+/**
+ * @brief Unpack the BME280 trimming parameters
+ *
+ * @param[out] calib Parameters
+ * @param tp Registers 0x88..0xA1
+ * @param h Registers 0xE1..0xE7
+ */
+void bme280_parse_calib(bme280_calib_t *calib, const uint8_t tp[BME280_CALIB_TP_LEN],
+        const uint8_t h[BME280_CALIB_H_LEN]);
+
+/**
+ * @brief Compensate a BME280 measurement with the datasheet integer formulas
+ *
+ * @param calib Trimming parameters
+ * @param data Registers 0xF7..0xFE
+ * @param[out] humidity Percents * 10
+ * @param[out] temperature Degrees Celsius * 10
+ * @return 0 on success, -1 if the measurement was skipped
+ */
+int bme280_compensate(const bme280_calib_t *calib, const uint8_t data[BME280_DATA_LEN],
+        int16_t *humidity, int16_t *temperature);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __SENSOR_I2C_DECODE_H__
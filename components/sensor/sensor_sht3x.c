@@ -0,0 +1,61 @@
+/**
+ * @file sensor_sht3x.c
+ *
+ * Sensirion SHT30, SHT31 and SHT35 on I2C
+ *
+ * Single-shot measurements at high repeatability without clock stretching,
+ * the sensor stays idle between reads.
+ */
+#include "sensor.h"
+#include "sensor_i2c.h"
+
+// high repeatability worst case
+#define SHT3X_CONVERSION_MS         16
+#define SHT3X_MIN_INTERVAL_MS       1000
+#define SHT3X_CRC_INIT              0xFF
+
+static const uint8_t measure_cmd[] = { 0x24, 0x00 };
+static const uint8_t status_cmd[] = { 0xF3, 0x2D };
+
+static esp_err_t sensor_sht3x_init(sensor_t *sensor)
+{
+    uint8_t status[3];
+    esp_err_t err = sensor_i2c_write_read(sensor->i2c.port, sensor->i2c.addr,
+                                          status_cmd, sizeof(status_cmd), status, sizeof(status));
+
+    sensor->min_interval_ms = SHT3X_MIN_INTERVAL_MS;
+    if (err != ESP_OK)
+        return err;
+    return sensor_crc8(status, 2, SHT3X_CRC_INIT) == status[2] ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+static esp_err_t sensor_sht3x_start(sensor_t *sensor, uint32_t *wait_ms)
+{
+    *wait_ms = SHT3X_CONVERSION_MS;
+    return sensor_i2c_write(sensor->i2c.port, sensor->i2c.addr, measure_cmd, sizeof(measure_cmd));
+}
+
+/* raw: temperature MSB, LSB, CRC, humidity MSB, LSB, CRC */
+static esp_err_t sensor_sht3x_read(sensor_t *sensor, uint8_t raw[SENSOR_RAW_MAX])
+{
+    return sensor_i2c_read(sensor->i2c.port, sensor->i2c.addr, raw, 6);
+}
+
+static esp_err_t sensor_sht3x_convert(const sensor_t *sensor, const uint8_t raw[SENSOR_RAW_MAX],
+        int16_t *humidity, int16_t *temperature)
+{
+    if (sensor_crc8(raw, 2, SHT3X_CRC_INIT) != raw[2] || sensor_crc8(raw + 3, 2, SHT3X_CRC_INIT) != raw[5])
+        return ESP_ERR_INVALID_CRC;
+
+    *temperature = sht3x_temperature(raw[0] << 8 | raw[1]);
+    *humidity = sht3x_humidity(raw[3] << 8 | raw[4]);
+    return ESP_OK;
+}
+
+const sensor_drv_t sensor_sht3x = {
+    .name = "sht3x",
+    .init = sensor_sht3x_init,
+    .start = sensor_sht3x_start,
+    .read = sensor_sht3x_read,
+    .convert = sensor_sht3x_convert,
+};
@@ -0,0 +1,67 @@
+/**
+ * @file sensor_si7021.c
+ *
+ * Silicon Labs Si7021 and compatible HTU21D on I2C
+ *
+ * A humidity measurement also measures the temperature, which is then
+ * fetched without a second conversion. The measurement is started without
+ * clock stretching, so the bus is free while the sensor converts.
+ */
+#include "sensor.h"
+#include "sensor_i2c.h"
+
+#define SI7021_MEASURE_RH           0xF5    // no hold master mode
+#define SI7021_READ_TEMP_FROM_RH    0xE0
+#define SI7021_READ_USER_REG        0xE7
+
+// 12-bit humidity and 14-bit temperature, worst case
+#define SI7021_CONVERSION_MS        23
+#define SI7021_MIN_INTERVAL_MS      1000
+
+static esp_err_t sensor_si7021_init(sensor_t *sensor)
+{
+    const uint8_t cmd = SI7021_READ_USER_REG;
+    uint8_t reg;
+
+    sensor->min_interval_ms = SI7021_MIN_INTERVAL_MS;
+    return sensor_i2c_write_read(sensor->i2c.port, sensor->i2c.addr, &cmd, 1, &reg, 1);
+}
+
+static esp_err_t sensor_si7021_start(sensor_t *sensor, uint32_t *wait_ms)
+{
+    const uint8_t cmd = SI7021_MEASURE_RH;
+
+    *wait_ms = SI7021_CONVERSION_MS;
+    return sensor_i2c_write(sensor->i2c.port, sensor->i2c.addr, &cmd, 1);
+}
+
+/* raw: humidity MSB, LSB, CRC, temperature MSB, LSB */
+static esp_err_t sensor_si7021_read(sensor_t *sensor, uint8_t raw[SENSOR_RAW_MAX])
+{
+    const uint8_t cmd = SI7021_READ_TEMP_FROM_RH;
+    esp_err_t err = sensor_i2c_read(sensor->i2c.port, sensor->i2c.addr, raw, 3);
+
+    if (err != ESP_OK)
+        return err;
+    return sensor_i2c_write_read(sensor->i2c.port, sensor->i2c.addr, &cmd, 1, raw + 3, 2);
+}
+
+static esp_err_t sensor_si7021_convert(const sensor_t *sensor, const uint8_t raw[SENSOR_RAW_MAX],
+        int16_t *humidity, int16_t *temperature)
+{
+    // the temperature of a humidity measurement comes without a checksum
+    if (sensor_crc8(raw, 2, 0x00) != raw[2])
+        return ESP_ERR_INVALID_CRC;
+
+    *humidity = si7021_humidity(raw[0] << 8 | raw[1]);
+    *temperature = si7021_temperature(raw[3] << 8 | raw[4]);
+    return ESP_OK;
+}
+
+const sensor_drv_t sensor_si7021 = {
+    .name = "si7021",
+    .init = sensor_si7021_init,
+    .start = sensor_si7021_start,
+    .read = sensor_si7021_read,
+    .convert = sensor_si7021_convert,
+};
@@ -21,303 +21,719 @@
 #include "esp_system.h"
 #include "esp_task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_event.h"
 #include "esp_wifi.h"
-#include "esp_http_client.h"
 #include "nvs_flash.h"
+#include "esp_sntp.h"
+#include "esp_attr.h"
+#include <sys/time.h>
 
 #include "lwip/err.h"
 #include <dht.h>
+#include <sensor.h>
+#include <sensor_async.h>
+#include <sensor_i2c.h>
+#if CONFIG_DHT_SIMULATOR
+#include <dht_sim.h>
+#endif
+
+#include "http_conn.h"
+#include "ctrl_channel.h"
+#include "sensor_sched.h"
+#include "history.h"
+#include "url_builder.h"
+#include "report_policy.h"
+#include "job_sched.h"
+#include "power.h"
+#include "wifi_conn.h"
+#include "blynk_resp.h"
+#include "ctrl_state.h"
+#include "metrics.h"
+#include "rollup.h"
+#include "task_layout.h"
+#include "net_load.h"
+#include "local_api.h"
+#include "mem_report.h"
 
 #define     BLYNK_AUTH_TOKEN        "K4HSc6ttnPha6dyF2CdN_A_4JsNfIxbD"
-#define     SERVER                  "blynk.cloud"
-#define     PORT                    "8080"
-
-#define     MAX_HTTP_RECV_BUFFER    4
+#define     SERVER                  CONFIG_BLYNK_SERVER
+#define     PORT                    STRINGIFY(CONFIG_BLYNK_HTTP_PORT)
+#define     STRINGIFY(x)            STRINGIFY_(x)
+#define     STRINGIFY_(x)           #x
+
+#define     API_URL                 "http://" SERVER ":" PORT "/external/api/"
+#define     GET_URL                 API_URL "get?token=" BLYNK_AUTH_TOKEN
+#define     BATCH_UPDATE_URL        API_URL "batch/update?token=" BLYNK_AUTH_TOKEN
+#if CONFIG_HISTORY_FRAME_UPLOAD
+#define     HISTORY_URL             CONFIG_HISTORY_FRAME_URL "?token=" BLYNK_AUTH_TOKEN
+#else
+#define     HISTORY_URL             BATCH_UPDATE_URL
+#endif
+#define     HTTP_URL_LEN            192
+
+/* Switch widget turning reporting on and off */
+#define     VPIN_REPORTING          2
 
 #define     SENSOR_TYPE             DHT_TYPE_AM2301
 #define     SENSOR_PIN              15
+#define     SENSOR_I2C_PORT         I2C_NUM_0
+#if CONFIG_SENSOR_SI7021
+#define     SENSOR_DEV              SENSOR_I2C_DEV(sensor_si7021, SENSOR_I2C_PORT, CONFIG_SENSOR_I2C_ADDR)
+#elif CONFIG_SENSOR_SHT3X
+#define     SENSOR_DEV              SENSOR_I2C_DEV(sensor_sht3x, SENSOR_I2C_PORT, CONFIG_SENSOR_I2C_ADDR)
+#elif CONFIG_SENSOR_BME280
+#define     SENSOR_DEV              SENSOR_I2C_DEV(sensor_bme280, SENSOR_I2C_PORT, CONFIG_SENSOR_I2C_ADDR)
+#else
+#define     SENSOR_DEV              SENSOR_DHT_DEV(SENSOR_TYPE, SENSOR_PIN)
+#endif
+#define     SENSOR_INTERVAL_MS      2000
+/* Give up on a read whose completion has not arrived after this long */
+#define     SENSOR_READ_TIMEOUT_MS  1000
+/* A read passes its sensor id and sequence number through the callback ctx */
+#define     READ_SEQ_MAX            (UINT32_MAX / SENSOR_SCHED_MAX)
+#define     READ_TAG(seq, id)       ((void *)(uintptr_t)((seq) * SENSOR_SCHED_MAX + (id)))
+
+#define     DUTY_WIFI_WAIT_MS       15000
+#define     DUTY_SNTP_WAIT_MS       10000
+#define     DUTY_MIN_SLEEP_MS       1000
 
 #define     EXAMPLE_ESP_WIFI_SSID       "NhanSgu"
 #define     EXAMPLE_ESP_WIFI_PASS       "123456789"
-#define     EXAMPLE_ESP_MAXIMUM_RETRY   5
 
-#define     WIFI_CONNECTED_BIT          BIT0
-#define     WIFI_FAIL_BIT               BIT1
+
+typedef struct
+{
+    sensor_t            dev;
+    uint32_t            interval_ms;
+} sensor_config_t;
+
+/* The first sensor feeds the Blynk pins */
+static sensor_config_t          sensors[] = {
+    { SENSOR_DEV, SENSOR_INTERVAL_MS },
+};
+#define     SENSOR_COUNT            ((int)(sizeof(sensors) / sizeof(sensors[0])))
+
+/* V0/V1 gauges and the V3 humidity line chart, raw or one value per rollup window */
+static const history_pin_t      history_pins[] = {
+    { "v0", HISTORY_TEMPERATURE, CONFIG_ROLLUP_V0_TIER },
+    { "v1", HISTORY_HUMIDITY, CONFIG_ROLLUP_V1_TIER },
+    { "v3", HISTORY_HUMIDITY, CONFIG_ROLLUP_V3_TIER },
+};
+
+#if CONFIG_ROLLUP_STAT_MIN
+#define     ROLLUP_STAT             ROLLUP_MIN
+#elif CONFIG_ROLLUP_STAT_MAX
+#define     ROLLUP_STAT             ROLLUP_MAX
+#elif CONFIG_ROLLUP_STAT_LAST
+#define     ROLLUP_STAT             ROLLUP_LAST
+#else
+#define     ROLLUP_STAT             ROLLUP_MEAN
+#endif
 
 static const char               *TAG                    = "UPDATE_DATA";
 static const char               *TAG_BUTTON_BLYNK       = "BUTTON_BLYNK";
-static  const char              *TAG_WIFI               = "wifi station";
 
-static  EventGroupHandle_t      s_wifi_event_group;
-static  float                   temperature, humidity;
-static  int                     s_retry_num             = 0;
-int                             button_blynk_response;
+static  sensor_sched_t          sensor_sched;
+static  report_policy_t         report_policy;
+static  QueueHandle_t           sensor_results;
+static  job_sched_t             jobs;
+static  TaskHandle_t            loop_task;
+static  int                     sensors_job_id;
+static  int                     upload_job_id;
+static  metrics_hist_t          dht_read_us;    // read itself, on the worker
+static  metrics_hist_t          dht_wait_us;    // queued until the worker started it
+static  metrics_hist_t          dht_cs_us;      // interrupts masked during the read
+static  metrics_hist_t          dht_jitter_us;  // start drift from the sensor interval
+static  metrics_counter_t       dht_ok;
+static  metrics_counter_t       dht_failed;
+static  rollup_t                rollup;
+static  int                     rollup_tiers[HISTORY_MAX_TIERS];    // history tier of each rollup tier
+static  int64_t                 rollup_offset_ms;                   // rollup clock minus uptime
+
+static  uint32_t                sensors_job(void *ctx);
+static  void                    sensors_init(void);
+
+static  void            wifi_start(void);
+static  int             reporting(void);
+
+const char              *form_http_request(char *buf, size_t size, const int *vpins, size_t count);
+esp_err_t               read_pins(const int *vpins, size_t count, blynk_resp_cb_t on_value, void *ctx);
+static void             start_control_channel();
+static uint32_t         upload_job(void *ctx);
+static void             main_loop(void *pvParameters);
+
+static inline uint32_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
 
-void                            dht_test(void *pvParameters);
+/* Completed read handed from the sensor worker to sensors_job() */
+typedef struct
+{
+    int                     id;
+    uint32_t                seq;        // sequence number of the request
+    sensor_read_result_t    result;
+} sensor_result_t;
 
-static  void            event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
-void                    wifi_init_sta(void);
-esp_err_t               client_event_post_handler(esp_http_client_event_handle_t evt);
+#if CONFIG_DHT_SIMULATOR
+static void sensor_sim_attach(const sensor_config_t *sensor)
+{
+    dht_sim_config_t sim = {
+        .type = sensor->dev.dht.type,
+        .humidity = 500,
+        .temperature = 250,
+        .jitter_us = CONFIG_DHT_SIM_JITTER_US};
+    ESP_ERROR_CHECK(dht_sim_attach(sensor->dev.dht.pin, &sim));
+}
+#endif
 
-char                    *form_http_request(char *pin);
-char                    *send_http_request_and_parse_response(char *http_request);
-void                    send_http_request_and_no_parse_response(char *http_request);
-void                    write_http_request(char *pinTemperature, char *pinHumidity);
-static void             check_button();
-static void             update_data();
+/* Bring up the line or the bus of a sensor, RMT channel -1 to bit-bang a DHT */
+static esp_err_t sensor_setup(sensor_config_t *sensor, int rmt_channel)
+{
+    char name[32];
+    esp_err_t err;
+
+    if (sensor->dev.drv == &sensor_dht)
+    {
+#if CONFIG_DHT_SIMULATOR
+        // simulated lines are bit-banged only
+        sensor_sim_attach(sensor);
+#else
+        gpio_num_t pin = sensor->dev.dht.pin;
+        if (rmt_channel >= 0 && (rmt_channel >= RMT_CHANNEL_MAX || dht_rmt_attach(pin, rmt_channel) != ESP_OK))
+            ESP_LOGW(TAG, "RMT capture unavailable on GPIO %d, bit-banging the sensor", pin);
+#endif
+    }
+#if !CONFIG_SENSOR_DHT
+    else if ((err = sensor_i2c_bus_init(sensor->dev.i2c.port, CONFIG_SENSOR_I2C_SDA, CONFIG_SENSOR_I2C_SCL,
+                                        CONFIG_SENSOR_I2C_HZ)) != ESP_OK)
+        return err;
+#endif
+
+    sensor_describe(&sensor->dev, name, sizeof(name));
+    if ((err = sensor_init(&sensor->dev)) != ESP_OK)
+        ESP_LOGE(TAG, "No answer from %s: %s", name, esp_err_to_name(err));
+    return err;
+}
 
-void dht_test(void *pvParameters)
+static void sensors_init(void)
 {
+    sensor_results = xQueueCreate(4, sizeof(sensor_result_t));
+    ESP_ERROR_CHECK(sensor_results ? ESP_OK : ESP_ERR_NO_MEM);
+    const task_layout_t *layout = task_layout_get(TASK_SENSOR);
+    StackType_t *stack;
+    StaticTask_t *tcb;
+    if (task_layout_static(TASK_SENSOR, &stack, &tcb))
+        ESP_ERROR_CHECK(sensor_async_init_static(4, layout->stack, layout->priority, layout->core, stack, tcb));
+    else
+        ESP_ERROR_CHECK(sensor_async_init(4, layout->stack, layout->priority, layout->core));
 
-    while (1)
+    // channel order matches the values passed by sensors_job()
+    report_policy_init(&report_policy, CONFIG_REPORT_MIN_INTERVAL_MS, CONFIG_REPORT_MAX_INTERVAL_S * 1000);
+    report_policy_add_channel(&report_policy, CONFIG_REPORT_TEMP_DEADBAND);
+    report_policy_add_channel(&report_policy, CONFIG_REPORT_HUM_DEADBAND);
+
+    // a sensor missing at boot keeps its slot, its reads retry the setup
+    for (int i = 0; i < SENSOR_COUNT; i++)
     {
-        if (dht_read_float_data(SENSOR_TYPE, 15, &humidity, &temperature) == ESP_OK)
-            printf("Humidity: %.1f%% Temp: %.1fC\n", humidity, temperature);
-        else
-            printf("Could not read data from sensor\n");
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        sensor_setup(&sensors[i], i);
+        if (sensor_sched_add(&sensor_sched, sensors[i].interval_ms,
+                             sensors[i].dev.min_interval_ms, (void *)&sensors[i], now_ms()) < 0)
+            ESP_LOGE(TAG, "Too many sensors, sensor %d ignored", i);
     }
 }
 
-static void event_handler(void *arg, esp_event_base_t event_base,
-                          int32_t event_id, void *event_data)
+static void on_sensor_read(const sensor_read_result_t *result, void *ctx)
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
+    static int64_t last_started_us[SENSOR_COUNT];    // 0 after a failed read
+    uint32_t tag = (uint32_t)(uintptr_t)ctx;
+    sensor_result_t r = { .id = tag % SENSOR_SCHED_MAX, .seq = tag / SENSOR_SCHED_MAX, .result = *result };
+
+    if (r.id < SENSOR_COUNT)
     {
-        esp_wifi_connect();
+        int64_t drift = result->started_us - last_started_us[r.id] - sensors[r.id].interval_ms * 1000LL;
+        if (result->err == ESP_OK && last_started_us[r.id])
+            metrics_record(&dht_jitter_us, drift < 0 ? -drift : drift);
+        last_started_us[r.id] = result->err == ESP_OK ? result->started_us : 0;
     }
-    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    metrics_record(&dht_read_us, result->done_us - result->started_us);
+    metrics_record(&dht_wait_us, result->started_us - result->queued_us);
+    metrics_record(&dht_cs_us, result->cs_us);
+    metrics_count(result->err == ESP_OK ? &dht_ok : &dht_failed);
+
+    xQueueSend(sensor_results, &r, portMAX_DELAY);
+    job_sched_trigger(&jobs, sensors_job_id);
+    if (loop_task)
+        xTaskNotifyGive(loop_task);
+}
+
+/* Tiers with a zero window are left out, the pins on them get nothing */
+static void rollup_setup(void)
+{
+    const uint32_t windows_s[HISTORY_MAX_TIERS] = { CONFIG_ROLLUP_TIER1_S, CONFIG_ROLLUP_TIER2_S };
+
+    rollup_init(&rollup, 2);
+    for (int t = 0; t < HISTORY_MAX_TIERS; t++)
     {
-        if (s_retry_num < EXAMPLE_ESP_MAXIMUM_RETRY)
-        {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG_WIFI, "retry to connect to the AP");
-        }
-        else
-        {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        }
-        ESP_LOGI(TAG_WIFI, "connect to the AP fail");
+        int i = windows_s[t] ? rollup_add_tier(&rollup, windows_s[t] * 1000) : -1;
+        if (i >= 0)
+            rollup_tiers[i] = HISTORY_RAW + 1 + t;
     }
-    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
+}
+
+static void on_rollup(int tier, int64_t start_ms, const rollup_acc_t *acc, void *ctx)
+{
+    history_add_rollup(rollup_tiers[tier], start_ms - rollup_offset_ms,
+                       rollup_stat(&acc[0], ROLLUP_STAT), rollup_stat(&acc[1], ROLLUP_STAT));
+}
+
+static void sensor_handle_result(const sensor_result_t *r)
+{
+    int id = r->id;
+    const sensor_config_t *sensor = sensor_sched_user(&sensor_sched, id);
+    int16_t i_humidity = r->result.humidity, i_temp = r->result.temperature;
+    bool ok = r->result.err == ESP_OK;
+    char name[32];
+
+    sensor_sched_done(&sensor_sched, id, ok, i_humidity, i_temp, now_ms());
+    sensor_describe(&sensor->dev, name, sizeof(name));
+    ESP_LOGD(TAG, "%s read in %lld us", name, (long long)(r->result.done_us - r->result.started_us));
+
+    if (!ok)
+    {
+        printf("Could not read data from %s\n", name);
+        return;
+    }
+    // tenths as integers, printing a double takes the most stack of the loop
+    printf("%s Humidity: %d.%d%% Temp: %s%d.%dC\n", name, i_humidity / 10, i_humidity % 10,
+           i_temp < 0 ? "-" : "", abs(i_temp) / 10, abs(i_temp) % 10);
+}
+
+/* Report the latest sample of the first sensor, taken from its published slot */
+static void sample_report(void)
+{
+    static uint32_t seq;    // last sample reported
+    sample_slot_t *slot = sensor_sched_latest(&sensor_sched, 0);
+    sample_t s;
+
+    // several reads drained at once are reported as the newest one
+    if (!slot || !sample_is_newer(slot, seq) || !sample_read(slot, &s))
+        return;
+    seq = s.seq;
+
+    // uptime of the read on the 64 bit clock, the slot keeps 32 bits
+    int64_t uptime_ms = esp_timer_get_time() / 1000 - (uint32_t)(now_ms() - s.timestamp_ms);
+#if CONFIG_LOCAL_API
+    // the LAN always gets the latest sample, whatever the reporting switch
+    local_api_publish(uptime_ms, s.temperature, s.humidity);
+#endif
+
+    // while reporting is off, send the first sample once it is back on,
+    // keep buffering while the switch is not known yet
+    const int16_t values[] = { s.temperature, s.humidity };
+    if (reporting() == 0)
     {
-        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-        ESP_LOGI(TAG_WIFI, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        report_policy_force(&report_policy);
+        return;
     }
+
+    // rollups see every sample, the policy only thins out the raw pins,
+    // timed by the read so a late run of this job does not skew it
+    uint32_t windows = rollup.windows;
+    rollup_add(&rollup, uptime_ms, values, on_rollup, NULL);
+    if (report_policy_check(&report_policy, values, s.timestamp_ms))
+        history_add(uptime_ms, s.temperature, s.humidity);
+    else if (windows == rollup.windows)
+        return;
+    job_sched_trigger(&jobs, upload_job_id);
 }
 
-void wifi_init_sta()
-{
-    s_wifi_event_group = xEventGroupCreate();
-
-    ESP_ERROR_CHECK(esp_netif_init());
-
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
-
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-    // có bất kỳ event nào của wifi thì chạy vào hàm event_handler
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &event_handler,
-                                                        NULL,
-                                                        NULL));
-
-    // có bất kỳ event nào của IP thì chạy vào hàm event_handler
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &event_handler,
-                                                        NULL,
-                                                        NULL));
-
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = EXAMPLE_ESP_WIFI_SSID,
-            .password = EXAMPLE_ESP_WIFI_PASS,
-            /* Setting a password implies station will connect to all security modes including WEP/WPA.
-             * However these modes are deprecated and not advisable to be used. Incase your Access point
-             * doesn't support WPA2, these mode can be enabled by commenting below line */
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-            .pmf_cfg = {
-                .capable = true,
-                .required = false},
-        },
-    };
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_LOGI(TAG_WIFI, "wifi_init_sta finished.");
-
-    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-     * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
-
-    // đợi 2 bit WIFI_CONNECTED_BIT WIFI_FAIL_BIT được set
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                           pdFALSE,
-                                           pdFALSE,
-                                           portMAX_DELAY);
-
-    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-     * happened. */
-    if (bits & WIFI_CONNECTED_BIT)
+/* Hand finished reads to the scheduler and start the next one when it is due */
+static uint32_t sensors_job(void *ctx)
+{
+    static bool busy;
+    static int busy_id;
+    static uint32_t busy_seq;
+    static uint32_t busy_since_ms;
+    sensor_result_t r;
+
+    while (xQueueReceive(sensor_results, &r, 0) == pdTRUE)
     {
-        ESP_LOGI(TAG_WIFI, "connected to ap SSID:%s password:%s",
-                 EXAMPLE_ESP_WIFI_SSID, EXAMPLE_ESP_WIFI_PASS);
+        // a read given up on below was already closed in the scheduler
+        if (!busy || r.seq != busy_seq)
+        {
+            ESP_LOGW(TAG, "Sensor %d read completed after it timed out, dropped", r.id);
+            continue;
+        }
+        sensor_handle_result(&r);
+        busy = false;
     }
-    else if (bits & WIFI_FAIL_BIT)
+    sample_report();
+    // one read in flight at a time, the worker serializes them anyway;
+    // a completion that never comes must not stop the sensors for good
+    uint32_t now = now_ms();
+    if (busy)
     {
-        ESP_LOGI(TAG_WIFI, "Failed to connect to SSID:%s, password:%s",
-                 EXAMPLE_ESP_WIFI_SSID, EXAMPLE_ESP_WIFI_PASS);
+        uint32_t elapsed = now - busy_since_ms;
+        if (elapsed < SENSOR_READ_TIMEOUT_MS)
+            return SENSOR_READ_TIMEOUT_MS - elapsed;
+        ESP_LOGW(TAG, "Sensor %d read not completed after %d ms", busy_id, SENSOR_READ_TIMEOUT_MS);
+        metrics_count(&dht_failed);
+        sensor_sched_done(&sensor_sched, busy_id, false, 0, 0, now);
+        busy = false;
     }
-    else
+
+    int id;
+    uint32_t wait = sensor_sched_next(&sensor_sched, now, &id);
+    if (id < 0)
+        return wait;
+
+    sensor_config_t *sensor = sensor_sched_user(&sensor_sched, id);
+    uint32_t seq = (busy_seq + 1) % READ_SEQ_MAX;
+    if (sensor_read_async(&sensor->dev, on_sensor_read, READ_TAG(seq, id)) == ESP_OK)
     {
-        ESP_LOGE(TAG_WIFI, "UNEXPECTED EVENT");
+        busy = true;
+        busy_seq = seq;
+        busy_id = id;
+        busy_since_ms = now;
+        return SENSOR_READ_TIMEOUT_MS;
     }
+    sensor_sched_done(&sensor_sched, id, false, 0, 0, now);
+    return 0;
+}
+
+static void on_wifi_connected(void *ctx)
+{
+    // upload what was buffered while offline
+    job_sched_trigger(&jobs, upload_job_id);
+    if (loop_task)
+        xTaskNotifyGive(loop_task);
+}
+
+static void wifi_start(void)
+{
+    wifi_conn_config_t config = {
+        .ssid = EXAMPLE_ESP_WIFI_SSID,
+        .password = EXAMPLE_ESP_WIFI_PASS,
+        .on_connected = on_wifi_connected,
+        .ctx = NULL};
+
+    ESP_ERROR_CHECK(wifi_conn_start(&config));
 }
 
-esp_err_t client_event_post_handler(esp_http_client_event_handle_t evt)
+/* get?token=...&v2&v4 reads all the pins in one round trip */
+const char *form_http_request(char *buf, size_t size, const int *vpins, size_t count)
 {
-    switch (evt->event_id)
+    static const url_prefix_t get_url = URL_PREFIX(GET_URL);
+    url_builder_t b;
+
+    url_init(&b, buf, size);
+    url_append_prefix(&b, &get_url);
+    for (size_t i = 0; i < count; i++)
     {
-    case HTTP_EVENT_ON_DATA:
-        printf("HTTP_EVENT_ON_DATA: %.*s\n", evt->data_len, (char *)evt->data);
-        break;
+        url_append(&b, "&v", 2);
+        url_append_int(&b, vpins[i]);
+    }
+    return url_finish(&b);
+}
 
-    default:
-        break;
+/* Upload what the sensors job queued, then wait for the next report */
+static uint32_t upload_job(void *ctx)
+{
+    // keep buffering until the switch is known, on_reporting_change() triggers us
+    int on = reporting();
+    if (on < 0)
+        return JOB_IDLE;
+    if (!on)
+    {
+        history_clear();
+        return JOB_IDLE;
+    }
+    // keep buffering until Wi-Fi is up, on_wifi_connected() triggers us
+    if (!wifi_conn_is_connected())
+        return JOB_IDLE;
+    // after an outage keep draining the backlog without waiting
+    while (history_pending())
+    {
+        if (history_flush() != ESP_OK)
+            return CONFIG_REPORT_RETRY_MS;
+        wifi_conn_mark_upload();
     }
-    return ESP_OK;
-}
-
-char *form_http_request(char *pin)
-{
-    static char http_request[500];
-    bzero(http_request, sizeof(http_request));
-    strcat(http_request, "http://");
-    strcat(http_request, SERVER);
-    strcat(http_request, ":");
-    strcat(http_request, PORT);
-    strcat(http_request, "/external/api/get");
-    strcat(http_request, "?token=");
-    strcat(http_request, BLYNK_AUTH_TOKEN);
-    strcat(http_request, "&pin=");
-    strcat(http_request, pin);
-    return http_request;
-}
-
-void send_http_request_and_no_parse_response(char *http_request)
-{
-    esp_http_client_config_t config_get = {
-        .url = http_request,
-        .method = HTTP_METHOD_GET,
-        .cert_pem = NULL,
-        .event_handler = client_event_post_handler};
-
-    esp_http_client_handle_t client = esp_http_client_init(&config_get);
-    esp_http_client_perform(client);
-    esp_http_client_cleanup(client);
-}
-
-void write_http_request(char *pinTemperature, char *pinHumidity)
-{
-    static char http_request[500];
-    char data[8];
-    char data2[8];
-
-    sprintf(data, "%.1f", temperature);
-    sprintf(data2, "%.1f", humidity);
-
-    bzero(http_request, sizeof(http_request));
-    strcat(http_request, "http://");
-    strcat(http_request, SERVER);
-    strcat(http_request, ":");
-    strcat(http_request, PORT);
-    strcat(http_request, "/external/api/batch/update");
-    strcat(http_request, "?token=");
-    strcat(http_request, BLYNK_AUTH_TOKEN);
-    strcat(http_request, "&");
-    strcat(http_request, pinTemperature);
-    strcat(http_request, "=");
-    strcat(http_request, data);
-    strcat(http_request, "&");
-    strcat(http_request, pinHumidity);
-    strcat(http_request, "=");
-    strcat(http_request, data2);
-    strcat(http_request, "&");
-    strcat(http_request, "v3");
-    strcat(http_request, "=");
-    strcat(http_request, data2);
-    send_http_request_and_no_parse_response(http_request);
-}
-
-static void update_data()
+    ESP_LOGD(TAG, "%u of %u samples reported, %u heartbeats", (unsigned)report_policy.reports,
+             (unsigned)report_policy.samples, (unsigned)report_policy.heartbeats);
+    return JOB_IDLE;
+}
+
+#if CONFIG_EVENT_LOOP_TRACE_DUMP_S
+static uint32_t trace_job(void *ctx)
 {
-    while (1)
+    // off the loop stack, only this job reads it
+    static job_trace_t trace[JOB_SCHED_TRACE_LEN];
+    size_t n = job_sched_trace(&jobs, trace, JOB_SCHED_TRACE_LEN);
+
+    for (size_t i = 0; i < n; i++)
+        ESP_LOGI(TAG, "trace %u ms %s: %u us, %u ms late", (unsigned)trace[i].start_ms,
+                 jobs.jobs[trace[i].job].name, (unsigned)trace[i].duration_us, (unsigned)trace[i].late_ms);
+    for (int i = 0; i < jobs.count; i++)
+        ESP_LOGI(TAG, "job %s: %u runs, max %u us, max %u ms late", jobs.jobs[i].name,
+                 (unsigned)jobs.jobs[i].runs, (unsigned)jobs.jobs[i].max_us, (unsigned)jobs.jobs[i].max_late_ms);
+    ESP_LOGI(TAG, "%u wakeups", (unsigned)jobs.wakeups);
+
+    power_stats_t power;
+    power_get_stats(&power);
+    ESP_LOGI(TAG, "%u ms awake, %u ms radio, ~%u mAh/day", (unsigned)power.awake_ms,
+             (unsigned)power.radio_ms, (unsigned)power_estimate_mah_per_day(&power));
+
+    return CONFIG_EVENT_LOOP_TRACE_DUMP_S * 1000;
+}
+#endif
+
+static void metrics_init(void)
+{
+    metrics_register_hist(&dht_read_us, "dht.read");
+    metrics_register_hist(&dht_wait_us, "dht.wait");
+    metrics_register_hist(&dht_cs_us, "dht.critical");
+    metrics_register_hist(&dht_jitter_us, "dht.jitter");
+    metrics_register_counter(&dht_ok, "dht.ok");
+    metrics_register_counter(&dht_failed, "dht.failed");
+
+    for (int i = 0; i < TASK_COUNT; i++)
     {
-        if (button_blynk_response == 1)
-        {
-            write_http_request("v0", "v1");
-        }
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        if (i != TASK_METRICS)
+            metrics_watch_task(task_layout_get(i)->name);
     }
+#if CONFIG_METRICS_SERIAL
+    if (metrics_serial_start() != ESP_OK)
+        ESP_LOGW(TAG, "Console metrics unavailable");
+#endif
+}
+
+#if CONFIG_METRICS_DUMP_S
+static uint32_t metrics_dump_job(void *ctx)
+{
+    metrics_dump();
+    return CONFIG_METRICS_DUMP_S * 1000;
+}
+#endif
+
+#if CONFIG_METRICS_PUSH_S
+#define     METRICS_PUSH_LEN        256
+
+static uint32_t metrics_push_job(void *ctx)
+{
+    static const url_prefix_t update_url = URL_PREFIX(BATCH_UPDATE_URL);
+    static char snapshot[METRICS_PUSH_LEN];
+    static char url[HTTP_URL_LEN + METRICS_PUSH_LEN];
+    url_builder_t b;
+
+    if (!wifi_conn_is_connected())
+        return CONFIG_METRICS_PUSH_S * 1000;
+
+    // the compact line only holds characters allowed in a query string
+    metrics_snapshot(snapshot, sizeof(snapshot), METRICS_FORMAT_COMPACT);
+    url_init(&b, url, sizeof(url));
+    url_append_prefix(&b, &update_url);
+    url_append_param(&b, "v" STRINGIFY(CONFIG_METRICS_VPIN), snapshot);
+    if (url_finish(&b))
+        http_conn_get(HTTP_CONN_EP_UPDATE, url, NULL, 0, NULL);
+    return CONFIG_METRICS_PUSH_S * 1000;
 }
+#endif
 
-char *send_http_request_and_parse_response(char *http_request)
+static uint64_t loop_clock_us(void)
 {
-    static char res_buffer[MAX_HTTP_RECV_BUFFER];
-    bzero(res_buffer, sizeof(res_buffer));
+    return esp_timer_get_time();
+}
 
-    if (res_buffer == NULL)
+/* Sensor reads and uploads share this task, woken by timeouts or triggers */
+static void main_loop(void *pvParameters)
+{
+    while (1)
     {
-        ESP_LOGI(TAG_BUTTON_BLYNK, "Cannot malloc http receive buffer");
-        return "\0";
+        uint32_t wait = job_sched_run(&jobs);
+        if (wait)
+            ulTaskNotifyTake(pdTRUE, wait == JOB_IDLE ? portMAX_DELAY : pdMS_TO_TICKS(wait) + 1);
     }
-    esp_http_client_config_t config = {
-        .url = http_request,
-        .method = HTTP_METHOD_GET,
-        .cert_pem = NULL,
-        .event_handler = client_event_post_handler};
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_err_t err;
-    if ((err = esp_http_client_open(client, 0)) != ESP_OK)
+}
+
+static void on_pin_data(const char *data, size_t len, void *ctx)
+{
+    blynk_resp_t *parser = ctx;
+
+    // a retried request starts the body over
+    if (!data)
+        blynk_resp_reset(parser);
+    else
+        blynk_resp_feed(parser, data, len);
+}
+
+esp_err_t read_pins(const int *vpins, size_t count, blynk_resp_cb_t on_value, void *ctx)
+{
+    char url[HTTP_URL_LEN];
+    char value[CTRL_CHAN_VALUE_LEN];
+    blynk_resp_t parser;
+    int status = 0;
+
+    if (!form_http_request(url, sizeof(url), vpins, count))
+        return ESP_ERR_INVALID_SIZE;
+
+    blynk_resp_init(&parser, vpins, count, value, sizeof(value), on_value, ctx);
+    esp_err_t err = http_conn_get_stream(HTTP_CONN_EP_GET, url, on_pin_data, &parser, &status);
+    if (err == ESP_OK && (status != 200 || !blynk_resp_finish(&parser)))
+        err = ESP_ERR_INVALID_RESPONSE;
+    if (err != ESP_OK)
+        ESP_LOGI(TAG_BUTTON_BLYNK, "Failed to read pins: %s", esp_err_to_name(err));
+    else if (parser.truncated)
+        ESP_LOGW(TAG_BUTTON_BLYNK, "%u values truncated", (unsigned)parser.truncated);
+    return err;
+}
+
+/* Reporting switch, -1 until its first value arrives */
+static int reporting(void)
+{
+    bool on;
+    return ctrl_state_get_bool(VPIN_REPORTING, &on) ? on : -1;
+}
+
+static void on_reporting_change(int vpin, const char *value, void *ctx)
+{
+    ESP_LOGI(TAG_BUTTON_BLYNK, "V%d -> %s", vpin, value);
+    job_sched_trigger(&jobs, upload_job_id);
+    if (loop_task)
+        xTaskNotifyGive(loop_task);
+}
+
+static bool on_control_update(int vpin, const char *value, void *ctx)
+{
+    return ctrl_state_update(vpin, value);
+}
+
+/* Every control pin is registered here, they are all read in one request */
+static void control_init(ctrl_state_cb_t on_reporting)
+{
+    ESP_ERROR_CHECK(ctrl_state_init(read_pins));
+    ESP_ERROR_CHECK(ctrl_state_register(VPIN_REPORTING, on_reporting, NULL));
+}
+
+static void start_control_channel()
+{
+    ctrl_chan_config_t config = {
+        .host = SERVER,
+        .port = CONFIG_BLYNK_HW_PORT,
+        .token = BLYNK_AUTH_TOKEN,
+        .on_update = on_control_update,
+        .poll = read_pins,
+        .ctx = NULL};
+
+    config.pin_count = ctrl_state_pins(&config.pins);
+
+    ESP_ERROR_CHECK(ctrl_chan_start(&config));
+}
+
+static void start_sntp(void)
+{
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, "pool.ntp.org");
+    sntp_init();
+}
+
+#if CONFIG_POWER_MODE_DUTY_CYCLE
+/* Samples waiting for the next Wi-Fi session, kept across deep sleep */
+typedef struct
+{
+    int64_t     time_ms;        // RTC wall clock, keeps counting in deep sleep
+    int16_t     temperature;
+    int16_t     humidity;
+} rtc_sample_t;
+
+static RTC_DATA_ATTR rtc_sample_t   rtc_samples[CONFIG_POWER_RTC_SAMPLES];
+static RTC_DATA_ATTR uint32_t       rtc_sample_count;
+
+static int64_t wall_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void duty_cycle_upload(void)
+{
+    ESP_ERROR_CHECK(http_conn_init());
+    ESP_ERROR_CHECK(history_init(HISTORY_URL, history_pins,
+                                 sizeof(history_pins) / sizeof(history_pins[0])));
+
+    // history stamps samples with uptime, convert before SNTP moves the clock
+    int64_t offset = wall_ms() - esp_timer_get_time() / 1000;
+    for (uint32_t i = 0; i < rtc_sample_count; i++)
+        history_add(rtc_samples[i].time_ms - offset, rtc_samples[i].temperature, rtc_samples[i].humidity);
+
+    // windows are rolled up from the samples of this upload, open ones included:
+    // one straddling two uploads is sent twice and the later part overwrites it
+    rollup_setup();
+    rollup_offset_ms = offset;
+    for (uint32_t i = 0; i < rtc_sample_count; i++)
     {
-        ESP_LOGI(TAG_BUTTON_BLYNK, "Failed to open HTTP connection: %s", esp_err_to_name(err));
-        return "\0";
+        const int16_t values[] = { rtc_samples[i].temperature, rtc_samples[i].humidity };
+        rollup_add(&rollup, rtc_samples[i].time_ms, values, on_rollup, NULL);
     }
-    int content_length = esp_http_client_fetch_headers(client);
-    int total_read_len = 0, read_len;
-    if (total_read_len < content_length && content_length <= MAX_HTTP_RECV_BUFFER)
+    rollup_close_expired(&rollup, INT64_MAX, on_rollup, NULL);
+
+    wifi_start();
+    if (!wifi_conn_wait(DUTY_WIFI_WAIT_MS))
+        return;
+    start_sntp();
+    for (int i = 0; i < DUTY_SNTP_WAIT_MS / 100 && sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED; i++)
+        vTaskDelay(pdMS_TO_TICKS(100));
+
+    // upload unless the switch is known to be off
+    ctrl_state_refresh();
+    if (reporting() == 0)
     {
-        read_len = esp_http_client_read(client, res_buffer, content_length);
-        if (read_len <= 0)
-        {
-            ESP_LOGI(TAG_BUTTON_BLYNK, "Error read data");
-        }
-        res_buffer[read_len] = 0;
+        history_clear();
+        rtc_sample_count = 0;
+        return;
     }
 
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-    return res_buffer;
+    while (history_pending() && history_flush() == ESP_OK)
+        wifi_conn_mark_upload();
+    // on failure keep everything, a resent point only overwrites itself
+    if (!history_pending())
+        rtc_sample_count = 0;
 }
 
-static void check_button()
+/* One wake: read, buffer in RTC memory, upload every few samples, sleep */
+static void duty_cycle_run(void)
 {
-    while (1)
+    sensor_config_t *sensor = &sensors[0];
+    int16_t humidity, temperature;
+    char name[32];
+
+    // one read per wake, a DHT is bit-banged
+    sensor_setup(sensor, -1);
+    if (sensor_read(&sensor->dev, &humidity, &temperature) == ESP_OK)
     {
-        char http_request[500];
-        strcpy(http_request, form_http_request("v2"));
-        button_blynk_response = atoi(send_http_request_and_parse_response(http_request));
-        vTaskDelay(pdMS_TO_TICKS(50));
+        if (rtc_sample_count == CONFIG_POWER_RTC_SAMPLES)
+        {
+            memmove(rtc_samples, rtc_samples + 1, sizeof(rtc_samples) - sizeof(rtc_samples[0]));
+            rtc_sample_count--;
+        }
+        rtc_samples[rtc_sample_count++] = (rtc_sample_t){ wall_ms(), temperature, humidity };
+    }
+    else
+    {
+        sensor_describe(&sensor->dev, name, sizeof(name));
+        printf("Could not read data from %s\n", name);
     }
+
+    if (rtc_sample_count >= CONFIG_POWER_UPLOAD_EVERY)
+        duty_cycle_upload();
+
+    int64_t awake = esp_timer_get_time() / 1000;
+    int64_t interval = CONFIG_POWER_SAMPLE_INTERVAL_S * 1000;
+    power_deep_sleep(awake + DUTY_MIN_SLEEP_MS < interval ? interval - awake : DUTY_MIN_SLEEP_MS);
 }
+#endif
 
 void app_main(void)
 {
@@ -329,12 +745,58 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    ESP_ERROR_CHECK(power_init());
+    mem_report_mark("boot");
+
+#if CONFIG_POWER_MODE_DUTY_CYCLE
+    control_init(NULL);
+    duty_cycle_run();
+#endif
+
+    ESP_ERROR_CHECK(http_conn_init());
+    ESP_ERROR_CHECK(history_init(HISTORY_URL, history_pins,
+                                 sizeof(history_pins) / sizeof(history_pins[0])));
+    mem_report_mark("history");
+
+    control_init(on_reporting_change);
+    metrics_init();
+    rollup_setup();
+#if CONFIG_LOCAL_API
+    ESP_ERROR_CHECK(local_api_init());
+#endif
+    mem_report_mark("control");
+
+    /* Sampling starts right away, history buffers until Wi-Fi is up */
+    sensors_init();
+    mem_report_mark("sensor");
+    job_sched_init(&jobs, loop_clock_us, CONFIG_EVENT_LOOP_SLACK_MS);
+    sensors_job_id = job_sched_add(&jobs, "sensors", sensors_job, NULL, 0);
+    upload_job_id = job_sched_add(&jobs, "upload", upload_job, NULL, JOB_IDLE);
+#if CONFIG_EVENT_LOOP_TRACE_DUMP_S
+    job_sched_add(&jobs, "trace", trace_job, NULL, CONFIG_EVENT_LOOP_TRACE_DUMP_S * 1000);
+#endif
+#if CONFIG_METRICS_DUMP_S
+    job_sched_add(&jobs, "metrics_dump", metrics_dump_job, NULL, CONFIG_METRICS_DUMP_S * 1000);
+#endif
+#if CONFIG_METRICS_PUSH_S
+    job_sched_add(&jobs, "metrics_push", metrics_push_job, NULL, CONFIG_METRICS_PUSH_S * 1000);
+#endif
+    task_layout_log();
+    ESP_ERROR_CHECK(task_layout_create(TASK_LOOP, main_loop, NULL, &loop_task));
+    mem_report_mark("loop");
 
     ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
-    wifi_init_sta();
-
-    xTaskCreate(dht_test, "dht_test", configMINIMAL_STACK_SIZE * 3, NULL, 1, NULL);
-    /* Start Blynk client task */
-    xTaskCreate(check_button, "HTTP request for valve control", 4096, NULL, 1, NULL);
-    xTaskCreate(update_data, "HTTP request for valve control", 4096, NULL, 1, NULL);
+    wifi_start();
+    start_sntp();
+    mem_report_mark("wifi");
+#if CONFIG_LOCAL_API
+    local_api_start();
+    mem_report_mark("httpd");
+#endif
+    /* Start Blynk control channel */
+    start_control_channel();
+    mem_report_mark("ctrl");
+#if CONFIG_SOAK_NET_LOAD
+    ESP_ERROR_CHECK(net_load_start());
+#endif
 }
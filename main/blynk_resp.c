@@ -0,0 +1,333 @@
+/**
+ * @file blynk_resp.c
+ *
+ * Streaming parser for Blynk /external/api/get responses.
+ */
+#include "blynk_resp.h"
+
+enum
+{
+    RESP_START = 0,
+    RESP_KEY_WAIT,          // object: before a key or the closing brace
+    RESP_KEY,
+    RESP_COLON,
+    RESP_VALUE,
+    RESP_STRING,
+    RESP_BARE,              // number, true, false, null or a bare top-level value
+    RESP_NESTED,            // array value, looking for its first element
+    RESP_NESTED_STRING,
+    RESP_NESTED_BARE,
+    RESP_NEXT,              // after a value: comma or the closing bracket
+    RESP_DONE,
+    RESP_ERROR,
+};
+
+static inline bool resp_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline void resp_append(blynk_resp_t *p, char c)
+{
+    if (p->len + 1 < p->size)
+        p->value[p->len++] = c;
+    else
+        p->overflow = true;
+}
+
+static int resp_key_pin(const blynk_resp_t *p)
+{
+    int pin = 0;
+
+    if (p->overflow || p->len < 2 || p->len > 4 || (p->value[0] | 0x20) != 'v')
+        return -1;
+    for (size_t i = 1; i < p->len; i++)
+    {
+        if (p->value[i] < '0' || p->value[i] > '9')
+            return -1;
+        pin = pin * 10 + p->value[i] - '0';
+    }
+    return pin;
+}
+
+static void resp_emit(blynk_resp_t *p)
+{
+    int pin = p->object ? p->key_pin : p->index < p->pin_count ? p->pins[p->index] : -1;
+
+    p->value[p->len] = 0;
+    if (p->overflow)
+        p->truncated++;
+    if (pin >= 0)
+    {
+        p->values++;
+        p->on_value(pin, p->value, p->ctx);
+    }
+    p->len = 0;
+    p->overflow = false;
+    p->state = p->container ? RESP_NEXT : RESP_DONE;
+}
+
+/*
+ * One character of a string, appended if `keep`.
+ * Returns 1 at the closing quote, -1 on a malformed string.
+ */
+static int resp_string(blynk_resp_t *p, char c, bool keep)
+{
+    if (p->hex_digits)
+    {
+        int d = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : -1;
+        if (d < 0)
+            return -1;
+        p->hex = p->hex << 4 | d;
+        // only ASCII is kept as is, values here are numbers and short labels
+        if (!--p->hex_digits && keep)
+            resp_append(p, p->hex < 0x80 ? (char)p->hex : '?');
+        return 0;
+    }
+    if (p->escape)
+    {
+        p->escape = false;
+        switch (c)
+        {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'u':
+            p->hex_digits = 4;
+            p->hex = 0;
+            return 0;
+        case '"': case '\\': case '/':
+            break;
+        default:
+            return -1;
+        }
+    }
+    else if (c == '\\')
+    {
+        p->escape = true;
+        return 0;
+    }
+    else if (c == '"')
+    {
+        return 1;
+    }
+    else if ((unsigned char)c < 0x20)
+    {
+        return -1;
+    }
+    if (keep)
+        resp_append(p, c);
+    return 0;
+}
+
+/*
+ * Returns false if `c` ended a token without being consumed and has to be
+ * fed again in the new state.
+ */
+static bool resp_char(blynk_resp_t *p, char c)
+{
+    int r;
+
+    switch (p->state)
+    {
+    case RESP_START:
+        if (resp_space(c))
+            break;
+        p->container = c == '{' || c == '[';
+        p->object = c == '{';
+        if (c == '{')
+            p->state = RESP_KEY_WAIT;
+        else if (c == '[')
+            p->state = RESP_VALUE;
+        else if (c == '"')
+            p->state = RESP_STRING;
+        else
+            return p->state = RESP_BARE, false;
+        break;
+
+    case RESP_KEY_WAIT:
+        if (c == '"')
+        {
+            p->len = 0;
+            p->overflow = false;
+            p->state = RESP_KEY;
+        }
+        else if (c == '}')
+            p->state = RESP_DONE;
+        else if (!resp_space(c))
+            p->state = RESP_ERROR;
+        break;
+
+    case RESP_KEY:
+        if ((r = resp_string(p, c, true)) < 0)
+            p->state = RESP_ERROR;
+        else if (r)
+        {
+            p->key_pin = resp_key_pin(p);
+            p->len = 0;
+            p->overflow = false;
+            p->state = RESP_COLON;
+        }
+        break;
+
+    case RESP_COLON:
+        if (c == ':')
+            p->state = RESP_VALUE;
+        else if (!resp_space(c))
+            p->state = RESP_ERROR;
+        break;
+
+    case RESP_VALUE:
+        if (resp_space(c))
+            break;
+        if (c == '"')
+            p->state = RESP_STRING;
+        else if (c == '[' || c == '{')
+        {
+            p->depth = 1;
+            p->captured = false;
+            p->state = RESP_NESTED;
+        }
+        else if (c == ']' && !p->object && !p->index)
+            p->state = RESP_DONE;       // empty array
+        else if (c == ',' || c == ':' || c == ']' || c == '}')
+            p->state = RESP_ERROR;
+        else
+            return p->state = RESP_BARE, false;
+        break;
+
+    case RESP_STRING:
+        if ((r = resp_string(p, c, true)) < 0)
+            p->state = RESP_ERROR;
+        else if (r)
+            resp_emit(p);
+        break;
+
+    case RESP_BARE:
+        // a bare top-level value runs to the end of the body
+        if (p->container && (resp_space(c) || c == ',' || c == ']' || c == '}'))
+            return resp_emit(p), false;
+        if (p->container && (c == '"' || c == '[' || c == '{' || c == ':'))
+            p->state = RESP_ERROR;
+        else
+            resp_append(p, c);
+        break;
+
+    case RESP_NESTED:
+        if (c == '"')
+            p->state = RESP_NESTED_STRING;
+        else if (c == '[' || c == '{')
+        {
+            if (p->depth == UINT8_MAX)
+                p->state = RESP_ERROR;
+            else
+                p->depth++;
+        }
+        else if (c == ']' || c == '}')
+        {
+            if (!--p->depth)
+                resp_emit(p);
+        }
+        else if (!resp_space(c) && c != ',' && c != ':' && !p->captured)
+            return p->state = RESP_NESTED_BARE, false;
+        break;
+
+    case RESP_NESTED_STRING:
+        if ((r = resp_string(p, c, !p->captured)) < 0)
+            p->state = RESP_ERROR;
+        else if (r)
+        {
+            p->captured = true;
+            p->state = RESP_NESTED;
+        }
+        break;
+
+    case RESP_NESTED_BARE:
+        if (resp_space(c) || c == ',' || c == ':' || c == ']' || c == '}')
+        {
+            p->captured = true;
+            p->state = RESP_NESTED;
+            return false;
+        }
+        resp_append(p, c);
+        break;
+
+    case RESP_NEXT:
+        if (c == ',')
+        {
+            if (p->object)
+                p->state = RESP_KEY_WAIT;
+            else
+            {
+                p->index++;
+                p->state = RESP_VALUE;
+            }
+        }
+        else if (c == (p->object ? '}' : ']'))
+            p->state = RESP_DONE;
+        else if (!resp_space(c))
+            p->state = RESP_ERROR;
+        break;
+
+    case RESP_DONE:
+        if (!resp_space(c))
+            p->state = RESP_ERROR;
+        break;
+
+    default:
+        break;
+    }
+    return true;
+}
+
+void blynk_resp_init(blynk_resp_t *p, const int *pins, size_t pin_count,
+        char *buf, size_t size, blynk_resp_cb_t on_value, void *ctx)
+{
+    p->pins = pins;
+    p->pin_count = pin_count;
+    p->on_value = on_value;
+    p->ctx = ctx;
+    p->value = buf;
+    p->size = size;
+    blynk_resp_reset(p);
+}
+
+void blynk_resp_reset(blynk_resp_t *p)
+{
+    p->len = 0;
+    p->state = RESP_START;
+    p->depth = 0;
+    p->container = false;
+    p->object = false;
+    p->escape = false;
+    p->overflow = false;
+    p->captured = false;
+    p->hex_digits = 0;
+    p->key_pin = -1;
+    p->index = 0;
+    p->values = 0;
+    p->truncated = 0;
+}
+
+bool blynk_resp_feed(blynk_resp_t *p, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && p->state != RESP_ERROR; i++)
+    {
+        if (!resp_char(p, data[i]))
+            resp_char(p, data[i]);
+    }
+    return p->state != RESP_ERROR;
+}
+
+bool blynk_resp_finish(blynk_resp_t *p)
+{
+    if (p->state == RESP_BARE && !p->container)
+    {
+        while (p->len && resp_space(p->value[p->len - 1]))
+            p->len--;
+        resp_emit(p);
+    }
+    return p->state == RESP_DONE;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file blynk_resp.h
+ *
+ * Streaming parser for Blynk /external/api/get responses.
+ *
+ * Bytes are fed as they arrive, in pieces of any size, and every pin value
+ * is handed to a callback as soon as it is complete. The only memory used
+ * is the parser state and a caller-supplied value buffer, so bodies of any
+ * length are parsed without buffering them. Accepted forms:
+ *
+ *     {"v2":"1","v4":"0"}     get?token=...&v2&v4, one value per key
+ *     ["1","0"]               values of the requested pins, in order
+ *     1                       a bare value, for the first requested pin
+ *
+ * A value that is itself an array, as multi-value pins return, is reduced
+ * to its first element. Values longer than the buffer are truncated.
+ *
+ * The parser does not depend on ESP-IDF.
+ */
+#ifndef __BLYNK_RESP_H__
+#define __BLYNK_RESP_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Receive one pin value, NUL-terminated
+ */
+typedef void (*blynk_resp_cb_t)(int vpin, const char *value, void *ctx);
+
+/**
+ * Parser state, set up with blynk_resp_init()
+ */
+typedef struct
+{
+    const int       *pins;          //!< Requested pins, for array and bare responses
+    size_t          pin_count;
+    blynk_resp_cb_t on_value;
+    void            *ctx;
+    char            *value;         //!< Caller buffer holding the key or value being parsed
+    size_t          size;
+    size_t          len;
+    uint8_t         state;
+    uint8_t         depth;          //!< Nesting inside an array value
+    bool            container;      //!< Top level is an object or an array
+    bool            object;         //!< Top level is an object
+    bool            escape;         //!< Inside a string, after a backslash
+    bool            captured;       //!< First element of an array value taken
+    bool            overflow;       //!< Current key or value did not fit
+    uint8_t         hex_digits;     //!< \uXXXX digits still expected
+    uint16_t        hex;
+    int             key_pin;        //!< Pin named by the current key, -1 if none
+    size_t          index;          //!< Element of a top-level array
+    uint32_t        values;         //!< Values handed to the callback
+    uint32_t        truncated;      //!< Values cut to the buffer size
+} blynk_resp_t;
+
+/**
+ * @brief Set up a parser for one response
+ *
+ * @param p Parser
+ * @param pins Pins in the order they were requested, must stay valid
+ * @param pin_count Number of pins
+ * @param buf Value buffer, also bounds the key length
+ * @param size Size of `buf`, at least 2
+ * @param on_value Value receiver
+ * @param ctx Passed to `on_value`
+ */
+void blynk_resp_init(blynk_resp_t *p, const int *pins, size_t pin_count,
+        char *buf, size_t size, blynk_resp_cb_t on_value, void *ctx);
+
+/**
+ * @brief Start over, e.g. when the request is retried
+ */
+void blynk_resp_reset(blynk_resp_t *p);
+
+/**
+ * @brief Parse the next piece of the body
+ *
+ * @param p Parser
+ * @param data Body bytes
+ * @param len Length of `data`
+ * @return false once the body is malformed, later calls are ignored
+ */
+bool blynk_resp_feed(blynk_resp_t *p, const char *data, size_t len);
+
+/**
+ * @brief Complete the parse at the end of the body
+ *
+ * A bare value is only known to be complete here.
+ *
+ * @param p Parser
+ * @return true if the body was well-formed and complete
+ */
+bool blynk_resp_finish(blynk_resp_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __BLYNK_RESP_H__
@@ -0,0 +1,365 @@
+/**
+ * @file ctrl_channel.c
+ *
+ * Control channel receiving virtual pin changes from the Blynk cloud.
+ */
+#include "ctrl_channel.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include "task_layout.h"
+
+/*
+ *  Blynk hardware protocol framing, all fields big endian:
+ *
+ *  +---------+--------------+------------------------+--------------------+
+ *  | command | message id   | length (or status for  | body, `length`     |
+ *  | 1 byte  | 2 bytes      | RESPONSE), 2 bytes     | bytes              |
+ *  +---------+--------------+------------------------+--------------------+
+ *
+ *  Body fields are separated by '\0', e.g. a widget write of V2=1 is
+ *  HARDWARE "vw\0" "2\0" "1".
+ */
+#define BLYNK_CMD_RESPONSE      0
+#define BLYNK_CMD_PING          6
+#define BLYNK_CMD_HW_SYNC       16
+#define BLYNK_CMD_HARDWARE      20
+#define BLYNK_CMD_HW_LOGIN      29
+#define BLYNK_SUCCESS           200
+
+#define BLYNK_HDR_LEN           5
+#define BLYNK_MAX_BODY          128
+
+#define CTRL_CHAN_LOGIN_TIMEOUT_MS  5000
+#define CTRL_CHAN_RECV_SLICE_MS     1000
+/* Receive timeouts tolerated in the middle of a message */
+#define CTRL_CHAN_RECV_STALLS       2
+
+static const char *TAG = "CTRL_CHANNEL";
+
+static ctrl_chan_config_t   cfg;
+static ctrl_chan_stats_t    stats;
+static uint16_t             msg_id;
+static portMUX_TYPE         stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline int64_t ctrl_chan_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+#if CONFIG_BLYNK_CONTROL_PUSH
+static int ctrl_chan_send(int sock, uint8_t cmd, uint16_t id, const char *body, uint16_t len)
+{
+    uint8_t hdr[BLYNK_HDR_LEN] = { cmd, id >> 8, id & 0xFF, len >> 8, len & 0xFF };
+
+    if (send(sock, hdr, sizeof(hdr), 0) != sizeof(hdr))
+        return -1;
+    if (len && send(sock, body, len, 0) != len)
+        return -1;
+    return 0;
+}
+
+/**
+ * Receive exactly `len` bytes.
+ * Returns 0 on success, 1 if the receive timed out before the first byte
+ * and -1 if the connection failed or stalled in the middle of the message.
+ */
+static int ctrl_chan_recv(int sock, uint8_t *buf, size_t len)
+{
+    size_t got = 0;
+    int stalls = 0;
+
+    while (got < len)
+    {
+        int r = recv(sock, buf + got, len - got, 0);
+        if (r > 0)
+        {
+            got += r;
+            continue;
+        }
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if (!got)
+                return 1;
+            // a half-received message never completes on a dead link
+            if (++stalls >= CTRL_CHAN_RECV_STALLS)
+                return -1;
+            continue;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Read one message. The body is truncated to `body_size - 1` bytes and
+ * NUL-terminated, the rest is discarded.
+ */
+static int ctrl_chan_read_msg(int sock, uint8_t *cmd, uint16_t *id, uint16_t *len,
+        char *body, size_t body_size)
+{
+    uint8_t hdr[BLYNK_HDR_LEN];
+    int r = ctrl_chan_recv(sock, hdr, sizeof(hdr));
+    if (r)
+        return r;
+
+    *cmd = hdr[0];
+    *id = (hdr[1] << 8) | hdr[2];
+    *len = (hdr[3] << 8) | hdr[4];
+    body[0] = 0;
+
+    // for RESPONSE the length field carries the status code
+    if (*cmd == BLYNK_CMD_RESPONSE)
+        return 0;
+
+    size_t keep = *len < body_size - 1 ? *len : body_size - 1;
+    if (keep && ctrl_chan_recv(sock, (uint8_t *)body, keep) != 0)
+        return -1;
+    body[keep] = 0;
+
+    for (size_t left = *len - keep; left; )
+    {
+        uint8_t scratch[16];
+        size_t n = left < sizeof(scratch) ? left : sizeof(scratch);
+        if (ctrl_chan_recv(sock, scratch, n) != 0)
+            return -1;
+        left -= n;
+    }
+    return 0;
+}
+
+/**
+ * Dispatch a HARDWARE message, body "vw\0<pin>\0<value>".
+ */
+static void ctrl_chan_handle_hw(const char *body, uint16_t len)
+{
+    if (len < 5 || strcmp(body, "vw") != 0)
+        return;
+
+    const char *pin = body + 3;
+    size_t pin_len = strnlen(pin, len - 3);
+    if (3 + pin_len + 1 >= len)
+        return;
+
+    if (cfg.on_update(atoi(pin), pin + pin_len + 1, cfg.ctx))
+    {
+        portENTER_CRITICAL(&stats_mux);
+        stats.push_events++;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+}
+
+static int ctrl_chan_connect(void)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    char port[8];
+
+    snprintf(port, sizeof(port), "%u", cfg.port);
+    if (getaddrinfo(cfg.host, port, &hints, &res) != 0 || !res)
+    {
+        ESP_LOGW(TAG, "DNS lookup failed for %s", cfg.host);
+        return -1;
+    }
+
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0)
+    {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock < 0)
+    {
+        ESP_LOGW(TAG, "Failed to connect to %s:%s", cfg.host, port);
+        return -1;
+    }
+
+    struct timeval tv = { .tv_sec = CTRL_CHAN_RECV_SLICE_MS / 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // log in and wait for the status
+    uint16_t login_id = ++msg_id;
+    if (ctrl_chan_send(sock, BLYNK_CMD_HW_LOGIN, login_id, cfg.token, strlen(cfg.token)) != 0)
+        goto fail;
+
+    int64_t deadline = ctrl_chan_now_ms() + CTRL_CHAN_LOGIN_TIMEOUT_MS;
+    while (ctrl_chan_now_ms() < deadline)
+    {
+        uint8_t cmd;
+        uint16_t id, len;
+        char body[BLYNK_MAX_BODY];
+        int r = ctrl_chan_read_msg(sock, &cmd, &id, &len, body, sizeof(body));
+        if (r < 0)
+            goto fail;
+        if (r > 0 || cmd != BLYNK_CMD_RESPONSE || id != login_id)
+            continue;
+        if (len != BLYNK_SUCCESS)
+        {
+            ESP_LOGE(TAG, "Login rejected, status %u", len);
+            goto fail;
+        }
+        return sock;
+    }
+
+fail:
+    ESP_LOGW(TAG, "Login failed");
+    close(sock);
+    return -1;
+}
+
+/**
+ * Serve the push connection until it fails.
+ */
+static void ctrl_chan_run_push(int sock)
+{
+    // ask the server to replay the current state of the watched pins
+    char sync[BLYNK_MAX_BODY] = "vr";
+    size_t sync_len = 3;
+    for (size_t i = 0; i < cfg.pin_count && sync_len + 4 < sizeof(sync); i++)
+        sync_len += snprintf(sync + sync_len, sizeof(sync) - sync_len, "%d", cfg.pins[i]) + 1;
+    if (ctrl_chan_send(sock, BLYNK_CMD_HW_SYNC, ++msg_id, sync, sync_len - 1) != 0)
+        return;
+
+    const int64_t heartbeat_ms = CONFIG_BLYNK_HEARTBEAT_S * 1000;
+    int64_t last_rx = ctrl_chan_now_ms();
+    int64_t last_tx = last_rx;
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.push_active = true;
+    stats.connects++;
+    portEXIT_CRITICAL(&stats_mux);
+    ESP_LOGI(TAG, "Push channel up");
+
+    while (1)
+    {
+        uint8_t cmd;
+        uint16_t id, len;
+        char body[BLYNK_MAX_BODY];
+        int r = ctrl_chan_read_msg(sock, &cmd, &id, &len, body, sizeof(body));
+        int64_t now = ctrl_chan_now_ms();
+
+        if (r < 0)
+            break;
+        if (r == 0)
+        {
+            last_rx = now;
+            if (cmd == BLYNK_CMD_HARDWARE)
+                ctrl_chan_handle_hw(body, len < sizeof(body) ? len : sizeof(body) - 1);
+            else if (cmd == BLYNK_CMD_PING
+                    && ctrl_chan_send(sock, BLYNK_CMD_RESPONSE, id, NULL, 0) != 0)
+                break;
+        }
+        if (now - last_rx > heartbeat_ms * 2)
+        {
+            ESP_LOGW(TAG, "Heartbeat lost");
+            break;
+        }
+        if (now - last_tx >= heartbeat_ms)
+        {
+            if (ctrl_chan_send(sock, BLYNK_CMD_PING, ++msg_id, NULL, 0) != 0)
+                break;
+            last_tx = now;
+        }
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.push_active = false;
+    portEXIT_CRITICAL(&stats_mux);
+    ESP_LOGW(TAG, "Push channel down");
+}
+#endif
+
+static void ctrl_chan_poll_value(int vpin, const char *value, void *ctx)
+{
+    bool *changed = ctx;
+
+    *changed |= cfg.on_update(vpin, value, cfg.ctx);
+}
+
+/**
+ * Poll the watched pins until `until_ms`, doubling the interval after every
+ * round without a change and dropping back to the minimum after a change.
+ */
+static void ctrl_chan_poll_until(int64_t until_ms)
+{
+    static uint32_t interval = CONFIG_BLYNK_POLL_MIN_MS;
+
+    while (ctrl_chan_now_ms() < until_ms)
+    {
+        bool changed = false;
+        cfg.poll(cfg.pins, cfg.pin_count, ctrl_chan_poll_value, &changed);
+
+        interval = changed ? CONFIG_BLYNK_POLL_MIN_MS : interval * 2;
+        if (interval > CONFIG_BLYNK_POLL_MAX_MS)
+            interval = CONFIG_BLYNK_POLL_MAX_MS;
+
+        portENTER_CRITICAL(&stats_mux);
+        stats.polls++;
+        stats.poll_events += changed;
+        stats.poll_interval_ms = interval;
+        portEXIT_CRITICAL(&stats_mux);
+
+        // not past the deadline, the push side is retried on time
+        int64_t left = until_ms - ctrl_chan_now_ms();
+        if (left <= 0)
+            break;
+        vTaskDelay(pdMS_TO_TICKS(left < interval ? left : interval));
+    }
+}
+
+static void ctrl_chan_task(void *pvParameters)
+{
+    uint32_t retry_s = 1;
+
+    while (1)
+    {
+#if CONFIG_BLYNK_CONTROL_PUSH
+        int sock = ctrl_chan_connect();
+        if (sock >= 0)
+        {
+            ctrl_chan_run_push(sock);
+            close(sock);
+            retry_s = 1;
+        }
+        else if ((retry_s *= 2) > CONFIG_BLYNK_PUSH_RETRY_MAX_S)
+        {
+            retry_s = CONFIG_BLYNK_PUSH_RETRY_MAX_S;
+        }
+#endif
+        if (cfg.poll)
+            ctrl_chan_poll_until(ctrl_chan_now_ms() + retry_s * 1000);
+        else
+            vTaskDelay(pdMS_TO_TICKS(retry_s * 1000));
+    }
+}
+
+esp_err_t ctrl_chan_start(const ctrl_chan_config_t *config)
+{
+    if (!config || !config->on_update || config->pin_count > CTRL_CHAN_MAX_PINS)
+        return ESP_ERR_INVALID_ARG;
+
+    cfg = *config;
+    stats.poll_interval_ms = CONFIG_BLYNK_POLL_MIN_MS;
+
+    return task_layout_create(TASK_CTRL, ctrl_chan_task, NULL, NULL);
+}
+
+void ctrl_chan_get_stats(ctrl_chan_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file ctrl_channel.h
+ *
+ * Control channel receiving virtual pin changes from the Blynk cloud.
+ *
+ * The channel holds a persistent socket speaking the native Blynk hardware
+ * protocol, so the server pushes every widget change as it happens. While the
+ * socket is down the channel falls back to polling through the caller's poll
+ * function, backing off from `CONFIG_BLYNK_POLL_MIN_MS` up to
+ * `CONFIG_BLYNK_POLL_MAX_MS` while nothing changes, and keeps trying to
+ * re-establish the push connection in the background.
+ *
+ * The channel keeps no copy of the values: everything it receives goes to
+ * the caller's update function, which tells whether the value changed.
+ */
+#ifndef __CTRL_CHANNEL_H__
+#define __CTRL_CHANNEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CTRL_CHAN_MAX_PINS      16
+#define CTRL_CHAN_VALUE_LEN     16
+
+/**
+ * Receive the value of a virtual pin
+ */
+typedef void (*ctrl_chan_event_cb_t)(int vpin, const char *value, void *ctx);
+
+/**
+ * Called from the channel task for every value received, returns true if
+ * the value differs from the one last seen
+ */
+typedef bool (*ctrl_chan_update_cb_t)(int vpin, const char *value, void *ctx);
+
+/**
+ * Fallback poll: read the current values of all watched pins in one request,
+ * calling `on_value` with `ctx` for every value received
+ */
+typedef esp_err_t (*ctrl_chan_poll_cb_t)(const int *pins, size_t count,
+        ctrl_chan_event_cb_t on_value, void *ctx);
+
+/**
+ * Channel configuration
+ */
+typedef struct
+{
+    const char              *host;          //!< Blynk server host name
+    uint16_t                port;           //!< Hardware protocol port
+    const char              *token;         //!< Device auth token
+    const int               *pins;          //!< Watched virtual pins
+    size_t                  pin_count;      //!< Number of watched pins, up to CTRL_CHAN_MAX_PINS
+    ctrl_chan_update_cb_t   on_update;      //!< Value callback
+    ctrl_chan_poll_cb_t     poll;           //!< Fallback poll, nullable to disable polling
+    void                    *ctx;           //!< Passed to `on_update`
+} ctrl_chan_config_t;
+
+/**
+ * Channel statistics
+ */
+typedef struct
+{
+    bool     push_active;       //!< Push connection currently logged in
+    uint32_t connects;          //!< Successful logins
+    uint32_t push_events;       //!< Changes received over the push connection
+    uint32_t polls;             //!< Fallback poll requests, one per round for all pins
+    uint32_t poll_events;       //!< Changes detected by polling
+    uint32_t poll_interval_ms;  //!< Current fallback poll interval
+} ctrl_chan_stats_t;
+
+/**
+ * @brief Start the control channel task
+ *
+ * The configuration is copied, `pins` must stay valid.
+ *
+ * @param config Channel configuration
+ * @return `ESP_OK` on success
+ */
+esp_err_t ctrl_chan_start(const ctrl_chan_config_t *config);
+
+/**
+ * @brief Copy the channel statistics
+ *
+ * @param[out] stats Statistics
+ */
+void ctrl_chan_get_stats(ctrl_chan_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __CTRL_CHANNEL_H__
@@ -0,0 +1,201 @@
+/**
+ * @file ctrl_state.c
+ *
+ * Cache of the control pins the device reacts to.
+ */
+#include "ctrl_state.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+static const char *TAG = "CTRL_STATE";
+
+typedef struct
+{
+    char            value[CTRL_STATE_VALUE_LEN];
+    bool            known;
+    ctrl_state_cb_t on_change;
+    void            *ctx;
+} ctrl_state_pin_t;
+
+static int                  pins[CTRL_STATE_MAX_PINS];
+static ctrl_state_pin_t     states[CTRL_STATE_MAX_PINS];
+static size_t               pin_count;
+static ctrl_state_fetch_t   fetch;
+static ctrl_state_stats_t   stats;
+static portMUX_TYPE         mux = portMUX_INITIALIZER_UNLOCKED;
+
+static int ctrl_state_find(int vpin)
+{
+    for (size_t i = 0; i < pin_count; i++)
+    {
+        if (pins[i] == vpin)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Copy the value of a pin, false if it has none yet.
+ */
+static bool ctrl_state_copy(int vpin, char value[CTRL_STATE_VALUE_LEN])
+{
+    int i = ctrl_state_find(vpin);
+    bool known = false;
+
+    if (i < 0)
+        return false;
+    portENTER_CRITICAL(&mux);
+    if ((known = states[i].known))
+        memcpy(value, states[i].value, CTRL_STATE_VALUE_LEN);
+    portEXIT_CRITICAL(&mux);
+    return known;
+}
+
+static void ctrl_state_on_fetched(int vpin, const char *value, void *ctx)
+{
+    ctrl_state_update(vpin, value);
+}
+
+esp_err_t ctrl_state_init(ctrl_state_fetch_t fetch_fn)
+{
+    if (!fetch_fn)
+        return ESP_ERR_INVALID_ARG;
+    fetch = fetch_fn;
+    return ESP_OK;
+}
+
+esp_err_t ctrl_state_register(int vpin, ctrl_state_cb_t on_change, void *ctx)
+{
+    if (vpin < 0 || ctrl_state_find(vpin) >= 0)
+        return ESP_ERR_INVALID_ARG;
+    if (pin_count == CTRL_STATE_MAX_PINS)
+        return ESP_ERR_NO_MEM;
+
+    states[pin_count] = (ctrl_state_pin_t){ .on_change = on_change, .ctx = ctx };
+    pins[pin_count++] = vpin;
+    return ESP_OK;
+}
+
+size_t ctrl_state_pins(const int **out)
+{
+    *out = pins;
+    return pin_count;
+}
+
+bool ctrl_state_update(int vpin, const char *value)
+{
+    int i = ctrl_state_find(vpin);
+    char copy[CTRL_STATE_VALUE_LEN];
+    bool changed;
+
+    if (i < 0)
+        return false;
+
+    strlcpy(copy, value, sizeof(copy));
+    portENTER_CRITICAL(&mux);
+    stats.updates++;
+    changed = !states[i].known || strcmp(states[i].value, copy) != 0;
+    if (changed)
+    {
+        memcpy(states[i].value, copy, sizeof(copy));
+        states[i].known = true;
+        stats.changes++;
+    }
+    portEXIT_CRITICAL(&mux);
+
+    if (changed && states[i].on_change)
+        states[i].on_change(vpin, copy, states[i].ctx);
+    return changed;
+}
+
+esp_err_t ctrl_state_refresh(void)
+{
+    if (!fetch)
+        return ESP_ERR_INVALID_STATE;
+    if (!pin_count)
+        return ESP_OK;
+
+    // one request whatever the number of pins
+    esp_err_t err = fetch(pins, pin_count, ctrl_state_on_fetched, NULL);
+
+    portENTER_CRITICAL(&mux);
+    stats.refreshes++;
+    stats.failures += err != ESP_OK;
+    portEXIT_CRITICAL(&mux);
+
+    if (err != ESP_OK)
+        ESP_LOGD(TAG, "Refresh failed: %s", esp_err_to_name(err));
+    return err;
+}
+
+bool ctrl_state_get_str(int vpin, char *buf, size_t size)
+{
+    char value[CTRL_STATE_VALUE_LEN];
+
+    if (!ctrl_state_copy(vpin, value))
+        return false;
+    strlcpy(buf, value, size);
+    return true;
+}
+
+bool ctrl_state_get_int(int vpin, int32_t *out)
+{
+    char value[CTRL_STATE_VALUE_LEN];
+    char *end;
+
+    if (!ctrl_state_copy(vpin, value))
+        return false;
+    long v = strtol(value, &end, 10);
+    // "12.5" from a slider with decimals reads as 12
+    if (end == value || (*end && *end != '.'))
+        return false;
+    *out = v;
+    return true;
+}
+
+bool ctrl_state_get_float(int vpin, float *out)
+{
+    char value[CTRL_STATE_VALUE_LEN];
+    char *end;
+
+    if (!ctrl_state_copy(vpin, value))
+        return false;
+    float v = strtof(value, &end);
+    if (end == value || *end)
+        return false;
+    *out = v;
+    return true;
+}
+
+bool ctrl_state_get_bool(int vpin, bool *out)
+{
+    char value[CTRL_STATE_VALUE_LEN];
+    char *end;
+
+    if (!ctrl_state_copy(vpin, value))
+        return false;
+    if (!strcasecmp(value, "true") || !strcasecmp(value, "on"))
+        *out = true;
+    else if (!strcasecmp(value, "false") || !strcasecmp(value, "off"))
+        *out = false;
+    else
+    {
+        long v = strtol(value, &end, 10);
+        if (end == value || *end)
+            return false;
+        *out = v != 0;
+    }
+    return true;
+}
+
+void ctrl_state_get_stats(ctrl_state_stats_t *out)
+{
+    portENTER_CRITICAL(&mux);
+    *out = stats;
+    portEXIT_CRITICAL(&mux);
+}
@@ -0,0 +1,133 @@
+/**
+ * @file ctrl_state.h
+ *
+ * Cache of the control pins the device reacts to.
+ *
+ * Every control (switch, setpoint, threshold) registers its virtual pin once
+ * with an optional change callback. New values arrive from the control
+ * channel or from ctrl_state_refresh(), which reads all registered pins in a
+ * single batched request, so adding a control does not add a request.
+ * Values are diffed against the cache and only changes reach the callbacks.
+ * Consumers read the cached values through typed getters from any task.
+ */
+#ifndef __CTRL_STATE_H__
+#define __CTRL_STATE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CTRL_STATE_MAX_PINS     16
+#define CTRL_STATE_VALUE_LEN    16
+
+/**
+ * @brief Receive the value of a pin
+ */
+typedef void (*ctrl_state_cb_t)(int vpin, const char *value, void *ctx);
+
+/**
+ * @brief Read several pins in one request, calling `on_value` for each value received
+ */
+typedef esp_err_t (*ctrl_state_fetch_t)(const int *pins, size_t count, ctrl_state_cb_t on_value, void *ctx);
+
+/**
+ * Cache statistics
+ */
+typedef struct
+{
+    uint32_t refreshes;     //!< Batched reads issued
+    uint32_t failures;      //!< Batched reads that failed
+    uint32_t updates;       //!< Values received from any source
+    uint32_t changes;       //!< Values that differed from the cache
+} ctrl_state_stats_t;
+
+/**
+ * @brief Set the function reading pins for ctrl_state_refresh()
+ *
+ * @param fetch Batched pin reader
+ * @return `ESP_OK` on success
+ */
+esp_err_t ctrl_state_init(ctrl_state_fetch_t fetch);
+
+/**
+ * @brief Add a pin to the cache
+ *
+ * Register every pin before values start to arrive.
+ *
+ * @param vpin Virtual pin
+ * @param on_change Called from the updating task when the value changes,
+ *                  including the first value received, nullable
+ * @param ctx Passed to `on_change`
+ * @return `ESP_OK` on success, `ESP_ERR_NO_MEM` if `CTRL_STATE_MAX_PINS` are registered
+ */
+esp_err_t ctrl_state_register(int vpin, ctrl_state_cb_t on_change, void *ctx);
+
+/**
+ * @brief Get the registered pins, e.g. for the control channel
+ *
+ * @param[out] pins Registered pins, valid as long as no pin is added
+ * @return Number of pins
+ */
+size_t ctrl_state_pins(const int **pins);
+
+/**
+ * @brief Store a received value, firing the change callback if it differs
+ *
+ * @param vpin Virtual pin, values of unregistered pins are ignored
+ * @param value New value
+ * @return true if the value changed
+ */
+bool ctrl_state_update(int vpin, const char *value);
+
+/**
+ * @brief Read all registered pins in one request and apply the values
+ *
+ * @return `ESP_OK` on success, or the error of the fetch function
+ */
+esp_err_t ctrl_state_refresh(void);
+
+/**
+ * @brief Copy the raw value of a pin
+ *
+ * @return false if the pin has no value yet, `buf` is left untouched
+ */
+bool ctrl_state_get_str(int vpin, char *buf, size_t size);
+
+/**
+ * @brief Get the value of a pin as an integer, a fractional part is dropped
+ *
+ * @return false if the pin has no value yet or it is not a number
+ */
+bool ctrl_state_get_int(int vpin, int32_t *value);
+
+/**
+ * @brief Get the value of a pin as a float
+ *
+ * @return false if the pin has no value yet or it is not a number
+ */
+bool ctrl_state_get_float(int vpin, float *value);
+
+/**
+ * @brief Get the value of a pin as a switch: a non-zero number, "true" or "on"
+ *
+ * @return false if the pin has no value yet or it is not a switch value
+ */
+bool ctrl_state_get_bool(int vpin, bool *value);
+
+/**
+ * @brief Copy the cache statistics
+ *
+ * @param[out] stats Statistics
+ */
+void ctrl_state_get_stats(ctrl_state_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __CTRL_STATE_H__
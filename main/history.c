@@ -0,0 +1,473 @@
+/**
+ * @file history.c
+ *
+ * Sample history kept on the device until it reaches the Blynk cloud.
+ */
+#include "history.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "sample_ring.h"
+#include "http_conn.h"
+#include "url_builder.h"
+#include "sample_frame.h"
+
+// anything before 2021 means SNTP has not set the clock yet
+#define HISTORY_MIN_EPOCH       1609459200
+
+#define HISTORY_URL_LEN         256
+// "[1700000000000,-40.0]," per point
+#define HISTORY_POINT_LEN       24
+
+#define HISTORY_NVS_NAMESPACE   "history"
+
+static const char *TAG = "HISTORY";
+
+// ring 0 holds the raw samples, ring n the windows of rollup tier n
+static sample_rec_t         ring_buf[CONFIG_HISTORY_CAPACITY];
+static sample_rec_t         tier_buf[HISTORY_MAX_TIERS][CONFIG_ROLLUP_CAPACITY];
+static sample_ring_t        rings[1 + HISTORY_MAX_TIERS];
+static sample_ring_t        *const ring = &rings[HISTORY_RAW];
+static SemaphoreHandle_t    lock;
+
+static url_prefix_t         base_url;
+static const history_pin_t  *pins;
+static size_t               pin_count;
+static bool                 tier_used[1 + HISTORY_MAX_TIERS];   // some pin receives the tier
+
+// used by the uploader only
+static sample_point_t       batch[CONFIG_HISTORY_BATCH];
+#if CONFIG_HISTORY_FRAME_UPLOAD
+static uint8_t              frame[SAMPLE_FRAME_MAX_LEN(CONFIG_HISTORY_BATCH)];
+#else
+static char                 body[CONFIG_HISTORY_BATCH * HISTORY_POINT_LEN + 4];
+static char                 url[HISTORY_URL_LEN];
+#endif
+
+#if CONFIG_HISTORY_SPILL_NVS
+// used by the reader task only, with the lock held
+static sample_point_t       spill[CONFIG_HISTORY_BATCH];
+// spilled chunks are numbered, pending ones are [nvs_tail, nvs_head)
+static uint32_t             nvs_head, nvs_tail;
+static size_t               nvs_points;
+#endif
+
+/**
+ * Offset from uptime to Unix time in milliseconds.
+ * Returns false while the clock is not set.
+ */
+static bool history_clock_offset(int64_t *offset_ms)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < HISTORY_MIN_EPOCH)
+        return false;
+
+    *offset_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - esp_timer_get_time() / 1000;
+    return true;
+}
+
+static inline int16_t history_value(const sample_point_t *point, history_channel_t channel)
+{
+    return channel == HISTORY_TEMPERATURE ? point->temperature : point->humidity;
+}
+
+static esp_err_t history_check_status(esp_err_t err, int status)
+{
+    if (err != ESP_OK)
+        return err;
+    if (status != 200)
+    {
+        ESP_LOGW(TAG, "Upload rejected, HTTP %d", status);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+#if CONFIG_HISTORY_FRAME_UPLOAD
+/**
+ * Send all channels of the points in one binary frame POST, the receiver
+ * maps them to pins.
+ */
+static esp_err_t history_send_frame(int tier, const sample_point_t *points, size_t n, uint8_t flags)
+{
+    flags |= SAMPLE_FRAME_STREAM(tier);
+    size_t len = sample_frame_encode(points, n, flags, frame, sizeof(frame));
+    if (!len)
+        return ESP_ERR_INVALID_SIZE;
+
+    int status = 0;
+    esp_err_t err = http_conn_post(HTTP_CONN_EP_UPDATE, base_url.str, "application/octet-stream",
+            (const char *)frame, len, NULL, 0, &status);
+    if ((err = history_check_status(err, status)) != ESP_OK)
+        return err;
+
+    ESP_LOGI(TAG, "Uploaded %u samples in %u bytes", (unsigned)n, (unsigned)len);
+    return ESP_OK;
+}
+
+static inline esp_err_t history_send_points(int tier, const sample_point_t *points, size_t n)
+{
+    return history_send_frame(tier, points, n, SAMPLE_FRAME_UNIX_TIME);
+}
+#else
+/**
+ * Send the only pending sample to all pins of its tier in one batch/update GET.
+ */
+static esp_err_t history_send_latest(int tier, const sample_point_t *point)
+{
+    url_builder_t b;
+
+    url_init(&b, url, sizeof(url));
+    url_append_prefix(&b, &base_url);
+    for (size_t i = 0; i < pin_count; i++)
+    {
+        if (pins[i].tier == tier)
+            url_append_param_fixed1(&b, pins[i].pin, history_value(point, pins[i].channel));
+    }
+    if (!url_finish(&b))
+        return ESP_ERR_INVALID_SIZE;
+
+    int status = 0;
+    esp_err_t err = http_conn_get(HTTP_CONN_EP_UPDATE, url, NULL, 0, &status);
+    return history_check_status(err, status);
+}
+
+/**
+ * Send timestamped points, one POST per pin of the tier with body [[ts,value],...].
+ */
+static esp_err_t history_send_points(int tier, const sample_point_t *points, size_t n)
+{
+    url_builder_t b;
+
+    for (size_t p = 0; p < pin_count; p++)
+    {
+        if (pins[p].tier != tier)
+            continue;
+        url_init(&b, body, sizeof(body));
+        url_append(&b, "[", 1);
+        for (size_t i = 0; i < n; i++)
+        {
+            url_append(&b, i ? ",[" : "[", i ? 2 : 1);
+            url_append_int(&b, points[i].timestamp_ms);
+            url_append(&b, ",", 1);
+            url_append_fixed1(&b, history_value(&points[i], pins[p].channel));
+            url_append(&b, "]", 1);
+        }
+        url_append(&b, "]", 1);
+        if (!url_finish(&b))
+            return ESP_ERR_INVALID_SIZE;
+        int len = b.len;
+
+        url_init(&b, url, sizeof(url));
+        url_append_prefix(&b, &base_url);
+        url_append_param(&b, "pin", pins[p].pin);
+        if (!url_finish(&b))
+            return ESP_ERR_INVALID_SIZE;
+
+        int status = 0;
+        esp_err_t err = http_conn_post(HTTP_CONN_EP_UPDATE, url, "application/json",
+                body, len, NULL, 0, &status);
+        if ((err = history_check_status(err, status)) != ESP_OK)
+            return err;
+    }
+
+    ESP_LOGI(TAG, "Uploaded %u samples", (unsigned)n);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_HISTORY_SPILL_NVS
+static inline void history_nvs_key(char key[8], uint32_t chunk)
+{
+    snprintf(key, 8, "c%u", (unsigned)(chunk % CONFIG_HISTORY_SPILL_CHUNKS));
+}
+
+static size_t history_nvs_chunk_points(nvs_handle_t nvs, uint32_t chunk)
+{
+    char key[8];
+    size_t size = 0;
+
+    history_nvs_key(key, chunk);
+    if (nvs_get_blob(nvs, key, NULL, &size) != ESP_OK)
+        return 0;
+    return size / sizeof(sample_point_t);
+}
+
+static void history_nvs_save_index(nvs_handle_t nvs)
+{
+    nvs_set_u32(nvs, "head", nvs_head);
+    nvs_set_u32(nvs, "tail", nvs_tail);
+    nvs_commit(nvs);
+}
+
+static void history_nvs_load(void)
+{
+    nvs_handle_t nvs;
+
+    if (nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+        return;
+    nvs_get_u32(nvs, "head", &nvs_head);
+    nvs_get_u32(nvs, "tail", &nvs_tail);
+    for (uint32_t c = nvs_tail; c != nvs_head; c++)
+        nvs_points += history_nvs_chunk_points(nvs, c);
+    nvs_close(nvs);
+
+    if (nvs_points)
+        ESP_LOGI(TAG, "%u samples pending in NVS", (unsigned)nvs_points);
+}
+
+/**
+ * Move the oldest batch from the full ring into NVS. Called with the lock
+ * held. Without wall-clock time the batch is left to be overwritten, its
+ * uptime stamps would be meaningless after a reboot.
+ */
+static void history_spill(void)
+{
+    int64_t offset;
+    nvs_handle_t nvs;
+    char key[8];
+    size_t records;
+
+    if (!history_clock_offset(&offset))
+        return;
+
+    size_t n = sample_ring_peek(ring, spill, CONFIG_HISTORY_BATCH, &records);
+    if (!n || nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+        return;
+
+    for (size_t i = 0; i < n; i++)
+        spill[i].timestamp_ms += offset;
+
+    if (nvs_head - nvs_tail >= CONFIG_HISTORY_SPILL_CHUNKS)
+    {
+        // NVS is full too, the oldest chunk is lost
+        nvs_points -= history_nvs_chunk_points(nvs, nvs_tail);
+        history_nvs_key(key, nvs_tail++);
+        nvs_erase_key(nvs, key);
+    }
+
+    history_nvs_key(key, nvs_head);
+    if (nvs_set_blob(nvs, key, spill, n * sizeof(sample_point_t)) == ESP_OK)
+    {
+        nvs_head++;
+        nvs_points += n;
+        sample_ring_drop(ring, records);
+    }
+    history_nvs_save_index(nvs);
+    nvs_close(nvs);
+}
+
+/**
+ * Upload the oldest chunk spilled to NVS.
+ */
+static esp_err_t history_flush_nvs(void)
+{
+    nvs_handle_t nvs;
+    char key[8];
+    size_t size = sizeof(batch);
+    esp_err_t err;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t chunk = nvs_tail;
+    history_nvs_key(key, chunk);
+    if ((err = nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &nvs)) == ESP_OK)
+    {
+        err = nvs_get_blob(nvs, key, batch, &size);
+        nvs_close(nvs);
+    }
+    xSemaphoreGive(lock);
+
+    if (err == ESP_OK)
+    {
+        err = history_send_points(HISTORY_RAW, batch, size / sizeof(sample_point_t));
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Chunk %s unreadable, dropped: %s", key, esp_err_to_name(err));
+        err = ESP_OK;
+    }
+    if (err != ESP_OK)
+        return err;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    // the reader may have dropped the chunk meanwhile
+    if (chunk == nvs_tail && nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        nvs_points -= history_nvs_chunk_points(nvs, chunk);
+        nvs_erase_key(nvs, key);
+        nvs_tail++;
+        history_nvs_save_index(nvs);
+        nvs_close(nvs);
+    }
+    xSemaphoreGive(lock);
+
+    return err;
+}
+#endif
+
+esp_err_t history_init(const char *batch_url, const history_pin_t *history_pins, size_t count)
+{
+    if (!batch_url || !history_pins || !count)
+        return ESP_ERR_INVALID_ARG;
+
+    if (!(lock = xSemaphoreCreateMutex()))
+        return ESP_ERR_NO_MEM;
+
+    url_prefix_set(&base_url, batch_url);
+    pins = history_pins;
+    pin_count = count;
+    sample_ring_init(ring, ring_buf, CONFIG_HISTORY_CAPACITY);
+    for (int t = 1; t <= HISTORY_MAX_TIERS; t++)
+        sample_ring_init(&rings[t], tier_buf[t - 1], CONFIG_ROLLUP_CAPACITY);
+
+#if CONFIG_HISTORY_FRAME_UPLOAD
+    // frames carry every tier, the receiver maps them to pins
+    memset(tier_used, true, sizeof(tier_used));
+#endif
+    for (size_t i = 0; i < count; i++)
+    {
+        if (history_pins[i].tier >= 0 && history_pins[i].tier <= HISTORY_MAX_TIERS)
+            tier_used[history_pins[i].tier] = true;
+    }
+
+#if CONFIG_HISTORY_SPILL_NVS
+    history_nvs_load();
+#endif
+
+    return ESP_OK;
+}
+
+void history_add(int64_t timestamp_ms, int16_t temperature, int16_t humidity)
+{
+    if (!tier_used[HISTORY_RAW])
+        return;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+#if CONFIG_HISTORY_SPILL_NVS
+    // room for a gap marker plus the sample
+    if (ring->capacity - ring->count < 2)
+        history_spill();
+#endif
+    uint32_t dropped = ring->dropped;
+    sample_ring_push(ring, timestamp_ms, temperature, humidity);
+    dropped = ring->dropped - dropped;
+    xSemaphoreGive(lock);
+
+    if (dropped)
+        ESP_LOGW(TAG, "History full, oldest sample dropped");
+}
+
+void history_add_rollup(int tier, int64_t timestamp_ms, int16_t temperature, int16_t humidity)
+{
+    if (tier < 1 || tier > HISTORY_MAX_TIERS || !tier_used[tier])
+        return;
+
+    // windows are never spilled, they are few and cheap to lose
+    xSemaphoreTake(lock, portMAX_DELAY);
+    sample_ring_push(&rings[tier], timestamp_ms, temperature, humidity);
+    xSemaphoreGive(lock);
+}
+
+size_t history_pending(void)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    size_t n = 0;
+    for (int t = 0; t <= HISTORY_MAX_TIERS; t++)
+        n += rings[t].points;
+#if CONFIG_HISTORY_SPILL_NVS
+    n += nvs_points;
+#endif
+    xSemaphoreGive(lock);
+
+    return n;
+}
+
+esp_err_t history_flush(void)
+{
+    int64_t offset;
+    size_t records;
+    esp_err_t err;
+
+#if CONFIG_HISTORY_SPILL_NVS
+    if (nvs_head != nvs_tail)
+        return history_clock_offset(&offset) ? history_flush_nvs() : ESP_ERR_INVALID_STATE;
+#endif
+
+    // raw samples first, then the oldest tier with pending windows
+    int tier = 0;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    while (tier < HISTORY_MAX_TIERS && !rings[tier].points)
+        tier++;
+    size_t n = sample_ring_peek(&rings[tier], batch, CONFIG_HISTORY_BATCH, &records);
+    xSemaphoreGive(lock);
+
+    if (!n)
+        return ESP_OK;
+
+    int64_t last_ms = batch[n - 1].timestamp_ms;
+#if CONFIG_HISTORY_FRAME_UPLOAD
+    // without wall clock, send the age of the samples and let the receiver stamp them
+    uint8_t flags = SAMPLE_FRAME_UNIX_TIME;
+    if (!history_clock_offset(&offset))
+    {
+        offset = -(esp_timer_get_time() / 1000);
+        flags = 0;
+    }
+    for (size_t i = 0; i < n; i++)
+        batch[i].timestamp_ms += offset;
+    err = history_send_frame(tier, batch, n, flags);
+#else
+    // nothing backed up: a plain live update, which needs no wall clock
+    if (n == 1)
+    {
+        err = history_send_latest(tier, &batch[0]);
+    }
+    else if (!history_clock_offset(&offset))
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+            batch[i].timestamp_ms += offset;
+        err = history_send_points(tier, batch, n);
+    }
+#endif
+
+    if (err == ESP_OK)
+    {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        sample_ring_drop_until(&rings[tier], last_ms);
+        xSemaphoreGive(lock);
+    }
+    return err;
+}
+
+void history_clear(void)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int t = 0; t <= HISTORY_MAX_TIERS; t++)
+        sample_ring_clear(&rings[t]);
+#if CONFIG_HISTORY_SPILL_NVS
+    nvs_handle_t nvs;
+    if (nvs_head != nvs_tail && nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        nvs_erase_all(nvs);
+        nvs_head = nvs_tail = 0;
+        nvs_points = 0;
+        history_nvs_save_index(nvs);
+        nvs_close(nvs);
+    }
+#endif
+    xSemaphoreGive(lock);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file history.h
+ *
+ * Sample history kept on the device until it reaches the Blynk cloud.
+ *
+ * The reader task appends every sample to a fixed-memory ring buffer (see
+ * sample_ring.h). The uploader drains it in batches, each batch carrying up
+ * to `CONFIG_HISTORY_BATCH` timestamped points per virtual pin in a single
+ * request, so a Wi-Fi outage no longer leaves a gap in the charts. With
+ * `CONFIG_HISTORY_SPILL_NVS` the oldest batch is moved to NVS instead of
+ * being overwritten when the ring is full.
+ *
+ * Points are stamped with wall-clock time when they are uploaded or
+ * spilled, so both need the clock to be set by SNTP.
+ *
+ * Pins either get every raw sample or one value per window of a rollup
+ * tier. Closed windows are queued in a small ring per tier with
+ * history_add_rollup() and uploaded after the raw samples.
+ *
+ * With `CONFIG_HISTORY_FRAME_UPLOAD` each batch is instead posted as one
+ * compact binary frame (see sample_frame.h) carrying every channel, and the
+ * receiver maps the channels to pins. Frames sent before SNTP carry sample
+ * ages, so only spilling needs the clock.
+ */
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISTORY_RAW         0   //!< Tier of the raw samples
+#define HISTORY_MAX_TIERS   2   //!< Rollup tiers, numbered from 1
+
+/**
+ * Measured value sent to a pin
+ */
+typedef enum
+{
+    HISTORY_TEMPERATURE = 0,
+    HISTORY_HUMIDITY,
+} history_channel_t;
+
+/**
+ * Virtual pin receiving the history of one channel
+ */
+typedef struct
+{
+    const char          *pin;       //!< Virtual pin, e.g. "v3"
+    history_channel_t   channel;    //!< Value sent to it
+    int                 tier;       //!< `HISTORY_RAW` or a rollup tier
+} history_pin_t;
+
+/**
+ * @brief Set up the ring buffer and the upload targets
+ *
+ * @param url Batch update URL with the token, "&pin=<pin>" is appended,
+ *            or the frame receiver URL with `CONFIG_HISTORY_FRAME_UPLOAD`
+ * @param pins Pins receiving the history, must stay valid, unused for frames
+ * @param pin_count Number of pins
+ * @return `ESP_OK` on success
+ */
+esp_err_t history_init(const char *url, const history_pin_t *pins, size_t pin_count);
+
+/**
+ * @brief Append a sample, called by the reader task
+ *
+ * @param timestamp_ms Uptime of the read, milliseconds
+ * @param temperature Degrees Celsius * 10
+ * @param humidity Percents * 10
+ */
+void history_add(int64_t timestamp_ms, int16_t temperature, int16_t humidity);
+
+/**
+ * @brief Queue the value of a closed rollup window
+ *
+ * @param tier Rollup tier, 1 to `HISTORY_MAX_TIERS`
+ * @param timestamp_ms Uptime of the window start, milliseconds
+ * @param temperature Degrees Celsius * 10
+ * @param humidity Percents * 10
+ */
+void history_add_rollup(int tier, int64_t timestamp_ms, int16_t temperature, int16_t humidity);
+
+/**
+ * @brief Number of samples and windows waiting for upload, RAM and NVS
+ */
+size_t history_pending(void);
+
+/**
+ * @brief Upload one batch, oldest samples first
+ *
+ * Samples are removed only after every pin accepted them.
+ *
+ * @return `ESP_OK` on success or if nothing is pending,
+ *         `ESP_ERR_INVALID_STATE` if the clock is needed and not set yet
+ */
+esp_err_t history_flush(void);
+
+/**
+ * @brief Drop all pending samples
+ */
+void history_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HISTORY_H__
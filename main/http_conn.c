@@ -0,0 +1,290 @@
+/**
+ * @file http_conn.c
+ *
+ * Persistent keep-alive HTTP connections to the Blynk cloud.
+ */
+#include "http_conn.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+
+#include "metrics.h"
+
+#define HTTP_CONN_TIMEOUT_MS    5000
+
+static const char *TAG = "HTTP_CONN";
+
+typedef struct
+{
+    http_conn_data_cb_t on_data;
+    void                *ctx;
+} http_conn_sink_t;
+
+// body collected into a caller buffer by http_conn_get()/http_conn_post()
+typedef struct
+{
+    char    *buf;
+    size_t  size;
+    size_t  len;
+} http_conn_buf_t;
+
+typedef struct
+{
+    metrics_hist_t              connect;    // new connections only
+    metrics_hist_t              ttfb;       // request sent to first response header
+    metrics_hist_t              total;      // whole request, retry included
+    metrics_counter_t           ok;
+    metrics_counter_t           failed;
+} http_conn_metrics_t;
+
+typedef struct
+{
+    esp_http_client_handle_t    client;
+    SemaphoreHandle_t           lock;
+    http_conn_sink_t            sink;
+    http_conn_stats_t           stats;
+    http_conn_metrics_t         metrics;
+    int64_t                     attempt_us;     // start of the current attempt
+    bool                        responded;      // first header of the attempt seen
+} http_conn_t;
+
+static http_conn_t conns[HTTP_CONN_EP_MAX];
+
+static const char *const metric_names[HTTP_CONN_EP_MAX][5] = {
+    [HTTP_CONN_EP_GET] = { "http.get.connect", "http.get.ttfb", "http.get.total", "http.get.ok", "http.get.failed" },
+    [HTTP_CONN_EP_UPDATE] = { "http.upd.connect", "http.upd.ttfb", "http.upd.total", "http.upd.ok", "http.upd.failed" },
+};
+
+static esp_err_t http_conn_event_handler(esp_http_client_event_handle_t evt)
+{
+    http_conn_t *conn = (http_conn_t *)evt->user_data;
+
+    switch (evt->event_id)
+    {
+    case HTTP_EVENT_ON_CONNECTED:
+        conn->stats.connects++;
+        metrics_record(&conn->metrics.connect, esp_timer_get_time() - conn->attempt_us);
+        break;
+
+    case HTTP_EVENT_ON_HEADER:
+        if (!conn->responded)
+        {
+            conn->responded = true;
+            metrics_record(&conn->metrics.ttfb, esp_timer_get_time() - conn->attempt_us);
+        }
+        break;
+
+    case HTTP_EVENT_ON_DATA:
+        // sized and chunked bodies alike, chunk framing is already removed
+        if (conn->sink.on_data && evt->data_len > 0)
+            conn->sink.on_data(evt->data, evt->data_len, conn->sink.ctx);
+        break;
+
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+static void http_conn_buf_write(const char *data, size_t len, void *ctx)
+{
+    http_conn_buf_t *b = ctx;
+
+    if (!data)
+        b->len = 0;
+    else if (b->len + 1 < b->size)
+    {
+        size_t n = b->size - 1 - b->len;
+        if (len < n)
+            n = len;
+        memcpy(b->buf + b->len, data, n);
+        b->len += n;
+    }
+    if (b->size)
+        b->buf[b->len] = 0;
+}
+
+typedef struct
+{
+    esp_http_client_method_t    method;
+    const char                  *content_type;
+    const char                  *body;
+    int                         body_len;
+} http_conn_req_t;
+
+static esp_err_t http_conn_prepare(http_conn_t *conn, const char *url, const http_conn_req_t *req)
+{
+    esp_err_t err;
+
+    if (conn->client && (err = esp_http_client_set_url(conn->client, url)) != ESP_OK)
+        return err;
+
+    if (!conn->client)
+    {
+        esp_http_client_config_t config = {
+            .url = url,
+            .method = HTTP_METHOD_GET,
+            .cert_pem = NULL,
+            .timeout_ms = HTTP_CONN_TIMEOUT_MS,
+            .keep_alive_enable = true,
+            .buffer_size = CONFIG_HTTP_CONN_RX_BUF,
+            .buffer_size_tx = CONFIG_HTTP_CONN_TX_BUF,
+            .event_handler = http_conn_event_handler,
+            .user_data = conn};
+
+        if (!(conn->client = esp_http_client_init(&config)))
+            return ESP_ERR_NO_MEM;
+    }
+
+    // the handle is reused, so method, body and headers are set every time
+    esp_http_client_set_method(conn->client, req->method);
+    esp_http_client_set_post_field(conn->client, req->body, req->body_len);
+    if (req->content_type)
+        esp_http_client_set_header(conn->client, "Content-Type", req->content_type);
+    else
+        esp_http_client_delete_header(conn->client, "Content-Type");
+
+    return ESP_OK;
+}
+
+static void http_conn_drop(http_conn_t *conn)
+{
+    if (!conn->client)
+        return;
+#if CONFIG_MEMORY_STATIC
+    // keep the handle and its buffers for life, only the socket goes
+    esp_http_client_close(conn->client);
+#else
+    esp_http_client_cleanup(conn->client);
+    conn->client = NULL;
+#endif
+}
+
+esp_err_t http_conn_init(void)
+{
+    for (int i = 0; i < HTTP_CONN_EP_MAX; i++)
+    {
+        if (conns[i].lock)
+            continue;
+        conns[i].lock = xSemaphoreCreateMutex();
+        if (!conns[i].lock)
+            return ESP_ERR_NO_MEM;
+
+        http_conn_metrics_t *m = &conns[i].metrics;
+        metrics_register_hist(&m->connect, metric_names[i][0]);
+        metrics_register_hist(&m->ttfb, metric_names[i][1]);
+        metrics_register_hist(&m->total, metric_names[i][2]);
+        metrics_register_counter(&m->ok, metric_names[i][3]);
+        metrics_register_counter(&m->failed, metric_names[i][4]);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t http_conn_request(http_conn_endpoint_t ep, const char *url,
+        const http_conn_req_t *req, const http_conn_sink_t *sink, int *status)
+{
+    if (ep >= HTTP_CONN_EP_MAX || !url || !conns[ep].lock)
+        return ESP_ERR_INVALID_ARG;
+
+    http_conn_t *conn = &conns[ep];
+    esp_err_t err = ESP_FAIL;
+
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    int64_t start = esp_timer_get_time();
+
+    conn->sink = *sink;
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (attempt)
+        {
+            // the server may have closed the idle keep-alive socket: start over
+            conn->stats.reconnects++;
+            http_conn_drop(conn);
+        }
+        if (sink->on_data)
+            sink->on_data(NULL, 0, sink->ctx);
+        conn->attempt_us = esp_timer_get_time();
+        conn->responded = false;
+        if ((err = http_conn_prepare(conn, url, req)) != ESP_OK)
+            continue;
+        if ((err = esp_http_client_perform(conn->client)) == ESP_OK)
+            break;
+    }
+
+    if (err == ESP_OK && status)
+        *status = esp_http_client_get_status_code(conn->client);
+    conn->sink.on_data = NULL;
+
+    int64_t elapsed = esp_timer_get_time() - start;
+    conn->stats.requests++;
+    conn->stats.last_us = elapsed;
+    conn->stats.total_us += elapsed;
+    if (elapsed > conn->stats.max_us)
+        conn->stats.max_us = elapsed;
+    metrics_record(&conn->metrics.total, elapsed);
+    metrics_count(err == ESP_OK ? &conn->metrics.ok : &conn->metrics.failed);
+    if (err != ESP_OK)
+    {
+        conn->stats.failures++;
+        http_conn_drop(conn);
+    }
+    xSemaphoreGive(conn->lock);
+
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "Request failed: %s", esp_err_to_name(err));
+    else
+        ESP_LOGD(TAG, "Request done in %" PRId64 " us", elapsed);
+
+    return err;
+}
+
+esp_err_t http_conn_get(http_conn_endpoint_t ep, const char *url,
+        char *resp, size_t resp_size, int *status)
+{
+    http_conn_req_t req = { .method = HTTP_METHOD_GET };
+    http_conn_buf_t buf = { .buf = resp, .size = resp ? resp_size : 0 };
+    http_conn_sink_t sink = { .on_data = http_conn_buf_write, .ctx = &buf };
+
+    return http_conn_request(ep, url, &req, &sink, status);
+}
+
+esp_err_t http_conn_get_stream(http_conn_endpoint_t ep, const char *url,
+        http_conn_data_cb_t on_data, void *ctx, int *status)
+{
+    http_conn_req_t req = { .method = HTTP_METHOD_GET };
+    http_conn_sink_t sink = { .on_data = on_data, .ctx = ctx };
+
+    return http_conn_request(ep, url, &req, &sink, status);
+}
+
+esp_err_t http_conn_post(http_conn_endpoint_t ep, const char *url,
+        const char *content_type, const char *body, int body_len,
+        char *resp, size_t resp_size, int *status)
+{
+    http_conn_req_t req = {
+        .method = HTTP_METHOD_POST,
+        .content_type = content_type,
+        .body = body,
+        .body_len = body_len};
+    http_conn_buf_t buf = { .buf = resp, .size = resp ? resp_size : 0 };
+    http_conn_sink_t sink = { .on_data = http_conn_buf_write, .ctx = &buf };
+
+    return http_conn_request(ep, url, &req, &sink, status);
+}
+
+void http_conn_get_stats(http_conn_endpoint_t ep, http_conn_stats_t *stats)
+{
+    if (ep >= HTTP_CONN_EP_MAX || !stats || !conns[ep].lock)
+        return;
+
+    xSemaphoreTake(conns[ep].lock, portMAX_DELAY);
+    *stats = conns[ep].stats;
+    xSemaphoreGive(conns[ep].lock);
+}
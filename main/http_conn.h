@@ -0,0 +1,126 @@
+/**
+ * @file http_conn.h
+ *
+ * Persistent keep-alive HTTP connections to the Blynk cloud.
+ *
+ * One esp_http_client handle is kept per endpoint and reused across requests
+ * with esp_http_client_set_url(), so the DNS lookup and TCP handshake are paid
+ * once instead of on every call. A failed request closes the socket and is
+ * retried once on a fresh connection before the error is returned.
+ *
+ * With `CONFIG_MEMORY_STATIC` a failure only closes the socket: the handle
+ * and its fixed-size buffers, allocated on first use, are kept for life so
+ * errors do not churn the heap.
+ */
+#ifndef __HTTP_CONN_H__
+#define __HTTP_CONN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Endpoints with their own persistent connection
+ */
+typedef enum
+{
+    HTTP_CONN_EP_GET = 0,   //!< /external/api/get, control pin reads
+    HTTP_CONN_EP_UPDATE,    //!< /external/api/batch/update, sensor uploads
+    HTTP_CONN_EP_MAX
+} http_conn_endpoint_t;
+
+/**
+ * @brief Receive a piece of a response body
+ *
+ * Called from the requesting task as the body arrives, chunked transfer
+ * encoding already removed. A NULL `data` marks the start of the body, it
+ * is sent again when a request is retried so the receiver can start over.
+ */
+typedef void (*http_conn_data_cb_t)(const char *data, size_t len, void *ctx);
+
+/**
+ * Per-endpoint request statistics
+ */
+typedef struct
+{
+    uint32_t requests;      //!< Requests issued
+    uint32_t connects;      //!< TCP connections opened, requests - connects were reused
+    uint32_t reconnects;    //!< Requests retried on a fresh connection
+    uint32_t failures;      //!< Requests that failed after the retry
+    int64_t  last_us;       //!< Duration of the last request, microseconds
+    int64_t  max_us;        //!< Longest request, microseconds
+    int64_t  total_us;      //!< Sum of all request durations, microseconds
+} http_conn_stats_t;
+
+/**
+ * @brief Create the per-endpoint locks
+ *
+ * Must be called once before any request. Client handles are created lazily.
+ *
+ * @return `ESP_OK` on success
+ */
+esp_err_t http_conn_init(void);
+
+/**
+ * @brief Perform a GET request on the persistent connection of an endpoint
+ *
+ * @param ep Endpoint whose connection is used
+ * @param url Full request URL
+ * @param[out] resp Buffer for the response body, nullable
+ * @param resp_size Size of `resp`, the body is truncated and always NUL-terminated
+ * @param[out] status HTTP status code, nullable
+ * @return `ESP_OK` on success
+ */
+esp_err_t http_conn_get(http_conn_endpoint_t ep, const char *url,
+        char *resp, size_t resp_size, int *status);
+
+/**
+ * @brief Perform a GET request and stream the response body to a callback
+ *
+ * Nothing is buffered, so the body can be parsed as it arrives whatever
+ * its length.
+ *
+ * @param ep Endpoint whose connection is used
+ * @param url Full request URL
+ * @param on_data Body receiver
+ * @param ctx Passed to `on_data`
+ * @param[out] status HTTP status code, nullable
+ * @return `ESP_OK` on success
+ */
+esp_err_t http_conn_get_stream(http_conn_endpoint_t ep, const char *url,
+        http_conn_data_cb_t on_data, void *ctx, int *status);
+
+/**
+ * @brief Perform a POST request on the persistent connection of an endpoint
+ *
+ * @param ep Endpoint whose connection is used
+ * @param url Full request URL
+ * @param content_type Content-Type of the body
+ * @param body Request body
+ * @param body_len Length of `body`
+ * @param[out] resp Buffer for the response body, nullable
+ * @param resp_size Size of `resp`, the body is truncated and always NUL-terminated
+ * @param[out] status HTTP status code, nullable
+ * @return `ESP_OK` on success
+ */
+esp_err_t http_conn_post(http_conn_endpoint_t ep, const char *url,
+        const char *content_type, const char *body, int body_len,
+        char *resp, size_t resp_size, int *status);
+
+/**
+ * @brief Copy the statistics of an endpoint
+ *
+ * @param ep Endpoint
+ * @param[out] stats Statistics
+ */
+void http_conn_get_stats(http_conn_endpoint_t ep, http_conn_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTTP_CONN_H__
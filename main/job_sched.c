@@ -0,0 +1,121 @@
+/**
+ * @file job_sched.c
+ *
+ * Timed jobs run from a single task.
+ */
+#include "job_sched.h"
+
+#include <string.h>
+
+// wrap-safe "a is before b" on a 32 bit millisecond clock
+static inline bool time_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static inline uint32_t job_now_ms(const job_sched_t *sched)
+{
+    return sched->clock_us() / 1000;
+}
+
+void job_sched_init(job_sched_t *sched, uint64_t (*clock_us)(void), uint32_t slack_ms)
+{
+    memset(sched, 0, sizeof(*sched));
+    sched->clock_us = clock_us;
+    sched->slack_ms = slack_ms;
+}
+
+int job_sched_add(job_sched_t *sched, const char *name, job_fn_t fn, void *ctx, uint32_t delay_ms)
+{
+    if (sched->count >= JOB_SCHED_MAX)
+        return -1;
+
+    int id = sched->count++;
+    job_t *job = &sched->jobs[id];
+
+    memset(job, 0, sizeof(*job));
+    job->name = name;
+    job->fn = fn;
+    job->ctx = ctx;
+    job->armed = delay_ms != JOB_IDLE;
+    job->next_ms = job_now_ms(sched) + (job->armed ? delay_ms : 0);
+
+    return id;
+}
+
+static void job_sched_record(job_sched_t *sched, int id, uint32_t start_ms,
+        uint32_t duration_us, uint32_t late_ms)
+{
+    job_trace_t *t = &sched->trace[sched->traced++ % JOB_SCHED_TRACE_LEN];
+
+    t->job = id;
+    t->start_ms = start_ms;
+    t->duration_us = duration_us;
+    t->late_ms = late_ms;
+}
+
+uint32_t job_sched_run(job_sched_t *sched)
+{
+    uint32_t now = job_now_ms(sched);
+    bool ran = false;
+
+    for (int i = 0; i < sched->count; i++)
+    {
+        job_t *job = &sched->jobs[i];
+        bool triggered = atomic_exchange_explicit(&job->triggered, false, memory_order_acquire);
+
+        if (!triggered && (!job->armed || time_before(now + sched->slack_ms, job->next_ms)))
+            continue;
+
+        uint32_t late = job->armed && !triggered && time_before(job->next_ms, now) ? now - job->next_ms : 0;
+        uint64_t start = sched->clock_us();
+        uint32_t delay = job->fn(job->ctx);
+        uint64_t end = sched->clock_us();
+
+        job->runs++;
+        job->last_us = end - start;
+        if (job->last_us > job->max_us)
+            job->max_us = job->last_us;
+        if (late > job->max_late_ms)
+            job->max_late_ms = late;
+        job_sched_record(sched, i, now, job->last_us, late);
+
+        now = end / 1000;
+        job->armed = delay != JOB_IDLE;
+        job->next_ms = now + (job->armed ? delay : 0);
+        ran = true;
+    }
+    sched->wakeups += ran;
+
+    uint32_t wait = JOB_IDLE;
+    for (int i = 0; i < sched->count; i++)
+    {
+        const job_t *job = &sched->jobs[i];
+
+        if (atomic_load_explicit(&job->triggered, memory_order_relaxed))
+            return 0;
+        if (!job->armed)
+            continue;
+        uint32_t left = time_before(now, job->next_ms) ? job->next_ms - now : 0;
+        if (left < wait)
+            wait = left;
+    }
+
+    return wait;
+}
+
+size_t job_sched_trace(const job_sched_t *sched, job_trace_t *out, size_t max)
+{
+    uint32_t n = sched->traced < JOB_SCHED_TRACE_LEN ? sched->traced : JOB_SCHED_TRACE_LEN;
+    uint32_t first = sched->traced - n;
+
+    if (n > max)
+    {
+        first += n - max;
+        n = max;
+    }
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = sched->trace[(first + i) % JOB_SCHED_TRACE_LEN];
+
+    return n;
+}
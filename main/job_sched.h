@@ -0,0 +1,133 @@
+/**
+ * @file job_sched.h
+ *
+ * Timed jobs run from a single task.
+ *
+ * Every job is a function that returns the delay until it wants to run
+ * again, or `JOB_IDLE` to sleep until it is triggered. One call to
+ * job_sched_run() runs every job due now or within the slack window, so
+ * wakeups that are close together are coalesced, and returns how long the
+ * task may sleep. Each run is recorded in a small trace ring.
+ *
+ * The scheduler reads time through a caller-supplied clock and does not
+ * depend on FreeRTOS, so it can be driven by a virtual clock.
+ */
+#ifndef __JOB_SCHED_H__
+#define __JOB_SCHED_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JOB_SCHED_MAX           8
+#define JOB_SCHED_TRACE_LEN     32
+
+/**
+ * Returned by a job, or by job_sched_run(), to wait for a trigger
+ */
+#define JOB_IDLE                UINT32_MAX
+
+/**
+ * Job body, returns milliseconds until the next run or `JOB_IDLE`
+ */
+typedef uint32_t (*job_fn_t)(void *ctx);
+
+typedef struct
+{
+    const char      *name;
+    job_fn_t        fn;
+    void            *ctx;
+    uint32_t        next_ms;
+    bool            armed;          // next_ms is valid
+    atomic_bool     triggered;      // set by job_sched_trigger()
+    uint32_t        runs;
+    uint32_t        last_us;        // duration of the last run
+    uint32_t        max_us;         // longest run
+    uint32_t        max_late_ms;    // worst delay past next_ms
+} job_t;
+
+/**
+ * One traced run
+ */
+typedef struct
+{
+    uint8_t         job;            //!< Job id
+    uint32_t        start_ms;       //!< Scheduler time of the run
+    uint32_t        duration_us;    //!< Time spent in the job
+    uint32_t        late_ms;        //!< Delay past the requested time, 0 if triggered or early
+} job_trace_t;
+
+/**
+ * Scheduler state, set up with job_sched_init()
+ */
+typedef struct
+{
+    job_t           jobs[JOB_SCHED_MAX];
+    int             count;
+    uint64_t        (*clock_us)(void);
+    uint32_t        slack_ms;                           //!< Jobs due this soon run in the current wakeup
+    uint32_t        wakeups;                            //!< Calls of job_sched_run() that ran a job
+    job_trace_t     trace[JOB_SCHED_TRACE_LEN];
+    uint32_t        traced;                             //!< Runs recorded since start
+} job_sched_t;
+
+/**
+ * @brief Reset the scheduler
+ *
+ * @param sched Scheduler
+ * @param clock_us Monotonic clock, microseconds
+ * @param slack_ms Coalescing window
+ */
+void job_sched_init(job_sched_t *sched, uint64_t (*clock_us)(void), uint32_t slack_ms);
+
+/**
+ * @brief Add a job
+ *
+ * @param sched Scheduler
+ * @param name Name shown in the trace, must stay valid
+ * @param fn Job body
+ * @param ctx Passed to `fn`
+ * @param delay_ms Delay of the first run, or `JOB_IDLE` to wait for a trigger
+ * @return Job id, or -1 if the table is full
+ */
+int job_sched_add(job_sched_t *sched, const char *name, job_fn_t fn, void *ctx, uint32_t delay_ms);
+
+/**
+ * @brief Make a job run at the next wakeup
+ *
+ * Safe to call from any task; the caller must then wake the task calling
+ * job_sched_run().
+ */
+static inline void job_sched_trigger(job_sched_t *sched, int id)
+{
+    atomic_store_explicit(&sched->jobs[id].triggered, true, memory_order_release);
+}
+
+/**
+ * @brief Run the due jobs
+ *
+ * @param sched Scheduler
+ * @return Milliseconds until the next job is due, or `JOB_IDLE`
+ */
+uint32_t job_sched_run(job_sched_t *sched);
+
+/**
+ * @brief Copy the trace, oldest run first
+ *
+ * @param sched Scheduler
+ * @param[out] out Trace records
+ * @param max Size of `out`
+ * @return Number of records copied
+ */
+size_t job_sched_trace(const job_sched_t *sched, job_trace_t *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __JOB_SCHED_H__
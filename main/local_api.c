@@ -0,0 +1,262 @@
+/**
+ * @file local_api.c
+ *
+ * HTTP endpoints on the LAN serving the latest readings without the cloud.
+ */
+#include "local_api.h"
+
+#include <sys/time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+
+#include "snapshot.h"
+#include "sample_ring.h"
+#include "url_builder.h"
+#include "metrics.h"
+#include "task_layout.h"
+
+// anything before 2021 means SNTP has not set the clock yet
+#define LOCAL_API_MIN_EPOCH         1609459200
+
+#define LOCAL_API_READINGS_LEN      128
+#define LOCAL_API_METRICS_LEN       2048
+#define LOCAL_API_CHUNK_SAMPLES     32
+// "[1700000000000,-40.0,100.0]," per sample
+#define LOCAL_API_SAMPLE_LEN        30
+
+static const char *TAG = "LOCAL_API";
+
+static SemaphoreHandle_t    lock;
+static char                 readings_buf[SNAPSHOT_SLOTS * LOCAL_API_READINGS_LEN];
+static char                 metrics_buf[SNAPSHOT_SLOTS * LOCAL_API_METRICS_LEN];
+static snapshot_t           readings;
+static snapshot_t           metrics;
+static sample_rec_t         ring_buf[CONFIG_LOCAL_API_HISTORY];
+static sample_ring_t        ring;
+
+// used by the server task only
+static sample_point_t       chunk_points[LOCAL_API_CHUNK_SAMPLES];
+static char                 chunk[LOCAL_API_CHUNK_SAMPLES * LOCAL_API_SAMPLE_LEN + 32];
+
+/**
+ * Wall clock minus uptime, 0 if the clock is not set.
+ */
+static int64_t local_api_clock_offset_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < LOCAL_API_MIN_EPOCH)
+        return 0;
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - esp_timer_get_time() / 1000;
+}
+
+/**
+ * Set the caching headers, true if the client already has `version`.
+ * `etag` must stay valid until the response is sent.
+ */
+static bool local_api_not_modified(httpd_req_t *req, uint32_t version, char etag[SNAPSHOT_ETAG_LEN])
+{
+    char if_none_match[64];
+
+    snapshot_etag(version, etag);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) != ESP_OK ||
+        !snapshot_etag_match(if_none_match, version))
+        return false;
+
+    httpd_resp_set_status(req, "304 Not Modified");
+    return true;
+}
+
+static esp_err_t local_api_send_snapshot(httpd_req_t *req, snapshot_t *snap, const char *type)
+{
+    char etag[SNAPSHOT_ETAG_LEN];
+    const char *data;
+    size_t len;
+    uint32_t version;
+    esp_err_t err;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool ok = snapshot_read_begin(snap, &data, &len, &version);
+    xSemaphoreGive(lock);
+    if (!ok)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    // the slot stays untouched by the reader until it is returned
+    if (local_api_not_modified(req, version, etag))
+        err = httpd_resp_send(req, NULL, 0);
+    else
+    {
+        httpd_resp_set_type(req, type);
+        err = httpd_resp_send(req, data, len);
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    snapshot_read_end(snap);
+    xSemaphoreGive(lock);
+    return err;
+}
+
+static esp_err_t local_api_readings(httpd_req_t *req)
+{
+    return local_api_send_snapshot(req, &readings, "application/json");
+}
+
+static esp_err_t local_api_metrics(httpd_req_t *req)
+{
+    return local_api_send_snapshot(req, &metrics, "text/plain");
+}
+
+/**
+ * Decode the next samples after `after_ms`, all of them if `first`.
+ * The ring may have moved on since the previous chunk, so the position is
+ * found again by timestamp on a copy of its state.
+ */
+static size_t local_api_history_next(bool first, int64_t after_ms)
+{
+    size_t records;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    sample_ring_t view = ring;
+    if (!first)
+        sample_ring_drop_until(&view, after_ms);
+    size_t n = sample_ring_peek(&view, chunk_points, LOCAL_API_CHUNK_SAMPLES, &records);
+    xSemaphoreGive(lock);
+    return n;
+}
+
+static esp_err_t local_api_history(httpd_req_t *req)
+{
+    char etag[SNAPSHOT_ETAG_LEN];
+    uint32_t version = 0;
+    int64_t offset = local_api_clock_offset_ms();
+    int64_t last_ms = 0;
+    bool first = true;
+    esp_err_t err;
+    size_t n;
+
+    // the history changes exactly when the readings do
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool any = snapshot_version(&readings, &version);
+    xSemaphoreGive(lock);
+    if (any && local_api_not_modified(req, version, etag))
+        return httpd_resp_send(req, NULL, 0);
+
+    httpd_resp_set_type(req, "application/json");
+    if ((err = httpd_resp_sendstr_chunk(req, offset ? "{\"clock\":\"unix\",\"samples\":["
+                                                    : "{\"clock\":\"uptime\",\"samples\":[")) != ESP_OK)
+        return err;
+
+    while ((n = local_api_history_next(first, last_ms)) > 0)
+    {
+        url_builder_t b;
+
+        url_init(&b, chunk, sizeof(chunk));
+        for (size_t i = 0; i < n; i++)
+        {
+            url_append(&b, first && !i ? "[" : ",[", first && !i ? 1 : 2);
+            url_append_int(&b, chunk_points[i].timestamp_ms + offset);
+            url_append(&b, ",", 1);
+            url_append_fixed1(&b, chunk_points[i].temperature);
+            url_append(&b, ",", 1);
+            url_append_fixed1(&b, chunk_points[i].humidity);
+            url_append(&b, "]", 1);
+        }
+        if (!url_finish(&b))
+            return ESP_ERR_INVALID_SIZE;
+        if ((err = httpd_resp_send_chunk(req, chunk, b.len)) != ESP_OK)
+            return err;
+        last_ms = chunk_points[n - 1].timestamp_ms;
+        first = false;
+    }
+
+    if ((err = httpd_resp_send_chunk(req, "]}", 2)) != ESP_OK)
+        return err;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t local_api_init(void)
+{
+    if (!(lock = xSemaphoreCreateMutex()))
+        return ESP_ERR_NO_MEM;
+
+    snapshot_init(&readings, readings_buf, LOCAL_API_READINGS_LEN, esp_random());
+    snapshot_init(&metrics, metrics_buf, LOCAL_API_METRICS_LEN, esp_random());
+    sample_ring_init(&ring, ring_buf, CONFIG_LOCAL_API_HISTORY);
+    return ESP_OK;
+}
+
+esp_err_t local_api_start(void)
+{
+    static const httpd_uri_t uris[] = {
+        { .uri = "/readings", .method = HTTP_GET, .handler = local_api_readings },
+        { .uri = "/metrics", .method = HTTP_GET, .handler = local_api_metrics },
+        { .uri = "/history", .method = HTTP_GET, .handler = local_api_history },
+    };
+    const task_layout_t *layout = task_layout_get(TASK_HTTPD);
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    httpd_handle_t server;
+    esp_err_t err;
+
+    config.server_port = CONFIG_LOCAL_API_PORT;
+    config.core_id = layout->core;
+    config.task_priority = layout->priority;
+    config.stack_size = layout->stack;
+    config.lru_purge_enable = true;
+
+    if ((err = httpd_start(&server, &config)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start the server: %s", esp_err_to_name(err));
+        return err;
+    }
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+        httpd_register_uri_handler(server, &uris[i]);
+
+    ESP_LOGI(TAG, "Serving on port %d", CONFIG_LOCAL_API_PORT);
+    return ESP_OK;
+}
+
+void local_api_publish(int64_t timestamp_ms, int16_t temperature, int16_t humidity)
+{
+    int64_t offset = local_api_clock_offset_ms();
+    url_builder_t b;
+    size_t size;
+    char *buf;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    sample_ring_push(&ring, timestamp_ms, temperature, humidity);
+    buf = snapshot_write_begin(&readings, &size);
+    xSemaphoreGive(lock);
+
+    // the slot is invisible to readers until committed, format it unlocked
+    url_init(&b, buf, size);
+    url_append_str(&b, offset ? "{\"time\":" : "{\"uptime_ms\":");
+    url_append_int(&b, timestamp_ms + offset);
+    url_append_str(&b, ",\"temperature\":");
+    url_append_fixed1(&b, temperature);
+    url_append_str(&b, ",\"humidity\":");
+    url_append_fixed1(&b, humidity);
+    url_append(&b, "}", 1);
+    url_finish(&b);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    snapshot_write_commit(&readings, b.len);
+    buf = snapshot_write_begin(&metrics, &size);
+    xSemaphoreGive(lock);
+
+    size = metrics_snapshot(buf, size, METRICS_FORMAT_TEXT);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    snapshot_write_commit(&metrics, size);
+    xSemaphoreGive(lock);
+}
@@ -0,0 +1,54 @@
+/**
+ * @file local_api.h
+ *
+ * HTTP endpoints on the LAN serving the latest readings without the cloud.
+ *
+ *     GET /readings   latest sample of the first sensor, JSON
+ *     GET /metrics    metrics snapshot (see metrics.h), text
+ *     GET /history    recent samples kept for the LAN, chunked JSON
+ *
+ * Bodies of /readings and /metrics are formatted once per sample, when it
+ * arrives, and requests are answered straight from that buffer (see
+ * snapshot.h). Every response carries an ETag that changes with each
+ * sample, so clients polling with If-None-Match get a 304 with no body
+ * until there is something new. /history streams a fixed-memory ring of
+ * samples in chunks, so its size is not bounded by a response buffer.
+ */
+#ifndef __LOCAL_API_H__
+#define __LOCAL_API_H__
+
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Set up the buffers, before the first local_api_publish()
+ *
+ * @return `ESP_OK` on success
+ */
+esp_err_t local_api_init(void);
+
+/**
+ * @brief Start the HTTP server, once the network interface exists
+ *
+ * @return `ESP_OK` on success, or the error of httpd_start()
+ */
+esp_err_t local_api_start(void);
+
+/**
+ * @brief Rebuild the bodies after a new sample, called by the reader
+ *
+ * @param timestamp_ms Uptime of the read, milliseconds
+ * @param temperature Degrees Celsius * 10
+ * @param humidity Percents * 10
+ */
+void local_api_publish(int64_t timestamp_ms, int16_t temperature, int16_t humidity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __LOCAL_API_H__
@@ -0,0 +1,26 @@
+/**
+ * @file mem_report.c
+ *
+ * Heap taken by each start-up step, for tools/ram_report.py.
+ */
+#include "mem_report.h"
+
+#include <stdint.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+
+static const char *TAG = "MEM_REPORT";
+
+void mem_report_mark(const char *name)
+{
+    static uint32_t last;
+    uint32_t free = esp_get_free_heap_size();
+
+    // the first mark gives the heap left by the system components
+    if (!last)
+        ESP_LOGI(TAG, "%s free=%u B", name, (unsigned)free);
+    else
+        ESP_LOGI(TAG, "%s heap=%d B", name, (int)(last - free));
+    last = free;
+}
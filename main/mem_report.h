@@ -0,0 +1,34 @@
+/**
+ * @file mem_report.h
+ *
+ * Heap taken by each start-up step, for tools/ram_report.py.
+ *
+ * Static RAM is read from the link map at build time, but queues, mutexes,
+ * HTTP client buffers and the tasks left on the heap only exist once the
+ * firmware runs. Each mark logs the free heap consumed since the previous
+ * one, so a boot log attributes the heap to the subsystem that allocated
+ * it. Together with the stack high-water marks of the metrics dump, this
+ * is what the report compares against the budgets of the "Memory Budget"
+ * menu.
+ */
+#ifndef __MEM_REPORT_H__
+#define __MEM_REPORT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Log the heap taken since the previous mark
+ *
+ * The first mark logs the free heap instead.
+ *
+ * @param name Subsystem initialized since the previous mark
+ */
+void mem_report_mark(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __MEM_REPORT_H__
@@ -0,0 +1,242 @@
+/**
+ * @file metrics.c
+ *
+ * Latency histograms and event counters readable in production.
+ */
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "driver/uart.h"
+
+#include "task_layout.h"
+
+#define METRICS_UART_BUF        256
+#define METRICS_DUMP_LEN        2048
+
+typedef struct
+{
+    const char          *name;
+    metrics_hist_t      *hist;      // NULL for a counter
+    metrics_counter_t   *counter;
+} metrics_entry_t;
+
+static metrics_entry_t      entries[METRICS_MAX];
+static atomic_uint          entry_count;
+static const char           *tasks[METRICS_MAX_TASKS];
+static atomic_uint          task_count;
+static portMUX_TYPE         mux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Snapshot writer, stops at the first entry that does not fit */
+typedef struct
+{
+    char    *buf;
+    size_t  size;
+    size_t  len;
+    bool    full;
+} metrics_out_t;
+
+static void metrics_printf(metrics_out_t *out, const char *fmt, ...)
+{
+    va_list args;
+
+    if (out->full)
+        return;
+    va_start(args, fmt);
+    int n = vsnprintf(out->buf + out->len, out->size - out->len, fmt, args);
+    va_end(args);
+
+    if (n < 0 || out->len + n >= out->size)
+    {
+        out->full = true;
+        out->buf[out->len] = 0;
+        return;
+    }
+    out->len += n;
+}
+
+static esp_err_t metrics_register(const char *name, metrics_hist_t *hist, metrics_counter_t *counter)
+{
+    esp_err_t err = ESP_OK;
+
+    if (!name)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&mux);
+    unsigned n = atomic_load_explicit(&entry_count, memory_order_relaxed);
+    if (n == METRICS_MAX)
+        err = ESP_ERR_NO_MEM;
+    else
+    {
+        entries[n] = (metrics_entry_t){ .name = name, .hist = hist, .counter = counter };
+        // snapshots only read entries below the published count
+        atomic_store_explicit(&entry_count, n + 1, memory_order_release);
+    }
+    portEXIT_CRITICAL(&mux);
+    return err;
+}
+
+esp_err_t metrics_register_hist(metrics_hist_t *hist, const char *name)
+{
+    return hist ? metrics_register(name, hist, NULL) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t metrics_register_counter(metrics_counter_t *counter, const char *name)
+{
+    return counter ? metrics_register(name, NULL, counter) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t metrics_watch_task(const char *name)
+{
+    esp_err_t err = ESP_OK;
+
+    if (!name)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&mux);
+    unsigned n = atomic_load_explicit(&task_count, memory_order_relaxed);
+    if (n == METRICS_MAX_TASKS)
+        err = ESP_ERR_NO_MEM;
+    else
+    {
+        tasks[n] = name;
+        atomic_store_explicit(&task_count, n + 1, memory_order_release);
+    }
+    portEXIT_CRITICAL(&mux);
+    return err;
+}
+
+uint32_t metrics_percentile(const metrics_hist_t *hist, unsigned percent)
+{
+    uint32_t counts[METRICS_BUCKETS];
+    uint64_t total = 0;
+
+    // buckets are read one by one, a record landing meanwhile only shifts the result slightly
+    for (int i = 0; i < METRICS_BUCKETS; i++)
+    {
+        counts[i] = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        total += counts[i];
+    }
+    if (!total)
+        return 0;
+
+    uint32_t max = atomic_load_explicit(&hist->max_us, memory_order_relaxed);
+    uint64_t rank = (total * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS - 1; i++)
+    {
+        // the max is a tighter bound for the top bucket
+        if ((seen += counts[i]) >= rank)
+            return (2u << i) < max ? (2u << i) : max;
+    }
+    return max;
+}
+
+size_t metrics_snapshot(char *buf, size_t size, metrics_format_t format)
+{
+    metrics_out_t out = { .buf = buf, .size = size };
+    bool text = format == METRICS_FORMAT_TEXT;
+    unsigned n = atomic_load_explicit(&entry_count, memory_order_acquire);
+
+    if (!size)
+        return 0;
+    buf[0] = 0;
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        const metrics_entry_t *e = &entries[i];
+        if (e->counter)
+        {
+            unsigned v = atomic_load_explicit(&e->counter->value, memory_order_relaxed);
+            if (text)
+                metrics_printf(&out, "%-20s %u\n", e->name, v);
+            else if (v)
+                metrics_printf(&out, "%s:%u,", e->name, v);
+            continue;
+        }
+
+        unsigned count = atomic_load_explicit(&e->hist->count, memory_order_relaxed);
+        unsigned max = atomic_load_explicit(&e->hist->max_us, memory_order_relaxed);
+        if (text)
+            metrics_printf(&out, "%-20s n=%u p50=%u p90=%u p99=%u max=%u us\n", e->name, count,
+                    (unsigned)metrics_percentile(e->hist, 50), (unsigned)metrics_percentile(e->hist, 90),
+                    (unsigned)metrics_percentile(e->hist, 99), max);
+        else if (count)
+            metrics_printf(&out, "%s:%u/%u/%u/%u,", e->name, count,
+                    (unsigned)metrics_percentile(e->hist, 50), (unsigned)metrics_percentile(e->hist, 99), max);
+    }
+
+    metrics_printf(&out, text ? "%-20s free=%u min=%u B\n" : "%s:%u/%u,", "heap",
+            (unsigned)esp_get_free_heap_size(), (unsigned)esp_get_minimum_free_heap_size());
+
+    n = atomic_load_explicit(&task_count, memory_order_acquire);
+    for (unsigned i = 0; i < n; i++)
+    {
+        TaskHandle_t task = xTaskGetHandle(tasks[i]);
+        if (!task)
+            continue;
+        // ESP-IDF reports the high-water mark in bytes
+        unsigned hwm = uxTaskGetStackHighWaterMark(task);
+        if (text)
+            metrics_printf(&out, "stack %-14s %u B free\n", tasks[i], hwm);
+        else
+            metrics_printf(&out, "stk.%s:%u,", tasks[i], hwm);
+    }
+
+    // no trailing separator on the compact line
+    if (!text && out.len && buf[out.len - 1] == ',')
+        buf[--out.len] = 0;
+    return out.len;
+}
+
+void metrics_dump(void)
+{
+    static char buf[METRICS_DUMP_LEN];
+    static portMUX_TYPE dump_mux = portMUX_INITIALIZER_UNLOCKED;
+    static bool busy;
+    bool mine;
+
+    // the buffer is shared, a dump requested while one is printing is skipped
+    portENTER_CRITICAL(&dump_mux);
+    if ((mine = !busy))
+        busy = true;
+    portEXIT_CRITICAL(&dump_mux);
+    if (!mine)
+        return;
+
+    metrics_snapshot(buf, sizeof(buf), METRICS_FORMAT_TEXT);
+    printf("--- metrics at %u ms ---\n%s", (unsigned)(xTaskGetTickCount() * portTICK_PERIOD_MS), buf);
+
+    portENTER_CRITICAL(&dump_mux);
+    busy = false;
+    portEXIT_CRITICAL(&dump_mux);
+}
+
+static void metrics_uart_task(void *pvParameters)
+{
+    uint8_t c;
+
+    while (1)
+    {
+        if (uart_read_bytes(CONFIG_ESP_CONSOLE_UART_NUM, &c, 1, portMAX_DELAY) == 1 && (c == 'm' || c == 'M'))
+            metrics_dump();
+    }
+}
+
+esp_err_t metrics_serial_start(void)
+{
+    esp_err_t err;
+
+    if (!uart_is_driver_installed(CONFIG_ESP_CONSOLE_UART_NUM) &&
+        (err = uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, METRICS_UART_BUF, 0, 0, NULL, 0)) != ESP_OK)
+        return err;
+
+    if ((err = task_layout_create(TASK_METRICS, metrics_uart_task, NULL, NULL)) != ESP_OK)
+        return err;
+    return metrics_watch_task(task_layout_get(TASK_METRICS)->name);
+}
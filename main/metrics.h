@@ -0,0 +1,156 @@
+/**
+ * @file metrics.h
+ *
+ * Latency histograms and event counters readable in production.
+ *
+ * Modules own their metrics as static variables and register them by name
+ * once at init. Recording is a handful of relaxed atomic operations, with
+ * no lock and no allocation, so it can sit on hot paths and run from any
+ * task. Histograms have fixed power-of-two buckets in microseconds, from
+ * below 2 us up to `METRICS_BUCKETS` doublings, the last bucket being
+ * open-ended.
+ *
+ * A snapshot formats every registered metric together with the free heap
+ * low-water mark and the stack high-water mark of the watched tasks, either
+ * as text lines for the serial console or as one compact line short enough
+ * for a Blynk pin.
+ */
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRICS_BUCKETS     24      //!< Last bucket starts at 2^23 us, ~8.4 s
+#define METRICS_MAX         32      //!< Registered histograms and counters
+#define METRICS_MAX_TASKS   8
+
+/**
+ * Histogram, zero-initialize before use
+ */
+typedef struct
+{
+    atomic_uint     buckets[METRICS_BUCKETS];   //!< Bucket i counts values in [2^i, 2^(i+1)) us, 0 and 1 in bucket 0
+    atomic_uint     count;
+    atomic_uint     max_us;
+} metrics_hist_t;
+
+/**
+ * Event counter, zero-initialize before use
+ */
+typedef struct
+{
+    atomic_uint     value;
+} metrics_counter_t;
+
+/**
+ * Snapshot layout
+ */
+typedef enum
+{
+    METRICS_FORMAT_TEXT = 0,    //!< One line per metric, for the serial console
+    METRICS_FORMAT_COMPACT,     //!< One line without spaces, for a Blynk pin
+} metrics_format_t;
+
+/**
+ * @brief Record a duration
+ */
+static inline void metrics_record(metrics_hist_t *hist, uint32_t us)
+{
+    int b = us < 2 ? 0 : 31 - __builtin_clz(us);
+    if (b >= METRICS_BUCKETS)
+        b = METRICS_BUCKETS - 1;
+
+    atomic_fetch_add_explicit(&hist->buckets[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+
+    unsigned max = atomic_load_explicit(&hist->max_us, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak_explicit(&hist->max_us, &max, us,
+            memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/**
+ * @brief Count an event
+ */
+static inline void metrics_count(metrics_counter_t *counter)
+{
+    atomic_fetch_add_explicit(&counter->value, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Add a histogram to the snapshots
+ *
+ * @param hist Histogram, must stay valid
+ * @param name Name in the snapshots, must stay valid
+ * @return `ESP_OK` on success, `ESP_ERR_NO_MEM` if `METRICS_MAX` are registered
+ */
+esp_err_t metrics_register_hist(metrics_hist_t *hist, const char *name);
+
+/**
+ * @brief Add a counter to the snapshots
+ *
+ * @param counter Counter, must stay valid
+ * @param name Name in the snapshots, must stay valid
+ * @return `ESP_OK` on success, `ESP_ERR_NO_MEM` if `METRICS_MAX` are registered
+ */
+esp_err_t metrics_register_counter(metrics_counter_t *counter, const char *name);
+
+/**
+ * @brief Report the stack high-water mark of a task in the snapshots
+ *
+ * The task is looked up by name when a snapshot is taken, so it may be
+ * created later or belong to another component.
+ *
+ * @param name Task name, must stay valid
+ * @return `ESP_OK` on success, `ESP_ERR_NO_MEM` if `METRICS_MAX_TASKS` are watched
+ */
+esp_err_t metrics_watch_task(const char *name);
+
+/**
+ * @brief Get a percentile of a histogram
+ *
+ * @param hist Histogram
+ * @param percent Percentile, 0-100
+ * @return Upper bound of the bucket holding the percentile in us, at most the max, 0 if empty
+ */
+uint32_t metrics_percentile(const metrics_hist_t *hist, unsigned percent);
+
+/**
+ * @brief Format a snapshot of all registered metrics
+ *
+ * Histograms show count, p50, p90, p99 and max in microseconds.
+ *
+ * @param[out] buf Output, always NUL-terminated
+ * @param size Size of `buf`
+ * @param format Layout
+ * @return Length of the output, truncated at a metric boundary if `buf` is too small
+ */
+size_t metrics_snapshot(char *buf, size_t size, metrics_format_t format);
+
+/**
+ * @brief Print a text snapshot to the console
+ */
+void metrics_dump(void);
+
+/**
+ * @brief Print a snapshot whenever 'm' is received on the console UART
+ *
+ * Installs the UART driver on the console port and starts a small task
+ * blocked on it, so waiting for input costs nothing.
+ *
+ * @return `ESP_OK` on success
+ */
+esp_err_t metrics_serial_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __METRICS_H__
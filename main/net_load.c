@@ -0,0 +1,63 @@
+/**
+ * @file net_load.c
+ *
+ * Synthetic network load for soak tests.
+ */
+#include "net_load.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include "task_layout.h"
+
+#define NET_LOAD_DATAGRAM       1024
+#define NET_LOAD_PERIOD_MS      10
+
+static const char *TAG = "NET_LOAD";
+
+#if CONFIG_SOAK_NET_LOAD
+static void net_load_task(void *pvParameters)
+{
+    static uint8_t datagram[NET_LOAD_DATAGRAM];
+    struct sockaddr_in sink = { .sin_family = AF_INET, .sin_port = htons(CONFIG_SOAK_NET_LOAD_PORT) };
+    // bytes owed, so low rates still send whole datagrams
+    const uint32_t per_period = CONFIG_SOAK_NET_LOAD_KBPS * 125 * NET_LOAD_PERIOD_MS / 1000;
+    uint32_t credit = 0;
+    int sock = -1;
+
+    inet_pton(AF_INET, CONFIG_SOAK_NET_LOAD_HOST, &sink.sin_addr);
+    TickType_t wake = xTaskGetTickCount();
+    while (1)
+    {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(NET_LOAD_PERIOD_MS));
+        if (sock < 0 && (sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+            continue;
+
+        for (credit += per_period; credit >= NET_LOAD_DATAGRAM; credit -= NET_LOAD_DATAGRAM)
+        {
+            // no address yet or a full queue, drop the backlog
+            if (sendto(sock, datagram, sizeof(datagram), 0, (struct sockaddr *)&sink, sizeof(sink)) < 0)
+            {
+                credit = 0;
+                break;
+            }
+        }
+    }
+}
+#endif
+
+esp_err_t net_load_start(void)
+{
+#if CONFIG_SOAK_NET_LOAD
+    ESP_LOGI(TAG, "%u kbit/s to %s:%u", CONFIG_SOAK_NET_LOAD_KBPS, CONFIG_SOAK_NET_LOAD_HOST,
+             CONFIG_SOAK_NET_LOAD_PORT);
+    return task_layout_create(TASK_NET_LOAD, net_load_task, NULL, NULL);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
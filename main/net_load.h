@@ -0,0 +1,32 @@
+/**
+ * @file net_load.h
+ *
+ * Synthetic network load for soak tests.
+ *
+ * With `CONFIG_SOAK_NET_LOAD` a task streams UDP datagrams at a fixed
+ * bit rate to a sink on the LAN, keeping the Wi-Fi driver and lwIP busy
+ * the way a large upload would. The sink does not need to listen, the
+ * traffic is on the air either way. tools/soak_report.py compares the
+ * sensor metrics of task layouts with and without it.
+ */
+#ifndef __NET_LOAD_H__
+#define __NET_LOAD_H__
+
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start the load task, sending as soon as the station has an address
+ *
+ * @return `ESP_OK` on success, `ESP_ERR_NOT_SUPPORTED` without `CONFIG_SOAK_NET_LOAD`
+ */
+esp_err_t net_load_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __NET_LOAD_H__
@@ -0,0 +1,110 @@
+/**
+ * @file power.c
+ *
+ * Power mode selection and energy accounting.
+ */
+#include "power.h"
+
+#include <stdbool.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_sleep.h"
+#include "esp_pm.h"
+
+// typical ESP32 module currents, microamperes
+#define POWER_CPU_UA        30000   // CPU at 80-160 MHz, radio off
+#define POWER_RADIO_UA      100000  // extra while Wi-Fi is up, averaged over TX/RX
+#define POWER_SLEEP_UA      10      // deep sleep, RTC timer only
+
+static const char *TAG = "POWER";
+
+// survive deep sleep, reset on power-on
+static RTC_DATA_ATTR power_stats_t  rtc_stats;
+
+static bool     radio_up;
+static int64_t  radio_since_ms;
+
+static inline int64_t uptime_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+esp_err_t power_init(void)
+{
+    rtc_stats.wakes++;
+
+#if CONFIG_POWER_MODE_MODEM_SLEEP && CONFIG_PM_ENABLE
+    esp_pm_config_esp32_t pm = {
+        .max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = 40,
+        .light_sleep_enable = true};
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK)
+        return err;
+#endif
+
+    return ESP_OK;
+}
+
+void power_radio_on(void)
+{
+    if (radio_up)
+        return;
+    radio_up = true;
+    radio_since_ms = uptime_ms();
+
+#if CONFIG_POWER_MODE_MODEM_SLEEP
+    esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+#endif
+}
+
+void power_radio_off(void)
+{
+    if (!radio_up)
+        return;
+    radio_up = false;
+    rtc_stats.radio_ms += uptime_ms() - radio_since_ms;
+}
+
+void power_get_stats(power_stats_t *stats)
+{
+    *stats = rtc_stats;
+    stats->awake_ms += uptime_ms();
+    if (radio_up)
+        stats->radio_ms += uptime_ms() - radio_since_ms;
+}
+
+uint32_t power_estimate_mah_per_day(const power_stats_t *stats)
+{
+    uint64_t total_ms = stats->awake_ms + stats->sleep_ms;
+    if (!total_ms)
+        return 0;
+
+    // microampere-milliseconds
+    uint64_t charge = stats->awake_ms * POWER_CPU_UA
+            + stats->radio_ms * POWER_RADIO_UA
+            + stats->sleep_ms * POWER_SLEEP_UA;
+
+    // scale to one day, then uA*ms to mAh
+    return charge * 24 / total_ms / 1000;
+}
+
+void power_deep_sleep(uint32_t sleep_ms)
+{
+    power_radio_off();
+    esp_wifi_stop();
+
+    power_stats_t stats;
+    power_get_stats(&stats);
+    ESP_LOGI(TAG, "Wake %u: %u ms awake, sleeping %u ms, ~%u mAh/day", (unsigned)stats.wakes,
+             (unsigned)uptime_ms(), (unsigned)sleep_ms, (unsigned)power_estimate_mah_per_day(&stats));
+
+    rtc_stats.awake_ms += uptime_ms();
+    rtc_stats.sleep_ms += sleep_ms;
+
+    esp_sleep_enable_timer_wakeup((uint64_t)sleep_ms * 1000);
+    esp_deep_sleep_start();
+}
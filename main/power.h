@@ -0,0 +1,86 @@
+/**
+ * @file power.h
+ *
+ * Power mode selection and energy accounting.
+ *
+ * The mode is chosen with `CONFIG_POWER_MODE_*`:
+ * - always on: the radio stays up, nothing sleeps;
+ * - modem sleep: Wi-Fi power save between beacons and, with
+ *   `CONFIG_PM_ENABLE`, automatic light sleep while all tasks are idle;
+ * - duty cycle: the device deep-sleeps between samples and brings Wi-Fi up
+ *   only to upload a batch, see app_main.c.
+ *
+ * Awake and radio-on time are accumulated in RTC memory, so they survive
+ * deep sleep, and turned into an estimated charge per day using typical
+ * module currents.
+ */
+#ifndef __POWER_H__
+#define __POWER_H__
+
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Energy accounting since power-on
+ */
+typedef struct
+{
+    uint32_t    wakes;          //!< Boots, deep sleep wakeups included
+    uint64_t    awake_ms;       //!< CPU running
+    uint64_t    radio_ms;       //!< Wi-Fi up, part of `awake_ms`
+    uint64_t    sleep_ms;       //!< Deep sleep requested
+} power_stats_t;
+
+/**
+ * @brief Count the boot and apply the power mode
+ *
+ * Call once early in app_main(). In modem sleep mode, call power_radio_on()
+ * after Wi-Fi has started so power save is enabled.
+ *
+ * @return `ESP_OK` on success
+ */
+esp_err_t power_init(void);
+
+/**
+ * @brief Record that Wi-Fi came up
+ */
+void power_radio_on(void);
+
+/**
+ * @brief Record that Wi-Fi went down
+ */
+void power_radio_off(void);
+
+/**
+ * @brief Copy the accounting, the current wake included
+ *
+ * @param[out] stats Accounting
+ */
+void power_get_stats(power_stats_t *stats);
+
+/**
+ * @brief Estimate the average charge drawn per day
+ *
+ * @param stats Accounting from power_get_stats()
+ * @return Milliampere-hours per day, 0 if nothing was accounted yet
+ */
+uint32_t power_estimate_mah_per_day(const power_stats_t *stats);
+
+/**
+ * @brief Stop Wi-Fi and deep-sleep
+ *
+ * Does not return, the device reboots on the timer.
+ *
+ * @param sleep_ms Sleep duration
+ */
+void power_deep_sleep(uint32_t sleep_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __POWER_H__
@@ -0,0 +1,60 @@
+/**
+ * @file report_policy.c
+ *
+ * Decides which samples are worth sending to the Blynk cloud.
+ */
+#include "report_policy.h"
+
+#include <string.h>
+
+void report_policy_init(report_policy_t *policy, uint32_t min_interval_ms, uint32_t max_interval_ms)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->min_interval_ms = min_interval_ms;
+    policy->max_interval_ms = max_interval_ms;
+}
+
+int report_policy_add_channel(report_policy_t *policy, int16_t deadband)
+{
+    if (policy->channel_count >= REPORT_POLICY_MAX_CHANNELS)
+        return -1;
+
+    policy->channels[policy->channel_count].deadband = deadband;
+    return policy->channel_count++;
+}
+
+bool report_policy_check(report_policy_t *policy, const int16_t *values, uint32_t now_ms)
+{
+    uint32_t elapsed = now_ms - policy->last_report_ms;
+    bool changed = !policy->reported;
+    bool heartbeat = false;
+
+    policy->samples++;
+    for (int i = 0; i < policy->channel_count && !changed; i++)
+    {
+        int delta = values[i] - policy->channels[i].last;
+        if (delta < 0)
+            delta = -delta;
+        changed = delta >= policy->channels[i].deadband;
+    }
+
+    if (changed)
+    {
+        if (policy->reported && elapsed < policy->min_interval_ms)
+            return false;
+    }
+    else
+    {
+        if (!policy->max_interval_ms || elapsed < policy->max_interval_ms)
+            return false;
+        heartbeat = true;
+    }
+
+    for (int i = 0; i < policy->channel_count; i++)
+        policy->channels[i].last = values[i];
+    policy->last_report_ms = now_ms;
+    policy->reported = true;
+    policy->reports++;
+    policy->heartbeats += heartbeat;
+    return true;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file report_policy.h
+ *
+ * Decides which samples are worth sending to the Blynk cloud.
+ *
+ * Every channel has a dead-band: a sample is reported when any channel
+ * moved by at least its dead-band since the last report, but never sooner
+ * than the minimum interval after it. If nothing changes, a heartbeat
+ * report is made once the maximum interval has passed so the dashboard
+ * still shows the device as alive. A report always carries all channels,
+ * so changed pins are coalesced into one batch-update request.
+ *
+ * The policy takes the current time as an argument and does not depend
+ * on FreeRTOS, so it can be driven by any clock. The firmware feeds it the
+ * samples taken from the sample slot of the first sensor (see sample.h),
+ * timed by their read.
+ */
+#ifndef __REPORT_POLICY_H__
+#define __REPORT_POLICY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REPORT_POLICY_MAX_CHANNELS  4
+
+typedef struct
+{
+    int16_t     deadband;   // smallest change worth a report
+    int16_t     last;       // value sent with the last report
+} report_channel_t;
+
+/**
+ * Policy state, set up with report_policy_init()
+ */
+typedef struct
+{
+    report_channel_t    channels[REPORT_POLICY_MAX_CHANNELS];
+    int                 channel_count;
+    uint32_t            min_interval_ms;    //!< No report sooner than this after the previous one
+    uint32_t            max_interval_ms;    //!< Heartbeat report after this long without one
+    uint32_t            last_report_ms;
+    bool                reported;           //!< A report was made, `last` values are valid
+    uint32_t            samples;            //!< Samples checked
+    uint32_t            reports;            //!< Samples reported, heartbeats included
+    uint32_t            heartbeats;         //!< Reports made only because of the maximum interval
+} report_policy_t;
+
+/**
+ * @brief Reset the policy and drop all channels
+ *
+ * @param policy Policy
+ * @param min_interval_ms Minimum time between two reports
+ * @param max_interval_ms Maximum time between two reports, 0 to disable heartbeats
+ */
+void report_policy_init(report_policy_t *policy, uint32_t min_interval_ms, uint32_t max_interval_ms);
+
+/**
+ * @brief Add a channel
+ *
+ * @param policy Policy
+ * @param deadband Smallest change reported, in the units of the channel values
+ * @return Channel index, or -1 if all channels are used
+ */
+int report_policy_add_channel(report_policy_t *policy, int16_t deadband);
+
+/**
+ * @brief Check a new sample
+ *
+ * If the sample is to be reported it becomes the reference for the
+ * following dead-band checks.
+ *
+ * @param policy Policy
+ * @param values One value per channel, in the order they were added
+ * @param now_ms Current time
+ * @return true if the sample should be sent
+ */
+bool report_policy_check(report_policy_t *policy, const int16_t *values, uint32_t now_ms);
+
+/**
+ * @brief Report the next sample whatever its value
+ */
+static inline void report_policy_force(report_policy_t *policy)
+{
+    policy->reported = false;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __REPORT_POLICY_H__
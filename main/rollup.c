@@ -0,0 +1,81 @@
+/**
+ * @file rollup.c
+ *
+ * Windowed aggregation of samples into downsampled tiers.
+ */
+#include "rollup.h"
+
+#include <string.h>
+
+static inline int64_t rollup_window_start(int64_t timestamp_ms, uint32_t window_ms)
+{
+    int64_t rem = timestamp_ms % window_ms;
+    return timestamp_ms - (rem < 0 ? rem + window_ms : rem);
+}
+
+static void rollup_close(rollup_t *rollup, int tier, rollup_emit_t emit, void *ctx)
+{
+    rollup_tier_t *t = &rollup->tiers[tier];
+
+    if (emit)
+        emit(tier, t->start_ms, t->acc, ctx);
+    rollup->windows++;
+    memset(t->acc, 0, sizeof(t->acc));
+}
+
+void rollup_init(rollup_t *rollup, int channel_count)
+{
+    memset(rollup, 0, sizeof(*rollup));
+    rollup->channel_count = channel_count < ROLLUP_MAX_CHANNELS ? channel_count : ROLLUP_MAX_CHANNELS;
+}
+
+int rollup_add_tier(rollup_t *rollup, uint32_t window_ms)
+{
+    if (!window_ms || rollup->tier_count >= ROLLUP_MAX_TIERS)
+        return -1;
+
+    memset(&rollup->tiers[rollup->tier_count], 0, sizeof(rollup->tiers[0]));
+    rollup->tiers[rollup->tier_count].window_ms = window_ms;
+    return rollup->tier_count++;
+}
+
+void rollup_add(rollup_t *rollup, int64_t timestamp_ms, const int16_t *values, rollup_emit_t emit, void *ctx)
+{
+    for (int i = 0; i < rollup->tier_count; i++)
+    {
+        rollup_tier_t *t = &rollup->tiers[i];
+        int64_t start = rollup_window_start(timestamp_ms, t->window_ms);
+
+        if (!t->acc[0].count)
+            t->start_ms = start;
+        else if (start > t->start_ms)
+        {
+            rollup_close(rollup, i, emit, ctx);
+            t->start_ms = start;
+        }
+
+        for (int c = 0; c < rollup->channel_count; c++)
+        {
+            rollup_acc_t *acc = &t->acc[c];
+            int16_t v = values[c];
+
+            if (!acc->count || v < acc->min)
+                acc->min = v;
+            if (!acc->count || v > acc->max)
+                acc->max = v;
+            acc->last = v;
+            acc->sum += v;
+            acc->count++;
+        }
+    }
+}
+
+void rollup_close_expired(rollup_t *rollup, int64_t now_ms, rollup_emit_t emit, void *ctx)
+{
+    for (int i = 0; i < rollup->tier_count; i++)
+    {
+        rollup_tier_t *t = &rollup->tiers[i];
+        if (t->acc[0].count && now_ms >= t->start_ms + t->window_ms)
+            rollup_close(rollup, i, emit, ctx);
+    }
+}
@@ -0,0 +1,143 @@
+/**
+ * @file rollup.h
+ *
+ * Windowed aggregation of samples into downsampled tiers.
+ *
+ * Every tier cuts time into fixed windows aligned to multiples of its
+ * length and keeps one accumulator per channel for the open window: count,
+ * sum, min, max and last value, all in the fixed-point units of the
+ * samples. Memory is constant whatever the window length. A window closes
+ * when the first sample past its end arrives, or when
+ * rollup_close_expired() is called after its end, and is then handed to
+ * the emit callback. Empty windows are never emitted.
+ *
+ * The rollup takes the time as an argument and does not depend on FreeRTOS,
+ * so it can be driven by any clock.
+ */
+#ifndef __ROLLUP_H__
+#define __ROLLUP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ROLLUP_MAX_CHANNELS     2
+#define ROLLUP_MAX_TIERS        4
+
+/**
+ * Streaming statistics of one channel over one window
+ */
+typedef struct
+{
+    uint32_t    count;
+    int64_t     sum;
+    int16_t     min;
+    int16_t     max;
+    int16_t     last;
+} rollup_acc_t;
+
+/**
+ * Value sent for a window
+ */
+typedef enum
+{
+    ROLLUP_MEAN = 0,
+    ROLLUP_MIN,
+    ROLLUP_MAX,
+    ROLLUP_LAST,
+} rollup_stat_t;
+
+/**
+ * Open window of a tier
+ */
+typedef struct
+{
+    uint32_t        window_ms;
+    int64_t         start_ms;                       //!< Start of the open window
+    rollup_acc_t    acc[ROLLUP_MAX_CHANNELS];       //!< Empty when `acc[0].count` is 0
+} rollup_tier_t;
+
+/**
+ * Rollup state, set up with rollup_init()
+ */
+typedef struct
+{
+    rollup_tier_t   tiers[ROLLUP_MAX_TIERS];
+    int             tier_count;
+    int             channel_count;
+    uint32_t        windows;                        //!< Windows emitted
+} rollup_t;
+
+/**
+ * @brief Receive a closed window
+ *
+ * @param tier Tier index, 0 for the first one added
+ * @param start_ms Start of the window
+ * @param acc One accumulator per channel
+ */
+typedef void (*rollup_emit_t)(int tier, int64_t start_ms, const rollup_acc_t *acc, void *ctx);
+
+/**
+ * @brief Reset the state and drop all tiers
+ *
+ * @param rollup Rollup
+ * @param channel_count Values per sample, at most `ROLLUP_MAX_CHANNELS`
+ */
+void rollup_init(rollup_t *rollup, int channel_count);
+
+/**
+ * @brief Add a tier
+ *
+ * @param rollup Rollup
+ * @param window_ms Window length, non-zero
+ * @return Tier index, or -1 if all tiers are used
+ */
+int rollup_add_tier(rollup_t *rollup, uint32_t window_ms);
+
+/**
+ * @brief Add a sample to the open window of every tier
+ *
+ * Windows the sample is past are emitted first. Samples must come in time
+ * order, an older one than the open window is counted in it.
+ *
+ * @param rollup Rollup
+ * @param timestamp_ms Time of the sample
+ * @param values One value per channel
+ * @param emit Called for every window closed
+ * @param ctx Passed to `emit`
+ */
+void rollup_add(rollup_t *rollup, int64_t timestamp_ms, const int16_t *values, rollup_emit_t emit, void *ctx);
+
+/**
+ * @brief Emit the windows that ended before `now_ms`, e.g. when samples stopped
+ */
+void rollup_close_expired(rollup_t *rollup, int64_t now_ms, rollup_emit_t emit, void *ctx);
+
+/**
+ * @brief Get a statistic of a window, the mean is rounded to the nearest unit
+ */
+static inline int16_t rollup_stat(const rollup_acc_t *acc, rollup_stat_t stat)
+{
+    switch (stat)
+    {
+    case ROLLUP_MIN:
+        return acc->min;
+    case ROLLUP_MAX:
+        return acc->max;
+    case ROLLUP_LAST:
+        return acc->last;
+    default:
+        if (!acc->count)
+            return 0;
+        return (int16_t)((acc->sum + (acc->sum < 0 ? -(int64_t)acc->count : (int64_t)acc->count) / 2) / acc->count);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __ROLLUP_H__
@@ -0,0 +1,38 @@
+/**
+ * @file sample.c
+ *
+ * Versioned sensor sample handed from the reader task to any number of
+ * consumers without locks.
+ */
+#include "sample.h"
+
+void sample_publish(sample_slot_t *slot, int16_t humidity, int16_t temperature,
+        uint32_t timestamp_ms)
+{
+    unsigned version = atomic_load_explicit(&slot->version, memory_order_relaxed);
+
+    atomic_store_explicit(&slot->version, version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->sample.humidity = humidity;
+    slot->sample.temperature = temperature;
+    slot->sample.timestamp_ms = timestamp_ms;
+    slot->sample.seq = (version >> 1) + 1;
+    slot->sample.valid = true;
+
+    atomic_store_explicit(&slot->version, version + 2, memory_order_release);
+}
+
+bool sample_read(sample_slot_t *slot, sample_t *sample)
+{
+    unsigned version;
+
+    do
+    {
+        version = atomic_load_explicit(&slot->version, memory_order_acquire);
+        *sample = slot->sample;
+        atomic_thread_fence(memory_order_acquire);
+    } while ((version & 1) || version != atomic_load_explicit(&slot->version, memory_order_relaxed));
+
+    return sample->valid;
+}
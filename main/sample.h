@@ -0,0 +1,87 @@
+/**
+ * @file sample.h
+ *
+ * Versioned sensor sample handed from the reader task to any number of
+ * consumers without locks.
+ *
+ * A slot is a seqlock: the single writer makes the version odd, updates
+ * the sample and makes it even again. Readers copy the sample and retry if
+ * the version was odd or changed meanwhile, so they never see a temperature
+ * from one read paired with the humidity of another, and never block the
+ * writer. Every publication carries a sequence number and a timestamp, so a
+ * consumer can tell a fresh sample from one it has already handled.
+ */
+#ifndef __SAMPLE_H__
+#define __SAMPLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One reading
+ */
+typedef struct
+{
+    int16_t     humidity;       //!< Percents * 10
+    int16_t     temperature;    //!< Degrees Celsius * 10
+    uint32_t    timestamp_ms;   //!< Time of the read
+    uint32_t    seq;            //!< Publication number, 0 before the first one
+    bool        valid;          //!< Set by the first publication
+} sample_t;
+
+/**
+ * Shared slot, zero-initialize before use
+ */
+typedef struct
+{
+    atomic_uint version;    //!< Odd while the writer is updating
+    sample_t    sample;
+} sample_slot_t;
+
+/**
+ * @brief Publish a new reading
+ *
+ * Only one task may publish into a slot.
+ *
+ * @param slot Shared slot
+ * @param humidity Percents * 10
+ * @param temperature Degrees Celsius * 10
+ * @param timestamp_ms Time of the read
+ */
+void sample_publish(sample_slot_t *slot, int16_t humidity, int16_t temperature,
+        uint32_t timestamp_ms);
+
+/**
+ * @brief Copy the latest reading
+ *
+ * Never blocks, retries only while a publication is in progress.
+ *
+ * @param slot Shared slot
+ * @param[out] sample Consistent copy
+ * @return `sample->valid`
+ */
+bool sample_read(sample_slot_t *slot, sample_t *sample);
+
+/**
+ * @brief Check whether a newer reading than `seq` has been published
+ *
+ * @param slot Shared slot
+ * @param seq Sequence number of the last handled sample
+ * @return true if a newer sample is available
+ */
+static inline bool sample_is_newer(sample_slot_t *slot, uint32_t seq)
+{
+    // the version advances by 2 per publication, seq by 1
+    return (atomic_load_explicit(&slot->version, memory_order_acquire) >> 1) != seq;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __SAMPLE_H__
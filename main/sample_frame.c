@@ -0,0 +1,157 @@
+/**
+ * @file sample_frame.c
+ *
+ * Compact binary frame carrying a batch of samples.
+ */
+#include "sample_frame.h"
+
+typedef struct
+{
+    uint8_t     *buf;
+    size_t      size;
+    size_t      len;
+    bool        overflow;
+} frame_writer_t;
+
+typedef struct
+{
+    const uint8_t   *buf;
+    size_t          len;
+    size_t          pos;
+    bool            error;
+} frame_reader_t;
+
+static uint16_t frame_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+        for (int i = 0; i < 8; i++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void put_byte(frame_writer_t *w, uint8_t b)
+{
+    if (w->len >= w->size)
+    {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = b;
+}
+
+static void put_varint(frame_writer_t *w, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        put_byte(w, (uint8_t)v | 0x80);
+        v >>= 7;
+    }
+    put_byte(w, (uint8_t)v);
+}
+
+static uint8_t get_byte(frame_reader_t *r)
+{
+    if (r->pos >= r->len)
+    {
+        r->error = true;
+        return 0;
+    }
+    return r->buf[r->pos++];
+}
+
+static uint64_t get_varint(frame_reader_t *r)
+{
+    uint64_t v = 0;
+
+    for (int shift = 0; shift < 64 && !r->error; shift += 7)
+    {
+        uint8_t b = get_byte(r);
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    r->error = true;
+    return 0;
+}
+
+size_t sample_frame_encode(const sample_point_t *points, size_t n, uint8_t flags,
+        uint8_t *buf, size_t size)
+{
+    frame_writer_t w = { .buf = buf, .size = size };
+    int64_t base = n ? points[0].timestamp_ms : 0;
+    int64_t prev_ticks = 0;
+    int16_t prev_temp = 0, prev_hum = 0;
+
+    put_byte(&w, SAMPLE_FRAME_MAGIC);
+    put_byte(&w, flags);
+    put_varint(&w, n);
+    put_varint(&w, zigzag(base));
+
+    for (size_t i = 0; i < n; i++)
+    {
+        // rounded from the first sample, so errors do not accumulate
+        int64_t ticks = (points[i].timestamp_ms - base + SAMPLE_FRAME_TICK_MS / 2) / SAMPLE_FRAME_TICK_MS;
+        put_varint(&w, (uint64_t)(ticks - prev_ticks));
+        put_varint(&w, zigzag((int32_t)points[i].temperature - prev_temp));
+        put_varint(&w, zigzag((int32_t)points[i].humidity - prev_hum));
+        prev_ticks = ticks;
+        prev_temp = points[i].temperature;
+        prev_hum = points[i].humidity;
+    }
+
+    uint16_t crc = w.overflow ? 0 : frame_crc16(buf, w.len);
+    put_byte(&w, crc & 0xFF);
+    put_byte(&w, crc >> 8);
+
+    return w.overflow ? 0 : w.len;
+}
+
+bool sample_frame_decode(const uint8_t *buf, size_t len, sample_point_t *points,
+        size_t max, size_t *n, uint8_t *flags)
+{
+    if (len < 4 || buf[0] != SAMPLE_FRAME_MAGIC)
+        return false;
+    if (frame_crc16(buf, len - 2) != (buf[len - 2] | buf[len - 1] << 8))
+        return false;
+
+    frame_reader_t r = { .buf = buf, .len = len - 2, .pos = 1 };
+    uint8_t frame_flags = get_byte(&r);
+    uint64_t count = get_varint(&r);
+    int64_t base = unzigzag(get_varint(&r));
+    if (r.error || count > max)
+        return false;
+
+    int64_t ticks = 0;
+    int32_t temp = 0, hum = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        ticks += (int64_t)get_varint(&r);
+        temp += (int32_t)unzigzag(get_varint(&r));
+        hum += (int32_t)unzigzag(get_varint(&r));
+        points[i].timestamp_ms = base + ticks * SAMPLE_FRAME_TICK_MS;
+        points[i].temperature = (int16_t)temp;
+        points[i].humidity = (int16_t)hum;
+    }
+    if (r.error || r.pos != r.len)
+        return false;
+
+    *n = count;
+    if (flags)
+        *flags = frame_flags;
+    return true;
+}
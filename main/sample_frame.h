@@ -0,0 +1,89 @@
+/**
+ * @file sample_frame.h
+ *
+ * Compact binary frame carrying a batch of samples.
+ *
+ * A frame replaces the per-pin query strings and JSON bodies with one
+ * binary body holding every channel:
+ *
+ *     magic    1 byte   SAMPLE_FRAME_MAGIC
+ *     flags    1 byte   SAMPLE_FRAME_*
+ *     count    varint   number of samples
+ *     base     zigzag   time of the first sample, milliseconds
+ *     samples  count x { varint dt, zigzag dtemp, zigzag dhum }
+ *     crc      2 bytes  CRC-16/CCITT-FALSE of everything before, little endian
+ *
+ * `dt` is the time since the previous sample in `SAMPLE_FRAME_TICK_MS`
+ * units, 0 for the first one. Values are the difference from the previous
+ * sample, the first one from 0. A slowly changing sample costs 4-5 bytes.
+ *
+ * Encoder and decoder do not depend on ESP-IDF, tools/frame_server.py is a
+ * stand-in receiver implementing the same format.
+ */
+#ifndef __SAMPLE_FRAME_H__
+#define __SAMPLE_FRAME_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_FRAME_MAGIC      0xF1
+#define SAMPLE_FRAME_TICK_MS    SAMPLE_RING_TICK_MS
+
+/**
+ * Timestamps are Unix time. Without it they are relative to the moment the
+ * frame is sent (all <= 0) and the receiver adds its own clock.
+ */
+#define SAMPLE_FRAME_UNIX_TIME  0x01
+
+/**
+ * Samples are rollup windows of tier `n` (1-15) rather than raw readings
+ */
+#define SAMPLE_FRAME_STREAM(n)          ((uint8_t)((n) << 4))
+#define SAMPLE_FRAME_GET_STREAM(flags)  ((flags) >> 4)
+
+/**
+ * Worst-case size of a frame of `n` samples
+ */
+#define SAMPLE_FRAME_MAX_LEN(n) (2 + 5 + 10 + (size_t)(n) * (10 + 3 + 3) + 2)
+
+/**
+ * @brief Encode samples into a frame
+ *
+ * Timestamps are rounded to `SAMPLE_FRAME_TICK_MS` relative to the first one.
+ *
+ * @param points Samples, oldest first
+ * @param n Number of samples
+ * @param flags `SAMPLE_FRAME_*` flags
+ * @param[out] buf Frame
+ * @param size Size of `buf`
+ * @return Frame length, 0 if it does not fit
+ */
+size_t sample_frame_encode(const sample_point_t *points, size_t n, uint8_t flags,
+        uint8_t *buf, size_t size);
+
+/**
+ * @brief Decode a frame
+ *
+ * @param buf Frame
+ * @param len Frame length
+ * @param[out] points Samples
+ * @param max Capacity of `points`
+ * @param[out] n Number of samples
+ * @param[out] flags `SAMPLE_FRAME_*` flags, nullable
+ * @return false if the frame is malformed, fails the CRC or has more than `max` samples
+ */
+bool sample_frame_decode(const uint8_t *buf, size_t len, sample_point_t *points,
+        size_t max, size_t *n, uint8_t *flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __SAMPLE_FRAME_H__
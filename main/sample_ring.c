@@ -0,0 +1,128 @@
+/**
+ * @file sample_ring.c
+ *
+ * Fixed-memory ring buffer of compact sensor samples.
+ */
+#include "sample_ring.h"
+
+#define SAMPLE_RING_MARKER  0xFFFF
+
+static inline int sample_rec_is_marker(const sample_rec_t *rec)
+{
+    return rec->dt == SAMPLE_RING_MARKER;
+}
+
+// ticks since the previous record
+static inline int64_t sample_rec_delta(const sample_rec_t *rec)
+{
+    if (sample_rec_is_marker(rec))
+        return ((uint32_t)(uint16_t)rec->temperature << 16) | (uint16_t)rec->humidity;
+    return rec->dt;
+}
+
+static inline sample_rec_t *sample_ring_at(const sample_ring_t *ring, size_t i)
+{
+    return &ring->buf[(ring->head + i) % ring->capacity];
+}
+
+void sample_ring_init(sample_ring_t *ring, sample_rec_t *buf, size_t capacity)
+{
+    ring->buf = buf;
+    ring->capacity = capacity;
+    ring->dropped = 0;
+    sample_ring_clear(ring);
+}
+
+void sample_ring_drop(sample_ring_t *ring, size_t records)
+{
+    if (records > ring->count)
+        records = ring->count;
+
+    while (records--)
+    {
+        sample_rec_t *oldest = sample_ring_at(ring, 0);
+        if (!sample_rec_is_marker(oldest))
+            ring->points--;
+
+        ring->head = (ring->head + 1) % ring->capacity;
+        ring->count--;
+        if (ring->count)
+            ring->first_ticks += sample_rec_delta(sample_ring_at(ring, 0));
+    }
+}
+
+void sample_ring_drop_until(sample_ring_t *ring, int64_t timestamp_ms)
+{
+    int64_t ticks = timestamp_ms / SAMPLE_RING_TICK_MS;
+
+    // a marker carries the time of the sample after it, so both go together
+    while (ring->count && ring->first_ticks <= ticks)
+        sample_ring_drop(ring, 1);
+}
+
+void sample_ring_push(sample_ring_t *ring, int64_t timestamp_ms, int16_t temperature, int16_t humidity)
+{
+    int64_t ticks = timestamp_ms / SAMPLE_RING_TICK_MS;
+    int64_t delta = ring->count ? ticks - ring->last_ticks : 0;
+
+    if (delta < 0)
+        delta = 0;
+    if (delta > UINT32_MAX)
+        delta = UINT32_MAX;
+
+    size_t needed = delta >= SAMPLE_RING_MARKER ? 2 : 1;
+    while (ring->capacity - ring->count < needed)
+    {
+        // drop through the oldest sample so no marker is left dangling
+        size_t before = ring->points;
+        while (ring->count && ring->points == before)
+            sample_ring_drop(ring, 1);
+        ring->dropped++;
+    }
+    if (!ring->count)
+    {
+        ring->first_ticks = ticks;
+        delta = 0;
+        needed = 1;
+    }
+
+    if (needed == 2)
+    {
+        sample_rec_t *marker = sample_ring_at(ring, ring->count++);
+        marker->dt = SAMPLE_RING_MARKER;
+        marker->temperature = (int16_t)(delta >> 16);
+        marker->humidity = (int16_t)(delta & 0xFFFF);
+        delta = 0;
+    }
+
+    sample_rec_t *rec = sample_ring_at(ring, ring->count++);
+    rec->dt = delta;
+    rec->temperature = temperature;
+    rec->humidity = humidity;
+
+    ring->points++;
+    ring->last_ticks = ticks;
+}
+
+size_t sample_ring_peek(const sample_ring_t *ring, sample_point_t *out, size_t max, size_t *records)
+{
+    int64_t ticks = ring->first_ticks;
+    size_t n = 0, i;
+
+    *records = 0;
+    for (i = 0; i < ring->count && n < max; i++)
+    {
+        const sample_rec_t *rec = sample_ring_at(ring, i);
+        if (i)
+            ticks += sample_rec_delta(rec);
+        if (sample_rec_is_marker(rec))
+            continue;
+
+        out[n].timestamp_ms = ticks * SAMPLE_RING_TICK_MS;
+        out[n].temperature = rec->temperature;
+        out[n].humidity = rec->humidity;
+        n++;
+        *records = i + 1;
+    }
+    return n;
+}
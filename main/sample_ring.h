@@ -0,0 +1,121 @@
+/**
+ * @file sample_ring.h
+ *
+ * Fixed-memory ring buffer of compact sensor samples.
+ *
+ * Every record is 6 bytes: scaled int16 temperature and humidity plus the
+ * time since the previous record in `SAMPLE_RING_TICK_MS` units. A gap too
+ * long for 16 bits is stored as an extra marker record. When the ring is
+ * full the oldest samples are dropped.
+ *
+ * The ring is not thread safe and does not depend on FreeRTOS.
+ */
+#ifndef __SAMPLE_RING_H__
+#define __SAMPLE_RING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_RING_TICK_MS     100
+
+/**
+ * Stored record
+ */
+typedef struct
+{
+    uint16_t    dt;             //!< Ticks since the previous record, 0xFFFF for a gap marker
+    int16_t     temperature;    //!< Degrees Celsius * 10, high half of the gap for a marker
+    int16_t     humidity;       //!< Percents * 10, low half of the gap for a marker
+} sample_rec_t;
+
+/**
+ * Decoded sample
+ */
+typedef struct
+{
+    int64_t     timestamp_ms;   //!< Same clock as passed to sample_ring_push(), tick resolution
+    int16_t     temperature;    //!< Degrees Celsius * 10
+    int16_t     humidity;       //!< Percents * 10
+} sample_point_t;
+
+/**
+ * Ring state
+ */
+typedef struct
+{
+    sample_rec_t    *buf;
+    size_t          capacity;
+    size_t          head;           //!< Index of the oldest record
+    size_t          count;          //!< Records in use, markers included
+    size_t          points;         //!< Samples in use
+    int64_t         first_ticks;    //!< Time of the oldest record
+    int64_t         last_ticks;     //!< Time of the newest record
+    uint32_t        dropped;        //!< Samples overwritten because the ring was full
+} sample_ring_t;
+
+/**
+ * @brief Initialize a ring over caller-provided storage
+ *
+ * @param ring Ring
+ * @param buf Record storage
+ * @param capacity Number of records in `buf`, at least 2
+ */
+void sample_ring_init(sample_ring_t *ring, sample_rec_t *buf, size_t capacity);
+
+/**
+ * @brief Append a sample, dropping the oldest ones if the ring is full
+ *
+ * @param ring Ring
+ * @param timestamp_ms Time of the sample, not older than the previous one
+ * @param temperature Degrees Celsius * 10
+ * @param humidity Percents * 10
+ */
+void sample_ring_push(sample_ring_t *ring, int64_t timestamp_ms, int16_t temperature, int16_t humidity);
+
+/**
+ * @brief Decode the oldest samples without removing them
+ *
+ * @param ring Ring
+ * @param[out] out Decoded samples, oldest first
+ * @param max Size of `out`
+ * @param[out] records Records to pass to sample_ring_drop() to remove exactly these samples
+ * @return Number of samples in `out`
+ */
+size_t sample_ring_peek(const sample_ring_t *ring, sample_point_t *out, size_t max, size_t *records);
+
+/**
+ * @brief Remove the oldest records
+ *
+ * @param ring Ring
+ * @param records Number of records, as returned by sample_ring_peek()
+ */
+void sample_ring_drop(sample_ring_t *ring, size_t records);
+
+/**
+ * @brief Remove the oldest samples up to and including a timestamp
+ *
+ * Unlike sample_ring_drop() this stays correct if samples were pushed, and
+ * old ones overwritten, since the matching sample_ring_peek().
+ *
+ * @param ring Ring
+ * @param timestamp_ms Timestamp of the newest sample to remove
+ */
+void sample_ring_drop_until(sample_ring_t *ring, int64_t timestamp_ms);
+
+/**
+ * @brief Remove everything
+ */
+static inline void sample_ring_clear(sample_ring_t *ring)
+{
+    ring->head = ring->count = ring->points = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __SAMPLE_RING_H__
@@ -0,0 +1,101 @@
+/**
+ * @file sensor_sched.c
+ *
+ * Registry and scheduler for several sensors read from one task.
+ */
+#include "sensor_sched.h"
+
+#include <string.h>
+
+// wrap-safe "a is before b" on a 32 bit millisecond clock
+static inline bool time_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+int sensor_sched_add(sensor_sched_t *sched, uint32_t interval_ms,
+        uint32_t min_interval_ms, void *user, uint32_t now_ms)
+{
+    if (sched->count >= SENSOR_SCHED_MAX)
+        return -1;
+
+    // a zeroed busy_until_ms is a time like any other, ahead of a clock
+    // about to wrap
+    if (!sched->count)
+        sched->busy_until_ms = now_ms;
+    int id = sched->count++;
+    sensor_sched_entry_t *e = &sched->entries[id];
+
+    memset(e, 0, sizeof(*e));
+    e->interval_ms = interval_ms > min_interval_ms ? interval_ms : min_interval_ms;
+    e->min_interval_ms = min_interval_ms;
+    e->next_due_ms = now_ms + id * SENSOR_SCHED_GAP_MS;
+    e->user = user;
+
+    return id;
+}
+
+uint32_t sensor_sched_next(sensor_sched_t *sched, uint32_t now_ms, int *id)
+{
+    int best = -1;
+
+    *id = -1;
+    for (int i = 0; i < sched->count; i++)
+        if (best < 0 || time_before(sched->entries[i].next_due_ms, sched->entries[best].next_due_ms))
+            best = i;
+    if (best < 0)
+        return UINT32_MAX;
+
+    uint32_t due = sched->entries[best].next_due_ms;
+    if (time_before(due, sched->busy_until_ms))
+        due = sched->busy_until_ms;
+    if (time_before(now_ms, due))
+        return due - now_ms;
+
+    sensor_sched_entry_t *e = &sched->entries[best];
+    e->last_start_ms = now_ms;
+    e->started = true;
+    sched->busy_until_ms = now_ms + SENSOR_SCHED_GAP_MS;
+    sched->reads++;
+    *id = best;
+
+    return 0;
+}
+
+void sensor_sched_done(sensor_sched_t *sched, int id, bool ok,
+        int16_t humidity, int16_t temperature, uint32_t now_ms)
+{
+    if (id < 0 || id >= sched->count)
+        return;
+
+    sensor_sched_entry_t *e = &sched->entries[id];
+
+    // keep the grid of the requested interval, the slots missed by a stall
+    // are skipped rather than read back to back
+    e->next_due_ms += e->interval_ms;
+    if (time_before(e->next_due_ms, now_ms))
+    {
+        uint32_t late = now_ms - e->next_due_ms;
+        e->next_due_ms = e->interval_ms ? e->next_due_ms + (late / e->interval_ms + 1) * e->interval_ms : now_ms;
+    }
+    if (e->started && time_before(e->next_due_ms, e->last_start_ms + e->min_interval_ms))
+        e->next_due_ms = e->last_start_ms + e->min_interval_ms;
+
+    if (ok)
+    {
+        sample_publish(&e->latest, humidity, temperature, now_ms);
+        atomic_store_explicit(&e->failures, 0, memory_order_relaxed);
+    }
+    else
+    {
+        atomic_fetch_add_explicit(&e->failures, 1, memory_order_relaxed);
+    }
+}
+
+sample_slot_t *sensor_sched_latest(sensor_sched_t *sched, int id)
+{
+    if (id < 0 || id >= sched->count)
+        return NULL;
+
+    return &sched->entries[id].latest;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file sensor_sched.h
+ *
+ * Registry and scheduler for several sensors read from one task.
+ *
+ * Every sensor is registered with its read interval and the minimum
+ * sampling interval of its type. The scheduler hands out one sensor at a
+ * time, keeps `SENSOR_SCHED_GAP_MS` between consecutive start pulses so
+ * captures never overlap, and never reads a sensor faster than its type
+ * allows. Results are published into per-sensor sample slots.
+ *
+ * The scheduler takes the current time as an argument and does not depend
+ * on FreeRTOS, so it can be driven by any clock.
+ */
+#ifndef __SENSOR_SCHED_H__
+#define __SENSOR_SCHED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_SCHED_MAX        16
+
+/**
+ * Time reserved for one read: 20 ms start pulse plus ~5 ms transfer
+ */
+#define SENSOR_SCHED_GAP_MS     30
+
+typedef struct
+{
+    uint32_t            interval_ms;
+    uint32_t            min_interval_ms;
+    uint32_t            next_due_ms;
+    uint32_t            last_start_ms;
+    bool                started;
+    void                *user;
+    atomic_uint         failures;   // consecutive failed reads
+    sample_slot_t       latest;     // last successful read
+} sensor_sched_entry_t;
+
+/**
+ * Scheduler state, zero-initialize before use
+ */
+typedef struct
+{
+    sensor_sched_entry_t    entries[SENSOR_SCHED_MAX];
+    int                     count;
+    uint32_t                busy_until_ms;  //!< No start pulse before this time
+    uint32_t                reads;          //!< Reads handed out
+} sensor_sched_t;
+
+/**
+ * @brief Register a sensor
+ *
+ * First reads of the registered sensors are staggered by `SENSOR_SCHED_GAP_MS`.
+ *
+ * @param sched Scheduler
+ * @param interval_ms Requested read interval
+ * @param min_interval_ms Minimum sampling interval of the sensor type
+ * @param user Opaque pointer returned by sensor_sched_user()
+ * @param now_ms Current time
+ * @return Sensor id, or -1 if the registry is full
+ */
+int sensor_sched_add(sensor_sched_t *sched, uint32_t interval_ms,
+        uint32_t min_interval_ms, void *user, uint32_t now_ms);
+
+/**
+ * @brief Pick the next sensor to read
+ *
+ * @param sched Scheduler
+ * @param now_ms Current time
+ * @param[out] id Sensor to read now, or -1 if none is due
+ * @return Milliseconds until the next sensor is due, 0 if `id` is due now
+ */
+uint32_t sensor_sched_next(sensor_sched_t *sched, uint32_t now_ms, int *id);
+
+/**
+ * @brief Record the end of a read and publish its result
+ *
+ * @param sched Scheduler
+ * @param id Sensor id returned by sensor_sched_next()
+ * @param ok Read succeeded, `humidity` and `temperature` are valid
+ * @param humidity Percents * 10
+ * @param temperature Degrees Celsius * 10
+ * @param now_ms Current time
+ */
+void sensor_sched_done(sensor_sched_t *sched, int id, bool ok,
+        int16_t humidity, int16_t temperature, uint32_t now_ms);
+
+/**
+ * @brief Get the latest-sample slot of a sensor
+ *
+ * Consumers read it with sample_read() without blocking the scheduler task.
+ *
+ * @param sched Scheduler
+ * @param id Sensor id
+ * @return Slot, or NULL if `id` is not registered
+ */
+sample_slot_t *sensor_sched_latest(sensor_sched_t *sched, int id);
+
+/**
+ * @brief Get the number of consecutive failed reads of a sensor
+ */
+static inline uint32_t sensor_sched_failures(sensor_sched_t *sched, int id)
+{
+    return atomic_load_explicit(&sched->entries[id].failures, memory_order_relaxed);
+}
+
+/**
+ * @brief Get the opaque pointer of a sensor
+ */
+static inline void *sensor_sched_user(const sensor_sched_t *sched, int id)
+{
+    return sched->entries[id].user;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __SENSOR_SCHED_H__
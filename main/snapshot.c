@@ -0,0 +1,98 @@
+/**
+ * @file snapshot.c
+ *
+ * Preformatted response bodies shared between one writer and readers.
+ */
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void snapshot_init(snapshot_t *snap, char *buf, size_t slot_size, uint32_t seed)
+{
+    memset(snap, 0, sizeof(*snap));
+    snap->buf = buf;
+    snap->slot_size = slot_size;
+    snap->current = snap->writing = snap->reading = -1;
+    snap->next_version = seed;
+}
+
+char *snapshot_write_begin(snapshot_t *snap, size_t *size)
+{
+    int slot = 0;
+
+    while (slot == snap->current || slot == snap->reading)
+        slot++;
+    snap->writing = slot;
+    *size = snap->slot_size;
+    return snap->buf + slot * snap->slot_size;
+}
+
+void snapshot_write_commit(snapshot_t *snap, size_t len)
+{
+    int slot = snap->writing;
+
+    if (slot < 0)
+        return;
+    snap->len[slot] = len < snap->slot_size ? len : snap->slot_size;
+    snap->version[slot] = snap->next_version++;
+    snap->current = slot;
+    snap->writing = -1;
+}
+
+bool snapshot_read_begin(snapshot_t *snap, const char **data, size_t *len, uint32_t *version)
+{
+    if (snap->current < 0 || snap->reading >= 0)
+        return false;
+
+    snap->reading = snap->current;
+    *data = snap->buf + snap->reading * snap->slot_size;
+    *len = snap->len[snap->reading];
+    *version = snap->version[snap->reading];
+    return true;
+}
+
+bool snapshot_version(const snapshot_t *snap, uint32_t *version)
+{
+    if (snap->current < 0)
+        return false;
+    *version = snap->version[snap->current];
+    return true;
+}
+
+void snapshot_etag(uint32_t version, char etag[SNAPSHOT_ETAG_LEN])
+{
+    snprintf(etag, SNAPSHOT_ETAG_LEN, "\"%08x\"", (unsigned)version);
+}
+
+bool snapshot_etag_match(const char *if_none_match, uint32_t version)
+{
+    char etag[SNAPSHOT_ETAG_LEN];
+    const char *p = if_none_match;
+
+    if (!p)
+        return false;
+    snapshot_etag(version, etag);
+
+    // comma-separated list, If-None-Match compares weakly so W/ is ignored
+    while (*p)
+    {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        if (*p == '*')
+            return true;
+        if (p[0] == 'W' && p[1] == '/')
+            p += 2;
+
+        const char *end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        while (n && (p[n - 1] == ' ' || p[n - 1] == '\t'))
+            n--;
+        if (n == SNAPSHOT_ETAG_LEN - 1 && !memcmp(p, etag, n))
+            return true;
+        if (!end)
+            break;
+        p = end;
+    }
+    return false;
+}
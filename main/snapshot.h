@@ -0,0 +1,125 @@
+/**
+ * @file snapshot.h
+ *
+ * Preformatted response bodies shared between one writer and readers.
+ *
+ * The writer formats a new version straight into a free slot and publishes
+ * it, a reader borrows the current slot and sends it as is, so serving a
+ * request copies nothing. With three slots the writer always finds one that
+ * is neither current nor borrowed, as long as at most one reader holds a
+ * slot at a time (the HTTP server runs handlers on a single task).
+ *
+ * Every version gets an entity tag for If-None-Match, seeded at init so
+ * tags do not repeat across reboots.
+ *
+ * The snapshot is not thread safe and does not depend on FreeRTOS, the
+ * caller serializes the calls with a lock held only for their duration.
+ */
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNAPSHOT_SLOTS      3
+#define SNAPSHOT_ETAG_LEN   11      //!< Quoted 8 hex digits and NUL
+
+/**
+ * Snapshot state, set up with snapshot_init()
+ */
+typedef struct
+{
+    char        *buf;                       //!< `SNAPSHOT_SLOTS` slots of `slot_size` bytes
+    size_t      slot_size;
+    size_t      len[SNAPSHOT_SLOTS];
+    uint32_t    version[SNAPSHOT_SLOTS];
+    int         current;                    //!< Published slot, -1 before the first one
+    int         writing;                    //!< Slot being formatted, -1 if none
+    int         reading;                    //!< Slot borrowed by a reader, -1 if none
+    uint32_t    next_version;
+} snapshot_t;
+
+/**
+ * @brief Initialize a snapshot over caller-provided storage
+ *
+ * @param snap Snapshot
+ * @param buf Storage of `SNAPSHOT_SLOTS * slot_size` bytes
+ * @param slot_size Largest body
+ * @param seed First version, e.g. random
+ */
+void snapshot_init(snapshot_t *snap, char *buf, size_t slot_size, uint32_t seed);
+
+/**
+ * @brief Get a free slot to format the next version into
+ *
+ * The slot is not visible to readers until snapshot_write_commit(), so it
+ * can be formatted without the lock.
+ *
+ * @param snap Snapshot
+ * @param[out] size Slot size
+ * @return Slot buffer
+ */
+char *snapshot_write_begin(snapshot_t *snap, size_t *size);
+
+/**
+ * @brief Publish the slot returned by snapshot_write_begin()
+ *
+ * @param len Body length, at most the slot size
+ */
+void snapshot_write_commit(snapshot_t *snap, size_t len);
+
+/**
+ * @brief Borrow the current version until snapshot_read_end()
+ *
+ * @param snap Snapshot
+ * @param[out] data Body
+ * @param[out] len Body length
+ * @param[out] version Version, for snapshot_etag()
+ * @return false if nothing was published yet or a slot is already borrowed
+ */
+bool snapshot_read_begin(snapshot_t *snap, const char **data, size_t *len, uint32_t *version);
+
+/**
+ * @brief Return the borrowed slot
+ */
+static inline void snapshot_read_end(snapshot_t *snap)
+{
+    snap->reading = -1;
+}
+
+/**
+ * @brief Get the version of the current body, without borrowing it
+ *
+ * @return false if nothing was published yet
+ */
+bool snapshot_version(const snapshot_t *snap, uint32_t *version);
+
+/**
+ * @brief Format the entity tag of a version, quotes included
+ *
+ * @param version Version
+ * @param[out] etag At least `SNAPSHOT_ETAG_LEN` bytes
+ */
+void snapshot_etag(uint32_t version, char etag[SNAPSHOT_ETAG_LEN]);
+
+/**
+ * @brief Check an If-None-Match header against a version
+ *
+ * Accepts a list of strong or weak tags, or "*".
+ *
+ * @param if_none_match Header value, nullable
+ * @param version Current version
+ * @return true if the client already has this version
+ */
+bool snapshot_etag_match(const char *if_none_match, uint32_t version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __SNAPSHOT_H__
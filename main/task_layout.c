@@ -0,0 +1,102 @@
+/**
+ * @file task_layout.c
+ *
+ * Core, priority and stack of every task the application creates.
+ */
+#include "task_layout.h"
+
+#include "esp_log.h"
+
+#if CONFIG_FREERTOS_UNICORE
+#define TASK_CORE(core)     tskNO_AFFINITY
+#else
+#define TASK_CORE(core)     ((core) < 0 ? tskNO_AFFINITY : (BaseType_t)(core))
+#endif
+
+static const char *TAG = "TASK_LAYOUT";
+
+#if CONFIG_MEMORY_STATIC
+// named per task so the RAM report can attribute them, httpd allocates its own
+static StackType_t          stack_sensor[CONFIG_TASK_SENSOR_STACK];
+static StackType_t          stack_loop[CONFIG_TASK_LOOP_STACK];
+static StackType_t          stack_ctrl[CONFIG_TASK_CTRL_STACK];
+#if CONFIG_METRICS_SERIAL
+static StackType_t          stack_metrics[CONFIG_TASK_METRICS_STACK];
+#else
+#define stack_metrics       NULL
+#endif
+#if CONFIG_SOAK_NET_LOAD
+static StackType_t          stack_net_load[3072];
+#else
+#define stack_net_load      NULL
+#endif
+static StackType_t *const   stacks[TASK_COUNT] = {
+    [TASK_SENSOR]   = stack_sensor,
+    [TASK_LOOP]     = stack_loop,
+    [TASK_CTRL]     = stack_ctrl,
+    [TASK_METRICS]  = stack_metrics,
+    [TASK_NET_LOAD] = stack_net_load,
+};
+static StaticTask_t         tcbs[TASK_COUNT];
+static bool                 used[TASK_COUNT];
+#endif
+
+static const task_layout_t layouts[TASK_COUNT] = {
+    [TASK_SENSOR]   = { "sensor_async", CONFIG_TASK_SENSOR_STACK, CONFIG_TASK_SENSOR_PRIO, TASK_CORE(CONFIG_TASK_SENSOR_CORE) },
+    [TASK_LOOP]     = { "main_loop", CONFIG_TASK_LOOP_STACK, CONFIG_TASK_LOOP_PRIO, TASK_CORE(CONFIG_TASK_LOOP_CORE) },
+    [TASK_CTRL]     = { "ctrl_channel", CONFIG_TASK_CTRL_STACK, CONFIG_TASK_CTRL_PRIO, TASK_CORE(CONFIG_TASK_CTRL_CORE) },
+    [TASK_METRICS]  = { "metrics_uart", CONFIG_TASK_METRICS_STACK, CONFIG_TASK_METRICS_PRIO, TASK_CORE(CONFIG_TASK_METRICS_CORE) },
+    [TASK_HTTPD]    = { "httpd", CONFIG_TASK_HTTPD_STACK, CONFIG_TASK_HTTPD_PRIO, TASK_CORE(CONFIG_TASK_HTTPD_CORE) },
+    [TASK_NET_LOAD] = { "net_load", 3072, 1, TASK_CORE(0) },
+};
+
+const task_layout_t *task_layout_get(task_id_t id)
+{
+    return id < TASK_COUNT ? &layouts[id] : NULL;
+}
+
+bool task_layout_static(task_id_t id, StackType_t **stack, StaticTask_t **tcb)
+{
+#if CONFIG_MEMORY_STATIC
+    // a stack serves a single task for the life of the application
+    if (id >= TASK_COUNT || !stacks[id] || used[id])
+        return false;
+    used[id] = true;
+    *stack = stacks[id];
+    *tcb = &tcbs[id];
+    return true;
+#else
+    return false;
+#endif
+}
+
+esp_err_t task_layout_create(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+    const task_layout_t *l = task_layout_get(id);
+    StackType_t *stack;
+    StaticTask_t *tcb;
+    TaskHandle_t task;
+
+    if (!l || !fn)
+        return ESP_ERR_INVALID_ARG;
+
+    if (task_layout_static(id, &stack, &tcb))
+        task = xTaskCreateStaticPinnedToCore(fn, l->name, l->stack, arg, l->priority, stack, tcb, l->core);
+    else if (xTaskCreatePinnedToCore(fn, l->name, l->stack, arg, l->priority, &task, l->core) != pdPASS)
+        task = NULL;
+    if (!task)
+        return ESP_ERR_NO_MEM;
+    if (handle)
+        *handle = task;
+    return ESP_OK;
+}
+
+void task_layout_log(void)
+{
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        const task_layout_t *l = &layouts[i];
+        ESP_LOGI(TAG, "%s core=%d prio=%u stack=%u", l->name, l->core == tskNO_AFFINITY ? -1 : (int)l->core,
+                 (unsigned)l->priority, (unsigned)l->stack);
+    }
+}
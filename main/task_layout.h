@@ -0,0 +1,91 @@
+/**
+ * @file task_layout.h
+ *
+ * Core, priority and stack of every task the application creates.
+ *
+ * The placement comes from the "Task Layout" menu. The defaults keep the
+ * timing-critical sensor capture alone on the APP CPU, while everything
+ * talking to the network shares the PRO CPU with the Wi-Fi driver and
+ * lwIP, so a burst of traffic cannot delay a read. A core of -1 lets the
+ * scheduler run the task on either core. On single-core builds every task
+ * runs unpinned.
+ *
+ * With `CONFIG_MEMORY_STATIC` stacks and control blocks are static arrays
+ * sized by the same options, so they show up in the link map and the RAM
+ * report instead of the heap.
+ */
+#ifndef __TASK_LAYOUT_H__
+#define __TASK_LAYOUT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Subsystems owning a task
+ */
+typedef enum
+{
+    TASK_SENSOR = 0,    //!< Sensor reader, sensor_async worker
+    TASK_LOOP,          //!< Event loop: results, uploads, periodic jobs
+    TASK_CTRL,          //!< Blynk control channel
+    TASK_METRICS,       //!< Console metrics
+    TASK_HTTPD,         //!< LAN HTTP server
+    TASK_NET_LOAD,      //!< Synthetic network load for soak tests
+    TASK_COUNT,
+} task_id_t;
+
+/**
+ * Placement of a task
+ */
+typedef struct
+{
+    const char  *name;          //!< Task name, as in metrics snapshots
+    uint32_t    stack;          //!< Stack size, bytes
+    UBaseType_t priority;
+    BaseType_t  core;           //!< Core id or `tskNO_AFFINITY`
+} task_layout_t;
+
+/**
+ * @brief Get the placement of a subsystem
+ */
+const task_layout_t *task_layout_get(task_id_t id);
+
+/**
+ * @brief Create the task of a subsystem with its placement
+ *
+ * @param id Subsystem
+ * @param fn Task function
+ * @param arg Passed to `fn`
+ * @param[out] handle Task handle, nullable
+ * @return `ESP_OK` on success, `ESP_ERR_NO_MEM` if the task could not be created
+ */
+esp_err_t task_layout_create(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+
+/**
+ * @brief Get the static stack of a subsystem whose task is created elsewhere
+ *
+ * @param id Subsystem
+ * @param[out] stack Stack of `task_layout_get(id)->stack` bytes
+ * @param[out] tcb Task control block
+ * @return false if the task is to be allocated on the heap
+ */
+bool task_layout_static(task_id_t id, StackType_t **stack, StaticTask_t **tcb);
+
+/**
+ * @brief Log the placement of every subsystem, read back by tools/soak_report.py
+ */
+void task_layout_log(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __TASK_LAYOUT_H__
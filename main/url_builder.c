@@ -0,0 +1,86 @@
+/**
+ * @file url_builder.c
+ *
+ * Single-pass, bounds-checked builder for request URLs and bodies.
+ */
+#include "url_builder.h"
+
+#include <string.h>
+
+void url_append(url_builder_t *b, const char *s, size_t n)
+{
+    // keep room for the terminating NUL
+    if (b->overflow || n >= b->size - b->len)
+    {
+        b->overflow = true;
+        return;
+    }
+    memcpy(b->buf + b->len, s, n);
+    b->len += n;
+}
+
+void url_append_str(url_builder_t *b, const char *s)
+{
+    url_append(b, s, strlen(s));
+}
+
+void url_append_int(url_builder_t *b, int64_t value)
+{
+    char digits[21];
+    char *p = digits + sizeof(digits);
+    uint64_t v = value < 0 ? -(uint64_t)value : (uint64_t)value;
+
+    do
+    {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (value < 0)
+        *--p = '-';
+
+    url_append(b, p, digits + sizeof(digits) - p);
+}
+
+void url_append_fixed1(url_builder_t *b, int32_t value)
+{
+    char digits[14];
+    char *p = digits + sizeof(digits);
+    uint32_t v = value < 0 ? -(uint32_t)value : (uint32_t)value;
+
+    *--p = '0' + v % 10;
+    *--p = '.';
+    v /= 10;
+    do
+    {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (value < 0)
+        *--p = '-';
+
+    url_append(b, p, digits + sizeof(digits) - p);
+}
+
+void url_append_param_fixed1(url_builder_t *b, const char *key, int32_t value)
+{
+    url_append(b, "&", 1);
+    url_append_str(b, key);
+    url_append(b, "=", 1);
+    url_append_fixed1(b, value);
+}
+
+void url_append_param(url_builder_t *b, const char *key, const char *value)
+{
+    url_append(b, "&", 1);
+    url_append_str(b, key);
+    url_append(b, "=", 1);
+    url_append_str(b, value);
+}
+
+const char *url_finish(url_builder_t *b)
+{
+    if (b->overflow)
+        return NULL;
+    b->buf[b->len] = 0;
+    return b->buf;
+}
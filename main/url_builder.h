@@ -0,0 +1,127 @@
+/**
+ * @file url_builder.h
+ *
+ * Single-pass, bounds-checked builder for request URLs and bodies.
+ *
+ * The builder writes into a caller-supplied buffer and tracks its length,
+ * so every append is O(length of the appended part) and no intermediate
+ * copies or heap allocations are made. Values are formatted without
+ * sprintf. Once the buffer is full further appends are ignored and
+ * url_finish() reports the overflow.
+ *
+ * A constant prefix such as "http://host:port/external/api/get?token=..."
+ * is stored with its length in a url_prefix_t, so every request copies it
+ * with a single memcpy() instead of rescanning it.
+ */
+#ifndef __URL_BUILDER_H__
+#define __URL_BUILDER_H__
+
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Builder state
+ */
+typedef struct
+{
+    char    *buf;
+    size_t  size;
+    size_t  len;
+    bool    overflow;
+} url_builder_t;
+
+/**
+ * Preformatted constant prefix
+ */
+typedef struct
+{
+    const char  *str;
+    size_t      len;
+} url_prefix_t;
+
+/**
+ * @brief Start building into `buf`
+ */
+static inline void url_init(url_builder_t *b, char *buf, size_t size)
+{
+    b->buf = buf;
+    b->size = size;
+    b->len = 0;
+    b->overflow = size == 0;
+    if (size)
+        buf[0] = 0;
+}
+
+/**
+ * @brief Append `n` bytes
+ */
+void url_append(url_builder_t *b, const char *s, size_t n);
+
+/**
+ * @brief Append a NUL-terminated string
+ */
+void url_append_str(url_builder_t *b, const char *s);
+
+/**
+ * @brief Append a decimal integer
+ */
+void url_append_int(url_builder_t *b, int64_t value);
+
+/**
+ * @brief Append a value scaled by 10 with one decimal, e.g. -123 as "-12.3"
+ */
+void url_append_fixed1(url_builder_t *b, int32_t value);
+
+/**
+ * @brief Append "&key=" followed by a scaled value, see url_append_fixed1()
+ */
+void url_append_param_fixed1(url_builder_t *b, const char *key, int32_t value);
+
+/**
+ * @brief Append "&key=value"
+ */
+void url_append_param(url_builder_t *b, const char *key, const char *value);
+
+/**
+ * @brief Append a preformatted prefix
+ */
+static inline void url_append_prefix(url_builder_t *b, const url_prefix_t *prefix)
+{
+    url_append(b, prefix->str, prefix->len);
+}
+
+/**
+ * @brief NUL-terminate the result
+ *
+ * @return The built string, or NULL if it did not fit
+ */
+const char *url_finish(url_builder_t *b);
+
+/**
+ * @brief Initializer of a prefix from a string literal, the length is computed at compile time
+ */
+#define URL_PREFIX(literal)     { .str = (literal), .len = sizeof(literal) - 1 }
+
+/**
+ * @brief Set a prefix from a string computed at run time
+ *
+ * @param prefix Prefix to set up
+ * @param str Prefix text, must stay valid
+ */
+static inline void url_prefix_set(url_prefix_t *prefix, const char *str)
+{
+    prefix->str = str;
+    prefix->len = strlen(str);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __URL_BUILDER_H__
@@ -0,0 +1,294 @@
+/**
+ * @file wifi_conn.c
+ *
+ * Wi-Fi station connectivity manager.
+ */
+#include "wifi_conn.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+
+#include "power.h"
+
+#define WIFI_CONN_NVS_NAMESPACE     "wifi_conn"
+#define WIFI_CONN_NVS_KEY           "cache"
+
+#define WIFI_CONNECTED_BIT          BIT0
+
+static const char *TAG = "WIFI_CONN";
+
+/* Association and lease of the last successful connection */
+typedef struct
+{
+    uint8_t                 bssid[6];
+    uint8_t                 channel;
+    esp_netif_ip_info_t     ip;
+    esp_netif_dns_info_t    dns;
+} wifi_conn_cache_t;
+
+static wifi_conn_config_t   conf;
+static EventGroupHandle_t   events;
+static esp_netif_t          *netif;
+static esp_timer_handle_t   retry_timer;
+static uint32_t             backoff_ms;
+
+static wifi_conn_cache_t    cache;
+static bool                 cache_valid;
+static bool                 using_cache;    // current attempt uses the cache
+static bool                 had_ip;         // current association got an IP
+static bool                 static_ip;      // running on the cached lease, DHCP stopped
+
+static wifi_conn_timing_t   timing;
+
+static bool wifi_conn_load_cache(void)
+{
+    nvs_handle_t nvs;
+    size_t size = sizeof(cache);
+
+    if (nvs_open(WIFI_CONN_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return false;
+    esp_err_t err = nvs_get_blob(nvs, WIFI_CONN_NVS_KEY, &cache, &size);
+    nvs_close(nvs);
+
+    return err == ESP_OK && size == sizeof(cache) && cache.channel;
+}
+
+static void wifi_conn_store_cache(bool valid)
+{
+    nvs_handle_t nvs;
+
+    if (nvs_open(WIFI_CONN_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+        return;
+    if (valid)
+        nvs_set_blob(nvs, WIFI_CONN_NVS_KEY, &cache, sizeof(cache));
+    else
+        nvs_erase_key(nvs, WIFI_CONN_NVS_KEY);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+/**
+ * Station config for the next attempt, pinned to the cached access point
+ * if there is one.
+ */
+static void wifi_conn_configure(void)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            /* Setting a password implies station will connect to all security modes including WEP/WPA.
+             * However these modes are deprecated and not advisable to be used. Incase your Access point
+             * doesn't support WPA2, these mode can be enabled by commenting below line */
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .pmf_cfg = {
+                .capable = true,
+                .required = false},
+        },
+    };
+    strlcpy((char *)wifi_config.sta.ssid, conf.ssid, sizeof(wifi_config.sta.ssid));
+    strlcpy((char *)wifi_config.sta.password, conf.password, sizeof(wifi_config.sta.password));
+
+    using_cache = cache_valid;
+    if (using_cache)
+    {
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, cache.bssid, sizeof(cache.bssid));
+        wifi_config.sta.channel = cache.channel;
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+#if CONFIG_WIFI_CACHE_IP
+    if (using_cache)
+    {
+        esp_netif_dhcpc_stop(netif);
+        esp_netif_set_ip_info(netif, &cache.ip);
+        esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &cache.dns);
+    }
+    else
+    {
+        esp_netif_dhcpc_start(netif);
+    }
+    static_ip = using_cache;
+#endif
+}
+
+static void wifi_conn_retry(void *arg)
+{
+    esp_wifi_connect();
+}
+
+static void wifi_conn_disconnected(void)
+{
+    power_radio_off();
+    if (xEventGroupGetBits(events) & WIFI_CONNECTED_BIT)
+        timing.reconnects++;
+    xEventGroupClearBits(events, WIFI_CONNECTED_BIT);
+
+    // the access point moved or the lease is gone, find it again
+    bool cache_failed = using_cache && !had_ip;
+    had_ip = false;
+    if (cache_failed)
+    {
+        ESP_LOGW(TAG, "Cached association failed, scanning");
+        cache_valid = false;
+        wifi_conn_store_cache(false);
+        wifi_conn_configure();
+        esp_wifi_connect();
+        return;
+    }
+
+    ESP_LOGI(TAG, "Disconnected, retry in %u ms", (unsigned)backoff_ms);
+    esp_timer_start_once(retry_timer, (uint64_t)backoff_ms * 1000);
+    backoff_ms *= 2;
+    if (backoff_ms > CONFIG_WIFI_BACKOFF_MAX_S * 1000)
+        backoff_ms = CONFIG_WIFI_BACKOFF_MAX_S * 1000;
+}
+
+static void wifi_conn_got_ip(const ip_event_got_ip_t *event)
+{
+    int64_t now = esp_timer_get_time();
+    wifi_ap_record_t ap;
+
+    ESP_LOGI(TAG, "got ip:" IPSTR " %s", IP2STR(&event->ip_info.ip), using_cache ? "(cached)" : "");
+    if (!timing.ip_us)
+    {
+        timing.ip_us = now;
+        timing.fast = using_cache;
+    }
+    backoff_ms = CONFIG_WIFI_BACKOFF_MIN_MS;
+    had_ip = true;
+
+    // refresh the cache if anything changed
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+    {
+        wifi_conn_cache_t fresh = { .channel = ap.primary, .ip = event->ip_info };
+        memcpy(fresh.bssid, ap.bssid, sizeof(fresh.bssid));
+        esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &fresh.dns);
+        if (!cache_valid || memcmp(&fresh, &cache, sizeof(cache)))
+        {
+            cache = fresh;
+            cache_valid = true;
+            wifi_conn_store_cache(true);
+        }
+    }
+
+    power_radio_on();
+    xEventGroupSetBits(events, WIFI_CONNECTED_BIT);
+    if (conf.on_connected)
+        conf.on_connected(conf.ctx);
+}
+
+static void wifi_conn_event(void *arg, esp_event_base_t event_base,
+        int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
+    {
+        esp_wifi_connect();
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+    {
+        if (!timing.assoc_us)
+            timing.assoc_us = esp_timer_get_time();
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        wifi_conn_disconnected();
+    }
+    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
+    {
+        wifi_conn_got_ip(event_data);
+    }
+}
+
+esp_err_t wifi_conn_start(const wifi_conn_config_t *config)
+{
+    if (!config || !config->ssid || !config->password)
+        return ESP_ERR_INVALID_ARG;
+
+    conf = *config;
+    timing.start_us = esp_timer_get_time();
+    backoff_ms = CONFIG_WIFI_BACKOFF_MIN_MS;
+    cache_valid = wifi_conn_load_cache();
+
+    if (!(events = xEventGroupCreate()))
+        return ESP_ERR_NO_MEM;
+
+    esp_timer_create_args_t timer_args = {
+        .callback = wifi_conn_retry,
+        .name = "wifi_retry"};
+    esp_err_t err = esp_timer_create(&timer_args, &retry_timer);
+    if (err != ESP_OK)
+        return err;
+
+    if ((err = esp_netif_init()) != ESP_OK)
+        return err;
+    if ((err = esp_event_loop_create_default()) != ESP_OK)
+        return err;
+    netif = esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    if ((err = esp_wifi_init(&cfg)) != ESP_OK)
+        return err;
+
+    if ((err = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+            &wifi_conn_event, NULL, NULL)) != ESP_OK)
+        return err;
+    if ((err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+            &wifi_conn_event, NULL, NULL)) != ESP_OK)
+        return err;
+
+    if ((err = esp_wifi_set_mode(WIFI_MODE_STA)) != ESP_OK)
+        return err;
+    wifi_conn_configure();
+    if ((err = esp_wifi_start()) != ESP_OK)
+        return err;
+
+    ESP_LOGI(TAG, "Connecting to %s%s", conf.ssid, cache_valid ? " with cached association" : "");
+    return ESP_OK;
+}
+
+bool wifi_conn_wait(uint32_t timeout_ms)
+{
+    return xEventGroupWaitBits(events, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE,
+            pdMS_TO_TICKS(timeout_ms)) & WIFI_CONNECTED_BIT;
+}
+
+bool wifi_conn_is_connected(void)
+{
+    return events && (xEventGroupGetBits(events) & WIFI_CONNECTED_BIT);
+}
+
+void wifi_conn_mark_upload(void)
+{
+#if CONFIG_WIFI_CACHE_IP
+    // the cached lease got the first upload out, now renew it: the new
+    // lease arrives as another IP_EVENT_STA_GOT_IP and refreshes the cache
+    if (static_ip)
+    {
+        static_ip = false;
+        ESP_LOGI(TAG, "Renewing the cached lease");
+        esp_netif_dhcpc_start(netif);
+    }
+#endif
+    if (timing.first_upload_us)
+        return;
+    timing.first_upload_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "Since boot: Wi-Fi start %lld ms, association %lld ms, IP %lld ms, first upload %lld ms%s",
+             (long long)timing.start_us / 1000, (long long)timing.assoc_us / 1000,
+             (long long)timing.ip_us / 1000, (long long)timing.first_upload_us / 1000,
+             timing.fast ? ", cached association" : "");
+}
+
+void wifi_conn_get_timing(wifi_conn_timing_t *out)
+{
+    *out = timing;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file wifi_conn.h
+ *
+ * Wi-Fi station connectivity manager.
+ *
+ * The station is started without blocking the caller. After every
+ * successful connection the access point BSSID and channel, and the IP
+ * lease, are cached in NVS. The next boot connects straight to that
+ * BSSID on that channel and reuses the lease without waiting for DHCP.
+ * If the cached association fails once, the cache is dropped and the
+ * station falls back to a full scan and DHCP.
+ *
+ * Lost connections are retried forever with exponential backoff. Boot,
+ * association, IP and first upload times are recorded for every boot.
+ */
+#ifndef __WIFI_CONN_H__
+#define __WIFI_CONN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Manager configuration
+ */
+typedef struct
+{
+    const char  *ssid;                      //!< Network name
+    const char  *password;                  //!< WPA2 passphrase
+    void        (*on_connected)(void *ctx); //!< Called from the event task once an IP is up, nullable
+    void        *ctx;                       //!< Passed to `on_connected`
+} wifi_conn_config_t;
+
+/**
+ * Startup timeline of the current boot, microseconds since boot, 0 if not reached yet
+ */
+typedef struct
+{
+    int64_t     start_us;           //!< wifi_conn_start() called
+    int64_t     assoc_us;           //!< First association
+    int64_t     ip_us;              //!< First IP
+    int64_t     first_upload_us;    //!< First successful upload, see wifi_conn_mark_upload()
+    bool        fast;               //!< First connection used the cache
+    uint32_t    reconnects;         //!< Connections lost since boot
+} wifi_conn_timing_t;
+
+/**
+ * @brief Start the station and return without waiting for a connection
+ *
+ * Initializes esp_netif and the default event loop.
+ *
+ * @param config Configuration, strings must stay valid
+ * @return `ESP_OK` on success
+ */
+esp_err_t wifi_conn_start(const wifi_conn_config_t *config);
+
+/**
+ * @brief Wait for an IP
+ *
+ * @param timeout_ms Maximum wait
+ * @return true if connected
+ */
+bool wifi_conn_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Check whether an IP is up
+ */
+bool wifi_conn_is_connected(void);
+
+/**
+ * @brief Record a successful upload, the first one ends the startup timeline
+ *
+ * With `CONFIG_WIFI_CACHE_IP`, the first upload on a cached lease also
+ * restarts DHCP to renew it.
+ */
+void wifi_conn_mark_upload(void);
+
+/**
+ * @brief Copy the startup timeline
+ *
+ * @param[out] timing Timeline
+ */
+void wifi_conn_get_timing(wifi_conn_timing_t *timing);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __WIFI_CONN_H__
@@ -0,0 +1,939 @@
+/**
+ * @file bench.c
+ *
+ * Benchmarks of the host build
+ *
+ *     bench [--quick]
+ *
+ * - decode: time to decode one read from its pulse widths, and the CPU
+ *   time of a whole read off the simulated line, start pulse skipped
+ * - sensors: CPU time of a whole read through each I2C backend, bus
+ *   transactions replayed from a recording and the conversion wait skipped
+ *   by the virtual clock, and of the convert step alone
+ * - sensor sched: sensors served per second by one task reading 16
+ *   simulated DHT lines through sensor_sched on the virtual clock, at the
+ *   minimum interval of each type, against the ceiling the gap between
+ *   start pulses allows, and the CPU time per read
+ * - metrics: cost of metrics_record() and metrics_count(), from one thread
+ *   and from several threads recording into the same histogram, checked
+ *   against the budget of a microsecond per event
+ * - rollup: cost of adding a sample to the project tiers, and the values
+ *   sent to a pin over a simulated week at the sensor period, raw and on
+ *   each tier
+ * - url: ns per request and stack bytes of building the pin GET and the
+ *   batch update URLs with url_builder, against the strcat chains into
+ *   static 500-byte buffers it replaced, sprintf'd floats and the copy
+ *   check_button() made included
+ * - local api: requests per second and latency of the LAN handlers run
+ *   in-process, for a full body, a 304 on a matching ETag and the chunked
+ *   history of a full ring, and the cost of rebuilding the bodies on a
+ *   sample
+ * - http: keep-alive GETs and batch updates per second through http_conn
+ *   against the loopback stand-in, and GETs per second on a fresh
+ *   connection each, init, perform and cleanup as the firmware made them
+ *   before http_conn
+ * - memory: heap high-water of the run and stack high-water of the task
+ *   that made the requests, then the metrics snapshot. Host frames are
+ *   larger than Xtensa ones and glibc resolves names on the stack, so the
+ *   stack figure is an upper bound of the device one
+ * - ctrl: time from a toggle in the stand-in to the callback of the pin,
+ *   and the requests and messages per toggle, over the push channel and
+ *   then over the polling fallback once the push side is down, next to
+ *   the requests the old 50 ms poll would have made in the same time
+ *
+ * --quick runs a few iterations only, to check the benchmarks still work.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dht.h>
+#include <dht_decode.h>
+#include <dht_sim.h>
+#include <esp_log.h>
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "host.h"
+#include "blynk_resp.h"
+#include "ctrl_channel.h"
+#include "ctrl_state.h"
+#include "http_conn.h"
+#include "http_standin.h"
+#include "i2c_script.h"
+#include "sensor.h"
+#include "sensor_sched.h"
+#include "esp_http_client.h"
+#include "esp_http_server.h"
+#include "local_api.h"
+#include "metrics.h"
+#include "rollup.h"
+#include "snapshot.h"
+#include "task_layout.h"
+#include "url_builder.h"
+
+#define BENCH_PIN       4
+#define BENCH_TOKEN     "bench-token"
+#define METRICS_THREADS 4
+#define METRICS_BUDGET_NS   1000
+#define SAMPLE_PERIOD_MS    2000
+#define WEEK_MS         (7 * 24 * 3600 * 1000LL)
+#define CTRL_PIN        2
+#define CTRL_TIMEOUT_MS 10000
+#define BLYNK_SERVER    "blynk.cloud"
+#define BLYNK_PORT      "80"
+#define BLYNK_API_URL   "http://" BLYNK_SERVER ":" BLYNK_PORT "/external/api/"
+#define URL_LEN         192
+
+static bool quick;
+
+typedef struct
+{
+    uint16_t    port;
+    int         requests;
+    int         failures;
+    double      gets_per_s;
+    double      updates_per_s;
+    double      fresh_gets_per_s;
+} http_bench_t;
+
+/* real time, the virtual clock stands still */
+static int64_t wall_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* pulse widths of one read as a sensor sends them, with jitter */
+static void make_pulses(const uint8_t data[DHT_DATA_BYTES], uint32_t *rng, dht_pulse_t pulses[DHT_DATA_BITS])
+{
+    for (int i = 0; i < DHT_DATA_BITS; i++)
+    {
+        bool one = data[i / 8] & (0x80 >> (i % 8));
+        *rng = *rng * 1103515245 + 12345;
+        int jitter = (int)(*rng >> 16) % 9 - 4;
+        pulses[i].low = 50 + jitter;
+        pulses[i].high = (one ? 70 : 26) - jitter;
+    }
+}
+
+static void bench_decode(void)
+{
+    const int rounds = quick ? 1000 : 1000000;
+    uint8_t sent[DHT_DATA_BYTES] = { 0x02, 0x5D, 0x00, 0xF7, 0x56 };
+    dht_pulse_t pulses[16][DHT_DATA_BITS];
+    uint32_t rng = 1, errors = 0;
+
+    for (int i = 0; i < 16; i++)
+        make_pulses(sent, &rng, pulses[i]);
+
+    int64_t start = wall_us();
+    for (int i = 0; i < rounds; i++)
+    {
+        uint8_t data[DHT_DATA_BYTES];
+        dht_decode_info_t info;
+        if (!dht_decode_adaptive(pulses[i & 15], 80, data, &info) || memcmp(data, sent, sizeof(data)))
+            errors++;
+    }
+    double ns = (wall_us() - start) * 1000.0 / rounds;
+    printf("decode: %.0f ns per read, %u errors in %d\n", ns, errors, rounds);
+
+    // whole reads, the start pulse skipped by the virtual clock
+    const int reads = quick ? 5 : 200;
+    dht_sim_config_t config = { .type = DHT_TYPE_AM2301, .humidity = 605, .temperature = 247,
+                                .jitter_us = CONFIG_DHT_SIM_JITTER_US };
+    dht_stats_t stats;
+
+    dht_sim_attach(BENCH_PIN, &config);
+    dht_reset_stats(BENCH_PIN);
+    host_clock_virtual(true);
+    start = wall_us();
+    for (int i = 0; i < reads; i++)
+    {
+        uint8_t data[DHT_RAW_LEN];
+        dht_read_raw(DHT_TYPE_AM2301, BENCH_PIN, data);
+    }
+    double us = (double)(wall_us() - start) / reads;
+    host_clock_virtual(false);
+    dht_sim_detach(BENCH_PIN);
+    dht_get_stats(BENCH_PIN, &stats);
+
+    const dht_error_counters_t *e = &stats.errors;
+    printf("read: %.1f us per read, %u failed of %u\n", us,
+           e->phase_b_timeouts + e->phase_c_timeouts + e->phase_d_timeouts + e->bit_timeouts + e->crc_failures,
+           stats.reads);
+}
+
+/* CPU time of the calling thread */
+static int64_t thread_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* the transactions of one read, after init */
+typedef struct
+{
+    const char      *name;
+    sensor_t        sensor;
+    i2c_txn_t       init[4];
+    size_t          init_len;
+    i2c_txn_t       read[3];
+    size_t          read_len;
+} sensor_bench_t;
+
+static void bench_sensors(void)
+{
+    const int rounds = quick ? 1000 : 200000;
+    static sensor_bench_t benches[] = {
+        { "sht3x", SENSOR_I2C_DEV(sensor_sht3x, I2C_NUM_0, 0x44),
+          { { .addr = 0x44, .out = { 0xF3, 0x2D }, .out_len = 2, .in = { 0x80, 0x10, 0xE1 }, .in_len = 3 } }, 1,
+          { { .addr = 0x44, .out = { 0x24, 0x00 }, .out_len = 2 },
+            { .addr = 0x44, .in = { 0x66, 0x66, 0x93, 0x80, 0x00, 0xA2 }, .in_len = 6 } }, 2 },
+        { "si7021", SENSOR_I2C_DEV(sensor_si7021, I2C_NUM_0, 0x40),
+          { { .addr = 0x40, .out = { 0xE7 }, .out_len = 1, .in = { 0x3A }, .in_len = 1 } }, 1,
+          { { .addr = 0x40, .out = { 0xF5 }, .out_len = 1 },
+            { .addr = 0x40, .in = { 0x7C, 0x80, 0xF5 }, .in_len = 3 },
+            { .addr = 0x40, .out = { 0xE0 }, .out_len = 1, .in = { 0x66, 0x40 }, .in_len = 2 } }, 3 },
+        // trimming of the datasheet example, 25.08 C
+        { "bme280", SENSOR_I2C_DEV(sensor_bme280, I2C_NUM_0, 0x76),
+          { { .addr = 0x76, .out = { 0xD0 }, .out_len = 1, .in = { 0x60 }, .in_len = 1 },
+            { .addr = 0x76, .out = { 0x88 }, .out_len = 1, .in = { 0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, [25] = 75 },
+              .in_len = BME280_CALIB_TP_LEN },
+            { .addr = 0x76, .out = { 0xE1 }, .out_len = 1, .in = { 0x6A, 0x01, 0x00, 0x13, 0x29, 0x03, 0x1E },
+              .in_len = BME280_CALIB_H_LEN },
+            { .addr = 0x76, .out = { 0xF2, 0x01 }, .out_len = 2 } }, 4,
+          { { .addr = 0x76, .out = { 0xF4, 0x25 }, .out_len = 2 },
+            { .addr = 0x76, .out = { 0xF7 }, .out_len = 1, .in = { 0x50, 0, 0, 0x7E, 0xED, 0x00, 0x75, 0x30 },
+              .in_len = BME280_DATA_LEN } }, 2 },
+    };
+
+    host_clock_virtual(true);
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++)
+    {
+        sensor_bench_t *s = &benches[b];
+        uint8_t raw[SENSOR_RAW_MAX] = { 0 };
+        int16_t h = 0, t = 0;
+        int failures = 0;
+
+        i2c_script_load(s->init, s->init_len);
+        if (sensor_init(&s->sensor) != ESP_OK)
+            failures++;
+
+        int64_t start = thread_us();
+        for (int i = 0; i < rounds; i++)
+        {
+            i2c_script_load(s->read, s->read_len);
+            if (sensor_read(&s->sensor, &h, &t) != ESP_OK)
+                failures++;
+        }
+        double read_ns = (thread_us() - start) * 1000.0 / rounds;
+
+        // the raw bytes as the read step leaves them
+        uint32_t wait_ms;
+        i2c_script_load(s->read, s->read_len);
+        if (s->sensor.drv->start(&s->sensor, &wait_ms) != ESP_OK || s->sensor.drv->read(&s->sensor, raw) != ESP_OK)
+            failures++;
+        start = thread_us();
+        for (int i = 0; i < rounds; i++)
+        {
+            if (s->sensor.drv->convert(&s->sensor, raw, &h, &t) != ESP_OK)
+                failures++;
+        }
+        double convert_ns = (thread_us() - start) * 1000.0 / rounds;
+
+        printf("sensors: %-6s %.0f ns per read, %.1f ns to convert, %.1f%% %.1f C\n",
+               s->name, read_ns, convert_ns, h / 10.0, t / 10.0);
+        if (failures || i2c_script_mismatches())
+            exit(1);
+    }
+    host_clock_virtual(false);
+}
+
+/* `count` sensors of one type read from one task for `seconds` of virtual time */
+static void sched_rate(dht_sensor_type_t type, uint32_t min_interval_ms, int count, int seconds)
+{
+    static sensor_sched_t sched;
+    dht_sim_config_t config = { .type = type, .humidity = 500, .temperature = 200 };
+    int failures = 0;
+
+    memset(&sched, 0, sizeof(sched));
+    host_clock_virtual(true);
+    uint32_t start_ms = esp_timer_get_time() / 1000;
+    for (int i = 0; i < count; i++)
+    {
+        dht_sim_attach(i, &config);
+        sensor_sched_add(&sched, min_interval_ms, min_interval_ms, NULL, start_ms);
+    }
+
+    int64_t cpu = thread_us();
+    uint32_t now = start_ms;
+    while (now - start_ms < seconds * 1000u)
+    {
+        int id;
+        uint32_t wait = sensor_sched_next(&sched, now, &id);
+        if (id < 0)
+            host_clock_advance(wait * 1000LL);
+        else
+        {
+            // the start pulse moves the virtual clock
+            int16_t h, t;
+            bool ok = dht_read_data(type, id, &h, &t) == ESP_OK;
+            failures += !ok;
+            sensor_sched_done(&sched, id, ok, h, t, esp_timer_get_time() / 1000);
+        }
+        now = esp_timer_get_time() / 1000;
+    }
+    double cpu_us = (double)(thread_us() - cpu) / sched.reads;
+    host_clock_virtual(false);
+    for (int i = 0; i < count; i++)
+        dht_sim_detach(i);
+
+    printf("sensor sched: %d %s at %u ms, %.1f sensors/s of %.1f the gap allows, %.1f us CPU per read, %d failed\n",
+           count, type == DHT_TYPE_DHT11 ? "DHT11" : "AM2301", min_interval_ms, sched.reads / (double)seconds,
+           1000.0 / SENSOR_SCHED_GAP_MS, cpu_us, failures);
+    if (failures)
+        exit(1);
+}
+
+static void bench_sensor_sched(void)
+{
+    const int seconds = quick ? 10 : 600;
+
+    sched_rate(DHT_TYPE_AM2301, 2000, SENSOR_SCHED_MAX, seconds);
+    sched_rate(DHT_TYPE_DHT11, 1000, SENSOR_SCHED_MAX, seconds);
+}
+
+static metrics_hist_t bench_hist;
+static metrics_counter_t bench_counter;
+
+typedef struct
+{
+    int         rounds;
+    uint32_t    seed;
+    int64_t     elapsed_us;
+} metrics_bench_t;
+
+/* durations spread over the buckets, as a mix of reads and requests gives */
+static void *metrics_thread(void *arg)
+{
+    metrics_bench_t *m = arg;
+    uint32_t rng = m->seed;
+
+    int64_t start = thread_us();
+    for (int i = 0; i < m->rounds; i++)
+    {
+        rng = rng * 1103515245 + 12345;
+        metrics_record(&bench_hist, (rng >> 8) >> (rng & 15));
+        metrics_count(&bench_counter);
+    }
+    m->elapsed_us = thread_us() - start;
+    return NULL;
+}
+
+static void bench_metrics(void)
+{
+    const int rounds = quick ? 10000 : 10000000;
+    metrics_bench_t one = { .rounds = rounds, .seed = 1 };
+    metrics_bench_t many[METRICS_THREADS];
+    pthread_t threads[METRICS_THREADS];
+
+    metrics_thread(&one);
+    double single_ns = one.elapsed_us * 1000.0 / rounds;
+
+    // CPU time of each thread, so that waiting for a shared CPU does not count
+    int64_t elapsed_us = 0;
+    for (int i = 0; i < METRICS_THREADS; i++)
+    {
+        many[i] = (metrics_bench_t){ .rounds = rounds / METRICS_THREADS, .seed = i + 2 };
+        pthread_create(&threads[i], NULL, metrics_thread, &many[i]);
+    }
+    for (int i = 0; i < METRICS_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        elapsed_us += many[i].elapsed_us;
+    }
+    double shared_ns = elapsed_us * 1000.0 / (rounds / METRICS_THREADS * METRICS_THREADS);
+
+    unsigned count = atomic_load(&bench_hist.count);
+    printf("metrics: %.1f ns per record and count, %.1f ns with %d threads, %u recorded\n",
+           single_ns, shared_ns, METRICS_THREADS, count);
+    if (count != atomic_load(&bench_counter.value) || single_ns > METRICS_BUDGET_NS)
+        exit(1);
+}
+
+static void on_rollup(int tier, int64_t start_ms, const rollup_acc_t *acc, void *ctx)
+{
+    uint32_t *windows = ctx;
+
+    windows[tier]++;
+}
+
+static void bench_rollup(void)
+{
+    const int64_t samples = WEEK_MS / SAMPLE_PERIOD_MS;
+    uint32_t windows[ROLLUP_MAX_TIERS] = { 0 };
+    uint32_t rng = 1;
+    rollup_t rollup;
+
+    rollup_init(&rollup, 2);
+    rollup_add_tier(&rollup, CONFIG_ROLLUP_TIER1_S * 1000);
+    rollup_add_tier(&rollup, CONFIG_ROLLUP_TIER2_S * 1000);
+
+    int64_t start = thread_us();
+    for (int64_t i = 0; i < samples; i++)
+    {
+        rng = rng * 1103515245 + 12345;
+        int16_t values[2] = { (int16_t)(200 + (rng >> 28)), (int16_t)(500 - (rng >> 27)) };
+        rollup_add(&rollup, i * SAMPLE_PERIOD_MS, values, on_rollup, windows);
+    }
+    double ns = (thread_us() - start) * 1000.0 / samples;
+    rollup_close_expired(&rollup, WEEK_MS, on_rollup, windows);
+
+    printf("rollup: %.1f ns per sample, %d tiers of %u B\n", ns, rollup.tier_count, (unsigned)sizeof(rollup_tier_t));
+    printf("rollup: a week at %d s sends %lld raw values per pin, %u on %d s (%.1f %% less), %u on %d s (%.1f %% less)\n",
+           SAMPLE_PERIOD_MS / 1000, (long long)samples,
+           windows[0], CONFIG_ROLLUP_TIER1_S, 100.0 - 100.0 * windows[0] / samples,
+           windows[1], CONFIG_ROLLUP_TIER2_S, 100.0 - 100.0 * windows[1] / samples);
+}
+
+/* real time in nanoseconds, for the handlers that take less than a microsecond */
+static int64_t wall_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* `rounds` requests of `uri`, every response checked against `status` */
+static bool local_api_rate(const char *uri, const char *if_none_match, const char *status, int rounds)
+{
+    host_httpd_resp_t resp;
+    int64_t max_ns = 0;
+    int failures = 0;
+
+    int64_t start = wall_ns();
+    for (int i = 0; i < rounds; i++)
+    {
+        int64_t t = wall_ns();
+        if (host_httpd_get(uri, if_none_match, &resp) != ESP_OK || !resp.complete
+            || strncmp(resp.head + 9, status, strlen(status)))
+            failures++;
+        t = wall_ns() - t;
+        if (t > max_ns)
+            max_ns = t;
+    }
+    double ns = (double)(wall_ns() - start) / rounds;
+
+    printf("local api: %-9s %-3s %8.0f req/s, %6.0f ns average, %6.1f us max, %zu B sent, %u chunks\n",
+           uri, status, 1e9 / ns, ns, max_ns / 1000.0, resp.wire_len, resp.chunks);
+    return !failures;
+}
+
+static void bench_local_api(void)
+{
+    const int rounds = quick ? 20 : 100000;
+    host_httpd_resp_t resp;
+    char etag[SNAPSHOT_ETAG_LEN + 8];
+    bool ok = true;
+
+    if (local_api_init() != ESP_OK || local_api_start() != ESP_OK)
+        exit(1);
+    // a full history, at the sensor period
+    int64_t start = wall_ns();
+    for (int i = 0; i < CONFIG_LOCAL_API_HISTORY; i++)
+        local_api_publish((int64_t)i * SAMPLE_PERIOD_MS, (int16_t)(200 + i % 40), (int16_t)(500 - i % 70));
+    double publish_ns = (double)(wall_ns() - start) / CONFIG_LOCAL_API_HISTORY;
+
+    host_httpd_get("/readings", NULL, &resp);
+    const char *tag = strstr(resp.head, "ETag: ");
+    if (!tag || sscanf(tag + 6, "%18s", etag) != 1)
+        exit(1);
+    printf("local api: %.1f us to rebuild the bodies on a sample, /readings is %.*s\n",
+           publish_ns / 1000, (int)resp.body_len, resp.body);
+
+    ok &= local_api_rate("/readings", NULL, "200", rounds);
+    ok &= local_api_rate("/readings", etag, "304", rounds);
+    ok &= local_api_rate("/metrics", NULL, "200", rounds);
+    ok &= local_api_rate("/history", NULL, "200", quick ? 5 : 2000);
+    ok &= local_api_rate("/history", etag, "304", rounds);
+
+    // a new sample makes the tag stale
+    local_api_publish((int64_t)CONFIG_LOCAL_API_HISTORY * SAMPLE_PERIOD_MS, 250, 450);
+    ok &= local_api_rate("/readings", etag, "200", 1);
+    if (!ok)
+        exit(1);
+}
+
+/* form_http_request() and write_http_request() before url_builder */
+static char *old_form_http_request(char *pin)
+{
+    static char http_request[500];
+    bzero(http_request, sizeof(http_request));
+    strcat(http_request, "http://");
+    strcat(http_request, BLYNK_SERVER);
+    strcat(http_request, ":");
+    strcat(http_request, BLYNK_PORT);
+    strcat(http_request, "/external/api/get");
+    strcat(http_request, "?token=");
+    strcat(http_request, BENCH_TOKEN);
+    strcat(http_request, "&pin=");
+    strcat(http_request, pin);
+    return http_request;
+}
+
+static char *old_write_http_request(char *pinTemperature, char *pinHumidity, float temperature, float humidity)
+{
+    static char http_request[500];
+    char data[8];
+    char data2[8];
+
+    sprintf(data, "%.1f", temperature);
+    sprintf(data2, "%.1f", humidity);
+
+    bzero(http_request, sizeof(http_request));
+    strcat(http_request, "http://");
+    strcat(http_request, BLYNK_SERVER);
+    strcat(http_request, ":");
+    strcat(http_request, BLYNK_PORT);
+    strcat(http_request, "/external/api/batch/update");
+    strcat(http_request, "?token=");
+    strcat(http_request, BENCH_TOKEN);
+    strcat(http_request, "&");
+    strcat(http_request, pinTemperature);
+    strcat(http_request, "=");
+    strcat(http_request, data);
+    strcat(http_request, "&");
+    strcat(http_request, pinHumidity);
+    strcat(http_request, "=");
+    strcat(http_request, data2);
+    strcat(http_request, "&");
+    strcat(http_request, "v3");
+    strcat(http_request, "=");
+    strcat(http_request, data2);
+    return http_request;
+}
+
+/* stands in for the client the URL is handed to */
+static __attribute__((noinline)) size_t url_send(const char *url)
+{
+    __asm__ volatile("" : : "r"(url) : "memory");
+    return url ? strlen(url) : 0;
+}
+
+/* check_button() copied the URL to its stack before sending it */
+static size_t url_old_get(int i)
+{
+    char http_request[500];
+    strcpy(http_request, old_form_http_request("v2"));
+    return url_send(http_request);
+}
+
+static size_t url_old_update(int i)
+{
+    return url_send(old_write_http_request("v0", "v1", (200 + i % 50) / 10.0f, (500 + i % 50) / 10.0f));
+}
+
+/* form_http_request() and the batch update of the device now */
+static size_t url_new_get(int i)
+{
+    static const url_prefix_t get_url = URL_PREFIX(BLYNK_API_URL "get?token=" BENCH_TOKEN);
+    static const int vpins[] = { 2 };
+    char url[URL_LEN];
+    url_builder_t b;
+
+    url_init(&b, url, sizeof(url));
+    url_append_prefix(&b, &get_url);
+    for (size_t p = 0; p < sizeof(vpins) / sizeof(vpins[0]); p++)
+    {
+        url_append(&b, "&v", 2);
+        url_append_int(&b, vpins[p]);
+    }
+    return url_send(url_finish(&b));
+}
+
+static size_t url_new_update(int i)
+{
+    static const url_prefix_t update_url = URL_PREFIX(BLYNK_API_URL "batch/update?token=" BENCH_TOKEN);
+    char url[URL_LEN];
+    url_builder_t b;
+
+    url_init(&b, url, sizeof(url));
+    url_append_prefix(&b, &update_url);
+    url_append_param_fixed1(&b, "v0", 200 + i % 50);
+    url_append_param_fixed1(&b, "v1", 500 + i % 50);
+    url_append_param_fixed1(&b, "v3", 500 + i % 50);
+    return url_send(url_finish(&b));
+}
+
+typedef struct
+{
+    const char  *name;
+    size_t      (*build)(int i);
+    double      ns;
+    size_t      stack;
+    size_t      len;
+} url_bench_t;
+
+static void url_stack_task(void *arg)
+{
+    url_bench_t *u = arg;
+    // what the task start used is not the build's
+    size_t start = host_task_stack_used(NULL);
+
+    u->len = u->build(0);
+    u->stack = host_task_stack_used(NULL) - start;
+    vTaskDelete(NULL);
+}
+
+static void bench_url(void)
+{
+    const int rounds = quick ? 1000 : 2000000;
+    url_bench_t benches[] = {
+        { .name = "get, strcat", .build = url_old_get },
+        { .name = "get, url_builder", .build = url_new_get },
+        { .name = "update, strcat", .build = url_old_update },
+        { .name = "update, url_builder", .build = url_new_update },
+    };
+    volatile size_t sink = 0;
+
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++)
+    {
+        url_bench_t *u = &benches[b];
+        TaskHandle_t task;
+
+        int64_t start = wall_ns();
+        for (int i = 0; i < rounds; i++)
+            sink += u->build(i);
+        u->ns = (double)(wall_ns() - start) / rounds;
+
+        // a fresh task, so that its stack holds this build only
+        if (xTaskCreatePinnedToCore(url_stack_task, "url", 8192, u, 5, &task, tskNO_AFFINITY) != pdPASS)
+            exit(1);
+        host_task_join(task);
+        printf("url: %-19s %6.1f ns per request, %4zu B of stack, %zu B URL\n", u->name, u->ns, u->stack, u->len);
+    }
+    // the same requests either way
+    if (!benches[0].len || benches[0].len - strlen("&pin=v2") != benches[1].len - strlen("&v2")
+        || benches[2].len != benches[3].len)
+        exit(1);
+    (void)sink;
+}
+
+static double http_rate(http_bench_t *b, bool update)
+{
+    char buf[128];
+    char resp[64];
+    url_builder_t url;
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < b->requests; i++)
+    {
+        int status = 0;
+        url_init(&url, buf, sizeof(buf));
+        url_append_str(&url, "http://127.0.0.1:");
+        url_append_int(&url, b->port);
+        if (update)
+        {
+            url_append_str(&url, "/external/api/batch/update?token=" BENCH_TOKEN);
+            url_append_param_fixed1(&url, "v0", 200 + i % 50);
+            url_append_param_fixed1(&url, "v1", 500 + i % 50);
+        }
+        else
+            url_append_str(&url, "/external/api/get?token=" BENCH_TOKEN "&v2");
+
+        esp_err_t err = http_conn_get(update ? HTTP_CONN_EP_UPDATE : HTTP_CONN_EP_GET, url_finish(&url),
+                                      resp, sizeof(resp), &status);
+        if (err != ESP_OK || status != 200)
+            b->failures++;
+    }
+    return b->requests / ((esp_timer_get_time() - start) / 1e6);
+}
+
+/* a client, and a connection, per request */
+static double http_fresh_rate(http_bench_t *b)
+{
+    char buf[128];
+    url_builder_t url;
+
+    url_init(&url, buf, sizeof(buf));
+    url_append_str(&url, "http://127.0.0.1:");
+    url_append_int(&url, b->port);
+    url_append_str(&url, "/external/api/get?token=" BENCH_TOKEN "&v2");
+    if (!url_finish(&url))
+        exit(1);
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < b->requests; i++)
+    {
+        esp_http_client_config_t config = {
+            .url = buf,
+            .method = HTTP_METHOD_GET,
+            .cert_pem = NULL};
+        esp_http_client_handle_t client = esp_http_client_init(&config);
+
+        if (!client || esp_http_client_perform(client) != ESP_OK || esp_http_client_get_status_code(client) != 200)
+            b->failures++;
+        esp_http_client_cleanup(client);
+    }
+    return b->requests / ((esp_timer_get_time() - start) / 1e6);
+}
+
+static void http_task(void *arg)
+{
+    http_bench_t *b = arg;
+
+    b->gets_per_s = http_rate(b, false);
+    b->updates_per_s = http_rate(b, true);
+    vTaskDelete(NULL);
+}
+
+static TaskHandle_t http_task_handle;
+
+static void bench_http(void)
+{
+    http_bench_t b = { .requests = quick ? 20 : 5000 };
+    http_conn_stats_t stats;
+    http_standin_stats_t server;
+    TaskHandle_t task;
+
+    if (http_standin_start(BENCH_TOKEN, &b.port) != ESP_OK || http_conn_init() != ESP_OK)
+    {
+        printf("http: stand-in failed to start\n");
+        exit(1);
+    }
+    http_standin_set_pin(2, "1");
+
+    // the loop task makes the uploads on the device
+    host_heap_reset_peak();
+    if (task_layout_create(TASK_LOOP, http_task, &b, &task) != ESP_OK)
+        exit(1);
+    host_task_join(task);
+    http_task_handle = task;
+
+    http_conn_get_stats(HTTP_CONN_EP_GET, &stats);
+    http_standin_get_stats(&server);
+    printf("http: %.0f gets/s, %.0f updates/s, %d failed, %u connections for %u requests\n",
+           b.gets_per_s, b.updates_per_s, b.failures, server.connections, server.requests);
+    // off the loop task, its stack figure is that of http_conn
+    b.fresh_gets_per_s = http_fresh_rate(&b);
+    printf("http: get %.1f us keep-alive, %.1f us on a fresh connection each (%.0f gets/s, %.1fx)\n",
+           1e6 / b.gets_per_s, 1e6 / b.fresh_gets_per_s, b.fresh_gets_per_s, b.gets_per_s / b.fresh_gets_per_s);
+    printf("http: get %lld us average, %lld us max\n",
+           stats.requests ? (long long)(stats.total_us / stats.requests) : 0LL, (long long)stats.max_us);
+    http_standin_stop();
+
+    if (b.failures)
+        exit(1);
+}
+
+static void bench_memory(void)
+{
+    char snapshot[1024];
+
+    metrics_watch_task(task_layout_get(TASK_LOOP)->name);
+    printf("memory: heap peak %zu bytes, minimum free %u of %u\n",
+           host_heap_peak(), esp_get_minimum_free_heap_size(), HOST_HEAP_SIZE);
+    const task_layout_t *loop = task_layout_get(TASK_LOOP);
+    size_t used = host_task_stack_used(http_task_handle);
+
+    printf("memory: %s stack %zu bytes used of %u, %d bytes to spare\n", loop->name, used, loop->stack,
+           (int)loop->stack - (int)used);
+    metrics_snapshot(snapshot, sizeof(snapshot), METRICS_FORMAT_TEXT);
+    fputs(snapshot, stdout);
+    // the margin the RAM report asks of every stack
+    if (used + CONFIG_MEMORY_STACK_MARGIN > loop->stack)
+    {
+        printf("memory: %s stack needs %zu bytes with the margin\n", loop->name, used + CONFIG_MEMORY_STACK_MARGIN);
+        exit(1);
+    }
+}
+
+static atomic_int   ctrl_effects;
+static atomic_llong ctrl_effect_us;
+static uint16_t     ctrl_port;
+static bool         ctrl_on;
+
+/* the effect of a toggle, button_blynk_response on the device */
+static void on_ctrl_change(int vpin, const char *value, void *ctx)
+{
+    atomic_store(&ctrl_effect_us, wall_us());
+    atomic_fetch_add(&ctrl_effects, 1);
+}
+
+static bool on_ctrl_update(int vpin, const char *value, void *ctx)
+{
+    return ctrl_state_update(vpin, value);
+}
+
+static void on_ctrl_data(const char *data, size_t len, void *ctx)
+{
+    blynk_resp_t *parser = ctx;
+
+    if (!data)
+        blynk_resp_reset(parser);
+    else
+        blynk_resp_feed(parser, data, len);
+}
+
+/* the fallback poll, read_pins() of app_main.c against the stand-in */
+static esp_err_t ctrl_read_pins(const int *vpins, size_t count, blynk_resp_cb_t on_value, void *ctx)
+{
+    char buf[128];
+    char value[CTRL_CHAN_VALUE_LEN];
+    url_builder_t url;
+    blynk_resp_t parser;
+    int status = 0;
+
+    url_init(&url, buf, sizeof(buf));
+    url_append_str(&url, "http://127.0.0.1:");
+    url_append_int(&url, ctrl_port);
+    url_append_str(&url, "/external/api/get?token=" BENCH_TOKEN);
+    for (size_t i = 0; i < count; i++)
+    {
+        url_append(&url, "&v", 2);
+        url_append_int(&url, vpins[i]);
+    }
+    if (!url_finish(&url))
+        return ESP_ERR_INVALID_SIZE;
+
+    blynk_resp_init(&parser, vpins, count, value, sizeof(value), on_value, ctx);
+    esp_err_t err = http_conn_get_stream(HTTP_CONN_EP_GET, buf, on_ctrl_data, &parser, &status);
+    if (err == ESP_OK && (status != 200 || !blynk_resp_finish(&parser)))
+        err = ESP_ERR_INVALID_RESPONSE;
+    return err;
+}
+
+/* wait for the effect count to reach `count` */
+static bool ctrl_wait_effect(int count)
+{
+    int64_t deadline = wall_us() + CTRL_TIMEOUT_MS * 1000LL;
+
+    while (atomic_load(&ctrl_effects) < count)
+    {
+        if (wall_us() > deadline)
+            return false;
+        usleep(100);
+    }
+    return true;
+}
+
+/* toggle the pin `toggles` times, `gap_ms` to twice that apart */
+static bool ctrl_toggles(const char *mode, int toggles, int gap_ms, uint32_t *rng)
+{
+    http_standin_stats_t before, after;
+    int64_t total_us = 0, max_us = 0;
+    int64_t start = wall_us();
+
+    http_standin_get_stats(&before);
+    for (int i = 0; i < toggles; i++)
+    {
+        *rng = *rng * 1103515245 + 12345;
+        usleep((gap_ms + (*rng >> 16) % (gap_ms + 1)) * 1000);
+
+        int count = atomic_load(&ctrl_effects) + 1;
+        ctrl_on = !ctrl_on;
+        int64_t toggled = wall_us();
+        http_standin_set_pin(CTRL_PIN, ctrl_on ? "1" : "0");
+        if (!ctrl_wait_effect(count))
+        {
+            printf("ctrl: %s toggle %d had no effect\n", mode, i);
+            return false;
+        }
+        int64_t latency = atomic_load(&ctrl_effect_us) - toggled;
+        total_us += latency;
+        if (latency > max_us)
+            max_us = latency;
+    }
+    http_standin_get_stats(&after);
+
+    double elapsed_ms = (wall_us() - start) / 1e3;
+    printf("ctrl: %s %lld us average, %lld us max toggle to effect over %d toggles\n",
+           mode, (long long)(total_us / toggles), (long long)max_us, toggles);
+    printf("ctrl: %s %.1f requests and %.1f messages per toggle, 50 ms polling would make %.1f\n",
+           mode, (double)(after.gets - before.gets) / toggles,
+           (double)(after.hw_messages - before.hw_messages) / toggles, elapsed_ms / 50 / toggles);
+    return true;
+}
+
+/* last, the channel task runs until the process ends */
+static void bench_ctrl(void)
+{
+    uint16_t hw_port = 0;
+    ctrl_chan_stats_t chan;
+    uint32_t rng = 1;
+    bool ok;
+
+    if (http_standin_start(BENCH_TOKEN, &ctrl_port) != ESP_OK || http_standin_start_hw(&hw_port) != ESP_OK)
+    {
+        printf("ctrl: stand-in failed to start\n");
+        exit(1);
+    }
+    http_standin_set_pin(CTRL_PIN, "0");
+
+    ctrl_chan_config_t config = {
+        .host = "127.0.0.1",
+        .port = hw_port,
+        .token = BENCH_TOKEN,
+        .on_update = on_ctrl_update,
+        .poll = ctrl_read_pins,
+        .ctx = NULL};
+
+    if (ctrl_state_init(ctrl_read_pins) != ESP_OK || ctrl_state_register(CTRL_PIN, on_ctrl_change, NULL) != ESP_OK)
+        exit(1);
+    config.pin_count = ctrl_state_pins(&config.pins);
+    if (ctrl_chan_start(&config) != ESP_OK)
+        exit(1);
+
+    // the sync after login delivers the first value
+    if (!ctrl_wait_effect(1))
+    {
+        printf("ctrl: no value after login\n");
+        exit(1);
+    }
+    ok = ctrl_toggles("push", quick ? 5 : 200, quick ? 1 : 5, &rng);
+
+    // the channel polls until the push side comes back
+    http_standin_stop_hw();
+    do
+    {
+        usleep(1000);
+        ctrl_chan_get_stats(&chan);
+    } while (chan.push_active);
+    ok = ok && ctrl_toggles("poll", quick ? 2 : 6, quick ? 100 : 1000, &rng);
+
+    ctrl_chan_get_stats(&chan);
+    printf("ctrl: %u logins, %u changes pushed, %u polled in %u polls\n",
+           chan.connects, chan.push_events, chan.poll_events, chan.polls);
+    http_standin_stop();
+    if (!ok)
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    quick = argc > 1 && !strcmp(argv[1], "--quick");
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    bench_decode();
+    bench_sensors();
+    bench_sensor_sched();
+    bench_metrics();
+    bench_rollup();
+    bench_url();
+    bench_http();
+    // after http, so that /metrics carries its histograms
+    bench_local_api();
+    bench_memory();
+    bench_ctrl();
+    return 0;
+}
@@ -0,0 +1,523 @@
+/**
+ * @file http_standin.c
+ *
+ * Stand-in for the Blynk HTTP API on the loopback interface
+ */
+#include "http_standin.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STANDIN_MAX_CONNS   8
+#define STANDIN_REQ_LEN     2048
+#define STANDIN_BODY_LEN    1024
+#define API_PREFIX          "/external/api/"
+
+// hardware protocol, see ctrl_channel.c
+#define HW_CMD_RESPONSE     0
+#define HW_CMD_PING         6
+#define HW_CMD_HW_SYNC      16
+#define HW_CMD_HARDWARE     20
+#define HW_CMD_HW_LOGIN     29
+#define HW_SUCCESS          200
+#define HW_INVALID_TOKEN    9
+#define HW_HDR_LEN          5
+#define HW_MAX_BODY         128
+
+typedef struct
+{
+    char    value[HTTP_STANDIN_VALUE_LEN];
+    bool    known;
+} standin_pin_t;
+
+static pthread_mutex_t          lock = PTHREAD_MUTEX_INITIALIZER;
+static char                     token[64];
+static int                      listen_sock = -1;
+static pthread_t                listener;
+static int                      hw_listen_sock = -1;
+static pthread_t                hw_listener;
+static int                      conns[STANDIN_MAX_CONNS];
+static bool                     conn_hw[STANDIN_MAX_CONNS];
+static bool                     conn_login[STANDIN_MAX_CONNS];
+static uint16_t                 hw_msg_id;
+static standin_pin_t            pins[HTTP_STANDIN_MAX_PINS];
+static http_standin_stats_t     stats;
+static uint32_t                 latency_us;
+
+static void url_decode(char *s)
+{
+    char *out = s;
+
+    for (; *s; s++)
+    {
+        if (*s == '+')
+            *out++ = ' ';
+        else if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2]))
+        {
+            char hex[3] = { s[1], s[2], 0 };
+            *out++ = (char)strtol(hex, NULL, 16);
+            s += 2;
+        }
+        else
+            *out++ = *s;
+    }
+    *out = 0;
+}
+
+/* "v12" to 12, -1 for anything else */
+static int pin_number(const char *key)
+{
+    char *end;
+
+    if ((key[0] != 'v' && key[0] != 'V') || !isdigit((unsigned char)key[1]))
+        return -1;
+    long pin = strtol(key + 1, &end, 10);
+    return *end || pin >= HTTP_STANDIN_MAX_PINS ? -1 : (int)pin;
+}
+
+static void store_pin(int pin, const char *value)
+{
+    if (pin < 0)
+        return;
+    snprintf(pins[pin].value, sizeof(pins[pin].value), "%s", value);
+    pins[pin].known = true;
+}
+
+/**
+ * Answer one request, `query` is modified. Returns the status code.
+ */
+static int standin_handle(const char *method, const char *path, char *query, size_t body_len,
+        char *body, size_t body_size)
+{
+    char *params[HTTP_STANDIN_MAX_PINS];
+    char *save;
+    int count = 0;
+    bool token_ok = false;
+
+    body[0] = 0;
+    for (char *p = strtok_r(query, "&", &save); p && count < HTTP_STANDIN_MAX_PINS;
+         p = strtok_r(NULL, "&", &save))
+    {
+        url_decode(p);
+        if (!strncmp(p, "token=", 6))
+            token_ok = !strcmp(p + 6, token);
+        else
+            params[count++] = p;
+    }
+
+    pthread_mutex_lock(&lock);
+    stats.requests++;
+    if (!token_ok || strncmp(path, API_PREFIX, strlen(API_PREFIX)))
+    {
+        stats.rejected++;
+        pthread_mutex_unlock(&lock);
+        snprintf(body, body_size, "{\"error\":{\"message\":\"Invalid token.\"}}");
+        return 400;
+    }
+    path += strlen(API_PREFIX);
+
+    if (!strcmp(method, "POST"))
+    {
+        stats.posts++;
+        stats.post_bytes += body_len;
+    }
+    else if (!strcmp(path, "get"))
+    {
+        size_t len = 0;
+        stats.gets++;
+        for (int i = 0; i < count; i++)
+        {
+            int pin = pin_number(params[i]);
+            const char *value = pin >= 0 && pins[pin].known ? pins[pin].value : "";
+            if (count == 1)
+                len += snprintf(body + len, body_size - len, "%s", value);
+            else
+                len += snprintf(body + len, body_size - len, "%s\"%s\":\"%s\"", i ? "," : "{", params[i], value);
+            if (len >= body_size)
+                break;
+        }
+        if (count > 1 && len < body_size)
+            snprintf(body + len, body_size - len, "}");
+    }
+    else if (!strcmp(path, "update") || !strcmp(path, "batch/update"))
+    {
+        const char *pin_key = NULL;
+        stats.updates++;
+        for (int i = 0; i < count; i++)
+        {
+            char *eq = strchr(params[i], '=');
+            if (!eq)
+                continue;
+            *eq = 0;
+            // update?pin=v3&value=1 or update?v3=1
+            if (!strcmp(params[i], "pin"))
+                pin_key = eq + 1;
+            else if (!strcmp(params[i], "value") && pin_key)
+                store_pin(pin_number(pin_key), eq + 1);
+            else
+                store_pin(pin_number(params[i]), eq + 1);
+        }
+    }
+    else
+    {
+        stats.rejected++;
+        pthread_mutex_unlock(&lock);
+        return 404;
+    }
+    pthread_mutex_unlock(&lock);
+    return 200;
+}
+
+static int send_all(int sock, const char *data, size_t len)
+{
+    while (len)
+    {
+        ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * Receive one request: headers into `req`, the body is read and dropped
+ * as only its length matters. Returns the length of the headers or -1.
+ */
+static int recv_request(int sock, char *req, size_t size, size_t *body_len)
+{
+    size_t len = 0;
+    char *end = NULL;
+
+    while (!end)
+    {
+        if (len == size - 1)
+            return -1;
+        ssize_t n = recv(sock, req + len, size - 1 - len, 0);
+        if (n <= 0)
+            return -1;
+        len += n;
+        req[len] = 0;
+        end = strstr(req, "\r\n\r\n");
+    }
+
+    size_t head = end + 4 - req;
+    char *cl = strcasestr(req, "\r\nContent-Length:");
+    *body_len = cl && cl < end ? strtoul(cl + 17, NULL, 10) : 0;
+
+    // pipelined requests are not expected, extra bytes belong to the body
+    size_t have = len - head;
+    char scratch[256];
+    while (have < *body_len)
+    {
+        size_t want = *body_len - have < sizeof(scratch) ? *body_len - have : sizeof(scratch);
+        ssize_t n = recv(sock, scratch, want, 0);
+        if (n <= 0)
+            return -1;
+        have += n;
+    }
+    *end = 0;
+    return head;
+}
+
+static void *standin_conn(void *arg)
+{
+    int slot = (int)(intptr_t)arg;
+    int sock = conns[slot];
+    char req[STANDIN_REQ_LEN];
+    char body[STANDIN_BODY_LEN];
+    char head[256];
+    size_t body_len;
+
+    while (recv_request(sock, req, sizeof(req), &body_len) > 0)
+    {
+        char method[8], target[STANDIN_REQ_LEN];
+        if (sscanf(req, "%7s %2047s", method, target) != 2)
+            break;
+
+        char *query = strchr(target, '?');
+        if (query)
+            *query++ = 0;
+        int status = standin_handle(method, target, query ? query : (char[]){ 0 }, body_len, body, sizeof(body));
+
+        if (latency_us)
+            nanosleep(&(struct timespec){ .tv_sec = latency_us / 1000000, .tv_nsec = latency_us % 1000000 * 1000 },
+                      NULL);
+        size_t len = strlen(body);
+        int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\n"
+                         "Content-Length: %zu\r\n\r\n", status, status == 200 ? "OK" : "Error", len);
+        if (send_all(sock, head, n) != 0 || send_all(sock, body, len) != 0)
+            break;
+    }
+
+    pthread_mutex_lock(&lock);
+    if (conns[slot] == sock)
+    {
+        close(sock);
+        conns[slot] = -1;
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/* exactly `len` bytes, -1 if the connection ends first */
+static int recv_all(int sock, void *buf, size_t len)
+{
+    for (size_t got = 0; got < len; )
+    {
+        ssize_t n = recv(sock, (char *)buf + got, len - got, 0);
+        if (n <= 0)
+            return -1;
+        got += n;
+    }
+    return 0;
+}
+
+/* one message in one send, for RESPONSE `len` is the status. Call locked. */
+static int hw_send(int sock, uint8_t cmd, uint16_t id, const char *body, uint16_t len)
+{
+    char msg[HW_HDR_LEN + HW_MAX_BODY] = { cmd, id >> 8, id & 0xFF, len >> 8, len & 0xFF };
+    size_t body_len = body ? len : 0;
+
+    if (body_len > HW_MAX_BODY)
+        return -1;
+    memcpy(msg + HW_HDR_LEN, body, body_len);
+    return send_all(sock, msg, HW_HDR_LEN + body_len);
+}
+
+/* HARDWARE "vw\0<pin>\0<value>" to one connection. Call locked. */
+static void hw_push(int sock, int pin)
+{
+    char body[HW_MAX_BODY];
+    int len = snprintf(body, sizeof(body), "vw%c%d%c%s", 0, pin, 0, pins[pin].value);
+
+    if (len < (int)sizeof(body) && hw_send(sock, HW_CMD_HARDWARE, ++hw_msg_id, body, len) == 0)
+        stats.hw_pushes++;
+}
+
+static void *hw_conn(void *arg)
+{
+    int slot = (int)(intptr_t)arg;
+    int sock = conns[slot];
+    uint8_t hdr[HW_HDR_LEN];
+    char body[HW_MAX_BODY + 1];
+
+    while (recv_all(sock, hdr, sizeof(hdr)) == 0)
+    {
+        uint8_t cmd = hdr[0];
+        uint16_t id = (hdr[1] << 8) | hdr[2];
+        uint16_t len = (hdr[3] << 8) | hdr[4];
+
+        // the length of a RESPONSE is its status, there is no body
+        if (cmd == HW_CMD_RESPONSE)
+            len = 0;
+        if (len > HW_MAX_BODY || recv_all(sock, body, len) != 0)
+            break;
+        body[len] = 0;
+
+        pthread_mutex_lock(&lock);
+        stats.hw_messages++;
+        int sent = 0;
+        if (cmd == HW_CMD_HW_LOGIN)
+        {
+            conn_login[slot] = len == strlen(token) && !memcmp(body, token, len);
+            sent = hw_send(sock, HW_CMD_RESPONSE, id, NULL, conn_login[slot] ? HW_SUCCESS : HW_INVALID_TOKEN);
+        }
+        else if (!conn_login[slot])
+            sent = -1;
+        else if (cmd == HW_CMD_PING)
+            sent = hw_send(sock, HW_CMD_RESPONSE, id, NULL, HW_SUCCESS);
+        else if (cmd == HW_CMD_HW_SYNC && !strcmp(body, "vr"))
+        {
+            // "vr\0" then the pins, the known ones are replayed
+            for (size_t at = 3; at < len; at += strlen(body + at) + 1)
+            {
+                int pin = atoi(body + at);
+                if (pin >= 0 && pin < HTTP_STANDIN_MAX_PINS && pins[pin].known)
+                    hw_push(sock, pin);
+            }
+        }
+        pthread_mutex_unlock(&lock);
+        if (sent != 0)
+            break;
+    }
+
+    pthread_mutex_lock(&lock);
+    if (conns[slot] == sock)
+    {
+        close(sock);
+        conns[slot] = -1;
+        conn_login[slot] = false;
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/* accept loop of either listening socket, `arg` true for the hardware one */
+static void *standin_listen(void *arg)
+{
+    bool hw = arg != NULL;
+
+    while (1)
+    {
+        int sock = accept(hw ? hw_listen_sock : listen_sock, NULL, NULL);
+        if (sock < 0)
+            break;
+
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        pthread_mutex_lock(&lock);
+        int slot = -1;
+        for (int i = 0; i < STANDIN_MAX_CONNS && slot < 0; i++)
+            if (conns[i] < 0)
+                slot = i;
+        if (slot >= 0)
+        {
+            conns[slot] = sock;
+            conn_hw[slot] = hw;
+            conn_login[slot] = false;
+            if (hw)
+                stats.hw_connections++;
+            else
+                stats.connections++;
+        }
+        pthread_mutex_unlock(&lock);
+
+        pthread_t thread;
+        if (slot < 0 || pthread_create(&thread, NULL, hw ? hw_conn : standin_conn, (void *)(intptr_t)slot) != 0)
+        {
+            close(sock);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+static esp_err_t standin_open(int *sock, pthread_t *thread, bool hw, uint16_t *port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(*port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+
+    int one = 1;
+    *sock = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(*sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(*sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(*sock, 4) != 0
+        || getsockname(*sock, (struct sockaddr *)&addr, &addr_len) != 0
+        || pthread_create(thread, NULL, standin_listen, hw ? (void *)1 : NULL) != 0)
+    {
+        close(*sock);
+        *sock = -1;
+        return ESP_FAIL;
+    }
+    *port = ntohs(addr.sin_port);
+    return ESP_OK;
+}
+
+static void standin_close(int *sock, pthread_t thread, bool hw)
+{
+    if (*sock < 0)
+        return;
+    shutdown(*sock, SHUT_RDWR);
+    pthread_join(thread, NULL);
+    close(*sock);
+    *sock = -1;
+
+    // connection threads see the shutdown and close their sockets
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < STANDIN_MAX_CONNS; i++)
+        if (conns[i] >= 0 && conn_hw[i] == hw)
+            shutdown(conns[i], SHUT_RDWR);
+    pthread_mutex_unlock(&lock);
+}
+
+esp_err_t http_standin_start(const char *auth_token, uint16_t *port)
+{
+    if (listen_sock >= 0 || hw_listen_sock >= 0)
+        return ESP_ERR_INVALID_STATE;
+    snprintf(token, sizeof(token), "%s", auth_token);
+    memset(pins, 0, sizeof(pins));
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < STANDIN_MAX_CONNS; i++)
+        conns[i] = -1;
+
+    return standin_open(&listen_sock, &listener, false, port);
+}
+
+void http_standin_stop(void)
+{
+    http_standin_stop_hw();
+    standin_close(&listen_sock, listener, false);
+}
+
+esp_err_t http_standin_start_hw(uint16_t *port)
+{
+    if (listen_sock < 0 || hw_listen_sock >= 0)
+        return ESP_ERR_INVALID_STATE;
+    return standin_open(&hw_listen_sock, &hw_listener, true, port);
+}
+
+void http_standin_stop_hw(void)
+{
+    standin_close(&hw_listen_sock, hw_listener, true);
+}
+
+void http_standin_set_pin(int vpin, const char *value)
+{
+    if (vpin < 0 || vpin >= HTTP_STANDIN_MAX_PINS)
+        return;
+    pthread_mutex_lock(&lock);
+    store_pin(vpin, value);
+    for (int i = 0; i < STANDIN_MAX_CONNS; i++)
+        if (conns[i] >= 0 && conn_login[i])
+            hw_push(conns[i], vpin);
+    pthread_mutex_unlock(&lock);
+}
+
+bool http_standin_get_pin(int vpin, char *buf, size_t size)
+{
+    bool known = false;
+
+    if (vpin < 0 || vpin >= HTTP_STANDIN_MAX_PINS)
+        return false;
+    pthread_mutex_lock(&lock);
+    if ((known = pins[vpin].known))
+        snprintf(buf, size, "%s", pins[vpin].value);
+    pthread_mutex_unlock(&lock);
+    return known;
+}
+
+void http_standin_drop_connections(void)
+{
+    // connection threads see the shutdown and close their sockets
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < STANDIN_MAX_CONNS; i++)
+        if (conns[i] >= 0 && !conn_hw[i])
+            shutdown(conns[i], SHUT_RDWR);
+    pthread_mutex_unlock(&lock);
+}
+
+void http_standin_set_latency_us(uint32_t us)
+{
+    latency_us = us;
+}
+
+void http_standin_get_stats(http_standin_stats_t *out)
+{
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
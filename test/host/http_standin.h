@@ -0,0 +1,115 @@
+/**
+ * @file http_standin.h
+ *
+ * Stand-in for the Blynk HTTP API on the loopback interface
+ *
+ * Serves the requests the firmware makes, on keep-alive connections, each
+ * in a thread of its own:
+ *
+ *     GET  /external/api/get?token=...&v2&v4          {"v2":"1","v4":"0"}, a bare value for one pin
+ *     GET  /external/api/update?token=...&v3=12.5     stores the values
+ *     GET  /external/api/batch/update?token=...&v0=.. stores the values
+ *     POST /external/api/batch/update?token=...       body counted, not parsed
+ *
+ * A wrong token gets a 400 with Blynk's error body. Pin values are kept
+ * as text and can be set and read by the test, as if from the app.
+ *
+ * http_standin_start_hw() adds the hardware protocol of ctrl_channel.c on
+ * a port of its own, for the same pins: login, ping, HW_SYNC replaying the
+ * known pins, and a HARDWARE message to every logged in connection when
+ * the test sets a pin.
+ */
+#ifndef __HTTP_STANDIN_H__
+#define __HTTP_STANDIN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HTTP_STANDIN_MAX_PINS   32
+#define HTTP_STANDIN_VALUE_LEN  32
+
+/**
+ * Server statistics
+ */
+typedef struct
+{
+    uint32_t connections;   //!< Connections accepted
+    uint32_t requests;      //!< Requests answered
+    uint32_t gets;          //!< Pin reads
+    uint32_t updates;       //!< Pin writes, update and batch/update
+    uint32_t posts;         //!< POST requests
+    uint32_t post_bytes;    //!< Bytes of POST bodies
+    uint32_t rejected;      //!< Requests with a wrong token or path
+    uint32_t hw_connections;    //!< Hardware protocol connections accepted
+    uint32_t hw_messages;       //!< Hardware protocol messages received
+    uint32_t hw_pushes;         //!< HARDWARE messages sent
+} http_standin_stats_t;
+
+/**
+ * @brief Start serving on 127.0.0.1
+ *
+ * @param token Accepted auth token, copied
+ * @param[in,out] port Port to listen on, 0 for any, set to the port used
+ * @return `ESP_OK` on success
+ */
+esp_err_t http_standin_start(const char *token, uint16_t *port);
+
+/**
+ * @brief Close the listening sockets and every connection
+ */
+void http_standin_stop(void);
+
+/**
+ * @brief Serve the hardware protocol too, on 127.0.0.1
+ *
+ * @param[in,out] port Port to listen on, 0 for any, set to the port used
+ * @return `ESP_OK` on success, `ESP_ERR_INVALID_STATE` unless the HTTP side
+ *         runs and the hardware side does not
+ */
+esp_err_t http_standin_start_hw(uint16_t *port);
+
+/**
+ * @brief Stop the hardware protocol only, its connections are closed
+ */
+void http_standin_stop_hw(void);
+
+/**
+ * @brief Set the value of a virtual pin, as a widget would
+ */
+void http_standin_set_pin(int vpin, const char *value);
+
+/**
+ * @brief Copy the value of a virtual pin
+ *
+ * @return false if the pin was never written
+ */
+bool http_standin_get_pin(int vpin, char *buf, size_t size);
+
+/**
+ * @brief Close every HTTP connection, as the cloud does with idle ones
+ *
+ * The clients only find out on their next request.
+ */
+void http_standin_drop_connections(void);
+
+/**
+ * @brief Delay every response, to stand for the round trip to the cloud
+ */
+void http_standin_set_latency_us(uint32_t us);
+
+/**
+ * @brief Copy the server statistics
+ */
+void http_standin_get_stats(http_standin_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTTP_STANDIN_H__
@@ -0,0 +1,79 @@
+/**
+ * @file i2c_script.c
+ *
+ * Recorded I2C transactions standing in for sensor_i2c.c
+ */
+#include "i2c_script.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sensor_i2c.h"
+
+static const i2c_txn_t  *script;
+static size_t           script_len;
+static size_t           next;
+static unsigned         mismatches;
+
+void i2c_script_load(const i2c_txn_t *txns, size_t count)
+{
+    script = txns;
+    script_len = count;
+    next = 0;
+    mismatches = 0;
+}
+
+size_t i2c_script_left(void)
+{
+    return script_len - next;
+}
+
+unsigned i2c_script_mismatches(void)
+{
+    return mismatches;
+}
+
+static esp_err_t i2c_script_step(uint8_t addr, const uint8_t *out, size_t out_len, uint8_t *in, size_t in_len)
+{
+    if (next == script_len)
+    {
+        fprintf(stderr, "i2c 0x%02x: past the end of the script\n", addr);
+        mismatches++;
+        return ESP_FAIL;
+    }
+
+    const i2c_txn_t *t = &script[next];
+    if (t->addr != addr || t->out_len != out_len || (out_len && memcmp(t->out, out, out_len)) || t->in_len != in_len)
+    {
+        fprintf(stderr, "i2c 0x%02x: transaction %zu does not match the script\n", addr, next);
+        mismatches++;
+        return ESP_FAIL;
+    }
+    next++;
+    if (t->err != ESP_OK)
+        return t->err;
+    if (in_len)
+        memcpy(in, t->in, in_len);
+    return ESP_OK;
+}
+
+esp_err_t sensor_i2c_bus_init(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t clk_hz)
+{
+    return port >= 0 && port < I2C_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t sensor_i2c_write(i2c_port_t port, uint8_t addr, const uint8_t *data, size_t len)
+{
+    return i2c_script_step(addr, data, len, NULL, 0);
+}
+
+esp_err_t sensor_i2c_read(i2c_port_t port, uint8_t addr, uint8_t *data, size_t len)
+{
+    return i2c_script_step(addr, NULL, 0, data, len);
+}
+
+esp_err_t sensor_i2c_write_read(i2c_port_t port, uint8_t addr, const uint8_t *out, size_t out_len,
+        uint8_t *in, size_t in_len)
+{
+    return i2c_script_step(addr, out, out_len, in, in_len);
+}
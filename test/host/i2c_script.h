@@ -0,0 +1,51 @@
+/**
+ * @file i2c_script.h
+ *
+ * Recorded I2C transactions standing in for sensor_i2c.c
+ *
+ * The backends run unchanged against a script of the transactions a
+ * device made: every call of sensor_i2c_write(), sensor_i2c_read() or
+ * sensor_i2c_write_read() must match the next transaction, address, bytes
+ * written and length read, and gets its recorded answer or error. A call
+ * that does not match fails with `ESP_FAIL`, like a device that does not
+ * acknowledge, and is counted.
+ */
+#ifndef __I2C_SCRIPT_H__
+#define __I2C_SCRIPT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#define I2C_SCRIPT_OUT_MAX  4
+#define I2C_SCRIPT_IN_MAX   32
+
+/**
+ * One transaction: a write, a read, or a write then a repeated start read
+ */
+typedef struct
+{
+    uint8_t     addr;
+    uint8_t     out[I2C_SCRIPT_OUT_MAX];    //!< Bytes written
+    size_t      out_len;
+    uint8_t     in[I2C_SCRIPT_IN_MAX];      //!< Bytes read back
+    size_t      in_len;
+    esp_err_t   err;                        //!< Result, no bytes read unless `ESP_OK`
+} i2c_txn_t;
+
+/**
+ * @brief Play a script from its start, it must stay valid
+ */
+void i2c_script_load(const i2c_txn_t *txns, size_t count);
+
+/**
+ * @brief Transactions of the script not made yet
+ */
+size_t i2c_script_left(void);
+
+/**
+ * @brief Calls that did not match the script since it was loaded
+ */
+unsigned i2c_script_mismatches(void);
+
+#endif  // __I2C_SCRIPT_H__
@@ -0,0 +1,30 @@
+/**
+ * @file gpio.h
+ *
+ * GPIO types for the host build. There are no pins to drive: the DHT
+ * driver reads the simulated lines of dht_sim.c instead.
+ */
+#ifndef __DRIVER_GPIO_H__
+#define __DRIVER_GPIO_H__
+
+#include <esp_err.h>
+
+#ifndef BIT
+#define BIT(nr) (1UL << (nr))
+#endif
+
+typedef int gpio_num_t;
+
+#define GPIO_NUM_MAX 40
+
+typedef enum
+{
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT = 1,
+    GPIO_MODE_OUTPUT = 2,
+    GPIO_MODE_OUTPUT_OD = 6,
+    GPIO_MODE_INPUT_OUTPUT_OD = 7,
+    GPIO_MODE_INPUT_OUTPUT = 3,
+} gpio_mode_t;
+
+#endif  // __DRIVER_GPIO_H__
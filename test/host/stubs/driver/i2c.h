@@ -0,0 +1,19 @@
+/**
+ * @file i2c.h
+ *
+ * I2C types for the host build. There is no bus: the sensor backends talk
+ * to the recorded transactions of i2c_script.c instead of sensor_i2c.c.
+ */
+#ifndef __DRIVER_I2C_H__
+#define __DRIVER_I2C_H__
+
+#include <esp_err.h>
+#include <driver/gpio.h>
+
+typedef int i2c_port_t;
+
+#define I2C_NUM_0   0
+#define I2C_NUM_1   1
+#define I2C_NUM_MAX 2
+
+#endif  // __DRIVER_I2C_H__
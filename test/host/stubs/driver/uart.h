@@ -0,0 +1,32 @@
+/**
+ * @file uart.h
+ *
+ * Console UART for the host build, there is none: metrics_serial_start()
+ * fails and snapshots are taken with metrics_snapshot()
+ */
+#ifndef __DRIVER_UART_H__
+#define __DRIVER_UART_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+
+static inline bool uart_is_driver_installed(int port)
+{
+    return false;
+}
+
+static inline esp_err_t uart_driver_install(int port, int rx_size, int tx_size, int queue_size,
+        void *queue, int flags)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline int uart_read_bytes(int port, void *buf, uint32_t len, TickType_t wait)
+{
+    return -1;
+}
+
+#endif  // __DRIVER_UART_H__
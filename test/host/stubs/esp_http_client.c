@@ -0,0 +1,378 @@
+/**
+ * @file esp_http_client.c
+ *
+ * HTTP/1.1 client of the host build, see esp_http_client.h
+ */
+#include "esp_http_client.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define CLIENT_MAX_HEADERS  4
+#define CLIENT_HOST_LEN     64
+
+typedef struct
+{
+    char    key[32];
+    char    value[64];
+} client_header_t;
+
+struct esp_http_client
+{
+    char                        *url;
+    esp_http_client_method_t    method;
+    const char                  *post_data;
+    int                         post_len;
+    client_header_t             headers[CLIENT_MAX_HEADERS];
+    http_event_handle_cb        handler;
+    void                        *user_data;
+    int                         timeout_ms;
+    char                        *rx;
+    int                         rx_size;
+    char                        *tx;
+    int                         tx_size;
+    int                         sock;
+    char                        host[CLIENT_HOST_LEN];  // of the open socket
+    int                         port;
+    int                         status;
+};
+
+static void client_event(esp_http_client_handle_t c, esp_http_client_event_id_t id,
+        void *data, int len, char *key, char *value)
+{
+    esp_http_client_event_t evt = {
+        .event_id = id,
+        .client = c,
+        .data = data,
+        .data_len = len,
+        .user_data = c->user_data,
+        .header_key = key,
+        .header_value = value};
+
+    if (c->handler)
+        c->handler(&evt);
+}
+
+/**
+ * Split "http://host[:port]/path" without copying the path.
+ */
+static int client_parse_url(const char *url, char host[CLIENT_HOST_LEN], int *port, const char **path)
+{
+    if (strncmp(url, "http://", 7))
+        return -1;
+    url += 7;
+
+    size_t n = strcspn(url, ":/");
+    if (!n || n >= CLIENT_HOST_LEN)
+        return -1;
+    memcpy(host, url, n);
+    host[n] = 0;
+    url += n;
+
+    *port = 80;
+    if (*url == ':')
+        *port = (int)strtol(url + 1, (char **)&url, 10);
+    *path = *url ? url : "/";
+    return 0;
+}
+
+static int client_connect(esp_http_client_handle_t c, const char *host, int port)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    char service[8];
+
+    snprintf(service, sizeof(service), "%d", port);
+    if (getaddrinfo(host, service, &hints, &res) != 0 || !res)
+        return -1;
+
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0)
+    {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock < 0)
+        return -1;
+
+    struct timeval tv = { .tv_sec = c->timeout_ms / 1000, .tv_usec = c->timeout_ms % 1000 * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    c->sock = sock;
+    strcpy(c->host, host);
+    c->port = port;
+    client_event(c, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+    return 0;
+}
+
+static int client_send_all(int sock, const char *data, size_t len)
+{
+    while (len)
+    {
+        ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int client_send_request(esp_http_client_handle_t c, const char *path)
+{
+    int n = snprintf(c->tx, c->tx_size, "%s %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n",
+                     c->method == HTTP_METHOD_POST ? "POST" : "GET", path, c->host);
+    for (int i = 0; i < CLIENT_MAX_HEADERS && n < c->tx_size; i++)
+        if (c->headers[i].key[0])
+            n += snprintf(c->tx + n, c->tx_size - n, "%s: %s\r\n", c->headers[i].key, c->headers[i].value);
+    if (n < c->tx_size)
+        n += snprintf(c->tx + n, c->tx_size - n, "Content-Length: %d\r\n\r\n",
+                      c->post_data ? c->post_len : 0);
+    // the device client also fails a request line that does not fit
+    if (n >= c->tx_size)
+        return -1;
+
+    if (client_send_all(c->sock, c->tx, n) != 0)
+        return -1;
+    if (c->post_data && c->post_len && client_send_all(c->sock, c->post_data, c->post_len) != 0)
+        return -1;
+    client_event(c, HTTP_EVENT_HEADERS_SENT, NULL, 0, NULL, NULL);
+    return 0;
+}
+
+/**
+ * Read the status line and headers into the receive buffer.
+ * Returns the number of body bytes read along with them, or -1.
+ */
+static int client_read_head(esp_http_client_handle_t c, long *content_length, bool *keep_alive)
+{
+    int len = 0;
+    char *end = NULL;
+
+    while (!end)
+    {
+        if (len == c->rx_size - 1)
+            return -1;
+        ssize_t n = recv(c->sock, c->rx + len, c->rx_size - 1 - len, 0);
+        if (n <= 0)
+            return -1;
+        len += n;
+        c->rx[len] = 0;
+        end = strstr(c->rx, "\r\n\r\n");
+    }
+
+    int head = end + 4 - c->rx;
+    char *line = c->rx;
+    *end = 0;
+    if (sscanf(line, "HTTP/1.%*d %d", &c->status) != 1)
+        return -1;
+
+    *content_length = -1;
+    *keep_alive = true;
+    while ((line = strstr(line, "\r\n")) != NULL)
+    {
+        line += 2;
+        char *next = strstr(line, "\r\n");
+        if (next)
+            *next = 0;
+        char *colon = strchr(line, ':');
+        if (colon)
+        {
+            *colon = 0;
+            char *value = colon + 1 + strspn(colon + 1, " ");
+            if (!strcasecmp(line, "Content-Length"))
+                *content_length = strtol(value, NULL, 10);
+            else if (!strcasecmp(line, "Connection") && !strcasecmp(value, "close"))
+                *keep_alive = false;
+            else if (!strcasecmp(line, "Transfer-Encoding") && !strcasecmp(value, "chunked"))
+                *content_length = -2;
+            client_event(c, HTTP_EVENT_ON_HEADER, NULL, 0, line, value);
+        }
+        if (!next)
+            break;
+        line = next;
+        *line = '\r';
+    }
+
+    memmove(c->rx, c->rx + head, len - head);
+    return len - head;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t c = calloc(1, sizeof(*c));
+
+    if (!c)
+        return NULL;
+    c->method = config->method;
+    c->handler = config->event_handler;
+    c->user_data = config->user_data;
+    c->timeout_ms = config->timeout_ms ? config->timeout_ms : 5000;
+    c->rx_size = config->buffer_size ? config->buffer_size : 512;
+    c->tx_size = config->buffer_size_tx ? config->buffer_size_tx : 512;
+    c->rx = malloc(c->rx_size);
+    c->tx = malloc(c->tx_size);
+    c->sock = -1;
+    if (!c->rx || !c->tx || esp_http_client_set_url(c, config->url) != ESP_OK)
+    {
+        esp_http_client_cleanup(c);
+        return NULL;
+    }
+    return c;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t c, const char *url)
+{
+    size_t len = url ? strlen(url) : 0;
+    char *copy = len ? malloc(len + 1) : NULL;
+
+    if (!copy)
+        return ESP_ERR_INVALID_ARG;
+    memcpy(copy, url, len + 1);
+    free(c->url);
+    c->url = copy;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t c, esp_http_client_method_t method)
+{
+    c->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t c, const char *data, int len)
+{
+    c->post_data = data;
+    c->post_len = len;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t c, const char *key, const char *value)
+{
+    client_header_t *free_slot = NULL;
+
+    for (int i = 0; i < CLIENT_MAX_HEADERS; i++)
+    {
+        client_header_t *h = &c->headers[i];
+        if (!strcasecmp(h->key, key))
+            free_slot = h;
+        else if (!h->key[0] && !free_slot)
+            free_slot = h;
+    }
+    if (!free_slot || strlen(key) >= sizeof(free_slot->key) || strlen(value) >= sizeof(free_slot->value))
+        return ESP_ERR_NO_MEM;
+    strcpy(free_slot->key, key);
+    strcpy(free_slot->value, value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t c, const char *key)
+{
+    for (int i = 0; i < CLIENT_MAX_HEADERS; i++)
+        if (!strcasecmp(c->headers[i].key, key))
+            c->headers[i].key[0] = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t c)
+{
+    char host[CLIENT_HOST_LEN];
+    const char *path;
+    int port;
+
+    if (client_parse_url(c->url, host, &port, &path) != 0)
+        return ESP_ERR_INVALID_ARG;
+    if (c->sock >= 0 && (strcmp(host, c->host) || port != c->port))
+        esp_http_client_close(c);
+    if (c->sock < 0 && client_connect(c, host, port) != 0)
+        return ESP_FAIL;
+
+    long content_length;
+    bool keep_alive;
+    c->status = 0;
+    int got = client_send_request(c, path) == 0 ? client_read_head(c, &content_length, &keep_alive) : -1;
+    if (got < 0)
+    {
+        esp_http_client_close(c);
+        return ESP_FAIL;
+    }
+    if (content_length == -2)
+    {
+        esp_http_client_close(c);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // without a length the body ends with the connection
+    long left = content_length < 0 ? -1 : content_length;
+    if (left >= 0 && got > left)
+        got = left;
+    while (1)
+    {
+        if (got > 0)
+        {
+            client_event(c, HTTP_EVENT_ON_DATA, c->rx, got, NULL, NULL);
+            if (left > 0)
+                left -= got;
+        }
+        if (!left)
+            break;
+        ssize_t n = recv(c->sock, c->rx, left > 0 && left < c->rx_size ? left : c->rx_size, 0);
+        if (n < 0 || (n == 0 && left > 0))
+        {
+            esp_http_client_close(c);
+            return ESP_FAIL;
+        }
+        if (n == 0)
+        {
+            keep_alive = false;
+            break;
+        }
+        got = n;
+    }
+
+    client_event(c, HTTP_EVENT_ON_FINISH, NULL, 0, NULL, NULL);
+    if (!keep_alive)
+        esp_http_client_close(c);
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t c)
+{
+    return c->status;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t c)
+{
+    if (c->sock >= 0)
+    {
+        close(c->sock);
+        c->sock = -1;
+        client_event(c, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t c)
+{
+    if (!c)
+        return ESP_ERR_INVALID_ARG;
+    esp_http_client_close(c);
+    free(c->url);
+    free(c->rx);
+    free(c->tx);
+    free(c);
+    return ESP_OK;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file esp_http_client.h
+ *
+ * The part of the ESP-IDF HTTP client used by http_conn.c, for the host
+ * build
+ *
+ * Plain HTTP/1.1 on a POSIX socket kept open between requests, as the
+ * device client does with `keep_alive_enable`. Response bodies must carry
+ * a Content-Length or end with the connection, chunked bodies fail with
+ * `ESP_ERR_NOT_SUPPORTED`. The receive and transmit buffers are allocated
+ * with the sizes of the configuration, so they show in the heap figures.
+ */
+#ifndef __ESP_HTTP_CLIENT_H__
+#define __ESP_HTTP_CLIENT_H__
+
+#include <stdbool.h>
+#include <esp_err.h>
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum
+{
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+} esp_http_client_event_id_t;
+
+typedef struct
+{
+    esp_http_client_event_id_t  event_id;
+    esp_http_client_handle_t    client;
+    void                        *data;
+    int                         data_len;
+    void                        *user_data;
+    char                        *header_key;
+    char                        *header_value;
+} esp_http_client_event_t;
+
+typedef esp_http_client_event_t *esp_http_client_event_handle_t;
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+
+typedef enum
+{
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+} esp_http_client_method_t;
+
+typedef struct
+{
+    const char                  *url;
+    esp_http_client_method_t    method;
+    const char                  *cert_pem;
+    int                         timeout_ms;
+    bool                        keep_alive_enable;
+    int                         buffer_size;
+    int                         buffer_size_tx;
+    http_event_handle_cb        event_handler;
+    void                        *user_data;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url);
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method);
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key);
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+#endif  // __ESP_HTTP_CLIENT_H__
@@ -0,0 +1,152 @@
+/**
+ * @file esp_http_server.c
+ *
+ * HTTP server of the host build, see esp_http_server.h
+ */
+#include "esp_http_server.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static httpd_uri_t  handlers[8];
+static int          handler_count;
+static int          server;
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    handler_count = 0;
+    *handle = &server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    handler_count = 0;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri)
+{
+    if (handler_count == sizeof(handlers) / sizeof(handlers[0]))
+        return ESP_ERR_NO_MEM;
+    handlers[handler_count++] = *uri;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size)
+{
+    // If-None-Match is the only request header the host requests carry
+    if (strcasecmp(field, "If-None-Match") || !req->if_none_match)
+        return ESP_ERR_NOT_FOUND;
+    if (strlen(req->if_none_match) >= val_size)
+        return ESP_ERR_INVALID_SIZE;
+    strcpy(val, req->if_none_match);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status)
+{
+    req->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type)
+{
+    req->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value)
+{
+    // the server keeps the pointers until the response is sent
+    if (req->hdr_count == HTTPD_MAX_REQ_HDRS)
+        return ESP_ERR_NO_MEM;
+    req->hdr_keys[req->hdr_count] = field;
+    req->hdr_values[req->hdr_count++] = value;
+    return ESP_OK;
+}
+
+/* status line and headers, as httpd_resp_send() writes them */
+static esp_err_t httpd_send_head(httpd_req_t *req, ssize_t len)
+{
+    host_httpd_resp_t *r = req->resp;
+    size_t size = sizeof(r->head);
+    int n;
+
+    n = snprintf(r->head, size, "HTTP/1.1 %s\r\nContent-Type: %s\r\n",
+                 req->status, req->type ? req->type : "text/html");
+    if (len < 0)
+        n += snprintf(r->head + n, size - n, "Transfer-Encoding: chunked\r\n");
+    else
+        n += snprintf(r->head + n, size - n, "Content-Length: %d\r\n", (int)len);
+    for (int i = 0; i < req->hdr_count && (size_t)n < size; i++)
+        n += snprintf(r->head + n, size - n, "%s: %s\r\n", req->hdr_keys[i], req->hdr_values[i]);
+    if ((size_t)n >= size - 2)
+        return ESP_ERR_INVALID_SIZE;
+    n += snprintf(r->head + n, size - n, "\r\n");
+    r->head_len = n;
+    r->wire_len += n;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t len)
+{
+    host_httpd_resp_t *r = req->resp;
+    esp_err_t err;
+
+    if (r->complete || r->chunked)
+        return ESP_ERR_INVALID_STATE;
+    if (buf && len < 0)
+        len = strlen(buf);
+    if (!buf)
+        len = 0;
+    if ((err = httpd_send_head(req, len)) != ESP_OK)
+        return err;
+    r->body = buf;
+    r->body_len = len;
+    r->wire_len += len;
+    r->complete = true;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t len)
+{
+    host_httpd_resp_t *r = req->resp;
+    char frame[16];
+    esp_err_t err;
+
+    if (r->complete)
+        return ESP_ERR_INVALID_STATE;
+    if (!r->chunked)
+    {
+        if ((err = httpd_send_head(req, -1)) != ESP_OK)
+            return err;
+        r->chunked = true;
+    }
+    if (buf && len < 0)
+        len = strlen(buf);
+    if (!buf)
+        len = 0;
+    // size line, data and CRLF, the empty chunk ends the body
+    r->wire_len += snprintf(frame, sizeof(frame), "%zx\r\n", (size_t)len) + len + 2;
+    r->body_len += len;
+    r->chunks++;
+    if (!len)
+        r->complete = true;
+    return ESP_OK;
+}
+
+esp_err_t host_httpd_get(const char *uri, const char *if_none_match, host_httpd_resp_t *resp)
+{
+    httpd_req_t req = { .uri = uri, .method = HTTP_GET, .if_none_match = if_none_match,
+                        .resp = resp, .status = "200 OK" };
+
+    memset(resp, 0, sizeof(*resp));
+    for (int i = 0; i < handler_count; i++)
+    {
+        if (handlers[i].method == HTTP_GET && !strcmp(handlers[i].uri, uri))
+            return handlers[i].handler(&req);
+    }
+    return ESP_ERR_NOT_FOUND;
+}
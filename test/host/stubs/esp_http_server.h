@@ -0,0 +1,113 @@
+/**
+ * @file esp_http_server.h
+ *
+ * The part of the ESP-IDF HTTP server used by local_api.c, for the host
+ * build
+ *
+ * There is no socket: host_httpd_get() runs the registered handler of a
+ * URI on the calling thread and the response is captured as the server
+ * would write it, status line and headers formatted, the body referenced
+ * where the handler keeps it, chunks counted with their framing. It
+ * measures the handlers, not the network.
+ */
+#ifndef __ESP_HTTP_SERVER_H__
+#define __ESP_HTTP_SERVER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <esp_err.h>
+
+#define HTTPD_MAX_REQ_HDRS  8
+
+typedef void *httpd_handle_t;
+
+typedef enum
+{
+    HTTP_GET = 1,
+} httpd_method_t;
+
+/**
+ * Response of host_httpd_get()
+ */
+typedef struct
+{
+    char        head[512];          //!< Status line and headers as sent
+    size_t      head_len;
+    const char  *body;              //!< Unchunked body, not copied
+    size_t      body_len;           //!< Body bytes, chunks included
+    size_t      wire_len;           //!< Every byte sent, chunk framing included
+    unsigned    chunks;
+    bool        chunked;
+    bool        complete;           //!< Body sent whole, or the last chunk sent
+} host_httpd_resp_t;
+
+typedef struct httpd_req
+{
+    const char          *uri;
+    httpd_method_t      method;
+    // host build only
+    const char          *if_none_match;
+    host_httpd_resp_t   *resp;
+    const char          *status;
+    const char          *type;
+    const char          *hdr_keys[HTTPD_MAX_REQ_HDRS];
+    const char          *hdr_values[HTTPD_MAX_REQ_HDRS];
+    int                 hdr_count;
+} httpd_req_t;
+
+typedef struct
+{
+    const char      *uri;
+    httpd_method_t  method;
+    esp_err_t       (*handler)(httpd_req_t *req);
+    void            *user_ctx;
+} httpd_uri_t;
+
+typedef struct
+{
+    uint16_t    server_port;
+    int         core_id;
+    unsigned    task_priority;
+    size_t      stack_size;
+    uint16_t    max_uri_handlers;
+    bool        lru_purge_enable;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() { \
+        .server_port = 80, \
+        .core_id = 0x7FFFFFFF, \
+        .task_priority = 5, \
+        .stack_size = 4096, \
+        .max_uri_handlers = 8, \
+        .lru_purge_enable = false, \
+    }
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri);
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size);
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t len);
+
+static inline esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *req, const char *str)
+{
+    return httpd_resp_send_chunk(req, str, str ? (ssize_t)__builtin_strlen(str) : 0);
+}
+
+/**
+ * @brief Run the handler of a GET request, host build only
+ *
+ * @param uri Path, matched exactly
+ * @param if_none_match If-None-Match header, nullable
+ * @param[out] resp Response
+ * @return Result of the handler, `ESP_ERR_NOT_FOUND` if no handler matches
+ */
+esp_err_t host_httpd_get(const char *uri, const char *if_none_match, host_httpd_resp_t *resp);
+
+#endif  // __ESP_HTTP_SERVER_H__
@@ -0,0 +1,16 @@
+/**
+ * @file esp_system.h
+ *
+ * Heap figures of ESP-IDF for the host build, taken from the allocations
+ * of the firmware code, see host.h, and the random number generator
+ */
+#ifndef __ESP_SYSTEM_H__
+#define __ESP_SYSTEM_H__
+
+#include <stdint.h>
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+uint32_t esp_random(void);
+
+#endif  // __ESP_SYSTEM_H__
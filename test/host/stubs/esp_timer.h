@@ -0,0 +1,17 @@
+/**
+ * @file esp_timer.h
+ *
+ * Microsecond clock of ESP-IDF for the host build, see host.h for the
+ * virtual time
+ */
+#ifndef __ESP_TIMER_H__
+#define __ESP_TIMER_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Microseconds since the program started, plus the virtual time
+ */
+int64_t esp_timer_get_time(void);
+
+#endif  // __ESP_TIMER_H__
@@ -0,0 +1,47 @@
+/**
+ * @file FreeRTOS.h
+ *
+ * FreeRTOS for the host build, tasks are POSIX threads
+ *
+ * Stack depths are in bytes as on ESP-IDF. A critical section is a
+ * recursive mutex per portMUX_TYPE, so it excludes the other tasks taking
+ * the same lock, but not interrupts: there are none.
+ */
+#ifndef __FREERTOS_H__
+#define __FREERTOS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <sdkconfig.h>
+
+typedef int             BaseType_t;
+typedef unsigned        UBaseType_t;
+typedef uint32_t        TickType_t;
+typedef uint8_t         StackType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFF)
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+
+typedef pthread_mutex_t portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+
+// nesting is counted per task, see host_critical_depth()
+void host_critical_enter(portMUX_TYPE *mux);
+void host_critical_exit(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)         host_critical_enter(mux)
+#define portEXIT_CRITICAL(mux)          host_critical_exit(mux)
+#define portENTER_CRITICAL_ISR(mux)     host_critical_enter(mux)
+#define portEXIT_CRITICAL_ISR(mux)      host_critical_exit(mux)
+
+#endif  // __FREERTOS_H__
@@ -0,0 +1,58 @@
+/**
+ * @file task.h
+ *
+ * FreeRTOS tasks for the host build
+ *
+ * Every task runs on a thread of its own with a painted stack, so
+ * uxTaskGetStackHighWaterMark() measures it as on the device. The stack
+ * gets `HOST_STACK_EXTRA` bytes on top of the requested depth, x86-64
+ * frames being larger than Xtensa ones: a task that overflows its depth
+ * reports 0 bytes free instead of crashing. Priorities and cores are
+ * ignored.
+ */
+#ifndef __FREERTOS_TASK_H__
+#define __FREERTOS_TASK_H__
+
+#include "FreeRTOS.h"
+
+#define tskNO_AFFINITY          0x7FFFFFFF
+#define HOST_STACK_EXTRA        (64 * 1024)
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+/**
+ * Storage of a statically allocated task, unused on the host
+ */
+typedef struct
+{
+    uint8_t     reserved[64];
+} StaticTask_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t depth, void *arg,
+        UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t depth, void *arg,
+        UBaseType_t priority, StackType_t *stack, StaticTask_t *tcb, BaseType_t core);
+
+#define xTaskCreate(fn, name, depth, arg, priority, handle) \
+        xTaskCreatePinnedToCore(fn, name, depth, arg, priority, handle, tskNO_AFFINITY)
+
+/**
+ * @brief End the calling task, only NULL is supported
+ */
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TaskHandle_t xTaskGetHandle(const char *name);
+
+/**
+ * @brief Bytes of the requested depth never used, NULL for the calling task
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#endif  // __FREERTOS_TASK_H__
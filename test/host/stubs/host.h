@@ -0,0 +1,74 @@
+/**
+ * @file host.h
+ *
+ * Controls of the host build that have no ESP-IDF counterpart
+ *
+ * Time: esp_timer_get_time() follows the monotonic clock. With the virtual
+ * clock on, time stands still and only vTaskDelay() and
+ * host_clock_advance() move it, vTaskDelay() without sleeping. Code that
+ * sleeps through long waits, such as the 20 ms DHT start pulse, runs at
+ * full speed and the simulated line gives the same pulses whatever the
+ * load of the host. Only turn it on while a single task is running, and
+ * not around code that spins on the clock.
+ *
+ * Heap: every allocation made by the code linked into a host executable is
+ * counted, the heap of esp_get_free_heap_size() is `HOST_HEAP_SIZE` bytes.
+ */
+#ifndef __HOST_H__
+#define __HOST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define HOST_HEAP_SIZE  (300 * 1024)
+
+/**
+ * @brief Make vTaskDelay() advance the clock instead of sleeping
+ */
+void host_clock_virtual(bool on);
+
+/**
+ * @brief Move the clock forward
+ */
+void host_clock_advance(int64_t us);
+
+/**
+ * @brief Bytes currently allocated
+ */
+size_t host_heap_used(void);
+
+/**
+ * @brief Most bytes allocated at once since the last reset
+ */
+size_t host_heap_peak(void);
+
+/**
+ * @brief Restart the peak from the current use
+ */
+void host_heap_reset_peak(void);
+
+/**
+ * @brief Critical sections the calling task has entered and not left
+ */
+int host_critical_depth(void);
+
+/**
+ * @brief Wait until a task has deleted itself
+ *
+ * The task stays known to xTaskGetHandle() and its high-water mark stays
+ * readable.
+ */
+void host_task_join(TaskHandle_t task);
+
+/**
+ * @brief Most bytes of stack a task has used, NULL for the calling task
+ *
+ * Unlike uxTaskGetStackHighWaterMark() it goes past the requested depth.
+ */
+size_t host_task_stack_used(TaskHandle_t task);
+
+#endif  // __HOST_H__
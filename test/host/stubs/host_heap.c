@@ -0,0 +1,96 @@
+/**
+ * @file host_heap.c
+ *
+ * Heap accounting of the host build
+ *
+ * Executables are linked with --wrap for malloc(), calloc(), realloc() and
+ * free(), so the calls made by the linked code land here. Memory that the C
+ * library allocates and frees internally is not seen.
+ */
+#include "host.h"
+#include "esp_system.h"
+
+#include <malloc.h>
+#include <stdatomic.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+static atomic_llong heap_used;
+static atomic_llong heap_peak;
+
+static void heap_add(long long delta)
+{
+    long long used = atomic_fetch_add(&heap_used, delta) + delta;
+    long long peak = atomic_load(&heap_peak);
+
+    while (used > peak && !atomic_compare_exchange_weak(&heap_peak, &peak, used))
+        ;
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *p = __real_malloc(size);
+
+    if (p)
+        heap_add(malloc_usable_size(p));
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+
+    if (p)
+        heap_add(malloc_usable_size(p));
+    return p;
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    size_t old = p ? malloc_usable_size(p) : 0;
+    void *q = __real_realloc(p, size);
+
+    if (q)
+        heap_add((long long)malloc_usable_size(q) - old);
+    else if (!size)
+        heap_add(-(long long)old);
+    return q;
+}
+
+void __wrap_free(void *p)
+{
+    if (p)
+        heap_add(-(long long)malloc_usable_size(p));
+    __real_free(p);
+}
+
+size_t host_heap_used(void)
+{
+    long long used = atomic_load(&heap_used);
+    return used > 0 ? used : 0;
+}
+
+size_t host_heap_peak(void)
+{
+    return atomic_load(&heap_peak);
+}
+
+void host_heap_reset_peak(void)
+{
+    atomic_store(&heap_peak, atomic_load(&heap_used));
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    size_t used = host_heap_used();
+    return used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    size_t peak = host_heap_peak();
+    return peak < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - peak : 0;
+}
@@ -0,0 +1,21 @@
+/**
+ * @file host_libc.c
+ *
+ * C library functions of newlib missing on the host, see host_libc.h
+ */
+#include "host_libc.h"
+
+#if HOST_NEEDS_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+
+    if (size)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+#endif
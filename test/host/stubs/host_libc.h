@@ -0,0 +1,18 @@
+/**
+ * @file host_libc.h
+ *
+ * What newlib has and the C library of the host may lack, included ahead
+ * of the sources of main
+ */
+#ifndef __HOST_LIBC_H__
+#define __HOST_LIBC_H__
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+#define HOST_NEEDS_STRLCPY 1
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+#endif  // __HOST_LIBC_H__
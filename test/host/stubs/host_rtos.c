@@ -0,0 +1,429 @@
+/**
+ * @file host_rtos.c
+ *
+ * FreeRTOS tasks, mutexes and clock on POSIX threads
+ */
+#include "host.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define STACK_PAINT     0xA5
+
+struct host_task
+{
+    pthread_t           thread;
+    char                name[16];
+    TaskFunction_t      fn;
+    void                *arg;
+    uint8_t             *stack;
+    size_t              stack_size;
+    uint32_t            depth;
+    size_t              base_used;      // taken by the thread itself before the task runs
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    uint32_t            notify;
+    bool                done;
+    struct host_task    *next;
+};
+
+struct host_sem
+{
+    pthread_mutex_t     mutex;
+};
+
+struct host_queue
+{
+    pthread_mutex_t     lock;
+    pthread_cond_t      changed;        // an item was added or taken
+    size_t              length;
+    size_t              item_size;
+    size_t              head;
+    size_t              count;
+    uint8_t             items[];
+};
+
+static struct host_task     *tasks;
+static pthread_mutex_t      tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct host_task *self;
+static __thread int         critical_depth;
+
+static atomic_llong         clock_offset_us;
+static atomic_llong         clock_frozen_us;    // time while the virtual clock is on
+static atomic_bool          clock_virtual;
+
+static int64_t monotonic_us(void)
+{
+    static int64_t start;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (!start)
+        start = now - 1;
+    return now - start;
+}
+
+__attribute__((constructor)) static void host_clock_start(void)
+{
+    monotonic_us();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    if (atomic_load(&clock_virtual))
+        return atomic_load(&clock_frozen_us);
+    return monotonic_us() + atomic_load(&clock_offset_us);
+}
+
+void host_clock_virtual(bool on)
+{
+    if (on == atomic_load(&clock_virtual))
+        return;
+    // the clock goes on from where it stopped
+    if (on)
+        atomic_store(&clock_frozen_us, esp_timer_get_time());
+    else
+        atomic_store(&clock_offset_us, atomic_load(&clock_frozen_us) - monotonic_us());
+    atomic_store(&clock_virtual, on);
+}
+
+void host_clock_advance(int64_t us)
+{
+    if (atomic_load(&clock_virtual))
+        atomic_fetch_add(&clock_frozen_us, us);
+    else
+        atomic_fetch_add(&clock_offset_us, us);
+}
+
+void host_critical_enter(portMUX_TYPE *mux)
+{
+    pthread_mutex_lock(mux);
+    critical_depth++;
+}
+
+void host_critical_exit(portMUX_TYPE *mux)
+{
+    critical_depth--;
+    pthread_mutex_unlock(mux);
+}
+
+int host_critical_depth(void)
+{
+    return critical_depth;
+}
+
+static void deadline_after(struct timespec *ts, TickType_t ticks)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    uint64_t ns = ts->tv_nsec + (uint64_t)ticks * portTICK_PERIOD_MS * 1000000;
+    ts->tv_sec += ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (atomic_load(&clock_virtual))
+    {
+        host_clock_advance((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+        return;
+    }
+    struct timespec ts = { .tv_sec = ticks / configTICK_RATE_HZ,
+                           .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * portTICK_PERIOD_MS * 1000000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return esp_timer_get_time() / 1000 / portTICK_PERIOD_MS;
+}
+
+static void *host_task_entry(void *p)
+{
+    struct host_task *t = p;
+    uint8_t probe;
+
+    self = t;
+    t->base_used = t->stack + t->stack_size - &probe;
+    t->fn(t->arg);
+
+    // a FreeRTOS task must not return, but ending here is harmless
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+static struct host_task *host_task_start(TaskFunction_t fn, const char *name, uint32_t depth, void *arg)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+    pthread_attr_t attr;
+
+    if (!t)
+        return NULL;
+    strncpy(t->name, name ? name : "", sizeof(t->name) - 1);
+    t->fn = fn;
+    t->arg = arg;
+    t->depth = depth;
+    t->stack_size = depth + HOST_STACK_EXTRA;
+    // mapped, not allocated, so stacks do not count as firmware heap
+    t->stack = mmap(NULL, t->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (t->stack == MAP_FAILED)
+    {
+        free(t);
+        return NULL;
+    }
+    memset(t->stack, STACK_PAINT, t->stack_size);
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+
+    pthread_mutex_lock(&tasks_lock);
+    t->next = tasks;
+    tasks = t;
+    pthread_mutex_unlock(&tasks_lock);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, t->stack, t->stack_size);
+    int err = pthread_create(&t->thread, &attr, host_task_entry, t);
+    pthread_attr_destroy(&attr);
+    return err ? NULL : t;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t depth, void *arg,
+        UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    struct host_task *t = host_task_start(fn, name, depth, arg);
+
+    if (handle)
+        *handle = t;
+    return t ? pdPASS : pdFAIL;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t depth, void *arg,
+        UBaseType_t priority, StackType_t *stack, StaticTask_t *tcb, BaseType_t core)
+{
+    // the caller's stack is left unused, a painted one is needed to measure
+    return host_task_start(fn, name, depth, arg);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task && task != self)
+        abort();
+    if (!self)
+        pthread_exit(NULL);
+
+    pthread_mutex_lock(&self->lock);
+    self->done = true;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+    pthread_exit(NULL);
+}
+
+void host_task_join(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    while (!task->done)
+        pthread_cond_wait(&task->cond, &task->lock);
+    pthread_mutex_unlock(&task->lock);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return self;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    struct host_task *t;
+
+    pthread_mutex_lock(&tasks_lock);
+    for (t = tasks; t; t = t->next)
+        if (!strncmp(t->name, name, sizeof(t->name) - 1))
+            break;
+    pthread_mutex_unlock(&tasks_lock);
+    return t;
+}
+
+size_t host_task_stack_used(TaskHandle_t task)
+{
+    struct host_task *t = task ? task : self;
+    size_t untouched = 0;
+
+    if (!t)
+        return 0;
+    // the stack grows down, paint left at the low end was never reached
+    while (untouched < t->stack_size && t->stack[untouched] == STACK_PAINT)
+        untouched++;
+    return t->stack_size - untouched - t->base_used;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    struct host_task *t = task ? task : self;
+    size_t used = host_task_stack_used(task);
+
+    return t && used < t->depth ? t->depth - used : 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct host_task *t = self;
+    struct timespec deadline;
+    uint32_t value;
+
+    if (!t)
+        abort();
+    deadline_after(&deadline, ticks);
+    pthread_mutex_lock(&t->lock);
+    while (!t->notify && ticks)
+    {
+        if (ticks == portMAX_DELAY)
+            pthread_cond_wait(&t->cond, &t->lock);
+        else if (pthread_cond_timedwait(&t->cond, &t->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    value = t->notify;
+    if (value)
+        t->notify = clear ? 0 : value - 1;
+    pthread_mutex_unlock(&t->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct host_sem *sem = malloc(sizeof(*sem));
+
+    if (sem)
+        pthread_mutex_init(&sem->mutex, NULL);
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    struct timespec deadline;
+
+    if (ticks == portMAX_DELAY)
+        return pthread_mutex_lock(&sem->mutex) == 0;
+    deadline_after(&deadline, ticks);
+    return pthread_mutex_timedlock(&sem->mutex, &deadline) == 0;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pthread_mutex_unlock(&sem->mutex) == 0;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(&sem->mutex);
+    free(sem);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q) + (size_t)length * item_size);
+
+    if (!q)
+        return NULL;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+/* wait on the queue, locked, until `ready` or the deadline of `ticks` */
+static bool queue_wait(struct host_queue *q, bool (*ready)(const struct host_queue *), TickType_t ticks)
+{
+    struct timespec deadline;
+
+    deadline_after(&deadline, ticks);
+    while (!ready(q))
+    {
+        if (!ticks)
+            return false;
+        if (ticks == portMAX_DELAY)
+            pthread_cond_wait(&q->changed, &q->lock);
+        else if (pthread_cond_timedwait(&q->changed, &q->lock, &deadline) == ETIMEDOUT)
+            return ready(q);
+    }
+    return true;
+}
+
+static bool queue_has_room(const struct host_queue *q)
+{
+    return q->count < q->length;
+}
+
+static bool queue_has_item(const struct host_queue *q)
+{
+    return q->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = queue_wait(q, queue_has_room, ticks);
+    if (ok)
+    {
+        memcpy(q->items + (q->head + q->count) % q->length * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = queue_wait(q, queue_has_item, ticks);
+    if (ok)
+    {
+        memcpy(item, q->items + q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_cond_destroy(&q->changed);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+}
+
+uint32_t esp_random(void)
+{
+    static atomic_uint state = 1;
+
+    return atomic_fetch_add(&state, 0x9E3779B9u) * 2654435761u;
+}
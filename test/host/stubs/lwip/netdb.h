@@ -0,0 +1,11 @@
+/**
+ * @file netdb.h
+ *
+ * lwIP name resolution of the host build, the resolver of the C library
+ */
+#ifndef __LWIP_NETDB_H__
+#define __LWIP_NETDB_H__
+
+#include <netdb.h>
+
+#endif  // __LWIP_NETDB_H__
@@ -0,0 +1,16 @@
+/**
+ * @file sockets.h
+ *
+ * lwIP sockets of the host build, the BSD API they follow
+ */
+#ifndef __LWIP_SOCKETS_H__
+#define __LWIP_SOCKETS_H__
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#endif  // __LWIP_SOCKETS_H__
@@ -0,0 +1,9 @@
+/**
+ * @file sys.h
+ *
+ * Nothing of lwIP's system layer is used on the host
+ */
+#ifndef __LWIP_SYS_H__
+#define __LWIP_SYS_H__
+
+#endif  // __LWIP_SYS_H__
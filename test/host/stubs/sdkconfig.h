@@ -0,0 +1,59 @@
+/**
+ * @file sdkconfig.h
+ *
+ * Configuration of the host build, the project defaults of sdkconfig with
+ * the simulated DHT line and every sensor type enabled
+ */
+#ifndef __SDKCONFIG_H__
+#define __SDKCONFIG_H__
+
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_ESP_CONSOLE_UART_NUM 0
+
+#define CONFIG_DHT_ANY_TYPE 1
+#define CONFIG_DHT_SIMULATOR 1
+#define CONFIG_DHT_SIM_JITTER_US 4
+
+#define CONFIG_BLYNK_SERVER "127.0.0.1"
+#define CONFIG_BLYNK_HW_PORT 80
+#define CONFIG_BLYNK_CONTROL_PUSH 1
+#define CONFIG_BLYNK_HEARTBEAT_S 10
+#define CONFIG_BLYNK_PUSH_RETRY_MAX_S 60
+#define CONFIG_BLYNK_POLL_MIN_MS 100
+#define CONFIG_BLYNK_POLL_MAX_MS 5000
+
+#define CONFIG_REPORT_MIN_INTERVAL_MS 2000
+#define CONFIG_REPORT_MAX_INTERVAL_S 60
+#define CONFIG_REPORT_TEMP_DEADBAND 2
+#define CONFIG_REPORT_HUM_DEADBAND 5
+
+#define CONFIG_ROLLUP_TIER1_S 60
+#define CONFIG_ROLLUP_TIER2_S 300
+
+#define CONFIG_LOCAL_API 1
+#define CONFIG_LOCAL_API_PORT 8080
+#define CONFIG_LOCAL_API_HISTORY 900
+
+#define CONFIG_HTTP_CONN_RX_BUF 512
+#define CONFIG_HTTP_CONN_TX_BUF 512
+
+#define CONFIG_TASK_SENSOR_CORE 1
+#define CONFIG_TASK_SENSOR_PRIO 10
+#define CONFIG_TASK_SENSOR_STACK 3072
+#define CONFIG_TASK_LOOP_CORE 0
+#define CONFIG_TASK_LOOP_PRIO 1
+#define CONFIG_TASK_LOOP_STACK 6144
+#define CONFIG_TASK_CTRL_CORE 0
+#define CONFIG_TASK_CTRL_PRIO 1
+#define CONFIG_TASK_CTRL_STACK 4096
+#define CONFIG_TASK_METRICS_CORE -1
+#define CONFIG_TASK_METRICS_PRIO 1
+#define CONFIG_TASK_METRICS_STACK 3072
+#define CONFIG_TASK_HTTPD_CORE 0
+#define CONFIG_TASK_HTTPD_PRIO 5
+#define CONFIG_TASK_HTTPD_STACK 4096
+
+#define CONFIG_MEMORY_STACK_MARGIN 512
+
+#endif  // __SDKCONFIG_H__
@@ -0,0 +1,41 @@
+/**
+ * @file test.h
+ *
+ * Checks of the host tests
+ *
+ * A failed check prints where it failed and the test goes on, the
+ * executable exits with the number of failures.
+ */
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) do { \
+        long long a_ = (a), b_ = (b); \
+        if (a_ != b_) \
+        { \
+            fprintf(stderr, "%s:%d: %s == %s failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, a_, b_); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_RUN(fn) do { \
+        int before_ = test_failures; \
+        fn(); \
+        printf("%-40s %s\n", #fn, test_failures == before_ ? "ok" : "FAILED"); \
+    } while (0)
+
+#define TEST_EXIT() (test_failures ? 1 : 0)
+
+#endif  // __TEST_H__
@@ -0,0 +1,340 @@
+/**
+ * @file test_blynk_resp.c
+ *
+ * Blynk response parser: the accepted forms fed whole, split at every
+ * position and byte by byte, malformed bodies, and random bytes and
+ * mutated bodies in random pieces.
+ *
+ * Built with the address and undefined behaviour sanitizers, without the
+ * stubs, so an overrun of the value buffer fails the run.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "blynk_resp.h"
+
+#include "test.h"
+
+#define LOG_SIZE    4096
+
+static const int pins[] = { 2, 4, 7 };
+
+/* the values received, as "pin=value;" */
+typedef struct
+{
+    char    text[LOG_SIZE];
+    size_t  len;
+    size_t  calls;
+    size_t  size;           // of the value buffer
+    bool    bad;            // a value not terminated within the buffer
+} value_log_t;
+
+static void on_value(int vpin, const char *value, void *ctx)
+{
+    value_log_t *log = ctx;
+    size_t n = strnlen(value, log->size);
+
+    if (n >= log->size)
+        log->bad = true;
+    log->calls++;
+    if (log->len < LOG_SIZE)
+        log->len += snprintf(log->text + log->len, LOG_SIZE - log->len, "%d=%.*s;", vpin, (int)n, value);
+}
+
+/* the body in the pieces given by `cuts`, ascending; returns the finish result */
+static bool parse(const char *body, size_t len, const size_t *cuts, size_t ncuts, size_t size, value_log_t *log)
+{
+    blynk_resp_t p;
+    char *buf = malloc(size);   // exact size, so that the sanitizer sees an overrun
+    size_t at = 0;
+    bool ok = true;
+
+    memset(log, 0, sizeof(*log));
+    log->size = size;
+    blynk_resp_init(&p, pins, sizeof(pins) / sizeof(pins[0]), buf, size, on_value, log);
+    for (size_t i = 0; i <= ncuts; i++)
+    {
+        size_t end = i < ncuts ? cuts[i] : len;
+        bool fed = blynk_resp_feed(&p, body + at, end - at);
+        // an error is sticky
+        if (!ok && fed)
+            log->bad = true;
+        ok = fed;
+        at = end;
+    }
+    bool done = blynk_resp_finish(&p);
+    if (done && !ok)
+        log->bad = true;
+    if (p.values != log->calls)
+        log->bad = true;
+    free(buf);
+    return done;
+}
+
+static bool parse_whole(const char *body, size_t size, value_log_t *log)
+{
+    return parse(body, strlen(body), NULL, 0, size, log);
+}
+
+typedef struct
+{
+    const char  *body;
+    bool        ok;
+    const char  *values;
+} resp_case_t;
+
+static const resp_case_t cases[] = {
+    { "{\"v2\":\"1\",\"v4\":\"0\"}",            true,   "2=1;4=0;" },
+    { " { \"V7\" : \"on\" ,\r\n \"v4\":\"\" } \n", true, "7=on;4=;" },
+    { "{\"v2\":12.5,\"v4\":true,\"v7\":null}",  true,   "2=12.5;4=true;7=null;" },
+    { "{\"v1\":[\"12\",\"34\"],\"v2\":[[5],6]}", true,  "1=12;2=5;" },
+    { "{\"v3\":{\"a\":\"b\"},\"v4\":\"x\"}",    true,   "3=a;4=x;" },
+    { "{\"name\":\"x\",\"v12345\":\"y\",\"v\":\"z\",\"v4\":\"w\"}", true, "4=w;" },
+    { "{\"error\":{\"message\":\"Invalid token.\"}}", true, "" },
+    { "{}",                                     true,   "" },
+    { "[\"1\",\"0\"]",                          true,   "2=1;4=0;" },
+    { "[1, 0 ,\"x\",\"extra\"]",                true,   "2=1;4=0;7=x;" },
+    { "[[\"a\",\"b\"],\"c\"]",                  true,   "2=a;4=c;" },
+    { "[]",                                     true,   "" },
+    { "1",                                      true,   "2=1;" },
+    { "  42.5 \r\n",                            true,   "2=42.5;" },
+    { "\"on\"",                                 true,   "2=on;" },
+    { "{\"v2\":\"a\\\"b\\\\c\\/d\\n\"}",        true,   "2=a\"b\\c/d\n;" },
+    { "{\"v2\":\"\\u0041\\u00e9\\u20AC\"}",     true,   "2=A??;" },
+    { "{\"v\\u0032\":\"k\"}",                   true,   "2=k;" },
+    { "{\"v2\":\"1\",}",                        true,   "2=1;" },    // tolerated in an object
+    // malformed
+    { "",                                       false,  "" },
+    { "{",                                      false,  "" },
+    { "{\"v2\":\"1\"",                          false,  "2=1;" },
+    { "{\"v2\" \"1\"}",                         false,  "" },
+    { "{\"v2\":}",                              false,  "" },
+    { "{\"v2\":\"1\"}x",                        false,  "2=1;" },
+    { "{\"v2\":\"a\\x\"}",                      false,  "" },
+    { "{\"v2\":\"\\u12g4\"}",                   false,  "" },
+    { "{\"v2\":\"a\nb\"}",                      false,  "" },
+    { "[\"1\" \"0\"]",                          false,  "2=1;" },
+    { "[,]",                                    false,  "" },
+    { "[\"1\",]",                               false,  "2=1;" },
+    { "{v2:1}",                                 false,  "" },
+    { "[1}",                                    false,  "2=1;" },
+};
+
+static void check_case(const resp_case_t *c, const value_log_t *log, bool done, const char *how)
+{
+    if (done != c->ok || strcmp(log->text, c->values) || log->bad)
+    {
+        fprintf(stderr, "%s '%s': %s, values '%s'\n", how, c->body, done ? "done" : "failed", log->text);
+        CHECK(!"unexpected parse");
+    }
+}
+
+static void test_forms(void)
+{
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        value_log_t log;
+        bool done = parse_whole(cases[i].body, 32, &log);
+        check_case(&cases[i], &log, done, "whole");
+    }
+}
+
+/* the network splits the body anywhere, even in an escape */
+static void test_split_everywhere(void)
+{
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        const char *body = cases[i].body;
+        size_t len = strlen(body);
+        value_log_t log;
+
+        for (size_t cut = 0; cut <= len; cut++)
+        {
+            bool done = parse(body, len, &cut, 1, 32, &log);
+            check_case(&cases[i], &log, done, "split");
+        }
+
+        size_t cuts[64];
+        for (size_t k = 0; k < len && k < 64; k++)
+            cuts[k] = k + 1;
+        bool done = parse(body, len, cuts, len < 64 ? len : 64, 32, &log);
+        check_case(&cases[i], &log, done, "bytes");
+    }
+}
+
+static void test_truncation(void)
+{
+    value_log_t log;
+    blynk_resp_t p;
+    char buf[4];
+
+    CHECK(parse_whole("{\"v2\":\"123456\",\"v4\":\"ab\"}", 4, &log));
+    CHECK(!strcmp(log.text, "2=123;4=ab;"));
+    CHECK(!log.bad);
+    // a long key is not taken for a short pin
+    CHECK(parse_whole("{\"v1234567\":\"1\",\"v4\":\"2\"}", 4, &log));
+    CHECK(!strcmp(log.text, "4=2;"));
+    CHECK(parse_whole("[[\"abcdef\"],\"xyz9\"]", 4, &log));
+    CHECK(!strcmp(log.text, "2=abc;4=xyz;"));
+    CHECK(parse_whole("123456789", 2, &log));
+    CHECK(!strcmp(log.text, "2=1;"));
+
+    blynk_resp_init(&p, pins, 3, buf, sizeof(buf), on_value, &log);
+    memset(&log, 0, sizeof(log));
+    log.size = sizeof(buf);
+    CHECK(blynk_resp_feed(&p, "[\"12345\",\"1\",99999]", 19));
+    CHECK(blynk_resp_finish(&p));
+    CHECK_EQ(p.values, 3);
+    CHECK_EQ(p.truncated, 2);
+}
+
+/* a retried request parses from the start */
+static void test_reset(void)
+{
+    value_log_t log = { .size = 8 };
+    blynk_resp_t p;
+    char buf[8];
+
+    blynk_resp_init(&p, pins, 3, buf, sizeof(buf), on_value, &log);
+    CHECK(!blynk_resp_feed(&p, "{\"v2\"}", 6));
+    CHECK(!blynk_resp_feed(&p, "{\"v2\":\"1\"}", 10));
+    CHECK(!blynk_resp_finish(&p));
+    CHECK_EQ(log.calls, 0);
+
+    blynk_resp_reset(&p);
+    CHECK(blynk_resp_feed(&p, "{\"v2\":\"1\"}", 10));
+    CHECK(blynk_resp_finish(&p));
+    CHECK(!strcmp(log.text, "2=1;"));
+}
+
+/* deep nesting inside a value is skipped up to the depth limit */
+static void test_deep_nesting(void)
+{
+    char body[1200];
+    value_log_t log;
+    size_t n = 0;
+
+    n += sprintf(body + n, "{\"v2\":");
+    for (int i = 0; i < 254; i++)
+        body[n++] = '[';
+    n += sprintf(body + n, "\"x\"");
+    for (int i = 0; i < 254; i++)
+        body[n++] = ']';
+    n += sprintf(body + n, ",\"v4\":\"y\"}");
+    body[n] = 0;
+    CHECK(parse_whole(body, 8, &log));
+    CHECK(!strcmp(log.text, "2=x;4=y;"));
+
+    // one level more than the counter holds
+    n = sprintf(body, "{\"v2\":");
+    for (int i = 0; i < 256; i++)
+        body[n++] = '[';
+    body[n] = 0;
+    CHECK(!parse_whole(body, 8, &log));
+}
+
+static uint32_t rng = 1;
+
+static uint32_t rand_next(void)
+{
+    rng = rng * 1103515245 + 12345;
+    return rng >> 16;
+}
+
+/* random cuts, ascending, at most `max` */
+static size_t random_cuts(size_t len, size_t *cuts, size_t max)
+{
+    size_t n = 0, at = 0;
+
+    while (n < max && len > at)
+    {
+        at += 1 + rand_next() % 8;
+        if (at >= len)
+            break;
+        cuts[n++] = at;
+    }
+    return n;
+}
+
+/*
+ * Random bytes and mutated bodies: no overrun, every value terminated
+ * within the buffer, and the same values and result however the body is
+ * split.
+ */
+static void test_fuzz(void)
+{
+    static const char alphabet[] = "{}[]\":,\\u0aAvV 1\n";
+    char body[128];
+    size_t cuts[128];
+    int differ = 0, bad = 0, done = 0;
+
+    for (int round = 0; round < 20000; round++)
+    {
+        size_t len;
+        if (round & 1)
+        {
+            // a valid body with a few bytes changed, inserted or removed
+            const char *src = cases[rand_next() % 18].body;
+            len = strlen(src);
+            memcpy(body, src, len);
+            for (uint32_t m = 1 + rand_next() % 3; m; m--)
+            {
+                size_t at = len ? rand_next() % len : 0;
+                char c = rand_next() & 1 ? alphabet[rand_next() % (sizeof(alphabet) - 1)] : (char)rand_next();
+                switch (rand_next() % 3)
+                {
+                case 0:
+                    if (len)
+                        body[at] = c;
+                    break;
+                case 1:
+                    if (len < sizeof(body) - 1)
+                    {
+                        memmove(body + at + 1, body + at, len - at);
+                        body[at] = c;
+                        len++;
+                    }
+                    break;
+                default:
+                    if (len)
+                    {
+                        memmove(body + at, body + at + 1, len - at - 1);
+                        len--;
+                    }
+                    break;
+                }
+            }
+        }
+        else
+        {
+            len = rand_next() % 64;
+            for (size_t i = 0; i < len; i++)
+                body[i] = rand_next() % 4 ? alphabet[rand_next() % (sizeof(alphabet) - 1)] : (char)rand_next();
+        }
+
+        size_t size = 2 + rand_next() % 10;
+        value_log_t whole, split;
+        bool a = parse(body, len, NULL, 0, size, &whole);
+        bool b = parse(body, len, cuts, random_cuts(len, cuts, 128), size, &split);
+        if (a != b || whole.len != split.len || memcmp(whole.text, split.text, whole.len))
+            differ++;
+        if (whole.bad || split.bad)
+            bad++;
+        done += a;
+    }
+    printf("fuzz: %d of 20000 bodies well-formed\n", done);
+    CHECK_EQ(differ, 0);
+    CHECK_EQ(bad, 0);
+    CHECK(done > 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_forms);
+    TEST_RUN(test_split_everywhere);
+    TEST_RUN(test_truncation);
+    TEST_RUN(test_reset);
+    TEST_RUN(test_deep_nesting);
+    TEST_RUN(test_fuzz);
+    return TEST_EXIT();
+}
@@ -0,0 +1,156 @@
+/**
+ * @file test_ctrl_state.c
+ *
+ * Control pin cache refreshed from the loopback stand-in: one request
+ * whatever the number of pins, and the typed getters on the values
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+#include "blynk_resp.h"
+#include "ctrl_state.h"
+#include "http_conn.h"
+#include "http_standin.h"
+#include "url_builder.h"
+
+#include "test.h"
+
+#define TOKEN   "test-token"
+
+static uint16_t port;
+static int changes[CTRL_STATE_MAX_PINS];
+
+static void on_data(const char *data, size_t len, void *ctx)
+{
+    blynk_resp_t *parser = ctx;
+
+    if (!data)
+        blynk_resp_reset(parser);
+    else
+        blynk_resp_feed(parser, data, len);
+}
+
+/* read_pins() of app_main.c against the stand-in */
+static esp_err_t fetch(const int *vpins, size_t count, ctrl_state_cb_t on_value, void *ctx)
+{
+    char buf[256];
+    char value[CTRL_STATE_VALUE_LEN];
+    url_builder_t url;
+    blynk_resp_t parser;
+    int status = 0;
+
+    url_init(&url, buf, sizeof(buf));
+    url_append_str(&url, "http://127.0.0.1:");
+    url_append_int(&url, port);
+    url_append_str(&url, "/external/api/get?token=" TOKEN);
+    for (size_t i = 0; i < count; i++)
+    {
+        url_append(&url, "&v", 2);
+        url_append_int(&url, vpins[i]);
+    }
+    if (!url_finish(&url))
+        return ESP_ERR_INVALID_SIZE;
+
+    blynk_resp_init(&parser, vpins, count, value, sizeof(value), on_value, ctx);
+    esp_err_t err = http_conn_get_stream(HTTP_CONN_EP_GET, buf, on_data, &parser, &status);
+    if (err == ESP_OK && (status != 200 || !blynk_resp_finish(&parser)))
+        err = ESP_ERR_INVALID_RESPONSE;
+    return err;
+}
+
+static void on_change(int vpin, const char *value, void *ctx)
+{
+    changes[vpin]++;
+}
+
+/* pins added one by one, every refresh is still a single GET */
+static void test_one_request(void)
+{
+    http_standin_stats_t before, after;
+    ctrl_state_stats_t stats;
+    char value[HTTP_STANDIN_VALUE_LEN];
+
+    for (int pin = 0; pin < CTRL_STATE_MAX_PINS; pin++)
+    {
+        snprintf(value, sizeof(value), "%d.5", pin);
+        http_standin_set_pin(pin, value);
+        CHECK_EQ(ctrl_state_register(pin, on_change, NULL), ESP_OK);
+
+        http_standin_get_stats(&before);
+        CHECK_EQ(ctrl_state_refresh(), ESP_OK);
+        http_standin_get_stats(&after);
+        CHECK_EQ(after.requests - before.requests, 1);
+        CHECK_EQ(after.gets - before.gets, 1);
+
+        // the new pin arrived with the others, and only it changed
+        for (int p = 0; p <= pin; p++)
+            CHECK_EQ(changes[p], 1);
+    }
+    CHECK_EQ(ctrl_state_register(CTRL_STATE_MAX_PINS, NULL, NULL), ESP_ERR_NO_MEM);
+
+    ctrl_state_get_stats(&stats);
+    CHECK_EQ(stats.refreshes, CTRL_STATE_MAX_PINS);
+    CHECK_EQ(stats.failures, 0);
+    CHECK_EQ(stats.changes, CTRL_STATE_MAX_PINS);
+    CHECK_EQ(stats.updates, CTRL_STATE_MAX_PINS * (CTRL_STATE_MAX_PINS + 1) / 2);
+
+    // a change made in the app reaches its callback on the next refresh
+    http_standin_set_pin(7, "on");
+    CHECK_EQ(ctrl_state_refresh(), ESP_OK);
+    CHECK_EQ(changes[7], 2);
+    CHECK_EQ(changes[6], 1);
+}
+
+static void test_getters(void)
+{
+    char buf[CTRL_STATE_VALUE_LEN];
+    int32_t i;
+    float f;
+    bool b;
+
+    CHECK(ctrl_state_get_str(3, buf, sizeof(buf)));
+    CHECK(!strcmp(buf, "3.5"));
+    CHECK(ctrl_state_get_int(3, &i));
+    CHECK_EQ(i, 3);
+    CHECK(ctrl_state_get_float(3, &f));
+    CHECK(f == 3.5f);
+    // a slider value is no switch
+    CHECK(!ctrl_state_get_bool(3, &b));
+
+    CHECK(ctrl_state_get_bool(7, &b));
+    CHECK(b);
+    CHECK(!ctrl_state_get_int(7, &i));
+    CHECK(!ctrl_state_get_float(7, &f));
+
+    CHECK(ctrl_state_update(0, "0"));
+    CHECK(ctrl_state_get_bool(0, &b));
+    CHECK(!b);
+    CHECK(ctrl_state_update(1, "-12"));
+    CHECK(ctrl_state_get_int(1, &i));
+    CHECK_EQ(i, -12);
+
+    // truncated to the buffer
+    CHECK(ctrl_state_get_str(10, buf, 3));
+    CHECK(!strcmp(buf, "10"));
+
+    // unknown pins leave the outputs alone
+    i = 42;
+    CHECK(!ctrl_state_get_int(20, &i));
+    CHECK_EQ(i, 42);
+    CHECK(!ctrl_state_update(20, "1"));
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_NONE);
+    if (http_standin_start(TOKEN, &port) != ESP_OK || http_conn_init() != ESP_OK
+        || ctrl_state_init(fetch) != ESP_OK)
+        return 1;
+
+    TEST_RUN(test_one_request);
+    TEST_RUN(test_getters);
+    http_standin_stop();
+    return TEST_EXIT();
+}
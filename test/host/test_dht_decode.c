@@ -0,0 +1,296 @@
+/**
+ * @file test_dht_decode.c
+ *
+ * Decoder of the DHT pulse train, on captures built from known bytes
+ */
+#include <string.h>
+
+#include <dht_decode.h>
+
+#include "test.h"
+
+static const uint8_t sample[DHT_DATA_BYTES] = { 0x02, 0x5D, 0x00, 0xF7, 0x56 };    // 60.5 %, 24.7 C
+
+// humidity/temperature patterns of the supported types, checksums included
+static const uint8_t corpus[][DHT_DATA_BYTES] = {
+    { 0x02, 0x5D, 0x00, 0xF7, 0x56 },   // AM2301 60.5 %, 24.7 C
+    { 0x03, 0xE8, 0x80, 0x65, 0xD0 },   // AM2301 100 %, -10.1 C
+    { 0x37, 0x00, 0x17, 0x00, 0x4E },   // DHT11 55 %, 23 C
+    { 0x00, 0x00, 0x00, 0x00, 0x00 },   // every bit '0'
+    { 0xFF, 0xFF, 0xFF, 0xFF, 0xFC },   // nearly every bit '1'
+    { 0x01, 0x90, 0x01, 0x3E, 0xD0 },   // Si7021 40.0 %, 31.8 C
+};
+
+static uint32_t rng = 1;
+
+static int rand_range(int lo, int hi)
+{
+    rng = rng * 1103515245 + 12345;
+    return lo + (int)((rng >> 16) % (uint32_t)(hi - lo + 1));
+}
+
+static bool bit_of(const uint8_t data[DHT_DATA_BYTES], int i)
+{
+    return data[i / 8] & (0x80 >> (i % 8));
+}
+
+/* bit pulses with every width off by up to `jitter` us, '0' and '1' HIGHs given */
+static void make_pulses(const uint8_t data[DHT_DATA_BYTES], int jitter, int low, int zero, int one,
+        dht_pulse_t pulses[DHT_DATA_BITS])
+{
+    for (int i = 0; i < DHT_DATA_BITS; i++)
+    {
+        pulses[i].low = low + rand_range(-jitter, jitter);
+        pulses[i].high = (bit_of(data, i) ? one : zero) + rand_range(-jitter, jitter);
+    }
+}
+
+/* segments of an RMT capture: phase B HIGH, preamble, bits, final LOW, end marker */
+static size_t make_edges(const uint8_t data[DHT_DATA_BYTES], dht_edge_t *edges)
+{
+    size_t n = 0;
+
+    edges[n++] = (dht_edge_t){ 30, 1 };
+    edges[n++] = (dht_edge_t){ 80, 0 };
+    edges[n++] = (dht_edge_t){ 80, 1 };
+    for (int i = 0; i < DHT_DATA_BITS; i++)
+    {
+        edges[n++] = (dht_edge_t){ 50, 0 };
+        edges[n++] = (dht_edge_t){ bit_of(data, i) ? 70 : 26, 1 };
+    }
+    edges[n++] = (dht_edge_t){ 50, 0 };
+    edges[n++] = (dht_edge_t){ 0, 1 };
+    return n;
+}
+
+static void test_edges(void)
+{
+    dht_edge_t edges[100];
+    dht_pulse_t pulses[DHT_DATA_BITS];
+    uint8_t data[DHT_DATA_BYTES];
+    uint16_t preamble = 0;
+
+    size_t n = make_edges(sample, edges);
+    CHECK_EQ(dht_decode_edges(edges, n, pulses, &preamble), DHT_DECODE_OK);
+    CHECK_EQ(preamble, 80);
+    dht_decode_pulses(pulses, data);
+    CHECK(!memcmp(data, sample, sizeof(data)));
+}
+
+/* RMT splits long levels over two items, and the line may glitch before the answer */
+static void test_edges_merged(void)
+{
+    dht_edge_t edges[110];
+    dht_edge_t split[110];
+    dht_pulse_t pulses[DHT_DATA_BITS];
+    uint8_t data[DHT_DATA_BYTES];
+    uint16_t preamble = 0;
+    size_t m = 0;
+
+    size_t n = make_edges(sample, edges);
+    split[m++] = (dht_edge_t){ 5, 0 };     // glitch, too short for a preamble
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i == 1 || i == 2)
+        {
+            split[m++] = (dht_edge_t){ edges[i].duration - 20, edges[i].level };
+            split[m++] = (dht_edge_t){ 20, edges[i].level };
+        }
+        else
+            split[m++] = edges[i];
+    }
+    CHECK_EQ(dht_decode_edges(split, m, pulses, &preamble), DHT_DECODE_OK);
+    CHECK_EQ(preamble, 80);
+    dht_decode_pulses(pulses, data);
+    CHECK(!memcmp(data, sample, sizeof(data)));
+}
+
+static void test_edges_truncated(void)
+{
+    dht_edge_t edges[100];
+    dht_pulse_t pulses[DHT_DATA_BITS];
+
+    make_edges(sample, edges);
+    // preamble and 30 bits
+    CHECK_EQ(dht_decode_edges(edges, 3 + 60, pulses, NULL), DHT_DECODE_TRUNCATED);
+}
+
+static void test_edges_no_preamble(void)
+{
+    dht_edge_t edges[100];
+    dht_pulse_t pulses[DHT_DATA_BITS];
+    uint16_t preamble = 1;
+
+    size_t n = make_edges(sample, edges);
+    edges[1].duration = 40;     // phase C too short
+    CHECK_EQ(dht_decode_edges(edges, 3, pulses, &preamble), DHT_DECODE_NO_PREAMBLE);
+    CHECK_EQ(preamble, 0);
+    CHECK_EQ(dht_decode_edges(edges, 0, pulses, NULL), DHT_DECODE_NO_PREAMBLE);
+    // the bits alone never look like a preamble
+    CHECK_EQ(dht_decode_edges(edges + 3, n - 3, pulses, NULL), DHT_DECODE_NO_PREAMBLE);
+}
+
+static void test_checksum(void)
+{
+    uint8_t data[DHT_DATA_BYTES];
+
+    CHECK(dht_decode_checksum_ok(sample));
+    memcpy(data, sample, sizeof(data));
+    data[4]++;
+    CHECK(!dht_decode_checksum_ok(data));
+    // the sum wraps
+    const uint8_t wrap[DHT_DATA_BYTES] = { 0xFF, 0xFF, 0x01, 0x02, 0x01 };
+    CHECK(dht_decode_checksum_ok(wrap));
+}
+
+/* every pattern under increasing jitter, nothing lost up to 12 us */
+static void test_jitter_corpus(void)
+{
+    for (int jitter = 0; jitter <= 12; jitter += 4)
+    {
+        int ok = 0, total = 0;
+        for (size_t c = 0; c < sizeof(corpus) / sizeof(corpus[0]); c++)
+        {
+            for (int round = 0; round < 500; round++)
+            {
+                dht_pulse_t pulses[DHT_DATA_BITS];
+                uint8_t data[DHT_DATA_BYTES];
+                dht_decode_info_t info;
+
+                make_pulses(corpus[c], jitter, 50, 26, 70, pulses);
+                uint16_t preamble = 80 + rand_range(-jitter, jitter);
+                if (dht_decode_adaptive(pulses, preamble, data, &info) && !memcmp(data, corpus[c], sizeof(data)))
+                    ok++;
+                total++;
+            }
+        }
+        if (ok != total)
+            fprintf(stderr, "jitter %d us: %d of %d decoded\n", jitter, ok, total);
+        CHECK_EQ(ok, total);
+    }
+}
+
+/*
+ * A long cable slows the edges: '1' shrinks, '0' grows and the LOW
+ * stretches. Comparing HIGH with LOW reads every '1' as '0', the adaptive
+ * threshold still splits the two clusters.
+ */
+static void test_slow_edges(void)
+{
+    dht_pulse_t pulses[DHT_DATA_BITS];
+    uint8_t data[DHT_DATA_BYTES];
+    dht_decode_info_t info;
+
+    make_pulses(sample, 2, 58, 34, 54, pulses);
+    dht_decode_pulses(pulses, data);
+    CHECK(memcmp(data, sample, sizeof(data)));
+
+    CHECK(dht_decode_adaptive(pulses, 72, data, &info));
+    CHECK(!memcmp(data, sample, sizeof(data)));
+    CHECK(info.threshold > 36 && info.threshold < 52);
+}
+
+/* with a single cluster the threshold comes from the preamble, then from the LOWs */
+static void test_uniform(void)
+{
+    const uint8_t zeros[DHT_DATA_BYTES] = { 0 };
+    dht_pulse_t pulses[DHT_DATA_BITS];
+    uint8_t data[DHT_DATA_BYTES];
+    dht_decode_info_t info;
+
+    make_pulses(zeros, 3, 50, 26, 70, pulses);
+    CHECK(dht_decode_adaptive(pulses, 80, data, &info));
+    CHECK(!memcmp(data, zeros, sizeof(data)));
+    CHECK_EQ(info.threshold, 48);
+    CHECK(dht_decode_adaptive(pulses, 0, data, &info));
+    CHECK(!memcmp(data, zeros, sizeof(data)));
+    CHECK(info.threshold >= 47 && info.threshold <= 53);
+}
+
+/* one bit near the threshold read wrong is fixed against the checksum */
+static void test_bit_flip_corrected(void)
+{
+    dht_pulse_t pulses[DHT_DATA_BITS];
+    uint8_t data[DHT_DATA_BYTES];
+    dht_decode_info_t info;
+
+    make_pulses(sample, 0, 50, 26, 70, pulses);
+    pulses[17].high = 50;   // '0' stretched
+    CHECK(dht_decode_adaptive(pulses, 80, data, &info));
+    CHECK(!memcmp(data, sample, sizeof(data)));
+    CHECK_EQ(info.corrected_bit, 17);
+
+    make_pulses(sample, 0, 50, 26, 70, pulses);
+    pulses[15].high = 44;   // '1' shrunk
+    CHECK(dht_decode_adaptive(pulses, 80, data, &info));
+    CHECK(!memcmp(data, sample, sizeof(data)));
+    CHECK_EQ(info.corrected_bit, 15);
+}
+
+/*
+ * Any bit of any pattern moved anywhere between the clusters: the read is
+ * right, corrected or refused, never wrong. A flip is refused when another
+ * ambiguous bit, usually in the checksum byte, would match as well.
+ */
+static void test_bit_flip_sweep(void)
+{
+    int wrong = 0, corrected = 0;
+
+    for (size_t c = 0; c < sizeof(corpus) / sizeof(corpus[0]); c++)
+    {
+        for (int bit = 0; bit < DHT_DATA_BITS; bit++)
+        {
+            for (uint16_t high = 30; high <= 66; high += 2)
+            {
+                dht_pulse_t pulses[DHT_DATA_BITS];
+                uint8_t data[DHT_DATA_BYTES];
+                dht_decode_info_t info;
+
+                make_pulses(corpus[c], 0, 50, 26, 70, pulses);
+                pulses[bit].high = high;
+                if (!dht_decode_adaptive(pulses, 80, data, &info))
+                    continue;
+                if (memcmp(data, corpus[c], sizeof(data)))
+                    wrong++;
+                else if (info.corrected_bit == bit)
+                    corrected++;
+            }
+        }
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK(corrected > 0);
+}
+
+/* two bad bits, or one far from the threshold, are not guessed */
+static void test_bit_flip_rejected(void)
+{
+    dht_pulse_t pulses[DHT_DATA_BITS];
+    uint8_t data[DHT_DATA_BYTES];
+    dht_decode_info_t info;
+
+    make_pulses(sample, 0, 50, 26, 70, pulses);
+    pulses[6].high = 44;    // '1'
+    pulses[7].high = 44;    // '1'
+    CHECK(!dht_decode_adaptive(pulses, 80, data, &info));
+
+    make_pulses(sample, 0, 50, 26, 70, pulses);
+    pulses[6].high = 26;    // '1' read as a clean '0'
+    CHECK(!dht_decode_adaptive(pulses, 80, data, &info));
+    CHECK_EQ(info.corrected_bit, -1);
+}
+
+int main(void)
+{
+    TEST_RUN(test_edges);
+    TEST_RUN(test_edges_merged);
+    TEST_RUN(test_edges_truncated);
+    TEST_RUN(test_edges_no_preamble);
+    TEST_RUN(test_checksum);
+    TEST_RUN(test_jitter_corpus);
+    TEST_RUN(test_slow_edges);
+    TEST_RUN(test_uniform);
+    TEST_RUN(test_bit_flip_corrected);
+    TEST_RUN(test_bit_flip_sweep);
+    TEST_RUN(test_bit_flip_rejected);
+    return TEST_EXIT();
+}
@@ -0,0 +1,178 @@
+/**
+ * @file test_dht_sim.c
+ *
+ * Reads through the bit-banged driver from the simulated line
+ */
+#include <dht.h>
+#include <dht_decode.h>
+#include <dht_sim.h>
+#include <esp_log.h>
+
+#include "host.h"
+#include "test.h"
+
+#define PIN     4
+
+static void read_type(dht_sensor_type_t type, int16_t humidity, int16_t temperature)
+{
+    dht_sim_config_t config = { .type = type, .humidity = humidity, .temperature = temperature,
+                                .jitter_us = CONFIG_DHT_SIM_JITTER_US };
+    int16_t h = 0, t = 0;
+
+    CHECK_EQ(dht_sim_attach(PIN, &config), ESP_OK);
+    CHECK_EQ(dht_read_data(type, PIN, &h, &t), ESP_OK);
+    CHECK_EQ(h, humidity);
+    CHECK_EQ(t, temperature);
+    dht_sim_detach(PIN);
+}
+
+static void test_types(void)
+{
+    read_type(DHT_TYPE_DHT11, 550, 230);
+    read_type(DHT_TYPE_AM2301, 613, 247);
+    read_type(DHT_TYPE_AM2301, 1000, -125);
+    read_type(DHT_TYPE_SI7021, 402, 318);
+}
+
+static void test_float(void)
+{
+    dht_sim_config_t config = { .type = DHT_TYPE_AM2301, .humidity = 455, .temperature = -32 };
+    float h, t;
+
+    dht_sim_attach(PIN, &config);
+    CHECK_EQ(dht_read_float_data(DHT_TYPE_AM2301, PIN, &h, &t), ESP_OK);
+    CHECK(h > 45.49f && h < 45.51f);
+    CHECK(t > -3.21f && t < -3.19f);
+    dht_sim_detach(PIN);
+}
+
+/* every pulse off by up to 8 us, the margin of the 88 us preamble timeouts */
+static void test_jitter(void)
+{
+    dht_stats_t stats;
+    int ok = 0;
+
+    dht_reset_stats(PIN);
+    for (uint32_t seed = 1; seed <= 50; seed++)
+    {
+        dht_sim_config_t config = { .type = DHT_TYPE_AM2301, .humidity = 500 + seed, .temperature = 200 + seed,
+                                    .jitter_us = 8, .seed = seed };
+        int16_t h, t;
+
+        dht_sim_attach(PIN, &config);
+        if (dht_read_data(DHT_TYPE_AM2301, PIN, &h, &t) == ESP_OK && h == config.humidity && t == config.temperature)
+            ok++;
+        dht_sim_detach(PIN);
+    }
+    CHECK_EQ(ok, 50);
+    CHECK_EQ(dht_get_stats(PIN, &stats), ESP_OK);
+    CHECK_EQ(stats.reads, 50);
+    CHECK_EQ(stats.errors.crc_failures, 0);
+}
+
+static void test_values_change(void)
+{
+    dht_sim_config_t config = { .type = DHT_TYPE_AM2301, .humidity = 300, .temperature = 100 };
+    int16_t h, t;
+
+    dht_sim_attach(PIN, &config);
+    CHECK_EQ(dht_sim_set_values(PIN, 350, 150), ESP_OK);
+    CHECK_EQ(dht_read_data(DHT_TYPE_AM2301, PIN, &h, &t), ESP_OK);
+    CHECK_EQ(h, 350);
+    CHECK_EQ(t, 150);
+    dht_sim_detach(PIN);
+}
+
+/* nobody answers on a detached line */
+static void test_no_sensor(void)
+{
+    dht_stats_t stats;
+    int16_t h, t;
+
+    dht_reset_stats(PIN);
+    CHECK_EQ(dht_read_data(DHT_TYPE_AM2301, PIN, &h, &t), ESP_ERR_TIMEOUT);
+    dht_get_stats(PIN, &stats);
+    CHECK_EQ(stats.reads, 1);
+    CHECK_EQ(stats.errors.phase_b_timeouts, 1);
+    CHECK_EQ(stats.last_fault, DHT_FAULT_PHASE_B);
+    CHECK_EQ(host_critical_depth(), 0);
+    CHECK_EQ(dht_sim_set_values(PIN, 1, 1), ESP_ERR_INVALID_STATE);
+}
+
+/* one fault injected in the answer, the counter it lands in */
+static dht_stats_t read_fault(dht_sim_fault_t fault, uint8_t bit, esp_err_t expected)
+{
+    dht_sim_config_t config = { .type = DHT_TYPE_AM2301, .humidity = 500, .temperature = 200,
+                                .fault = fault, .fault_bit = bit };
+    dht_stats_t stats;
+    int16_t h, t;
+
+    dht_reset_stats(PIN);
+    dht_sim_attach(PIN, &config);
+    CHECK_EQ(dht_read_data(DHT_TYPE_AM2301, PIN, &h, &t), expected);
+    CHECK_EQ(host_critical_depth(), 0);
+    dht_sim_detach(PIN);
+    dht_get_stats(PIN, &stats);
+    CHECK_EQ(stats.reads, 1);
+    return stats;
+}
+
+static void test_faults(void)
+{
+    dht_stats_t s;
+
+    s = read_fault(DHT_SIM_FAULT_NO_PHASE_C, 0, ESP_ERR_TIMEOUT);
+    CHECK_EQ(s.last_fault, DHT_FAULT_PHASE_C);
+    CHECK_EQ(s.errors.phase_c_timeouts, 1);
+
+    s = read_fault(DHT_SIM_FAULT_NO_PHASE_D, 0, ESP_ERR_TIMEOUT);
+    CHECK_EQ(s.last_fault, DHT_FAULT_PHASE_D);
+    CHECK_EQ(s.errors.phase_d_timeouts, 1);
+
+    // first, middle and last bit
+    for (int bit = 0; bit < DHT_DATA_BITS; bit += 19)
+    {
+        s = read_fault(DHT_SIM_FAULT_BIT_LOW, bit, ESP_ERR_TIMEOUT);
+        CHECK_EQ(s.last_fault, DHT_FAULT_BIT_LOW);
+        CHECK_EQ(s.errors.bit_timeouts, 1);
+
+        s = read_fault(DHT_SIM_FAULT_BIT_HIGH, bit, ESP_ERR_TIMEOUT);
+        CHECK_EQ(s.last_fault, DHT_FAULT_BIT_HIGH);
+        CHECK_EQ(s.errors.bit_timeouts, 1);
+    }
+
+    s = read_fault(DHT_SIM_FAULT_CHECKSUM, 0, ESP_ERR_INVALID_CRC);
+    CHECK_EQ(s.last_fault, DHT_FAULT_CRC);
+    CHECK_EQ(s.errors.crc_failures, 1);
+    CHECK_EQ(s.errors.phase_b_timeouts + s.errors.phase_c_timeouts + s.errors.phase_d_timeouts
+             + s.errors.bit_timeouts, 0);
+
+    // a good read after the faults clears the last one
+    s = read_fault(DHT_SIM_FAULT_NONE, 0, ESP_OK);
+    CHECK_EQ(s.last_fault, DHT_FAULT_NONE);
+    CHECK_EQ(s.errors.crc_failures, 0);
+}
+
+static void test_bad_args(void)
+{
+    uint8_t data[DHT_RAW_LEN];
+
+    CHECK_EQ(dht_read_raw(DHT_TYPE_AM2301, -1, data), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(dht_read_raw(DHT_TYPE_AM2301, GPIO_NUM_MAX, data), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(dht_read_raw(DHT_TYPE_AM2301, PIN, NULL), ESP_ERR_INVALID_ARG);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_NONE);
+    host_clock_virtual(true);
+
+    TEST_RUN(test_types);
+    TEST_RUN(test_float);
+    TEST_RUN(test_jitter);
+    TEST_RUN(test_values_change);
+    TEST_RUN(test_no_sensor);
+    TEST_RUN(test_faults);
+    TEST_RUN(test_bad_args);
+    return TEST_EXIT();
+}
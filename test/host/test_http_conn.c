@@ -0,0 +1,137 @@
+/**
+ * @file test_http_conn.c
+ *
+ * Keep-alive requests against the loopback stand-in: one connection for
+ * many requests, the retry on a fresh connection once the server has
+ * closed the idle one, and the failure once it is gone
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+#include "http_conn.h"
+#include "http_standin.h"
+
+#include "test.h"
+
+#define TOKEN   "test-token"
+
+static char get_url[128];
+static char update_url[128];
+
+static esp_err_t get(char *resp, size_t size, int *status)
+{
+    return http_conn_get(HTTP_CONN_EP_GET, get_url, resp, size, status);
+}
+
+static void test_keep_alive(void)
+{
+    http_conn_stats_t stats;
+    http_standin_stats_t server;
+    char resp[16];
+
+    for (int i = 0; i < 5; i++)
+    {
+        int status = 0;
+        CHECK_EQ(get(resp, sizeof(resp), &status), ESP_OK);
+        CHECK_EQ(status, 200);
+        CHECK(!strcmp(resp, "1"));
+    }
+    http_conn_get_stats(HTTP_CONN_EP_GET, &stats);
+    http_standin_get_stats(&server);
+    CHECK_EQ(stats.requests, 5);
+    CHECK_EQ(stats.connects, 1);
+    CHECK_EQ(stats.reconnects, 0);
+    CHECK_EQ(server.connections, 1);
+    CHECK_EQ(server.gets, 5);
+}
+
+/* the idle socket closed by the server costs a retry, not the request */
+static void test_idle_close(void)
+{
+    http_conn_stats_t before, after;
+    http_standin_stats_t server_before, server;
+    char resp[16];
+    int status = 0;
+
+    http_conn_get_stats(HTTP_CONN_EP_GET, &before);
+    http_standin_get_stats(&server_before);
+    http_standin_drop_connections();
+
+    CHECK_EQ(get(resp, sizeof(resp), &status), ESP_OK);
+    CHECK_EQ(status, 200);
+    CHECK(!strcmp(resp, "1"));
+    http_conn_get_stats(HTTP_CONN_EP_GET, &after);
+    http_standin_get_stats(&server);
+    CHECK_EQ(after.requests, before.requests + 1);
+    CHECK_EQ(after.reconnects, before.reconnects + 1);
+    CHECK_EQ(after.connects, before.connects + 1);
+    CHECK_EQ(after.failures, before.failures);
+    CHECK_EQ(server.connections, server_before.connections + 1);
+    CHECK_EQ(server.gets, server_before.gets + 1);
+
+    // and the new connection is kept
+    CHECK_EQ(get(resp, sizeof(resp), &status), ESP_OK);
+    http_conn_get_stats(HTTP_CONN_EP_GET, &after);
+    CHECK_EQ(after.reconnects, before.reconnects + 1);
+    CHECK_EQ(after.connects, before.connects + 1);
+}
+
+/* each endpoint has a connection of its own */
+static void test_endpoints(void)
+{
+    static const char body[] = "[[1700000000000,24.7]]";
+    http_conn_stats_t stats;
+    http_standin_stats_t server;
+    char resp[16];
+    int status = 0;
+
+    CHECK_EQ(http_conn_post(HTTP_CONN_EP_UPDATE, update_url, "application/json", body, sizeof(body) - 1,
+                            resp, sizeof(resp), &status), ESP_OK);
+    CHECK_EQ(status, 200);
+    http_standin_drop_connections();
+    CHECK_EQ(http_conn_post(HTTP_CONN_EP_UPDATE, update_url, "application/json", body, sizeof(body) - 1,
+                            NULL, 0, &status), ESP_OK);
+    http_conn_get_stats(HTTP_CONN_EP_UPDATE, &stats);
+    http_standin_get_stats(&server);
+    CHECK_EQ(stats.requests, 2);
+    CHECK_EQ(stats.connects, 2);
+    CHECK_EQ(stats.reconnects, 1);
+    CHECK_EQ(server.posts, 2);
+    CHECK_EQ(server.post_bytes, 2 * (sizeof(body) - 1));
+}
+
+/* with the server gone the retry fails too, and the request with it */
+static void test_server_gone(void)
+{
+    http_conn_stats_t before, after;
+    char resp[16];
+    int status = 0;
+
+    http_conn_get_stats(HTTP_CONN_EP_GET, &before);
+    http_standin_stop();
+    CHECK(get(resp, sizeof(resp), &status) != ESP_OK);
+    http_conn_get_stats(HTTP_CONN_EP_GET, &after);
+    CHECK_EQ(after.requests, before.requests + 1);
+    CHECK_EQ(after.reconnects, before.reconnects + 1);
+    CHECK_EQ(after.failures, before.failures + 1);
+}
+
+int main(void)
+{
+    uint16_t port = 0;
+
+    esp_log_level_set("*", ESP_LOG_NONE);
+    if (http_standin_start(TOKEN, &port) != ESP_OK || http_conn_init() != ESP_OK)
+        return 1;
+    http_standin_set_pin(2, "1");
+    snprintf(get_url, sizeof(get_url), "http://127.0.0.1:%u/external/api/get?token=" TOKEN "&v2", port);
+    snprintf(update_url, sizeof(update_url), "http://127.0.0.1:%u/external/api/batch/update?token=" TOKEN, port);
+
+    TEST_RUN(test_keep_alive);
+    TEST_RUN(test_idle_close);
+    TEST_RUN(test_endpoints);
+    TEST_RUN(test_server_gone);
+    return TEST_EXIT();
+}
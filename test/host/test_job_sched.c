@@ -0,0 +1,237 @@
+/**
+ * @file test_job_sched.c
+ *
+ * Job scheduler driven by a virtual clock: the loop sleeps by moving the
+ * clock forward by the returned wait, and jobs spend time the same way
+ */
+#include "job_sched.h"
+
+#include "test.h"
+
+static uint64_t now_us;
+
+static uint64_t virtual_clock(void)
+{
+    return now_us;
+}
+
+typedef struct
+{
+    uint32_t    period_ms;      // returned delay
+    uint32_t    cost_ms;        // virtual time spent per run
+    uint32_t    runs;
+    uint64_t    run_at_us[64];
+} job_ctx_t;
+
+static uint32_t job_body(void *arg)
+{
+    job_ctx_t *ctx = arg;
+
+    if (ctx->runs < 64)
+        ctx->run_at_us[ctx->runs] = now_us;
+    ctx->runs++;
+    now_us += (uint64_t)ctx->cost_ms * 1000;
+    return ctx->period_ms;
+}
+
+/* the event loop: run the due jobs, sleep until the next one, up to `until_ms` */
+static void loop_until(job_sched_t *sched, uint64_t until_ms)
+{
+    while (now_us < until_ms * 1000)
+    {
+        uint32_t wait = job_sched_run(sched);
+        if (wait == JOB_IDLE || now_us + (uint64_t)wait * 1000 > until_ms * 1000)
+            now_us = until_ms * 1000;
+        else
+            now_us += (uint64_t)(wait ? wait : 1) * 1000;
+    }
+}
+
+static void test_periodic(void)
+{
+    job_sched_t sched;
+    job_ctx_t a = { .period_ms = 2000 };
+
+    now_us = 0;
+    job_sched_init(&sched, virtual_clock, 0);
+    int id = job_sched_add(&sched, "a", job_body, &a, 0);
+    CHECK_EQ(id, 0);
+
+    loop_until(&sched, 60000);
+    CHECK_EQ(a.runs, 30);
+    for (uint32_t i = 0; i < 30; i++)
+        CHECK_EQ(a.run_at_us[i], i * 2000000ULL);
+    CHECK_EQ(sched.jobs[id].max_late_ms, 0);
+    CHECK_EQ(sched.wakeups, 30);
+}
+
+/* jobs due within the slack run in the same wakeup */
+static void test_coalescing(void)
+{
+    job_sched_t sched;
+    job_ctx_t a = { .period_ms = 1000 }, b = { .period_ms = 1000 };
+
+    now_us = 0;
+    job_sched_init(&sched, virtual_clock, 100);
+    job_sched_add(&sched, "a", job_body, &a, 1000);
+    job_sched_add(&sched, "b", job_body, &b, 1050);
+
+    loop_until(&sched, 10000);
+    CHECK_EQ(a.runs, 9);
+    CHECK_EQ(b.runs, 9);
+    CHECK_EQ(sched.wakeups, 9);
+    // b ran early with a, never late
+    CHECK_EQ(b.run_at_us[0], 1000000);
+    CHECK_EQ(sched.jobs[1].max_late_ms, 0);
+
+    // without slack every job wakes the loop on its own
+    now_us = 0;
+    a.runs = b.runs = 0;
+    job_sched_init(&sched, virtual_clock, 0);
+    job_sched_add(&sched, "a", job_body, &a, 1000);
+    job_sched_add(&sched, "b", job_body, &b, 1050);
+    loop_until(&sched, 10000);
+    CHECK_EQ(sched.wakeups, 18);
+}
+
+static job_sched_t *trigger_sched;
+static int trigger_id;
+
+/* wakes another job, as the sensor callback does from its own task */
+static uint32_t trigger_body(void *arg)
+{
+    job_sched_trigger(trigger_sched, trigger_id);
+    return JOB_IDLE;
+}
+
+static void test_trigger(void)
+{
+    job_sched_t sched;
+    job_ctx_t idle = { .period_ms = JOB_IDLE };
+    job_ctx_t tick = { .period_ms = 5000 };
+
+    now_us = 0;
+    job_sched_init(&sched, virtual_clock, 0);
+    int id = job_sched_add(&sched, "idle", job_body, &idle, JOB_IDLE);
+    job_sched_add(&sched, "tick", job_body, &tick, 5000);
+
+    CHECK_EQ(job_sched_run(&sched), 5000);
+    loop_until(&sched, 20000);
+    CHECK_EQ(idle.runs, 0);
+    CHECK_EQ(tick.runs, 3);
+
+    job_sched_trigger(&sched, id);
+    CHECK_EQ(job_sched_run(&sched), 5000);
+    CHECK_EQ(idle.runs, 1);
+    CHECK_EQ(idle.run_at_us[0], 20000000);
+    // not armed again by a trigger
+    loop_until(&sched, 40000);
+    CHECK_EQ(idle.runs, 1);
+
+    // a trigger raised during a run, after the target was passed, asks for no sleep
+    trigger_sched = &sched;
+    trigger_id = id;
+    int waker = job_sched_add(&sched, "waker", trigger_body, NULL, JOB_IDLE);
+    job_sched_trigger(&sched, waker);
+    CHECK_EQ(job_sched_run(&sched), 0);
+    CHECK_EQ(idle.runs, 1);
+    CHECK_EQ(job_sched_run(&sched), 5000);
+    CHECK_EQ(idle.runs, 2);
+}
+
+/* a slow job makes the next one late, and the lateness is recorded */
+static void test_late(void)
+{
+    job_sched_t sched;
+    job_ctx_t slow = { .period_ms = 10000, .cost_ms = 300 };
+    job_ctx_t fast = { .period_ms = 1000 };
+    job_trace_t trace[JOB_SCHED_TRACE_LEN];
+
+    now_us = 0;
+    job_sched_init(&sched, virtual_clock, 0);
+    job_sched_add(&sched, "slow", job_body, &slow, 900);
+    job_sched_add(&sched, "fast", job_body, &fast, 1000);
+
+    loop_until(&sched, 1500);
+    CHECK_EQ(slow.runs, 1);
+    CHECK_EQ(fast.runs, 1);
+    CHECK_EQ(fast.run_at_us[0], 1200000);
+    CHECK_EQ(sched.jobs[1].max_late_ms, 200);
+    CHECK_EQ(sched.jobs[0].max_us, 300000);
+
+    size_t n = job_sched_trace(&sched, trace, JOB_SCHED_TRACE_LEN);
+    CHECK_EQ(n, 2);
+    CHECK_EQ(trace[1].job, 1);
+    CHECK_EQ(trace[1].late_ms, 200);
+    CHECK_EQ(trace[0].duration_us, 300000);
+    // the next run is timed from the end of the late one
+    loop_until(&sched, 2500);
+    CHECK_EQ(fast.run_at_us[1], 2200000);
+}
+
+/* the millisecond clock wraps after 49.7 days of uptime */
+static void test_wrap(void)
+{
+    job_sched_t sched;
+    job_ctx_t a = { .period_ms = 3000 };
+    uint64_t start_ms = UINT32_MAX - 10000ULL;
+
+    now_us = start_ms * 1000;
+    job_sched_init(&sched, virtual_clock, 0);
+    job_sched_add(&sched, "a", job_body, &a, 3000);
+    loop_until(&sched, start_ms + 30000);
+    // at +3 s to +27 s, the clock wraps between the third and the fourth
+    CHECK_EQ(a.runs, 9);
+    for (uint32_t i = 1; i < 9; i++)
+        CHECK_EQ(a.run_at_us[i] - a.run_at_us[i - 1], 3000000);
+    CHECK_EQ(sched.jobs[0].max_late_ms, 0);
+}
+
+static void test_trace_ring(void)
+{
+    job_sched_t sched;
+    job_ctx_t a = { .period_ms = 10 };
+    job_trace_t trace[JOB_SCHED_TRACE_LEN];
+
+    now_us = 0;
+    job_sched_init(&sched, virtual_clock, 0);
+    job_sched_add(&sched, "a", job_body, &a, 0);
+    loop_until(&sched, 1000);
+    CHECK_EQ(sched.traced, 100);
+
+    size_t n = job_sched_trace(&sched, trace, JOB_SCHED_TRACE_LEN);
+    CHECK_EQ(n, JOB_SCHED_TRACE_LEN);
+    CHECK_EQ(trace[0].start_ms, (100 - JOB_SCHED_TRACE_LEN) * 10);
+    CHECK_EQ(trace[n - 1].start_ms, 990);
+
+    // the newest records when the copy is short
+    n = job_sched_trace(&sched, trace, 4);
+    CHECK_EQ(n, 4);
+    CHECK_EQ(trace[0].start_ms, 960);
+    CHECK_EQ(trace[3].start_ms, 990);
+}
+
+static void test_table_full(void)
+{
+    job_sched_t sched;
+    job_ctx_t a = { .period_ms = JOB_IDLE };
+
+    job_sched_init(&sched, virtual_clock, 0);
+    for (int i = 0; i < JOB_SCHED_MAX; i++)
+        CHECK_EQ(job_sched_add(&sched, "a", job_body, &a, JOB_IDLE), i);
+    CHECK_EQ(job_sched_add(&sched, "a", job_body, &a, JOB_IDLE), -1);
+    CHECK_EQ(job_sched_run(&sched), JOB_IDLE);
+    CHECK_EQ(sched.wakeups, 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_periodic);
+    TEST_RUN(test_coalescing);
+    TEST_RUN(test_trigger);
+    TEST_RUN(test_late);
+    TEST_RUN(test_wrap);
+    TEST_RUN(test_trace_ring);
+    TEST_RUN(test_table_full);
+    return TEST_EXIT();
+}
@@ -0,0 +1,201 @@
+/**
+ * @file test_report_policy.c
+ *
+ * Report policy: rules on hand-made sequences, then a day of readings
+ * replayed at the sensor period with the project defaults
+ *
+ * The day is generated, not read from a file, with the shape of a living
+ * room trace: a slow daily swing, a reading flickering by one count now
+ * and then, a shower that raises the humidity in the morning and a window
+ * opened in the evening.
+ */
+#include <math.h>
+#include <stdlib.h>
+
+#include "report_policy.h"
+
+#include "test.h"
+
+#define SAMPLE_PERIOD_MS    2000
+#define DAY_MS              (24 * 3600 * 1000)
+
+enum { TEMP = 0, HUM };
+
+static void make_policy(report_policy_t *policy)
+{
+    report_policy_init(policy, CONFIG_REPORT_MIN_INTERVAL_MS, CONFIG_REPORT_MAX_INTERVAL_S * 1000);
+    report_policy_add_channel(policy, CONFIG_REPORT_TEMP_DEADBAND);
+    report_policy_add_channel(policy, CONFIG_REPORT_HUM_DEADBAND);
+}
+
+static void test_first_and_deadband(void)
+{
+    report_policy_t policy;
+
+    make_policy(&policy);
+    CHECK(report_policy_check(&policy, (int16_t[]){ 215, 550 }, 0));
+    // below both dead-bands
+    CHECK(!report_policy_check(&policy, (int16_t[]){ 216, 553 }, 10000));
+    CHECK(!report_policy_check(&policy, (int16_t[]){ 214, 546 }, 12000));
+    // one channel is enough, and the move is measured from the last report
+    CHECK(report_policy_check(&policy, (int16_t[]){ 217, 550 }, 14000));
+    CHECK(report_policy_check(&policy, (int16_t[]){ 217, 545 }, 16000));
+    CHECK_EQ(policy.reports, 3);
+    CHECK_EQ(policy.heartbeats, 0);
+}
+
+static void test_min_interval(void)
+{
+    report_policy_t policy;
+
+    make_policy(&policy);
+    CHECK(report_policy_check(&policy, (int16_t[]){ 200, 500 }, 1000));
+    CHECK(!report_policy_check(&policy, (int16_t[]){ 250, 500 }, 2999));
+    // the change is still there once the interval is over
+    CHECK(report_policy_check(&policy, (int16_t[]){ 250, 500 }, 3000));
+}
+
+static void test_heartbeat(void)
+{
+    report_policy_t policy;
+
+    make_policy(&policy);
+    CHECK(report_policy_check(&policy, (int16_t[]){ 200, 500 }, 0));
+    CHECK(!report_policy_check(&policy, (int16_t[]){ 200, 500 }, 59999));
+    CHECK(report_policy_check(&policy, (int16_t[]){ 200, 500 }, 60000));
+    CHECK_EQ(policy.heartbeats, 1);
+
+    // no heartbeat without a maximum interval
+    report_policy_init(&policy, 1000, 0);
+    report_policy_add_channel(&policy, 5);
+    CHECK(report_policy_check(&policy, (int16_t[]){ 1 }, 0));
+    CHECK(!report_policy_check(&policy, (int16_t[]){ 1 }, 3600000));
+}
+
+static void test_force_and_channels(void)
+{
+    report_policy_t policy;
+
+    make_policy(&policy);
+    CHECK(report_policy_check(&policy, (int16_t[]){ 200, 500 }, 0));
+    report_policy_force(&policy);
+    CHECK(report_policy_check(&policy, (int16_t[]){ 200, 500 }, 100));
+
+    for (int i = 2; i < REPORT_POLICY_MAX_CHANNELS; i++)
+        CHECK_EQ(report_policy_add_channel(&policy, 1), i);
+    CHECK_EQ(report_policy_add_channel(&policy, 1), -1);
+}
+
+/* the reading at `t` ms into the day, Celsius and percents * 10 */
+static void day_reading(uint32_t t, uint32_t *rng, int16_t values[2])
+{
+    double h = t / 3600000.0;
+    double temp = 215 + 25 * sin((h - 9) * M_PI / 12);
+    double hum = 520 - 0.8 * (temp - 215);
+
+    // shower at 07:30, humidity up in 5 minutes and back down in an hour
+    if (h > 7.5)
+        hum += 250 * fmin((h - 7.5) * 12, 1) * exp(-fmax(h - 7.6, 0) * 3);
+    // window open from 18:00 to 18:20
+    if (h > 18 && h < 18.34)
+        temp -= 40 * fmin((h - 18) * 6, 1);
+    else if (h >= 18.34)
+        temp -= 40 * exp(-(h - 18.34) * 4);
+
+    // one sample in eight flickers by a count either way
+    *rng = *rng * 1103515245 + 12345;
+    int flicker = (*rng >> 16) % 16;
+    values[TEMP] = (int16_t)lround(temp) + (flicker == 0) - (flicker == 1);
+    values[HUM] = (int16_t)lround(hum) + (flicker == 2) - (flicker == 3);
+}
+
+typedef struct
+{
+    uint32_t    samples;
+    uint32_t    reports;
+    uint32_t    heartbeats;
+    uint32_t    longest_ms;     // between two reports
+    uint32_t    shortest_ms;
+    uint32_t    stale;          // samples past a dead-band and outside the minimum interval, not reported
+} replay_t;
+
+static void replay_day(uint32_t start_ms, replay_t *r)
+{
+    report_policy_t policy;
+    uint32_t rng = 1;
+    uint32_t last = 0;
+    int16_t shown[2] = { 0 };
+
+    make_policy(&policy);
+    *r = (replay_t){ .shortest_ms = UINT32_MAX };
+    for (uint32_t t = 0; t < DAY_MS; t += SAMPLE_PERIOD_MS)
+    {
+        int16_t values[2];
+        uint32_t now = start_ms + t;
+
+        day_reading(t, &rng, values);
+        bool sent = report_policy_check(&policy, values, now);
+        bool moved = abs(values[TEMP] - shown[TEMP]) >= CONFIG_REPORT_TEMP_DEADBAND
+                     || abs(values[HUM] - shown[HUM]) >= CONFIG_REPORT_HUM_DEADBAND;
+
+        if (!sent && r->reports && moved && now - last >= CONFIG_REPORT_MIN_INTERVAL_MS)
+            r->stale++;
+        if (!sent)
+            continue;
+        if (r->reports)
+        {
+            uint32_t gap = now - last;
+            if (gap > r->longest_ms)
+                r->longest_ms = gap;
+            if (gap < r->shortest_ms)
+                r->shortest_ms = gap;
+        }
+        last = now;
+        shown[TEMP] = values[TEMP];
+        shown[HUM] = values[HUM];
+        r->reports++;
+    }
+    r->samples = policy.samples;
+    r->heartbeats = policy.heartbeats;
+}
+
+static void test_day(void)
+{
+    replay_t r;
+
+    replay_day(0, &r);
+    printf("day: %u samples, %u reports, %u heartbeats, %u to %u ms between reports\n",
+           r.samples, r.reports, r.heartbeats, r.shortest_ms, r.longest_ms);
+    CHECK_EQ(r.samples, DAY_MS / SAMPLE_PERIOD_MS);
+    // the dashboard never lags by a dead-band once the rate limit allows a report
+    CHECK_EQ(r.stale, 0);
+    CHECK(r.shortest_ms >= CONFIG_REPORT_MIN_INTERVAL_MS);
+    CHECK(r.longest_ms <= CONFIG_REPORT_MAX_INTERVAL_S * 1000 + SAMPLE_PERIOD_MS);
+    // flicker alone rarely makes a report: a small fraction of the samples are sent
+    CHECK(r.reports < r.samples / 10);
+    CHECK(r.heartbeats > 0);
+}
+
+/* the millisecond clock wraps after 49.7 days */
+static void test_day_across_wrap(void)
+{
+    replay_t plain, wrapped;
+
+    replay_day(0, &plain);
+    replay_day(UINT32_MAX - DAY_MS / 2, &wrapped);
+    CHECK_EQ(wrapped.reports, plain.reports);
+    CHECK_EQ(wrapped.heartbeats, plain.heartbeats);
+    CHECK_EQ(wrapped.longest_ms, plain.longest_ms);
+    CHECK_EQ(wrapped.stale, 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_first_and_deadband);
+    TEST_RUN(test_min_interval);
+    TEST_RUN(test_heartbeat);
+    TEST_RUN(test_force_and_channels);
+    TEST_RUN(test_day);
+    TEST_RUN(test_day_across_wrap);
+    return TEST_EXIT();
+}
@@ -0,0 +1,216 @@
+/**
+ * @file test_rollup.c
+ *
+ * Rollup windows on hand-made samples, then a week of readings at the
+ * sensor period through the project tiers, every window checked against
+ * the samples it covers
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "rollup.h"
+
+#include "test.h"
+
+#define SAMPLE_PERIOD_MS    2000
+#define WEEK_MS             (7 * 24 * 3600 * 1000LL)
+#define WEEK_SAMPLES        (WEEK_MS / SAMPLE_PERIOD_MS)
+
+typedef struct
+{
+    int         tier;
+    int64_t     start_ms;
+    rollup_acc_t acc[ROLLUP_MAX_CHANNELS];
+} window_t;
+
+typedef struct
+{
+    window_t    last;
+    uint32_t    count[ROLLUP_MAX_TIERS];
+} emitted_t;
+
+static void on_window(int tier, int64_t start_ms, const rollup_acc_t *acc, void *ctx)
+{
+    emitted_t *e = ctx;
+
+    e->last.tier = tier;
+    e->last.start_ms = start_ms;
+    memcpy(e->last.acc, acc, sizeof(e->last.acc));
+    e->count[tier]++;
+}
+
+static void test_window(void)
+{
+    rollup_t rollup;
+    emitted_t e = { 0 };
+
+    rollup_init(&rollup, 2);
+    CHECK_EQ(rollup_add_tier(&rollup, 60000), 0);
+    rollup_add(&rollup, 61000, (int16_t[]){ 200, 500 }, on_window, &e);
+    rollup_add(&rollup, 90000, (int16_t[]){ 210, 480 }, on_window, &e);
+    rollup_add(&rollup, 119999, (int16_t[]){ 205, 490 }, on_window, &e);
+    CHECK_EQ(e.count[0], 0);
+
+    rollup_add(&rollup, 120000, (int16_t[]){ 0, 0 }, on_window, &e);
+    CHECK_EQ(e.count[0], 1);
+    CHECK_EQ(e.last.start_ms, 60000);
+    CHECK_EQ(e.last.acc[0].count, 3);
+    CHECK_EQ(e.last.acc[0].min, 200);
+    CHECK_EQ(e.last.acc[0].max, 210);
+    CHECK_EQ(e.last.acc[0].last, 205);
+    CHECK_EQ(rollup_stat(&e.last.acc[0], ROLLUP_MEAN), 205);
+    CHECK_EQ(rollup_stat(&e.last.acc[1], ROLLUP_MEAN), 490);
+    CHECK_EQ(rollup_stat(&e.last.acc[1], ROLLUP_MIN), 480);
+    CHECK_EQ(rollup_stat(&e.last.acc[1], ROLLUP_LAST), 490);
+    CHECK_EQ(rollup.windows, 1);
+}
+
+/* the mean rounds half away from zero, below zero as well */
+static void test_mean_rounding(void)
+{
+    rollup_acc_t acc = { .count = 2, .sum = 3 };
+
+    CHECK_EQ(rollup_stat(&acc, ROLLUP_MEAN), 2);
+    acc.sum = -3;
+    CHECK_EQ(rollup_stat(&acc, ROLLUP_MEAN), -2);
+    acc = (rollup_acc_t){ .count = 3, .sum = -4 };
+    CHECK_EQ(rollup_stat(&acc, ROLLUP_MEAN), -1);
+    acc = (rollup_acc_t){ 0 };
+    CHECK_EQ(rollup_stat(&acc, ROLLUP_MEAN), 0);
+}
+
+/* no window for the time without samples, and windows before zero align too */
+static void test_gap_and_expiry(void)
+{
+    rollup_t rollup;
+    emitted_t e = { 0 };
+
+    rollup_init(&rollup, 1);
+    rollup_add_tier(&rollup, 60000);
+    rollup_add_tier(&rollup, 300000);
+    rollup_add(&rollup, -30000, (int16_t[]){ -50 }, on_window, &e);
+    rollup_add(&rollup, 10 * 60000 + 5, (int16_t[]){ 7 }, on_window, &e);
+    CHECK_EQ(e.count[0], 1);
+    CHECK_EQ(e.count[1], 1);
+    CHECK_EQ(e.last.tier, 1);
+    CHECK_EQ(e.last.start_ms, -300000);
+    CHECK_EQ(e.last.acc[0].last, -50);
+
+    // samples stopped: nothing before the end of the window, then once
+    rollup_close_expired(&rollup, 11 * 60000 - 1, on_window, &e);
+    CHECK_EQ(e.count[0], 1);
+    rollup_close_expired(&rollup, 11 * 60000, on_window, &e);
+    CHECK_EQ(e.count[0], 2);
+    CHECK_EQ(e.last.start_ms, 10 * 60000);
+    rollup_close_expired(&rollup, 20 * 60000, on_window, &e);
+    CHECK_EQ(e.count[0], 2);
+    CHECK_EQ(e.count[1], 2);
+    CHECK_EQ(rollup.windows, 4);
+}
+
+static void test_tiers_full(void)
+{
+    rollup_t rollup;
+
+    rollup_init(&rollup, 5);
+    CHECK_EQ(rollup.channel_count, ROLLUP_MAX_CHANNELS);
+    CHECK_EQ(rollup_add_tier(&rollup, 0), -1);
+    for (int i = 0; i < ROLLUP_MAX_TIERS; i++)
+        CHECK_EQ(rollup_add_tier(&rollup, 1000), i);
+    CHECK_EQ(rollup_add_tier(&rollup, 1000), -1);
+}
+
+/* the reading of sample `i` of the week, Celsius and percents * 10 */
+static void week_reading(int64_t i, int16_t values[2])
+{
+    uint32_t h = (uint32_t)(i * 2654435761u);
+
+    values[0] = (int16_t)(180 + (i / 900) % 80 + (int)(h >> 29) - 4);
+    values[1] = (int16_t)(450 + (i / 1300) % 200 - (int)(h >> 28));
+}
+
+typedef struct
+{
+    int64_t     end_ms;         // samples up to here were fed
+    uint32_t    count[ROLLUP_MAX_TIERS];
+    uint32_t    wrong;
+    int64_t     last_start[ROLLUP_MAX_TIERS];
+} week_t;
+
+static week_t week;
+
+static bool offline(int64_t t)
+{
+    // the device is off for three hours on the third day
+    return t >= 50 * 3600000LL && t < 53 * 3600000LL;
+}
+
+/* every window against the samples it covers, recomputed from scratch */
+static void on_week_window(int tier, int64_t start_ms, const rollup_acc_t *acc, void *ctx)
+{
+    const rollup_t *rollup = ctx;
+    uint32_t window_ms = rollup->tiers[tier].window_ms;
+    rollup_acc_t want[2] = { 0 };
+
+    for (int64_t t = start_ms; t < start_ms + window_ms; t += SAMPLE_PERIOD_MS)
+    {
+        int16_t values[2];
+        if (offline(t) || t >= week.end_ms)
+            continue;
+        week_reading(t / SAMPLE_PERIOD_MS, values);
+        for (int c = 0; c < 2; c++)
+        {
+            if (!want[c].count || values[c] < want[c].min)
+                want[c].min = values[c];
+            if (!want[c].count || values[c] > want[c].max)
+                want[c].max = values[c];
+            want[c].last = values[c];
+            want[c].sum += values[c];
+            want[c].count++;
+        }
+    }
+    if (memcmp(acc, want, sizeof(want)) || start_ms % window_ms || start_ms <= week.last_start[tier])
+        week.wrong++;
+    week.last_start[tier] = start_ms;
+    week.count[tier]++;
+}
+
+static void test_week(void)
+{
+    rollup_t rollup;
+
+    memset(&week, 0, sizeof(week));
+    week.last_start[0] = week.last_start[1] = -1;
+    rollup_init(&rollup, 2);
+    rollup_add_tier(&rollup, CONFIG_ROLLUP_TIER1_S * 1000);
+    rollup_add_tier(&rollup, CONFIG_ROLLUP_TIER2_S * 1000);
+    for (int64_t i = 0; i < WEEK_SAMPLES; i++)
+    {
+        int16_t values[2];
+        int64_t t = i * SAMPLE_PERIOD_MS;
+
+        if (offline(t))
+            continue;
+        week_reading(i, values);
+        week.end_ms = t + 1;
+        rollup_add(&rollup, t, values, on_week_window, &rollup);
+    }
+    week.end_ms = WEEK_MS;
+    rollup_close_expired(&rollup, WEEK_MS, on_week_window, &rollup);
+
+    uint32_t off_ms = 3 * 3600000;
+    CHECK_EQ(week.wrong, 0);
+    CHECK_EQ(week.count[0], (WEEK_MS - off_ms) / (CONFIG_ROLLUP_TIER1_S * 1000));
+    CHECK_EQ(week.count[1], (WEEK_MS - off_ms) / (CONFIG_ROLLUP_TIER2_S * 1000));
+    CHECK_EQ(rollup.windows, week.count[0] + week.count[1]);
+}
+
+int main(void)
+{
+    TEST_RUN(test_window);
+    TEST_RUN(test_mean_rounding);
+    TEST_RUN(test_gap_and_expiry);
+    TEST_RUN(test_tiers_full);
+    TEST_RUN(test_week);
+    return TEST_EXIT();
+}
@@ -0,0 +1,133 @@
+/**
+ * @file test_sample.c
+ *
+ * Seqlock sample slot: one writer thread publishing as fast as it can
+ * against reader threads that check every copy for a torn sample. They run
+ * for long enough that, even on a single CPU, the scheduler preempts the
+ * writer in the middle of publications many times.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "sample.h"
+
+#include "test.h"
+
+#define READERS         3
+#define STRESS_MS       500
+
+static sample_slot_t slot;
+static atomic_bool done;
+static uint32_t published;
+
+typedef struct
+{
+    uint32_t    reads;
+    uint32_t    torn;
+    uint32_t    backwards;
+    uint32_t    fresh;
+} reader_t;
+
+/* every field derived from the publication number */
+static void *writer(void *arg)
+{
+    uint32_t i = 0;
+
+    while (!atomic_load(&done))
+    {
+        i++;
+        sample_publish(&slot, (int16_t)(i * 3), (int16_t)~i, i);
+    }
+    published = i;
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    reader_t *r = arg;
+    uint32_t last = 0;
+
+    while (!atomic_load(&done))
+    {
+        sample_t s;
+
+        if (!sample_read(&slot, &s))
+            continue;
+        r->reads++;
+        if (s.seq != s.timestamp_ms || s.humidity != (int16_t)(s.seq * 3) || s.temperature != (int16_t)~s.seq)
+            r->torn++;
+        if (s.seq < last)
+            r->backwards++;
+        if (s.seq != last)
+            r->fresh++;
+        last = s.seq;
+    }
+    return NULL;
+}
+
+static void test_empty(void)
+{
+    sample_slot_t empty = { 0 };
+    sample_t s;
+
+    CHECK(!sample_read(&empty, &s));
+    CHECK_EQ(s.seq, 0);
+    CHECK(!sample_is_newer(&empty, 0));
+}
+
+static void test_sequence(void)
+{
+    sample_slot_t s1 = { 0 };
+    sample_t s;
+
+    sample_publish(&s1, 500, 250, 1000);
+    CHECK(sample_is_newer(&s1, 0));
+    CHECK(sample_read(&s1, &s));
+    CHECK_EQ(s.seq, 1);
+    CHECK_EQ(s.humidity, 500);
+    CHECK_EQ(s.temperature, 250);
+    CHECK_EQ(s.timestamp_ms, 1000);
+    CHECK(!sample_is_newer(&s1, s.seq));
+
+    sample_publish(&s1, 510, -15, 3000);
+    CHECK(sample_is_newer(&s1, 1));
+    CHECK(sample_read(&s1, &s));
+    CHECK_EQ(s.seq, 2);
+    CHECK_EQ(s.temperature, -15);
+}
+
+static void test_torn_reads(void)
+{
+    pthread_t w, r[READERS];
+    reader_t stats[READERS] = { 0 };
+
+    pthread_create(&w, NULL, writer, NULL);
+    for (int i = 0; i < READERS; i++)
+        pthread_create(&r[i], NULL, reader, &stats[i]);
+    nanosleep(&(struct timespec){ .tv_nsec = STRESS_MS * 1000000L }, NULL);
+    atomic_store(&done, true);
+    pthread_join(w, NULL);
+    for (int i = 0; i < READERS; i++)
+    {
+        pthread_join(r[i], NULL);
+        CHECK_EQ(stats[i].torn, 0);
+        CHECK_EQ(stats[i].backwards, 0);
+        CHECK(stats[i].fresh > 1);
+    }
+
+    sample_t s;
+    CHECK(sample_read(&slot, &s));
+    CHECK_EQ(s.seq, published);
+    printf("%u, %u and %u reads, %u, %u and %u fresh, of %u publications\n",
+           stats[0].reads, stats[1].reads, stats[2].reads,
+           stats[0].fresh, stats[1].fresh, stats[2].fresh, published);
+}
+
+int main(void)
+{
+    TEST_RUN(test_empty);
+    TEST_RUN(test_sequence);
+    TEST_RUN(test_torn_reads);
+    return TEST_EXIT();
+}
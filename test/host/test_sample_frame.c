@@ -0,0 +1,195 @@
+/**
+ * @file test_sample_frame.c
+ *
+ * Binary sample frames: round trips of samples read across the gap
+ * markers of the ring and of deltas at the ends of their ranges, damaged
+ * frames, and the bytes of 1000 samples against the JSON bodies they
+ * replace
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "sample_frame.h"
+#include "sample_ring.h"
+#include "url_builder.h"
+
+#include "test.h"
+
+#define HOUR_MS         (3600 * 1000LL)
+#define SAMPLES         1000
+#define BATCH           60      // CONFIG_HISTORY_BATCH
+#define JSON_PINS       3       // v0 temperature, v1 and v3 humidity
+#define POINT_LEN       24      // HISTORY_POINT_LEN
+
+static bool same_points(const sample_point_t *a, const sample_point_t *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        if (a[i].timestamp_ms != b[i].timestamp_ms || a[i].temperature != b[i].temperature
+            || a[i].humidity != b[i].humidity)
+            return false;
+    return true;
+}
+
+/* encoded, decoded and compared, the frame length returned */
+static size_t round_trip(const sample_point_t *points, size_t n, uint8_t flags)
+{
+    static uint8_t frame[SAMPLE_FRAME_MAX_LEN(SAMPLES)];
+    static sample_point_t out[SAMPLES];
+    size_t len = sample_frame_encode(points, n, flags, frame, sizeof(frame));
+    size_t count = 0;
+    uint8_t got_flags = 0;
+
+    CHECK(len > 0 && len <= SAMPLE_FRAME_MAX_LEN(n));
+    CHECK(sample_frame_decode(frame, len, out, SAMPLES, &count, &got_flags));
+    CHECK_EQ(count, n);
+    CHECK_EQ(got_flags, flags);
+    CHECK(same_points(points, out, n));
+    return len;
+}
+
+static void test_round_trip(void)
+{
+    const sample_point_t points[] = {
+        { 1700000000000LL, 215, 480 },
+        { 1700000002000LL, 216, 478 },
+        { 1700000004000LL, 216, 478 },
+        { 1700000006100LL, 214, 481 },
+    };
+
+    // a sample that barely changes takes 3 bytes
+    CHECK_EQ(round_trip(points, 4, SAMPLE_FRAME_UNIX_TIME), 2 + 1 + 6 + (1 + 2 + 2) + 3 * 3 + 2);
+    round_trip(points, 4, SAMPLE_FRAME_UNIX_TIME | SAMPLE_FRAME_STREAM(2));
+    CHECK_EQ(round_trip(points, 0, 0), 2 + 1 + 1 + 2);
+}
+
+/* what the ring reads back across its gap markers goes out as plain samples */
+static void test_gap_markers(void)
+{
+    sample_rec_t buf[16];
+    sample_ring_t ring;
+    sample_point_t points[16];
+    size_t records;
+    int64_t t = 1700000000000LL;
+
+    sample_ring_init(&ring, buf, 16);
+    sample_ring_push(&ring, t, 200, 500);
+    sample_ring_push(&ring, t += 2000, 201, 499);
+    // an outage past the 16 bit ticks of a record, and a much longer one
+    sample_ring_push(&ring, t += 3 * HOUR_MS, 180, 620);
+    sample_ring_push(&ring, t += 2000, 181, 621);
+    sample_ring_push(&ring, t += 400 * 24 * HOUR_MS, -50, 950);
+    sample_ring_push(&ring, t += 2000, -49, 950);
+    CHECK_EQ(ring.points, 6);
+    CHECK_EQ(ring.count, 8);
+
+    size_t n = sample_ring_peek(&ring, points, 16, &records);
+    CHECK_EQ(n, 6);
+    CHECK_EQ(records, 8);
+    CHECK_EQ(points[2].timestamp_ms - points[1].timestamp_ms, 3 * HOUR_MS);
+    round_trip(points, n, SAMPLE_FRAME_UNIX_TIME);
+
+    // ages before SNTP, all at or below 0
+    for (size_t i = 0; i < n; i++)
+        points[i].timestamp_ms -= t;
+    round_trip(points, n, 0);
+}
+
+/* the widest steps of every field, within the worst case length, times on the tick from the first */
+static void test_wide_deltas(void)
+{
+    static uint8_t frame[SAMPLE_FRAME_MAX_LEN(6)];
+    const sample_point_t points[] = {
+        { -1000000000000000000LL, INT16_MIN, INT16_MAX },
+        { -1000000000000000000LL + 100, INT16_MAX, INT16_MIN },
+        { 0, INT16_MIN, INT16_MAX },
+        // 13.6 years, more than the ring's markers hold
+        { (int64_t)UINT32_MAX * 1000, 0, 0 },
+        { (int64_t)UINT32_MAX * 1000, INT16_MAX, INT16_MAX },
+        { 2000000000000000000LL, INT16_MIN, INT16_MIN },
+    };
+    const size_t n = sizeof(points) / sizeof(points[0]);
+
+    size_t len = round_trip(points, n, SAMPLE_FRAME_UNIX_TIME);
+    CHECK_EQ(sample_frame_encode(points, n, 0, frame, sizeof(frame)), len);
+    // one byte short is refused, not truncated
+    CHECK_EQ(sample_frame_encode(points, n, 0, frame, len - 1), 0);
+}
+
+static void test_damaged(void)
+{
+    const sample_point_t points[] = { { 1000, 200, 500 }, { 3000, 201, 501 }, { 5000, 202, 502 } };
+    sample_point_t out[3];
+    uint8_t frame[SAMPLE_FRAME_MAX_LEN(3)];
+    size_t n;
+    size_t len = sample_frame_encode(points, 3, 0, frame, sizeof(frame));
+
+    CHECK(sample_frame_decode(frame, len, out, 3, &n, NULL));
+    // more samples than room
+    CHECK(!sample_frame_decode(frame, len, out, 2, &n, NULL));
+    CHECK(!sample_frame_decode(frame, len - 1, out, 3, &n, NULL));
+    for (size_t i = 0; i < len; i++)
+    {
+        frame[i] ^= 0x10;
+        CHECK(!sample_frame_decode(frame, len, out, 3, &n, NULL));
+        frame[i] ^= 0x10;
+    }
+}
+
+/* the [[ts,value],...] body history.c posts to one pin */
+static size_t json_body(const sample_point_t *points, size_t n, bool temperature)
+{
+    char body[BATCH * POINT_LEN + 4];
+    url_builder_t b;
+
+    url_init(&b, body, sizeof(body));
+    url_append(&b, "[", 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        url_append(&b, i ? ",[" : "[", i ? 2 : 1);
+        url_append_int(&b, points[i].timestamp_ms);
+        url_append(&b, ",", 1);
+        url_append_fixed1(&b, temperature ? points[i].temperature : points[i].humidity);
+        url_append(&b, "]", 1);
+    }
+    url_append(&b, "]", 1);
+    CHECK(url_finish(&b));
+    return b.len;
+}
+
+/* a day and a half at one sample a minute, in batches as history.c sends them */
+static void test_size(void)
+{
+    static sample_point_t points[SAMPLES];
+    uint32_t rng = 1;
+    size_t frame_bytes = 0, json_bytes = 0;
+
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        rng = rng * 1103515245 + 12345;
+        int16_t temperature = (int16_t)(220 + (i / 40) % 30 + (int)(rng >> 16) % 3 - 1);
+        int16_t humidity = (int16_t)(550 - (i / 25) % 60 + (int)(rng >> 20) % 3 - 1);
+        points[i] = (sample_point_t){ 1700000000000LL + i * 60000LL, temperature, humidity };
+    }
+    for (int i = 0; i < SAMPLES; i += BATCH)
+    {
+        size_t n = SAMPLES - i < BATCH ? SAMPLES - i : BATCH;
+        frame_bytes += round_trip(points + i, n, SAMPLE_FRAME_UNIX_TIME);
+        json_bytes += json_body(points + i, n, true) + (JSON_PINS - 1) * json_body(points + i, n, false);
+    }
+
+    printf("  %d samples: %zu B of frames, %zu B of JSON on %d pins, %.1fx\n",
+           SAMPLES, frame_bytes, json_bytes, JSON_PINS, (double)json_bytes / frame_bytes);
+    // both channels once, the time as a one byte delta
+    CHECK(frame_bytes <= SAMPLES * 5);
+    CHECK(frame_bytes * 10 < json_bytes);
+}
+
+int main(void)
+{
+    TEST_RUN(test_round_trip);
+    TEST_RUN(test_gap_markers);
+    TEST_RUN(test_wide_deltas);
+    TEST_RUN(test_damaged);
+    TEST_RUN(test_size);
+    return TEST_EXIT();
+}
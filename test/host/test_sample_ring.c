@@ -0,0 +1,233 @@
+/**
+ * @file test_sample_ring.c
+ *
+ * Sample ring: wrap-around, long gaps and draining
+ */
+#include <stdbool.h>
+#include <string.h>
+
+#include "sample_ring.h"
+
+#include "test.h"
+
+#define MODEL_MAX   4096
+
+/* every sample pushed, the ring must hold the newest ones */
+static sample_point_t model[MODEL_MAX];
+static size_t model_count;
+
+static void push(sample_ring_t *ring, int64_t timestamp_ms, int16_t temperature, int16_t humidity)
+{
+    sample_ring_push(ring, timestamp_ms, temperature, humidity);
+    model[model_count++] = (sample_point_t){ timestamp_ms / SAMPLE_RING_TICK_MS * SAMPLE_RING_TICK_MS,
+                                             temperature, humidity };
+}
+
+/* the ring holds exactly the newest `ring->points` samples of the model */
+static bool matches_model(const sample_ring_t *ring, size_t drained)
+{
+    sample_point_t out[MODEL_MAX];
+    size_t records;
+    size_t n = sample_ring_peek(ring, out, MODEL_MAX, &records);
+
+    if (n != ring->points || records != ring->count || n > model_count - drained)
+        return false;
+    for (size_t i = 0; i < n; i++)
+    {
+        const sample_point_t *want = &model[model_count - n + i];
+        if (out[i].timestamp_ms != want->timestamp_ms || out[i].temperature != want->temperature
+            || out[i].humidity != want->humidity)
+            return false;
+    }
+    return true;
+}
+
+static void test_push_peek(void)
+{
+    sample_rec_t buf[8];
+    sample_ring_t ring;
+    sample_point_t out[8];
+    size_t records;
+
+    model_count = 0;
+    sample_ring_init(&ring, buf, 8);
+    CHECK_EQ(sample_ring_peek(&ring, out, 8, &records), 0);
+    CHECK_EQ(records, 0);
+
+    push(&ring, 1050, 215, 600);
+    push(&ring, 3120, 216, 601);
+    push(&ring, 3120, 217, 602);
+    CHECK_EQ(ring.points, 3);
+    CHECK(matches_model(&ring, 0));
+    CHECK_EQ(sample_ring_peek(&ring, out, 8, &records), 3);
+    CHECK_EQ(out[0].timestamp_ms, 1000);
+    CHECK_EQ(out[1].timestamp_ms, 3100);
+    CHECK_EQ(out[2].timestamp_ms, 3100);
+
+    // a clock going back is stored as no time passing
+    push(&ring, 2000, 218, 603);
+    CHECK_EQ(sample_ring_peek(&ring, out, 8, &records), 4);
+    CHECK_EQ(out[3].timestamp_ms, 3100);
+}
+
+static void test_wrap(void)
+{
+    sample_rec_t buf[8];
+    sample_ring_t ring;
+
+    model_count = 0;
+    sample_ring_init(&ring, buf, 8);
+    for (int i = 0; i < 100; i++)
+    {
+        push(&ring, 60000LL * i, 200 + i, 500 - i);
+        CHECK(matches_model(&ring, 0));
+    }
+    CHECK_EQ(ring.points, 8);
+    CHECK_EQ(ring.count, 8);
+    CHECK_EQ(ring.dropped, 92);
+}
+
+/* gaps over 0xFFFF ticks, ~1.8 hours, take a marker record */
+static void test_gap(void)
+{
+    sample_rec_t buf[8];
+    sample_ring_t ring;
+    const int64_t hour = 3600 * 1000LL;
+
+    model_count = 0;
+    sample_ring_init(&ring, buf, 8);
+    push(&ring, 0, 100, 400);
+    push(&ring, 2 * hour, 101, 401);
+    CHECK_EQ(ring.count, 3);
+    CHECK_EQ(ring.points, 2);
+    CHECK(matches_model(&ring, 0));
+
+    // the longest gap a marker holds, ~13.6 years
+    push(&ring, 2 * hour + (int64_t)UINT32_MAX * SAMPLE_RING_TICK_MS, 102, 402);
+    CHECK(matches_model(&ring, 0));
+
+    // markers dropped with their sample when the ring wraps
+    for (int i = 0; i < 20; i++)
+    {
+        int64_t last = model[model_count - 1].timestamp_ms;
+        push(&ring, last + (i & 1 ? 3 * hour : 1000), 110 + i, 410 + i);
+        CHECK(matches_model(&ring, 0));
+        CHECK(ring.count <= ring.capacity);
+        CHECK(ring.count >= ring.points);
+    }
+}
+
+static void test_drain(void)
+{
+    sample_rec_t buf[16];
+    sample_ring_t ring;
+    sample_point_t out[4];
+    size_t records;
+    size_t drained = 0;
+
+    model_count = 0;
+    sample_ring_init(&ring, buf, 16);
+    for (int i = 0; i < 10; i++)
+        push(&ring, i * 1000 + (i >= 5 ? 10000000LL : 0), 100 + i, 300 + i);
+
+    // upload batches of 4, as the history uploader does
+    while (ring.points)
+    {
+        size_t n = sample_ring_peek(&ring, out, 4, &records);
+        CHECK(n > 0 && n <= 4);
+        CHECK_EQ(out[0].temperature, model[drained].temperature);
+        sample_ring_drop(&ring, records);
+        drained += n;
+        CHECK(matches_model(&ring, drained));
+    }
+    CHECK_EQ(drained, 10);
+    CHECK_EQ(ring.count, 0);
+    CHECK_EQ(ring.dropped, 0);
+
+    // the ring starts over from the next push
+    push(&ring, 20000000, 1, 2);
+    CHECK(matches_model(&ring, drained));
+}
+
+/* samples pushed and overwritten between peek and drop */
+static void test_drop_until(void)
+{
+    sample_rec_t buf[6];
+    sample_ring_t ring;
+    sample_point_t out[3];
+    size_t records;
+
+    model_count = 0;
+    sample_ring_init(&ring, buf, 6);
+    for (int i = 0; i < 6; i++)
+        push(&ring, i * 1000, i, i);
+
+    CHECK_EQ(sample_ring_peek(&ring, out, 3, &records), 3);
+    int64_t uploaded = out[2].timestamp_ms;
+    push(&ring, 6000, 6, 6);
+    push(&ring, 7000, 7, 7);
+    sample_ring_drop_until(&ring, uploaded);
+
+    // 0 and 1 were overwritten, 2 uploaded, 3 to 7 left
+    CHECK_EQ(ring.points, 5);
+    CHECK_EQ(ring.dropped, 2);
+    CHECK(matches_model(&ring, 0));
+
+    // a marker goes with the sample after it
+    push(&ring, 7000 + 10000000LL, 8, 8);
+    sample_ring_drop_until(&ring, 7000);
+    CHECK_EQ(ring.points, 1);
+    CHECK_EQ(ring.count, 2);
+    sample_ring_drop_until(&ring, 7000 + 10000000LL);
+    CHECK_EQ(ring.count, 0);
+
+    sample_ring_clear(&ring);
+    CHECK_EQ(sample_ring_peek(&ring, out, 3, &records), 0);
+}
+
+/* random pushes, gaps and partial drains against the model */
+static void test_random(void)
+{
+    sample_rec_t buf[32];
+    sample_ring_t ring;
+    uint32_t rng = 7;
+    int64_t now = 0;
+    size_t drained = 0;
+
+    model_count = 0;
+    sample_ring_init(&ring, buf, 32);
+    for (int i = 0; i < 3000; i++)
+    {
+        rng = rng * 1103515245 + 12345;
+        uint32_t r = rng >> 16;
+        if (r % 10 == 0)
+        {
+            sample_point_t out[8];
+            size_t records;
+            size_t n = sample_ring_peek(&ring, out, 1 + r % 8, &records);
+            sample_ring_drop(&ring, records);
+            drained += n;
+        }
+        else
+        {
+            now += r % 50 == 0 ? 7200000 : (int64_t)(r % 7) * 1000;
+            push(&ring, now, (int16_t)r, (int16_t)(r >> 3));
+        }
+        if (!matches_model(&ring, drained))
+        {
+            CHECK(!"ring and model differ");
+            break;
+        }
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_push_peek);
+    TEST_RUN(test_wrap);
+    TEST_RUN(test_gap);
+    TEST_RUN(test_drain);
+    TEST_RUN(test_drop_until);
+    TEST_RUN(test_random);
+    return TEST_EXIT();
+}
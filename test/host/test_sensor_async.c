@@ -0,0 +1,154 @@
+/**
+ * @file test_sensor_async.c
+ *
+ * Queued reads of simulated DHT lines on the worker task: results in
+ * request order, and the time each spent queued and being read
+ *
+ * The reads run on the virtual clock, so a host thread preempted mid-read
+ * does not fail them. Only the worker moves it, the test thread waits in
+ * real time.
+ */
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <dht_sim.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "host.h"
+#include "sensor_async.h"
+
+#include "test.h"
+
+#define LINES       4
+#define READS       12
+#define QUEUE_LEN   READS
+
+typedef struct
+{
+    int                     tag;
+    sensor_read_result_t    result;
+} done_t;
+
+static done_t       done[READS * 2];
+static atomic_int   done_count;
+
+static void on_read(const sensor_read_result_t *result, void *ctx)
+{
+    int n = atomic_load(&done_count);
+
+    if (n < READS * 2)
+        done[n] = (done_t){ (int)(intptr_t)ctx, *result };
+    atomic_store(&done_count, n + 1);
+}
+
+static bool wait_done(int count)
+{
+    for (int i = 0; i < 5000 && atomic_load(&done_count) < count; i++)
+        usleep(1000);
+    return atomic_load(&done_count) >= count;
+}
+
+static void test_not_started(void)
+{
+    sensor_t sensor = SENSOR_DHT_DEV(DHT_TYPE_AM2301, 0);
+
+    CHECK_EQ(sensor_read_async(&sensor, on_read, NULL), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(sensor_async_init(0, 4096, 5, tskNO_AFFINITY), ESP_ERR_INVALID_ARG);
+}
+
+/* reads of every line queued at once come back in the order they were asked */
+static void test_order(void)
+{
+    static sensor_t sensors[LINES];
+    int64_t wait_sum = 0, wait_max = 0, read_sum = 0, read_max = 0;
+
+    for (int i = 0; i < LINES; i++)
+    {
+        dht_sim_config_t config = { .type = DHT_TYPE_AM2301, .humidity = 400 + i, .temperature = 200 + i };
+        sensors[i] = (sensor_t)SENSOR_DHT_DEV(DHT_TYPE_AM2301, i);
+        dht_sim_attach(i, &config);
+    }
+
+    atomic_store(&done_count, 0);
+    for (int i = 0; i < READS; i++)
+        CHECK_EQ(sensor_read_async(&sensors[(i * 3) % LINES], on_read, (void *)(intptr_t)i), ESP_OK);
+    CHECK(wait_done(READS));
+
+    for (int i = 0; i < READS; i++)
+    {
+        const sensor_read_result_t *r = &done[i].result;
+        int line = (i * 3) % LINES;
+
+        CHECK_EQ(done[i].tag, i);
+        CHECK(r->sensor == &sensors[line]);
+        CHECK_EQ(r->err, ESP_OK);
+        CHECK_EQ(r->humidity, 400 + line);
+        CHECK_EQ(r->temperature, 200 + line);
+        // queued, then started once the previous read is done
+        CHECK(r->queued_us <= r->started_us && r->started_us <= r->done_us);
+        if (i)
+            CHECK(r->started_us >= done[i - 1].result.done_us);
+
+        int64_t wait = r->started_us - r->queued_us, read = r->done_us - r->started_us;
+        wait_sum += wait;
+        read_sum += read;
+        wait_max = wait > wait_max ? wait : wait_max;
+        read_max = read > read_max ? read : read_max;
+    }
+    printf("  queued to started %lld us average, %lld us max; started to done %lld us average, %lld us max\n",
+           (long long)(wait_sum / READS), (long long)wait_max, (long long)(read_sum / READS), (long long)read_max);
+    // the start pulse is slept through in real time
+    CHECK(read_sum / READS >= 20000);
+    CHECK(done[READS - 1].result.started_us - done[READS - 1].result.queued_us >= (READS - 1) * 20000LL);
+}
+
+/* a failed read takes its turn like the others */
+static void test_failure_in_order(void)
+{
+    sensor_t ok = SENSOR_DHT_DEV(DHT_TYPE_AM2301, 0);
+    sensor_t missing = SENSOR_DHT_DEV(DHT_TYPE_AM2301, LINES);
+
+    atomic_store(&done_count, 0);
+    CHECK_EQ(sensor_read_async(&ok, on_read, (void *)0), ESP_OK);
+    CHECK_EQ(sensor_read_async(&missing, on_read, (void *)1), ESP_OK);
+    CHECK_EQ(sensor_read_async(&ok, on_read, (void *)2), ESP_OK);
+    CHECK(wait_done(3));
+    for (int i = 0; i < 3; i++)
+        CHECK_EQ(done[i].tag, i);
+    CHECK_EQ(done[0].result.err, ESP_OK);
+    CHECK_EQ(done[1].result.err, ESP_ERR_TIMEOUT);
+    CHECK_EQ(done[2].result.err, ESP_OK);
+}
+
+/* requests beyond the queue are refused, not blocked on */
+static void test_queue_full(void)
+{
+    sensor_t sensor = SENSOR_DHT_DEV(DHT_TYPE_AM2301, 0);
+    int queued = 0;
+
+    atomic_store(&done_count, 0);
+    for (int i = 0; i < QUEUE_LEN + 4; i++)
+        queued += sensor_read_async(&sensor, on_read, (void *)(intptr_t)i) == ESP_OK;
+    // the worker may have taken one off already
+    CHECK(queued >= QUEUE_LEN && queued <= QUEUE_LEN + 1);
+    CHECK(wait_done(queued));
+    CHECK_EQ(sensor_async_init(QUEUE_LEN, 4096, 5, tskNO_AFFINITY), ESP_ERR_INVALID_STATE);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    TEST_RUN(test_not_started);
+    if (sensor_async_init(QUEUE_LEN, 4096, 5, tskNO_AFFINITY) != ESP_OK)
+        return 1;
+    host_clock_virtual(true);
+    TEST_RUN(test_order);
+    TEST_RUN(test_failure_in_order);
+    // the real 20 ms start pulse keeps the worker from draining the queue as it fills
+    host_clock_virtual(false);
+    TEST_RUN(test_queue_full);
+    return TEST_EXIT();
+}
@@ -0,0 +1,313 @@
+/**
+ * @file test_sensor_i2c.c
+ *
+ * Sensor backends: the conversions against the datasheet formulas, then
+ * each I2C backend through sessions of recorded bus transactions, errors
+ * included, and the DHT backend on the simulated line
+ */
+#include <math.h>
+#include <string.h>
+
+#include <dht_sim.h>
+#include <esp_log.h>
+#include "esp_timer.h"
+
+#include "host.h"
+#include "i2c_script.h"
+#include "sensor.h"
+
+#include "test.h"
+
+#define DHT_PIN     4
+
+/* a read that starts a conversion waits for it on the clock */
+static esp_err_t timed_read(sensor_t *sensor, int16_t *h, int16_t *t, int64_t *waited_ms)
+{
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = sensor_read(sensor, h, t);
+
+    *waited_ms = (esp_timer_get_time() - start) / 1000;
+    return err;
+}
+
+static void test_crc(void)
+{
+    // Sensirion datasheet example
+    CHECK_EQ(sensor_crc8((const uint8_t[]){ 0xBE, 0xEF }, 2, 0xFF), 0x92);
+    CHECK_EQ(sensor_crc8((const uint8_t[]){ 0x7C, 0x80 }, 2, 0x00), 0xF5);
+    CHECK_EQ(sensor_crc8(NULL, 0, 0xFF), 0xFF);
+}
+
+/* every code against the floating point formulas, within the rounding */
+static void test_conversions(void)
+{
+    int wrong = 0;
+
+    CHECK_EQ(sht3x_temperature(0x6666), 250);
+    CHECK_EQ(sht3x_temperature(0), -450);
+    CHECK_EQ(sht3x_temperature(0xFFFF), 1300);
+    CHECK_EQ(sht3x_humidity(0x8000), 500);
+    CHECK_EQ(si7021_humidity(0x7C80), 548);
+    CHECK_EQ(si7021_temperature(0x6640), 233);
+    CHECK_EQ(si7021_temperature(0), -469);
+    // Si7021 humidity codes reach past 0..100 %, the result is clamped
+    CHECK_EQ(si7021_humidity(0), 0);
+    CHECK_EQ(si7021_humidity(0xFFFF), 1000);
+
+    for (uint32_t code = 0; code <= 0xFFFF; code++)
+    {
+        double st = -45 + 175.0 * code / 65535, sh = 100.0 * code / 65535;
+        double it = 175.72 * code / 65536 - 46.85, ih = 125.0 * code / 65536 - 6;
+
+        ih = ih < 0 ? 0 : ih > 100 ? 100 : ih;
+        if (fabs(sht3x_temperature(code) - st * 10) > 0.51 || fabs(sht3x_humidity(code) - sh * 10) > 0.51
+            || fabs(si7021_temperature(code) - it * 10) > 0.51 || fabs(si7021_humidity(code) - ih * 10) > 0.51)
+            wrong++;
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+static void test_sht3x(void)
+{
+    sensor_t sht = SENSOR_I2C_DEV(sensor_sht3x, I2C_NUM_0, 0x44);
+    int16_t h = 0, t = 0;
+    int64_t waited_ms;
+
+    // status, then a measurement at 25.0 C and 50.0 %, then one with a bad humidity CRC
+    const i2c_txn_t session[] = {
+        { .addr = 0x44, .out = { 0xF3, 0x2D }, .out_len = 2, .in = { 0x80, 0x10, 0xE1 }, .in_len = 3 },
+        { .addr = 0x44, .out = { 0x24, 0x00 }, .out_len = 2 },
+        { .addr = 0x44, .in = { 0x66, 0x66, 0x93, 0x80, 0x00, 0xA2 }, .in_len = 6 },
+        { .addr = 0x44, .out = { 0x24, 0x00 }, .out_len = 2 },
+        { .addr = 0x44, .in = { 0x66, 0x66, 0x93, 0x80, 0x00, 0xA3 }, .in_len = 6 },
+    };
+    i2c_script_load(session, 5);
+    CHECK_EQ(sensor_init(&sht), ESP_OK);
+    CHECK_EQ(sht.min_interval_ms, 1000);
+    CHECK_EQ(timed_read(&sht, &h, &t, &waited_ms), ESP_OK);
+    CHECK_EQ(t, 250);
+    CHECK_EQ(h, 500);
+    CHECK(waited_ms >= 16);
+    CHECK_EQ(sensor_read(&sht, &h, &t), ESP_ERR_INVALID_CRC);
+    CHECK_EQ(i2c_script_left(), 0);
+    CHECK_EQ(i2c_script_mismatches(), 0);
+
+    // a corrupted status is not taken for a sensor, a NACK of the data ends the read
+    const i2c_txn_t broken[] = {
+        { .addr = 0x44, .out = { 0xF3, 0x2D }, .out_len = 2, .in = { 0x80, 0x10, 0xE0 }, .in_len = 3 },
+        { .addr = 0x44, .out = { 0xF3, 0x2D }, .out_len = 2, .in = { 0x80, 0x10, 0xE1 }, .in_len = 3 },
+        { .addr = 0x44, .out = { 0x24, 0x00 }, .out_len = 2 },
+        { .addr = 0x44, .in_len = 6, .err = ESP_FAIL },
+    };
+    sht.ready = false;
+    i2c_script_load(broken, 4);
+    CHECK_EQ(sensor_init(&sht), ESP_ERR_INVALID_CRC);
+    CHECK(!sht.ready);
+    CHECK_EQ(sensor_read(&sht, &h, &t), ESP_FAIL);
+    CHECK(sht.ready);
+    CHECK_EQ(i2c_script_left(), 0);
+    CHECK_EQ(i2c_script_mismatches(), 0);
+}
+
+static void test_si7021(void)
+{
+    sensor_t si = SENSOR_I2C_DEV(sensor_si7021, I2C_NUM_0, 0x40);
+    int16_t h = 0, t = 0;
+    int64_t waited_ms;
+
+    // absent at boot, connected later: the first read sets it up again
+    const i2c_txn_t session[] = {
+        { .addr = 0x40, .out = { 0xE7 }, .out_len = 1, .in_len = 1, .err = ESP_FAIL },
+        { .addr = 0x40, .out = { 0xE7 }, .out_len = 1, .in = { 0x3A }, .in_len = 1 },
+        { .addr = 0x40, .out = { 0xF5 }, .out_len = 1 },
+        { .addr = 0x40, .in = { 0x7C, 0x80, 0xF5 }, .in_len = 3 },
+        { .addr = 0x40, .out = { 0xE0 }, .out_len = 1, .in = { 0x66, 0x40 }, .in_len = 2 },
+        // the humidity CRC covers no temperature
+        { .addr = 0x40, .out = { 0xF5 }, .out_len = 1 },
+        { .addr = 0x40, .in = { 0x7C, 0x80, 0xF4 }, .in_len = 3 },
+        { .addr = 0x40, .out = { 0xE0 }, .out_len = 1, .in = { 0x66, 0x40 }, .in_len = 2 },
+    };
+    i2c_script_load(session, 8);
+    CHECK_EQ(sensor_init(&si), ESP_FAIL);
+    CHECK(!si.ready);
+    CHECK_EQ(timed_read(&si, &h, &t, &waited_ms), ESP_OK);
+    CHECK(si.ready);
+    CHECK_EQ(h, 548);
+    CHECK_EQ(t, 233);
+    CHECK(waited_ms >= 23);
+    CHECK_EQ(sensor_read(&si, &h, &t), ESP_ERR_INVALID_CRC);
+    CHECK_EQ(i2c_script_left(), 0);
+    CHECK_EQ(i2c_script_mismatches(), 0);
+}
+
+/* Bosch floating point compensation, datasheet section 8.1 */
+static double bme280_temperature_ref(const bme280_calib_t *c, int32_t adc_t, double *t_fine)
+{
+    double v1 = (adc_t / 16384.0 - c->t1 / 1024.0) * c->t2;
+    double v2 = (adc_t / 131072.0 - c->t1 / 8192.0) * (adc_t / 131072.0 - c->t1 / 8192.0) * c->t3;
+
+    *t_fine = v1 + v2;
+    return (v1 + v2) / 5120.0;
+}
+
+static double bme280_humidity_ref(const bme280_calib_t *c, int32_t adc_h, double t_fine)
+{
+    double h = t_fine - 76800.0;
+
+    h = (adc_h - (c->h4 * 64.0 + c->h5 / 16384.0 * h))
+        * (c->h2 / 65536.0 * (1.0 + c->h6 / 67108864.0 * h * (1.0 + c->h3 / 67108864.0 * h)));
+    h = h * (1.0 - c->h1 * h / 524288.0);
+    return h > 100 ? 100 : h < 0 ? 0 : h;
+}
+
+/* trimming registers with the Bosch example temperature parameters */
+static void bme280_trimming(uint8_t tp[BME280_CALIB_TP_LEN], uint8_t hc[BME280_CALIB_H_LEN])
+{
+    const uint16_t t1 = 27504;
+    const int16_t t2 = 26435, t3 = -1000, h2 = 362, h4 = 313, h5 = 50;
+
+    memset(tp, 0, BME280_CALIB_TP_LEN);
+    tp[0] = t1 & 0xFF;
+    tp[1] = t1 >> 8;
+    tp[2] = t2 & 0xFF;
+    tp[3] = (uint16_t)t2 >> 8;
+    tp[4] = t3 & 0xFF;
+    tp[5] = (uint16_t)t3 >> 8;
+    tp[25] = 75;                            // h1
+    hc[0] = h2 & 0xFF;
+    hc[1] = h2 >> 8;
+    hc[2] = 0;                              // h3
+    hc[3] = h4 >> 4;                        // h4 11:4, then h4 3:0 and h5 3:0 share a register
+    hc[4] = (h4 & 0xF) | (h5 & 0xF) << 4;
+    hc[5] = h5 >> 4;
+    hc[6] = 30;                             // h6
+}
+
+static void bme280_data(int32_t adc_t, int32_t adc_h, uint8_t data[BME280_DATA_LEN])
+{
+    data[0] = 0x50;
+    data[1] = data[2] = 0;
+    data[3] = adc_t >> 12;
+    data[4] = adc_t >> 4;
+    data[5] = (adc_t & 0xF) << 4;
+    data[6] = adc_h >> 8;
+    data[7] = adc_h;
+}
+
+static void test_bme280(void)
+{
+    sensor_t bme = SENSOR_I2C_DEV(sensor_bme280, I2C_NUM_0, 0x76);
+    i2c_txn_t session[] = {
+        { .addr = 0x76, .out = { 0xD0 }, .out_len = 1, .in = { 0x60 }, .in_len = 1 },
+        { .addr = 0x76, .out = { 0x88 }, .out_len = 1, .in_len = BME280_CALIB_TP_LEN },
+        { .addr = 0x76, .out = { 0xE1 }, .out_len = 1, .in_len = BME280_CALIB_H_LEN },
+        { .addr = 0x76, .out = { 0xF2, 0x01 }, .out_len = 2 },
+        { .addr = 0x76, .out = { 0xF4, 0x25 }, .out_len = 2 },
+        { .addr = 0x76, .out = { 0xF7 }, .out_len = 1, .in_len = BME280_DATA_LEN },
+    };
+    int16_t h = 0, t = 0;
+    int64_t waited_ms;
+    double t_fine;
+
+    bme280_trimming(session[1].in, session[2].in);
+    bme280_data(519888, 30000, session[5].in);
+    i2c_script_load(session, 6);
+    CHECK_EQ(sensor_init(&bme), ESP_OK);
+    CHECK_EQ(bme.bme280.t3, -1000);
+    CHECK_EQ(bme.bme280.h4, 313);
+    CHECK_EQ(bme.bme280.h5, 50);
+    CHECK_EQ(timed_read(&bme, &h, &t, &waited_ms), ESP_OK);
+    CHECK(waited_ms >= 10);
+    CHECK_EQ(i2c_script_left(), 0);
+    CHECK_EQ(i2c_script_mismatches(), 0);
+
+    // 25.08 C in the datasheet example
+    CHECK_EQ(t, 251);
+    double ref = bme280_humidity_ref(&bme.bme280, 30000, (bme280_temperature_ref(&bme.bme280, 519888, &t_fine), t_fine));
+    CHECK(fabs(h - ref * 10) <= 1);
+
+    // the integer formulas against the floating point ones over the range
+    int wrong = 0;
+    for (int32_t adc_t = 400000; adc_t <= 600000; adc_t += 997)
+    {
+        for (int32_t adc_h = 0; adc_h <= 0xFFFF; adc_h += 1021)
+        {
+            uint8_t data[BME280_DATA_LEN];
+            double t_ref = bme280_temperature_ref(&bme.bme280, adc_t, &t_fine);
+            double h_ref = bme280_humidity_ref(&bme.bme280, adc_h, t_fine);
+
+            bme280_data(adc_t, adc_h, data);
+            if (bme280_compensate(&bme.bme280, data, &h, &t) || fabs(t - t_ref * 10) > 1 || fabs(h - h_ref * 10) > 1)
+                wrong++;
+        }
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+static void test_bme280_errors(void)
+{
+    sensor_t bme = SENSOR_I2C_DEV(sensor_bme280, I2C_NUM_0, 0x76);
+    uint8_t tp[BME280_CALIB_TP_LEN], hc[BME280_CALIB_H_LEN];
+    int16_t h, t;
+
+    // a BMP280 answers on the same address, without humidity
+    const i2c_txn_t bmp280[] = { { .addr = 0x76, .out = { 0xD0 }, .out_len = 1, .in = { 0x58 }, .in_len = 1 } };
+    i2c_script_load(bmp280, 1);
+    CHECK_EQ(sensor_init(&bme), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(i2c_script_mismatches(), 0);
+
+    // h4 and h5 are signed 12-bit values split over nibbles
+    bme280_trimming(tp, hc);
+    hc[3] = 0xFF;
+    hc[4] = 0x8F;
+    hc[5] = 0xFF;
+    bme280_parse_calib(&bme.bme280, tp, hc);
+    CHECK_EQ(bme.bme280.h4, -1);
+    CHECK_EQ(bme.bme280.h5, -8);
+
+    // a measurement that did not run reads 0x80000
+    const uint8_t skipped[BME280_DATA_LEN] = { 0x80, 0, 0, 0x80, 0, 0, 0x80, 0 };
+    CHECK_EQ(bme280_compensate(&bme.bme280, skipped, &h, &t), -1);
+    CHECK_EQ(sensor_bme280.convert(&bme, skipped, &h, &t), ESP_ERR_INVALID_RESPONSE);
+}
+
+/* the bit-banged backend behind the same interface */
+static void test_dht(void)
+{
+    dht_sim_config_t config = { .type = DHT_TYPE_AM2301, .humidity = 613, .temperature = -47,
+                                .jitter_us = CONFIG_DHT_SIM_JITTER_US };
+    sensor_t dht = SENSOR_DHT_DEV(DHT_TYPE_AM2301, DHT_PIN);
+    char name[32];
+    int16_t h = 0, t = 0;
+
+    dht_sim_attach(DHT_PIN, &config);
+    CHECK_EQ(sensor_init(&dht), ESP_OK);
+    CHECK_EQ(dht.min_interval_ms, 2000);
+    CHECK_EQ(sensor_read(&dht, &h, &t), ESP_OK);
+    CHECK_EQ(h, 613);
+    CHECK_EQ(t, -47);
+    dht_sim_detach(DHT_PIN);
+
+    sensor_describe(&dht, name, sizeof(name));
+    CHECK(!strcmp(name, "dht on GPIO 4"));
+    sensor_t sht = SENSOR_I2C_DEV(sensor_sht3x, I2C_NUM_1, 0x45);
+    sensor_describe(&sht, name, sizeof(name));
+    CHECK(!strcmp(name, "sht3x on I2C1 0x45"));
+    CHECK_EQ(sensor_read(&sht, NULL, NULL), ESP_ERR_INVALID_ARG);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_NONE);
+    // conversions are waited for on the virtual clock
+    host_clock_virtual(true);
+
+    TEST_RUN(test_crc);
+    TEST_RUN(test_conversions);
+    TEST_RUN(test_sht3x);
+    TEST_RUN(test_si7021);
+    TEST_RUN(test_bme280);
+    TEST_RUN(test_bme280_errors);
+    TEST_RUN(test_dht);
+    return TEST_EXIT();
+}
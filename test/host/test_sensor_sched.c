@@ -0,0 +1,211 @@
+/**
+ * @file test_sensor_sched.c
+ *
+ * Sensor scheduler driven by a virtual clock: the task sleeps by moving
+ * the clock forward by the returned wait, and reads spend time the same
+ * way
+ */
+#include "sensor_sched.h"
+
+#include "test.h"
+
+#define MAX_STARTS  256
+
+static uint32_t now_ms;
+
+typedef struct
+{
+    int         id;
+    uint32_t    at_ms;
+} start_t;
+
+typedef struct
+{
+    uint32_t    read_ms;        // virtual time spent per read
+    bool        fail;           // reads fail
+    int         count;
+    start_t     starts[MAX_STARTS];
+} run_t;
+
+/* the sensor task: read what is due, sleep until the next one, up to `until_ms` */
+static void run_until(sensor_sched_t *sched, run_t *run, uint32_t until_ms)
+{
+    while ((int32_t)(now_ms - until_ms) < 0)
+    {
+        int id;
+        uint32_t wait = sensor_sched_next(sched, now_ms, &id);
+        if (id < 0)
+        {
+            now_ms = wait > until_ms - now_ms ? until_ms : now_ms + wait;
+            continue;
+        }
+        if (run->count < MAX_STARTS)
+            run->starts[run->count] = (start_t){ id, now_ms };
+        run->count++;
+        now_ms += run->read_ms;
+        sensor_sched_done(sched, id, !run->fail, 500 + id, 200 + id, now_ms);
+    }
+}
+
+/* first reads one gap apart, in registration order */
+static void test_stagger(void)
+{
+    sensor_sched_t sched = { 0 };
+    run_t run = { .read_ms = 25 };
+
+    now_ms = 1000;
+    for (int i = 0; i < 4; i++)
+        CHECK_EQ(sensor_sched_add(&sched, 2000, 2000, NULL, now_ms), i);
+    run_until(&sched, &run, 1500);
+    CHECK_EQ(run.count, 4);
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK_EQ(run.starts[i].id, i);
+        CHECK_EQ(run.starts[i].at_ms, 1000 + i * SENSOR_SCHED_GAP_MS);
+    }
+}
+
+/* sensors all due at once still start one gap apart */
+static void test_gap(void)
+{
+    sensor_sched_t sched = { 0 };
+    run_t run = { .read_ms = 5 };
+    int id;
+
+    now_ms = 0;
+    for (int i = 0; i < 8; i++)
+        sensor_sched_add(&sched, 100, 0, NULL, 0);
+
+    // the second sensor is due, the gap is not over
+    CHECK_EQ(sensor_sched_next(&sched, 0, &id), 0);
+    CHECK_EQ(id, 0);
+    sensor_sched_done(&sched, id, true, 0, 0, 10);
+    CHECK_EQ(sensor_sched_next(&sched, 10, &id), SENSOR_SCHED_GAP_MS - 10);
+    CHECK_EQ(id, -1);
+
+    now_ms = 10;
+    run_until(&sched, &run, 3010);
+    for (int i = 1; i < run.count; i++)
+        CHECK(run.starts[i].at_ms - run.starts[i - 1].at_ms >= SENSOR_SCHED_GAP_MS);
+    // 8 sensors at 100 ms ask for 80 reads/s, the gap allows 33
+    CHECK_EQ(run.count, 3000 / SENSOR_SCHED_GAP_MS);
+    CHECK_EQ(sched.reads, run.count + 1);
+}
+
+/* a sensor is never read faster than its type allows */
+static void test_min_interval(void)
+{
+    sensor_sched_t sched = { 0 };
+    run_t run = { .read_ms = 25 };
+
+    now_ms = 0;
+    sensor_sched_add(&sched, 500, 2000, NULL, 0);
+    sensor_sched_add(&sched, 1000, 1000, NULL, 0);
+    CHECK_EQ(sched.entries[0].interval_ms, 2000);
+
+    run_until(&sched, &run, 10000);
+    uint32_t last[2] = { 0 };
+    int reads[2] = { 0 };
+    for (int i = 0; i < run.count; i++)
+    {
+        int id = run.starts[i].id;
+        if (reads[id]++)
+            CHECK(run.starts[i].at_ms - last[id] >= (id ? 1000u : 2000u));
+        last[id] = run.starts[i].at_ms;
+    }
+    CHECK_EQ(reads[0], 5);
+    CHECK_EQ(reads[1], 10);
+}
+
+/* after a stall the missed slots are skipped, not read back to back */
+static void test_catch_up(void)
+{
+    sensor_sched_t sched = { 0 };
+    run_t run = { .read_ms = 25 };
+
+    now_ms = 0;
+    sensor_sched_add(&sched, 2000, 1000, NULL, 0);
+    run_until(&sched, &run, 5000);
+    CHECK_EQ(run.count, 3);
+
+    // the task is held up for 11.5 s, past five and a half slots
+    now_ms = 16500;
+    run.count = 0;
+    run_until(&sched, &run, 24000);
+    // one read at once, then back on the grid: 18, 20 and 22 s
+    CHECK_EQ(run.count, 4);
+    CHECK_EQ(run.starts[0].at_ms, 16500);
+    for (int i = 1; i < run.count; i++)
+        CHECK_EQ(run.starts[i].at_ms, 16000 + i * 2000);
+}
+
+static void test_results(void)
+{
+    sensor_sched_t sched = { 0 };
+    run_t run = { .read_ms = 25, .fail = true };
+    sample_t s;
+
+    now_ms = 0;
+    sensor_sched_add(&sched, 1000, 1000, NULL, 0);
+    sensor_sched_add(&sched, 1000, 1000, NULL, 0);
+    run_until(&sched, &run, 2500);
+    CHECK_EQ(sensor_sched_failures(&sched, 0), 3);
+    CHECK(!sample_read(sensor_sched_latest(&sched, 0), &s));
+
+    run.fail = false;
+    run_until(&sched, &run, 3500);
+    CHECK_EQ(sensor_sched_failures(&sched, 0), 0);
+    CHECK(sample_read(sensor_sched_latest(&sched, 1), &s));
+    CHECK_EQ(s.humidity, 501);
+    CHECK_EQ(s.temperature, 201);
+    CHECK(sensor_sched_latest(&sched, 2) == NULL);
+}
+
+/* the millisecond clock wraps after 49.7 days of uptime */
+static void test_wrap(void)
+{
+    sensor_sched_t sched = { 0 };
+    run_t run = { .read_ms = 25 };
+
+    now_ms = UINT32_MAX - 4999;
+    sensor_sched_add(&sched, 1000, 1000, NULL, now_ms);
+    sensor_sched_add(&sched, 2000, 2000, NULL, now_ms);
+    run_until(&sched, &run, now_ms + 10000);
+    CHECK_EQ(run.count, 15);
+
+    uint32_t last[2] = { 0 };
+    int reads[2] = { 0 };
+    for (int i = 0; i < run.count; i++)
+    {
+        int id = run.starts[i].id;
+        if (reads[id]++)
+            CHECK_EQ(run.starts[i].at_ms - last[id], id ? 2000 : 1000);
+        last[id] = run.starts[i].at_ms;
+    }
+}
+
+static void test_full(void)
+{
+    sensor_sched_t sched = { 0 };
+    int id;
+
+    for (int i = 0; i < SENSOR_SCHED_MAX; i++)
+        CHECK_EQ(sensor_sched_add(&sched, 1000, 1000, NULL, 0), i);
+    CHECK_EQ(sensor_sched_add(&sched, 1000, 1000, NULL, 0), -1);
+
+    sensor_sched_t empty = { 0 };
+    CHECK_EQ(sensor_sched_next(&empty, 0, &id), UINT32_MAX);
+    CHECK_EQ(id, -1);
+}
+
+int main(void)
+{
+    TEST_RUN(test_stagger);
+    TEST_RUN(test_gap);
+    TEST_RUN(test_min_interval);
+    TEST_RUN(test_catch_up);
+    TEST_RUN(test_results);
+    TEST_RUN(test_wrap);
+    TEST_RUN(test_full);
+    return TEST_EXIT();
+}
@@ -0,0 +1,138 @@
+/**
+ * @file test_url_builder.c
+ *
+ * Appends up to the last byte of the buffer, the overflow past it, and the
+ * integer and fixed-point formatting at the ends of their ranges
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "url_builder.h"
+
+#include "test.h"
+
+#define CHECK_STR(s, expected) do { \
+        const char *s_ = (s); \
+        CHECK(s_ && !strcmp(s_, expected)); \
+    } while (0)
+
+static void test_build(void)
+{
+    static const url_prefix_t prefix = URL_PREFIX("http://host/get?token=t");
+    char buf[64];
+    url_builder_t b;
+
+    CHECK_EQ(prefix.len, strlen("http://host/get?token=t"));
+    url_init(&b, buf, sizeof(buf));
+    url_append_prefix(&b, &prefix);
+    url_append_param(&b, "pin", "v2");
+    url_append_param_fixed1(&b, "v0", 247);
+    CHECK_STR(url_finish(&b), "http://host/get?token=t&pin=v2&v0=24.7");
+    CHECK_EQ(b.len, strlen(buf));
+
+    // an empty builder gives an empty string
+    url_init(&b, buf, sizeof(buf));
+    CHECK_STR(url_finish(&b), "");
+}
+
+/* the last byte is kept for the NUL, anything past it fails the whole URL */
+static void test_overflow(void)
+{
+    char buf[8];
+    url_builder_t b;
+
+    url_init(&b, buf, sizeof(buf));
+    url_append_str(&b, "1234567");
+    CHECK(!b.overflow);
+    CHECK_STR(url_finish(&b), "1234567");
+
+    url_init(&b, buf, sizeof(buf));
+    url_append_str(&b, "12345678");
+    CHECK(b.overflow);
+    CHECK(!url_finish(&b));
+    // nothing of the part that did not fit was written
+    CHECK_STR(buf, "");
+
+    // nor is anything after it, even a part that would fit
+    url_init(&b, buf, sizeof(buf));
+    url_append_str(&b, "1234");
+    url_append_int(&b, 12345);
+    url_append(&b, "5", 1);
+    CHECK(!url_finish(&b));
+    CHECK_EQ(b.len, 4);
+
+    url_init(&b, buf, sizeof(buf));
+    url_append_fixed1(&b, -123456);
+    CHECK(!url_finish(&b));
+
+    // a value that ends right before the NUL fits
+    url_init(&b, buf, sizeof(buf));
+    url_append_fixed1(&b, -12345);
+    CHECK_STR(url_finish(&b), "-1234.5");
+
+    url_init(&b, buf, 0);
+    url_append(&b, "", 0);
+    CHECK(!url_finish(&b));
+    url_init(&b, buf, 1);
+    CHECK_STR(url_finish(&b), "");
+    url_append(&b, "x", 1);
+    CHECK(!url_finish(&b));
+}
+
+static const char *int_str(char *buf, size_t size, int64_t value)
+{
+    url_builder_t b;
+
+    url_init(&b, buf, size);
+    url_append_int(&b, value);
+    return url_finish(&b);
+}
+
+static const char *fixed1_str(char *buf, size_t size, int32_t value)
+{
+    url_builder_t b;
+
+    url_init(&b, buf, size);
+    url_append_fixed1(&b, value);
+    return url_finish(&b);
+}
+
+static void test_int(void)
+{
+    char buf[24];
+
+    CHECK_STR(int_str(buf, sizeof(buf), 0), "0");
+    CHECK_STR(int_str(buf, sizeof(buf), 7), "7");
+    CHECK_STR(int_str(buf, sizeof(buf), -7), "-7");
+    CHECK_STR(int_str(buf, sizeof(buf), 1700000000000LL), "1700000000000");
+    CHECK_STR(int_str(buf, sizeof(buf), INT64_MAX), "9223372036854775807");
+    CHECK_STR(int_str(buf, sizeof(buf), INT64_MIN), "-9223372036854775808");
+    // 20 characters and the NUL
+    CHECK_STR(int_str(buf, 21, INT64_MIN), "-9223372036854775808");
+    CHECK(!int_str(buf, 20, INT64_MIN));
+}
+
+/* tenths, the sign kept when the whole part is zero */
+static void test_fixed1(void)
+{
+    char buf[16];
+
+    CHECK_STR(fixed1_str(buf, sizeof(buf), 0), "0.0");
+    CHECK_STR(fixed1_str(buf, sizeof(buf), 5), "0.5");
+    CHECK_STR(fixed1_str(buf, sizeof(buf), -5), "-0.5");
+    CHECK_STR(fixed1_str(buf, sizeof(buf), -10), "-1.0");
+    CHECK_STR(fixed1_str(buf, sizeof(buf), 247), "24.7");
+    CHECK_STR(fixed1_str(buf, sizeof(buf), -123), "-12.3");
+    CHECK_STR(fixed1_str(buf, sizeof(buf), INT16_MIN), "-3276.8");
+    CHECK_STR(fixed1_str(buf, sizeof(buf), INT32_MAX), "214748364.7");
+    CHECK_STR(fixed1_str(buf, sizeof(buf), INT32_MIN), "-214748364.8");
+}
+
+int main(void)
+{
+    TEST_RUN(test_build);
+    TEST_RUN(test_overflow);
+    TEST_RUN(test_int);
+    TEST_RUN(test_fixed1);
+    return TEST_EXIT();
+}
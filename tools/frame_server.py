@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+"""
+Stand-in receiver for the compact sample frames (main/sample_frame.h).
+
+    frame_server.py serve [--port 8090] [--forward http://blynk.cloud:8080]
+        Accept POST /frame?token=..., decode and print the samples. With
+        --forward, push them to the Blynk batch update API as the device
+        would have done without frames.
+
+    frame_server.py decode FILE
+        Decode a frame saved to a file.
+
+    frame_server.py compare [--samples 1000] [--batch 60]
+        Bytes on the wire for the same samples sent as one GET per sample
+        (the original write_http_request()), as history JSON POSTs and as
+        frames.
+"""
+import argparse
+import json
+import random
+import sys
+import time
+import urllib.parse
+import urllib.request
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+MAGIC = 0xF1
+TICK_MS = 100
+FLAG_UNIX_TIME = 0x01
+STREAM_SHIFT = 4            # rollup tier in the high nibble of the flags, 0 for raw
+
+# channel and tier of the device's history_pins[], same as in app_main.c
+PINS = [("v0", "temperature", 0), ("v1", "humidity", 0), ("v3", "humidity", 1)]
+
+TOKEN = "K4HSc6ttnPha6dyF2CdN_A_4JsNfIxbD"
+SERVER = "blynk.cloud:8080"
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def zigzag(v):
+    return (v << 1) ^ (v >> 63)
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def varint(v):
+    out = bytearray()
+    while v >= 0x80:
+        out.append((v & 0x7F) | 0x80)
+        v >>= 7
+    out.append(v)
+    return out
+
+
+def encode(samples, flags=FLAG_UNIX_TIME):
+    """samples: [(timestamp_ms, temperature_x10, humidity_x10)]"""
+    base = samples[0][0] if samples else 0
+    out = bytearray([MAGIC, flags])
+    out += varint(len(samples))
+    out += varint(zigzag(base))
+    prev = (0, 0, 0)
+    for ts, temp, hum in samples:
+        ticks = (ts - base + TICK_MS // 2) // TICK_MS
+        out += varint(ticks - prev[0])
+        out += varint(zigzag(temp - prev[1]))
+        out += varint(zigzag(hum - prev[2]))
+        prev = (ticks, temp, hum)
+    crc = crc16(out)
+    out += bytes([crc & 0xFF, crc >> 8])
+    return bytes(out)
+
+
+def decode(frame):
+    """Returns (flags, [(timestamp_ms, temperature_x10, humidity_x10)])"""
+    if len(frame) < 4 or frame[0] != MAGIC:
+        raise ValueError("bad magic")
+    if crc16(frame[:-2]) != frame[-2] | frame[-1] << 8:
+        raise ValueError("bad CRC")
+    body, pos = frame[:-2], 2
+
+    def get():
+        nonlocal pos
+        v, shift = 0, 0
+        while True:
+            if pos >= len(body):
+                raise ValueError("truncated")
+            b = body[pos]
+            pos += 1
+            v |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return v
+            shift += 7
+
+    flags = body[1]
+    count = get()
+    base = unzigzag(get())
+    ticks = temp = hum = 0
+    samples = []
+    for _ in range(count):
+        ticks += get()
+        temp += unzigzag(get())
+        hum += unzigzag(get())
+        samples.append((base + ticks * TICK_MS, temp, hum))
+    if pos != len(body):
+        raise ValueError("trailing bytes")
+    return flags, samples
+
+
+def to_unix(flags, samples):
+    """Relative frames carry sample ages, stamp them with our clock."""
+    if flags & FLAG_UNIX_TIME:
+        return samples
+    now = int(time.time() * 1000)
+    return [(now + ts, temp, hum) for ts, temp, hum in samples]
+
+
+def forward(server, token, stream, samples):
+    for pin, channel, tier in PINS:
+        if tier != stream:
+            continue
+        points = [[ts, (temp if channel == "temperature" else hum) / 10]
+                  for ts, temp, hum in samples]
+        url = "%s/external/api/batch/update?token=%s&pin=%s" % (server, token, pin)
+        req = urllib.request.Request(url, json.dumps(points).encode(),
+                                     {"Content-Type": "application/json"})
+        urllib.request.urlopen(req, timeout=10).read()
+
+
+class FrameHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    forward_to = None
+    received = 0
+    bytes_in = 0
+
+    def do_POST(self):
+        url = urllib.parse.urlsplit(self.path)
+        token = urllib.parse.parse_qs(url.query).get("token", [""])[0]
+        frame = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        try:
+            flags, samples = decode(frame)
+        except ValueError as e:
+            self.reply(400, str(e))
+            return
+
+        samples = to_unix(flags, samples)
+        FrameHandler.received += len(samples)
+        FrameHandler.bytes_in += len(frame)
+        for ts, temp, hum in samples:
+            print("%s %s %.1fC %.1f%%" % (token[:6], time.strftime(
+                "%Y-%m-%d %H:%M:%S", time.localtime(ts / 1000)), temp / 10, hum / 10))
+        print("%d samples in %d bytes, %.2f bytes/sample overall" % (
+            len(samples), len(frame), FrameHandler.bytes_in / max(FrameHandler.received, 1)))
+
+        if self.forward_to:
+            try:
+                forward(self.forward_to, token, flags >> STREAM_SHIFT, samples)
+            except OSError as e:
+                self.reply(502, str(e))
+                return
+        self.reply(200, "")
+
+    def reply(self, status, text):
+        body = text.encode()
+        self.send_response(status)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+def http_request(method, url, headers, body=b""):
+    """Request and response bytes as esp_http_client sends them, approximately."""
+    parts = urllib.parse.urlsplit(url)
+    path = parts.path + ("?" + parts.query if parts.query else "")
+    lines = ["%s %s HTTP/1.1" % (method, path),
+             "User-Agent: ESP32 HTTP Client/1.0",
+             "Host: %s" % parts.netloc]
+    lines += ["%s: %s" % h for h in headers]
+    if method == "POST":
+        lines.append("Content-Length: %d" % len(body))
+    request = len("\r\n".join(lines)) + 4 + len(body)
+    response = len("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n"
+                   "Connection: keep-alive\r\n\r\n")
+    return request + response
+
+
+def synthetic(n, interval_ms=60000):
+    rnd = random.Random(1)
+    ts, temp, hum = 1700000000000, 215, 480
+    samples = []
+    for _ in range(n):
+        samples.append((ts, temp, hum))
+        ts += interval_ms
+        temp += rnd.choice((-1, 0, 0, 1))
+        hum += rnd.choice((-3, -1, 0, 0, 1, 3))
+    return samples
+
+
+def compare(n, batch):
+    samples = synthetic(n)
+    api = "http://%s/external/api/" % SERVER
+
+    # original: one GET per sample, every value as text, humidity twice
+    legacy = sum(http_request("GET", "%sbatch/update?token=%s&v0=%.1f&v1=%.1f&v3=%.1f" % (
+        api, TOKEN, t / 10, h / 10, h / 10), []) for _, t, h in samples)
+
+    # history: one JSON POST per pin and batch
+    history = 0
+    for i in range(0, n, batch):
+        chunk = samples[i:i + batch]
+        for pin, channel, _ in PINS:
+            body = json.dumps([[ts, (t if channel == "temperature" else h) / 10]
+                               for ts, t, h in chunk], separators=(",", ":")).encode()
+            history += http_request("POST", "%sbatch/update?token=%s&pin=%s" % (api, TOKEN, pin),
+                                    [("Content-Type", "application/json")], body)
+
+    # frames: one binary POST per batch
+    frames = payload = 0
+    for i in range(0, n, batch):
+        body = encode(samples[i:i + batch])
+        payload += len(body)
+        frames += http_request("POST", "http://192.168.1.10:8090/frame?token=%s" % TOKEN,
+                               [("Content-Type", "application/octet-stream")], body)
+
+    raw = n * (8 + 2 + 2)
+    print("%d samples, %d per batch, HTTP request + response bytes, TCP/IP headers excluded" % (n, batch))
+    print("  raw int64 time + 2 x int16:  %8d" % raw)
+    print("  GET per sample (original):   %8d  %6.1f bytes/sample" % (legacy, legacy / n))
+    print("  history JSON POST per pin:   %8d  %6.1f bytes/sample" % (history, history / n))
+    print("  binary frame POST:           %8d  %6.1f bytes/sample (frame body %d)" % (
+        frames, frames / n, payload))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("serve")
+    p.add_argument("--port", type=int, default=8090)
+    p.add_argument("--forward", help="Blynk server URL, e.g. http://blynk.cloud:8080")
+    p = sub.add_parser("decode")
+    p.add_argument("file")
+    p = sub.add_parser("compare")
+    p.add_argument("--samples", type=int, default=1000)
+    p.add_argument("--batch", type=int, default=60)
+    args = parser.parse_args()
+
+    if args.cmd == "serve":
+        FrameHandler.forward_to = args.forward
+        HTTPServer(("", args.port), FrameHandler).serve_forever()
+    elif args.cmd == "decode":
+        with open(args.file, "rb") as f:
+            flags, samples = decode(f.read())
+        for ts, temp, hum in samples:
+            print("%d %.1f %.1f" % (ts, temp / 10, hum / 10))
+        print("flags 0x%02x, %d samples" % (flags, len(samples)), file=sys.stderr)
+    else:
+        compare(args.samples, args.batch)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+RAM used by the firmware per subsystem, checked against the budgets of the
+"Memory Budget" menu.
+
+    ram_report.py --map build/PROJECT.map --sdkconfig sdkconfig [--log LOG]
+
+Static RAM comes from the link map: the .data and .bss input sections
+placed in DRAM, summed per object file of the application and per library
+of the other components. With CONFIG_MEMORY_STATIC the task stacks of
+main/task_layout.c get a row each.
+
+A console log from a device running the same build adds what only exists
+at run time: the heap taken by each start-up step (MEM_REPORT lines, see
+main/mem_report.h), the lowest free heap and the stack high-water marks
+of the last metrics dump ('m' on the console, or CONFIG_METRICS_DUMP_S).
+Stack sizes are then suggested from the measured use plus
+CONFIG_MEMORY_STACK_MARGIN, rounded up to 256 bytes.
+
+Prints Markdown tables and exits with 1 when a budget is exceeded. The
+ram_report build target runs it after linking:
+
+    cmake --build build --target ram_report
+    cmake -D RAM_REPORT_LOG=boot.log build && cmake --build build --target ram_report
+"""
+import argparse
+import os
+import re
+import sys
+
+ANSI = re.compile(r"\x1b\[[0-9;]*m")
+OUTPUT_SECTION = re.compile(r"^(\.dram0\.(?:data|bss))\b")
+# an input section may be on its own line when its name is long
+INPUT = re.compile(r"^ (\S+)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$")
+INPUT_NAME = re.compile(r"^ (\S+)$")
+OBJECT = re.compile(r"(?:^|/)lib([^/]+)\.a\(([^)]+?)(?:\.c|\.cpp|\.S)?\.obj\)$")
+TASK_STACK = re.compile(r"^\.bss\.stack_(\w+)$")
+LAYOUT = re.compile(r"TASK_LAYOUT: (\S+) core=(-?\d+) prio=(\d+) stack=(\d+)")
+MEM_FREE = re.compile(r"MEM_REPORT: (\S+) free=(\d+) B")
+MEM_STEP = re.compile(r"MEM_REPORT: (\S+) heap=(-?\d+) B")
+HEAP = re.compile(r"^heap\s+free=(\d+) min=(\d+) B$")
+STACK = re.compile(r"^stack (\S+)\s+(\d+) B free$")
+
+# libraries whose objects are listed one by one
+APP_LIBS = ("main", "dht", "sensor")
+
+
+def read_sdkconfig(path):
+    config = {}
+    with open(path) as f:
+        for line in f:
+            name, sep, value = line.strip().partition("=")
+            if sep and name.startswith("CONFIG_"):
+                config[name[7:]] = value.strip('"')
+    return config
+
+
+def subsystem(obj):
+    m = OBJECT.search(obj)
+    if not m:
+        return os.path.basename(obj)
+    lib, name = m.groups()
+    return "%s/%s" % (lib, name) if lib in APP_LIBS else lib
+
+
+def parse_map(path):
+    """Bytes of .data and .bss per subsystem, static task stacks apart"""
+    usage = {}
+    stacks = {}
+    section = None
+    pending = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line and not line[0].isspace():
+                m = OUTPUT_SECTION.match(line)
+                section = m.group(1)[len(".dram0."):] if m else None
+                pending = None
+                continue
+            if not section:
+                continue
+            m = INPUT.match(line)
+            if m:
+                name = m.group(1) or pending
+                pending = None
+                size = int(m.group(3), 16)
+                if not size or not name or name == "*fill*":
+                    continue
+                s = TASK_STACK.match(name)
+                if s and "task_layout" in m.group(4):
+                    stacks[s.group(1)] = size
+                    continue
+                row = usage.setdefault(subsystem(m.group(4)), {"data": 0, "bss": 0})
+                row[section] += size
+                continue
+            m = INPUT_NAME.match(line)
+            pending = m.group(1) if m else None
+    return usage, stacks
+
+
+def parse_log(path):
+    run = {"boot_free": None, "steps": [], "heap": None, "stacks": {}, "layout": {}}
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = ANSI.sub("", line).rstrip()
+            m = LAYOUT.search(line)
+            if m:
+                run["layout"][m.group(1)] = int(m.group(4))
+                continue
+            m = MEM_FREE.search(line)
+            if m:
+                run["boot_free"] = int(m.group(2))
+                run["steps"] = []
+                continue
+            m = MEM_STEP.search(line)
+            if m:
+                run["steps"].append((m.group(1), int(m.group(2))))
+                continue
+            # the high-water marks only go down, the last dump wins
+            m = HEAP.match(line)
+            if m:
+                run["heap"] = (int(m.group(1)), int(m.group(2)))
+                continue
+            m = STACK.match(line)
+            if m:
+                run["stacks"][m.group(1)] = int(m.group(2))
+    return run
+
+
+def round_up(n, to=256):
+    return (n + to - 1) // to * to
+
+
+def report(map_path, sdkconfig, log_path):
+    config = read_sdkconfig(sdkconfig)
+    usage, stacks = parse_map(map_path)
+    over = []
+
+    print("| subsystem | .data | .bss | total |")
+    print("|---|---|---|---|")
+    total = 0
+    for name, row in sorted(usage.items(), key=lambda kv: -(kv[1]["data"] + kv[1]["bss"])):
+        size = row["data"] + row["bss"]
+        total += size
+        print("| %s | %d | %d | %d |" % (name, row["data"], row["bss"], size))
+    for name, size in sorted(stacks.items()):
+        total += size
+        print("| stack %s | 0 | %d | %d |" % (name, size, size))
+    print("| **total** | | | **%d** |" % total)
+
+    budget = int(config.get("MEMORY_BUDGET_STATIC_KB", "0")) * 1024
+    if budget and total > budget:
+        over.append("static RAM %d B over the budget of %d B" % (total, budget))
+
+    if log_path:
+        run = parse_log(log_path)
+        print()
+        print("| start-up step | heap B |")
+        print("|---|---|")
+        for name, size in run["steps"]:
+            print("| %s | %d |" % (name, size))
+
+        if run["heap"] and run["boot_free"] is not None:
+            peak = run["boot_free"] - run["heap"][1]
+            print("| **peak since boot** | **%d** |" % peak)
+            budget = int(config.get("MEMORY_BUDGET_HEAP_KB", "0")) * 1024
+            if budget and peak > budget:
+                over.append("peak heap %d B over the budget of %d B" % (peak, budget))
+        else:
+            print("| peak since boot | no MEM_REPORT boot line or metrics dump |")
+
+        margin = int(config.get("MEMORY_STACK_MARGIN", "512"))
+        print()
+        print("| task | stack B | used B | suggested B |")
+        print("|---|---|---|---|")
+        for name, free in sorted(run["stacks"].items()):
+            size = run["layout"].get(name)
+            if size is None:
+                print("| %s | ? | ? | ? |" % name)
+                continue
+            used = size - free
+            print("| %s | %d | %d | %d |" % (name, size, used, round_up(used + margin)))
+
+    for msg in over:
+        print("ram_report: %s" % msg, file=sys.stderr)
+    return 1 if over else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--map", required=True)
+    parser.add_argument("--sdkconfig", required=True)
+    parser.add_argument("--log")
+    args = parser.parse_args()
+    return report(args.map, args.sdkconfig, args.log)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Soak test of the task layouts (main/task_layout.h) with and without
+synthetic network load, and a report comparing them.
+
+    soak_report.py plan [--port /dev/ttyUSB0] [--minutes 60]
+        Print the commands building, flashing and capturing every layout in
+        tools/soak/*.cfg, idle and under the load of tools/soak/load.cfg.
+        Every build starts from the checked-in sdkconfig, so a run only
+        differs from another by its fragments.
+
+    soak_report.py capture --port /dev/ttyUSB0 --minutes 60 --out LOG
+        Log the console for the given time from a reset, then ask the
+        device for a metrics snapshot ('m') and save everything. Needs
+        pyserial.
+
+    soak_report.py report LOG...
+        One row per log, from its task layout lines and last metrics
+        snapshot: sensor placement, load, reads, failure rate, capture
+        jitter and read time percentiles, as a Markdown table.
+"""
+import argparse
+import glob
+import os
+import re
+import sys
+import time
+
+SOAK_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "soak")
+ANSI = re.compile(r"\x1b\[[0-9;]*m")
+LAYOUT = re.compile(r"TASK_LAYOUT: (\S+) core=(-?\d+) prio=(\d+) stack=(\d+)")
+LOAD = re.compile(r"NET_LOAD: (\d+) kbit/s")
+SNAPSHOT = re.compile(r"^--- metrics at (\d+) ms ---$")
+COUNTER = re.compile(r"^(\S+)\s+(\d+)$")
+HIST = re.compile(r"^(\S+)\s+n=(\d+) p50=(\d+) p90=(\d+) p99=(\d+) max=(\d+) us$")
+
+
+def plan(port, minutes):
+    layouts = sorted(f for f in glob.glob(os.path.join(SOAK_DIR, "*.cfg"))
+                     if os.path.basename(f) != "load.cfg")
+    for cfg in layouts:
+        name = os.path.splitext(os.path.basename(cfg))[0]
+        for load in (False, True):
+            run = name + ("-load" if load else "-idle")
+            defaults = ";".join(["sdkconfig", "tools/soak/%s.cfg" % name] +
+                                (["tools/soak/load.cfg"] if load else []))
+            print("# %s" % run)
+            print("idf.py -B build-%s -D SDKCONFIG=build-%s/sdkconfig -D SDKCONFIG_DEFAULTS=\"%s\" -p %s flash"
+                  % (run, run, defaults, port))
+            print("tools/soak_report.py capture --port %s --minutes %d --out soak-%s.log" % (port, minutes, run))
+    print("tools/soak_report.py report soak-*.log")
+
+
+def capture(port, minutes, out):
+    import serial   # pyserial, only needed here
+
+    with serial.Serial(port, 115200, timeout=1) as s, open(out, "w") as f:
+        # reset through RTS like idf.py monitor, so the log has the layout lines
+        s.dtr = False
+        s.rts = True
+        time.sleep(0.1)
+        s.rts = False
+        end = time.time() + minutes * 60
+        snapshot_at = None
+        while True:
+            line = s.readline().decode("utf-8", "replace")
+            if line:
+                f.write(line)
+            if snapshot_at is None and time.time() >= end:
+                s.write(b"m")
+                snapshot_at = time.time()
+            elif snapshot_at is not None and time.time() - snapshot_at > 3:
+                break
+
+
+def parse(path):
+    run = {"log": os.path.basename(path), "layout": {}, "load": 0, "metrics": {}, "uptime_ms": 0}
+    metrics = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = ANSI.sub("", line).rstrip()
+            m = LAYOUT.search(line)
+            if m:
+                run["layout"][m.group(1)] = tuple(int(v) for v in m.groups()[1:])
+                continue
+            m = LOAD.search(line)
+            if m:
+                run["load"] = int(m.group(1))
+                continue
+            m = SNAPSHOT.match(line)
+            if m:
+                # keep the last complete snapshot only
+                metrics = {}
+                run["uptime_ms"] = int(m.group(1))
+                run["metrics"] = metrics
+                continue
+            if metrics is None:
+                continue
+            m = HIST.match(line)
+            if m:
+                metrics[m.group(1)] = tuple(int(v) for v in m.groups()[1:])
+                continue
+            m = COUNTER.match(line)
+            if m:
+                metrics[m.group(1)] = int(m.group(2))
+    return run
+
+
+def report(paths):
+    runs = [parse(p) for p in paths]
+    print("| log | sensor core/prio | loop core | load kbit/s | hours | reads | failed | "
+          "jitter p50/p99/max us | read p99 us | wait p99 us |")
+    print("|---|---|---|---|---|---|---|---|---|---|")
+    for r in sorted(runs, key=lambda r: r["log"]):
+        m = r["metrics"]
+        if not m:
+            print("| %s | no metrics snapshot | | | | | | | | |" % r["log"])
+            continue
+        ok, failed = m.get("dht.ok", 0), m.get("dht.failed", 0)
+        sensor = r["layout"].get("sensor_async")
+        loop = r["layout"].get("main_loop")
+        jitter = m.get("dht.jitter", (0,) * 5)
+        print("| %s | %s | %s | %d | %.1f | %d | %.2f%% | %d/%d/%d | %d | %d |" % (
+            r["log"],
+            "%d/%d" % sensor[:2] if sensor else "?",
+            "%d" % loop[0] if loop else "?",
+            r["load"], r["uptime_ms"] / 3.6e6, ok + failed,
+            100.0 * failed / max(ok + failed, 1),
+            jitter[1], jitter[3], jitter[4],
+            m.get("dht.read", (0,) * 5)[3], m.get("dht.wait", (0,) * 5)[3]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("plan")
+    p.add_argument("--port", default="/dev/ttyUSB0")
+    p.add_argument("--minutes", type=int, default=60)
+    p = sub.add_parser("capture")
+    p.add_argument("--port", required=True)
+    p.add_argument("--minutes", type=int, default=60)
+    p.add_argument("--out", required=True)
+    p = sub.add_parser("report")
+    p.add_argument("logs", nargs="+")
+    args = parser.parse_args()
+
+    if args.cmd == "plan":
+        plan(args.port, args.minutes)
+    elif args.cmd == "capture":
+        capture(args.port, args.minutes, args.out)
+    else:
+        report(args.logs)
+
+
+if __name__ == "__main__":
+    sys.exit(main())